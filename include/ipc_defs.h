@@ -13,6 +13,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <sys/types.h>
+#include <time.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -27,12 +28,33 @@ extern "C" {
 /** Maximum length of a result string (two concatenated strings + null). */
 #define IPC_MAX_RESULT_LEN  33
 
+/** Size in bytes of the shared data arena for variable-size payloads. */
+#define IPC_ARENA_SIZE      (16u * 1024u * 1024u)
+
+/** Alignment (and header size) of every arena block. */
+#define IPC_ARENA_ALIGN     64u
+
+/** Number of streaming aggregation channels. */
+#define IPC_MAX_STREAMS     8
+
+/** Values buffered per stream ring (power of two). */
+#define IPC_STREAM_CAPACITY 4096u
+
+/** Entries in the shared string intern table (power of two). */
+#define IPC_INTERN_CAPACITY 4096u
+
+/** Entries in the client registration table. */
+#define IPC_MAX_CLIENTS     4096u
+
 /** Return code from ipc_get_result() when the result is not yet available. */
 #define IPC_NOT_READY       1
 
 /** Return code when server restart is detected and request context was invalidated. */
 #define IPC_ERR_SERVER_RESTARTED -2
 
+/** Return code when a blocking call's timeout expired; its request was cancelled. */
+#define IPC_ERR_TIMEOUT     -3
+
 /* --- IPC object names (POSIX shared memory and semaphores) --- */
 
 #define IPC_SHM_NAME        "/ipc_shm"
@@ -40,6 +62,45 @@ extern "C" {
 #define IPC_SERVER_SEM_NAME "/ipc_server_notify"
 #define IPC_SLOT_SEM_PREFIX "/ipc_slot_"
 
+/** Single-instance lock; holds the running server's pid as text. */
+#define IPC_SERVER_LOCK_FILE "/tmp/ipc_server.lock"
+
+/** Default Unix socket for live reconfiguration (server --control=, ipcctl). */
+#define IPC_CONTROL_SOCKET  "/tmp/ipc_server.ctl"
+
+/** Default warm-restart snapshot of the server's caches (server --cache-file=). */
+#define IPC_CACHE_SNAPSHOT_FILE "/tmp/ipc_server.cache"
+
+/*
+ * --- TCP gateway framing (ipc_gateway) ---
+ *
+ * Integers are little-endian. A request frame is
+ *   u32 length    bytes that follow (tag, command and payload)
+ *   u32 tag       chosen by the client, echoed in the response
+ *   u8  command   IPC_CMD_ADD, _SUB, _MUL, _DIV, _CONCAT or _SEARCH
+ *   payload       math: i32 a, i32 b
+ *                 strings: u8 len1, len1 bytes, u8 len2, len2 bytes
+ * and a response frame is
+ *   u32 length, u32 tag, u8 status (ipc_status_t or IPC_GW_STATUS_REJECTED)
+ *   payload       only for IPC_STATUS_OK: math i32 result, CONCAT u8 length
+ *                 and the bytes, SEARCH i32 position.
+ * A connection may pipeline any number of requests; responses can arrive in
+ * a different order and are matched by tag.
+ */
+#define IPC_GATEWAY_PORT       7878
+#define IPC_GW_MAX_FRAME       64     /**< Largest valid request length field. */
+#define IPC_GW_STATUS_REJECTED 0xFFu  /**< Unsupported or malformed request, or server gone. */
+
+/**
+ * @brief CLOCK_MONOTONIC in nanoseconds, the time base of request deadlines.
+ */
+static inline uint64_t ipc_monotonic_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
 /**
  * @brief Build the named semaphore path for a slot index.
  */
@@ -49,16 +110,21 @@ static inline void ipc_slot_sem_name(int index, char *buf, size_t buflen)
 }
 
 /**
- * @brief Validate IPC string argument length (1..IPC_MAX_STRING_LEN).
+ * @brief Measure an IPC string argument (1..IPC_MAX_STRING_LEN).
+ *
+ * The scan is bounded to IPC_MAX_STRING_LEN + 1 bytes, so over-long input is
+ * rejected without walking the whole string.
+ *
+ * @return The string length, or -1 if the string is NULL, empty or too long.
  */
-static inline int ipc_validate_string(const char *s)
+static inline int ipc_string_length(const char *s)
 {
     if (!s)
         return -1;
-    size_t len = strlen(s);
+    size_t len = strnlen(s, IPC_MAX_STRING_LEN + 1);
     if (len < 1 || len > IPC_MAX_STRING_LEN)
         return -1;
-    return 0;
+    return (int)len;
 }
 
 /**
@@ -70,9 +136,48 @@ typedef enum {
     IPC_CMD_MUL,
     IPC_CMD_DIV,
     IPC_CMD_CONCAT,
-    IPC_CMD_SEARCH
+    IPC_CMD_SEARCH,
+    IPC_CMD_MATMUL,
+    IPC_CMD_STR_SORT,
+    IPC_CMD_STR_DEDUPE,
+    IPC_CMD_STR_HASH,
+    IPC_CMD_REGEX_SEARCH,
+    IPC_CMD_STREAM_OPEN,
+    IPC_CMD_STREAM_QUERY,
+    IPC_CMD_STREAM_CLOSE,
+    IPC_CMD_SEARCH_BATCH,
+    IPC_CMD_CONCAT_INTERNED,
+    IPC_CMD_SEARCH_INTERNED
 } ipc_cmd_t;
 
+/**
+ * @brief Element types for matrices stored in the shared data arena.
+ */
+typedef enum {
+    IPC_DTYPE_INT32 = 0,
+    IPC_DTYPE_FLOAT32
+} ipc_dtype_t;
+
+/**
+ * @brief Hash algorithms for IPC_CMD_STR_HASH.
+ */
+typedef enum {
+    IPC_HASH_CRC32C = 0,
+    IPC_HASH_XXH32
+} ipc_hash_t;
+
+/**
+ * @brief Request priority levels (MessageSlot::priority).
+ */
+typedef enum {
+    IPC_PRIORITY_LOW = 0,
+    IPC_PRIORITY_NORMAL,
+    IPC_PRIORITY_HIGH
+} ipc_priority_t;
+
+/** Number of priority levels (one pool queue each). */
+#define IPC_PRIORITY_LEVELS 3
+
 /**
  * @brief Status codes returned in IPC responses.
  */
@@ -82,7 +187,8 @@ typedef enum {
     IPC_STATUS_NOT_FOUND,
     IPC_STATUS_STR_TOO_LONG,
     IPC_STATUS_INVALID_INPUT,
-    IPC_STATUS_INTERNAL_ERROR
+    IPC_STATUS_INTERNAL_ERROR,
+    IPC_STATUS_BUSY             /**< No free resource (e.g. all streams open). */
 } ipc_status_t;
 
 /**
@@ -92,7 +198,9 @@ typedef enum {
     IPC_SLOT_FREE = 0,
     IPC_SLOT_REQUEST_PENDING,
     IPC_SLOT_PROCESSING,
-    IPC_SLOT_RESPONSE_READY
+    IPC_SLOT_RESPONSE_READY,
+    IPC_SLOT_RESERVED,          /**< Idle in a client thread's slot magazine. */
+    IPC_SLOT_CLAIMED            /**< Taken from a magazine; its owner is writing the request. */
 } ipc_slot_state_t;
 
 /**
@@ -106,56 +214,435 @@ typedef struct {
 /**
  * @brief Arguments for string operations.
  *
- * Each string can be 1..16 characters long (plus null terminator).
+ * Each string can be 1..16 characters long (plus null terminator). The
+ * explicit lengths are authoritative: the server never scans for the
+ * terminator, and bytes past len1/len2 are unspecified.
  */
 typedef struct {
+    uint8_t len1;
+    uint8_t len2;
     char s1[IPC_MAX_STRING_LEN + 1];
     char s2[IPC_MAX_STRING_LEN + 1];
 } StringArgs;
 
+/**
+ * @brief Arguments for a matrix multiply over arena buffers.
+ *
+ * Computes C[m x n] = A[m x k] * B[k x n]. All matrices are dense row-major
+ * arrays of @c dtype elements; the offsets are arena offsets returned by
+ * ipc_arena_alloc(). Int32 products wrap on overflow. A @c c_off of 0 asks
+ * the server to allocate C (see ResultBufferRef).
+ */
+typedef struct {
+    uint32_t m;
+    uint32_t n;
+    uint32_t k;
+    uint32_t dtype;
+    uint64_t a_off;
+    uint64_t b_off;
+    uint64_t c_off;
+} MatmulArgs;
+
+/**
+ * @brief Reference to one string stored in the shared data arena.
+ *
+ * @c offset is an arena byte offset (no alignment requirement); the string is
+ * @c len bytes long and need not be null-terminated.
+ */
+typedef struct {
+    uint32_t offset;
+    uint32_t len;
+} IpcStrRef;
+
+/**
+ * @brief Arguments for bulk string commands (sort, dedupe, hash).
+ *
+ * @c refs_off names an arena buffer holding @c count IpcStrRef entries;
+ * @c out_off names an arena buffer receiving @c count uint32_t values, or is
+ * 0 to have the server allocate one (see ResultBufferRef).
+ */
+typedef struct {
+    uint64_t refs_off;
+    uint64_t out_off;
+    uint32_t count;
+    uint32_t algo;      /**< ipc_hash_t for IPC_CMD_STR_HASH, otherwise 0. */
+} StrArrayArgs;
+
+/**
+ * @brief Arguments for IPC_CMD_REGEX_SEARCH.
+ *
+ * Pattern and haystack are byte strings in the shared data arena (no null
+ * terminator needed). Patterns are limited to 1024 bytes.
+ */
+typedef struct {
+    uint64_t pattern_off;
+    uint64_t hay_off;
+    uint32_t pattern_len;
+    uint32_t hay_len;
+} RegexArgs;
+
+/**
+ * @brief Arguments for IPC_CMD_SEARCH_BATCH.
+ *
+ * One haystack (@c hay_len bytes at @c hay_off) is searched for @c count
+ * needles given as an IpcStrRef table at @c refs_off. The first position of
+ * each needle (-1 if absent, 0 for an empty needle) is written as int32_t to
+ * @c count entries at @c out_off (0: server-allocated, see ResultBufferRef).
+ */
+typedef struct {
+    uint64_t hay_off;
+    uint64_t refs_off;
+    uint64_t out_off;
+    uint32_t hay_len;
+    uint32_t count;
+} SearchBatchArgs;
+
+/**
+ * @brief Arguments for IPC_CMD_CONCAT_INTERNED / IPC_CMD_SEARCH_INTERNED.
+ *
+ * Both operands are intern table ids (see InternEntry), in the same roles
+ * as StringArgs::s1 / s2.
+ */
+typedef struct {
+    uint32_t id1;
+    uint32_t id2;
+} InternArgs;
+
+/**
+ * @brief Arguments for IPC_CMD_STREAM_QUERY / IPC_CMD_STREAM_CLOSE.
+ */
+typedef struct {
+    uint32_t stream_id;
+} StreamArgs;
+
 /**
  * @brief Request payload -- a union of math or string arguments.
  */
 typedef union {
-    MathArgs   math;
-    StringArgs str;
+    MathArgs     math;
+    StringArgs   str;
+    MatmulArgs   matmul;
+    StrArrayArgs str_array;
+    RegexArgs    regex;
+    StreamArgs   stream;
+    SearchBatchArgs search_batch;
+    InternArgs   intern;
 } RequestPayload;
 
+/**
+ * @brief Match span reported by IPC_CMD_REGEX_SEARCH.
+ *
+ * @c position overlays ResponsePayload::position.
+ */
+typedef struct {
+    int32_t  position;  /**< Byte offset of the match, -1 if none. */
+    uint32_t length;    /**< Match length in bytes (may be 0). */
+} RegexMatch;
+
+/**
+ * @brief Running aggregates of a stream (IPC_CMD_STREAM_QUERY / _CLOSE).
+ *
+ * Quantiles come from a log-linear histogram (8 sub-buckets per power of
+ * two), so they are within 6.25% of a true sample value; values below 16 in
+ * magnitude are exact. All fields are 0 while @c count is 0.
+ */
+typedef struct {
+    uint64_t count;
+    int64_t  sum;
+    double   mean;
+    int32_t  min;
+    int32_t  max;
+    int32_t  p50;
+    int32_t  p90;
+    int32_t  p99;
+} StreamStats;
+
+/**
+ * @brief Output buffer the server allocated for a bulk command.
+ *
+ * Bulk commands (matmul, string arrays, batched search) given an output
+ * offset of 0 have their output written to a buffer the server allocates on
+ * the client's behalf. @c count overlays ResponsePayload::count; @c offset is
+ * 0 if the client supplied its own buffer. The buffer starts with one
+ * reference (see ipc_result_view()).
+ */
+typedef struct {
+    uint32_t count;
+    uint32_t reserved;
+    uint64_t offset;
+    uint64_t bytes;
+} ResultBufferRef;
+
 /**
  * @brief Response payload -- a union of possible result types.
  */
 typedef union {
-    int32_t math_result;
-    char    str_result[IPC_MAX_RESULT_LEN];
-    int32_t position;
+    int32_t  math_result;
+    char     str_result[IPC_MAX_RESULT_LEN];
+    int32_t  position;
+    uint32_t count;     /**< Elements written by bulk commands. */
+    RegexMatch match;
+    uint32_t stream_id; /**< Channel opened by IPC_CMD_STREAM_OPEN. */
+    StreamStats stream;
+    ResultBufferRef result;
 } ResponsePayload;
 
 /**
- * @brief A single message slot in shared memory.
+ * @brief A single message slot in shared memory, a cache line multiple each.
  *
  * Each slot holds one in-flight request and its corresponding response.
  * The slot transitions through states:
  *   FREE -> REQUEST_PENDING -> PROCESSING -> RESPONSE_READY -> FREE
+ *
+ * A client thread with a slot magazine keeps its answered slots instead:
+ *   RESPONSE_READY -> RESERVED -> CLAIMED -> REQUEST_PENDING -> ...
+ * A RESERVED slot belongs to whoever clears @c magazine_tag by CAS: its
+ * owner, without /ipc_mutex, or under the mutex a claimant that found no
+ * free slot or the server taking back an idle or orphaned slot.
  */
 typedef struct {
     ipc_slot_state_t state;
     uint64_t         request_id;
     pid_t            client_pid;
     ipc_cmd_t        command;
+    uint8_t          priority;      /**< ipc_priority_t; higher levels run first. */
+    uint8_t          notify;        /**< Post the slot semaphore on completion. */
+    uint8_t          cancelled;     /**< Caller gave up; free the slot instead of answering. */
+    uint64_t         deadline_ns;   /**< ipc_monotonic_ns() deadline; 0 = none. */
     RequestPayload   request;
     ResponsePayload  response;
     ipc_status_t     status;
-} MessageSlot;
+    uint64_t         magazine_tag;    /**< Owning thread's token while RESERVED, else 0. */
+    uint64_t         reserved_epoch;  /**< client_epoch when the slot was last reserved. */
+} __attribute__((aligned(IPC_ARENA_ALIGN))) MessageSlot;
+
+/** Arena block states. */
+#define IPC_ARENA_BLOCK_FREE   0u   /**< On a free list (TLSF or slab). */
+#define IPC_ARENA_BLOCK_USED   1u   /**< Handed out by ipc_arena_alloc(). */
+#define IPC_ARENA_BLOCK_CACHED 2u   /**< Slab block held in a client magazine. */
+#define IPC_ARENA_BLOCK_SLAB   3u   /**< TLSF block carved into slab blocks. */
+
+/** Marker stored in every arena block header ("IPCA"). */
+#define IPC_ARENA_MAGIC      0x49504341u
+
+/** Slab size classes: payloads of 64 << c bytes, c < IPC_ARENA_CLASSES. */
+#define IPC_ARENA_CLASSES    7
+#define IPC_ARENA_NO_CLASS   0xFFFFFFFFu
+
+/** TLSF first-level (log2 of the block size) and second-level bin counts. */
+#define IPC_ARENA_FL_COUNT   25
+#define IPC_ARENA_SL_COUNT   8
+
+/**
+ * @brief Header preceding every block in the shared data arena.
+ *
+ * Blocks tile the arena back to back; the payload starts right after the
+ * header, so a payload offset is always a multiple of IPC_ARENA_ALIGN and
+ * never 0 (offset 0 is used as the "no buffer" handle). Slab blocks live
+ * inside an IPC_ARENA_BLOCK_SLAB block and carry headers of their own.
+ * Free-list links are payload offsets, 0 meaning none.
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t state;
+    pid_t    owner_pid;
+    uint32_t size_class;  /**< Slab class, or IPC_ARENA_NO_CLASS for TLSF blocks. */
+    uint64_t size;        /**< Whole block size including this header. */
+    uint64_t prev_size;   /**< Size of the physically preceding TLSF block, 0 if first. */
+    uint64_t next_free;
+    uint64_t prev_free;
+    uint32_t refs;        /**< Holders of a server-allocated result buffer, else 0. */
+    uint8_t  pad[IPC_ARENA_ALIGN - 52];
+} ArenaBlockHeader;
+
+/**
+ * @brief Allocator state of the data arena.
+ *
+ * Slab lists are lock-free stacks: the low 32 bits of a head hold the top
+ * block's payload offset / IPC_ARENA_ALIGN, the high 32 bits an ABA tag.
+ * The TLSF bitmaps and list heads and @c slab_next (the next unused chunk
+ * of the slab region at the top of the arena) are protected by /ipc_mutex.
+ * The bitmaps and occupancy counters are stored atomically, so status
+ * readers may load them without the mutex.
+ */
+typedef struct {
+    struct {
+        uint64_t head __attribute__((aligned(IPC_ARENA_ALIGN)));
+    } slab[IPC_ARENA_CLASSES];
+    uint64_t slab_next __attribute__((aligned(IPC_ARENA_ALIGN)));
+    uint32_t fl_bitmap;
+    uint32_t sl_bitmap[IPC_ARENA_FL_COUNT];
+    uint64_t free_heads[IPC_ARENA_FL_COUNT][IPC_ARENA_SL_COUNT];
+    uint64_t free_bytes;    /**< Bytes in free TLSF blocks. */
+    uint32_t used_blocks;   /**< TLSF blocks handed out (slab chunks excluded). */
+    uint32_t slab_chunks;   /**< Chunks carved into slab blocks. */
+} ArenaControl;
+
+/** Stream ring states. */
+#define IPC_STREAM_FREE 0u
+#define IPC_STREAM_OPEN 1u
+
+/**
+ * @brief Single-producer/single-consumer ring of int32 values.
+ *
+ * The owning client appends values and publishes @c head; the server
+ * consumes them and publishes @c tail. Both indices count values since the
+ * stream was opened and are accessed with atomic builtins, each on its own
+ * cache line. When the consumer goes idle it sets @c need_wakeup; the
+ * producer that clears it rings @c doorbell and posts the server semaphore,
+ * so a busy stream costs no semaphore traffic at all. @c state and
+ * @c owner_pid change only under /ipc_mutex.
+ */
+typedef struct {
+    uint64_t head __attribute__((aligned(IPC_ARENA_ALIGN)));
+    uint64_t tail __attribute__((aligned(IPC_ARENA_ALIGN)));
+    uint32_t need_wakeup __attribute__((aligned(IPC_ARENA_ALIGN)));
+    uint32_t doorbell;
+    uint32_t state;
+    pid_t    owner_pid;
+    int32_t  values[IPC_STREAM_CAPACITY] __attribute__((aligned(IPC_ARENA_ALIGN)));
+} StreamRing;
+
+/** Intern entry tags: empty, being written (BUSY | pid), or READY | 31 hash bits. */
+#define IPC_INTERN_EMPTY 0u
+#define IPC_INTERN_BUSY  1u
+#define IPC_INTERN_READY 0x80000000u
+
+/**
+ * @brief BUSY tag for an entry being filled in by @p pid.
+ *
+ * Like ipc_client_joining(), the claimer's pid is stored by the claiming CAS
+ * itself, so an entry left BUSY by a process that died mid-insert can be
+ * taken over by the next prober. Linux pids fit in 22 bits.
+ */
+static inline uint32_t ipc_intern_busy(pid_t pid)
+{
+    return ((uint32_t)pid << 1) | IPC_INTERN_BUSY;
+}
+
+static inline int ipc_intern_is_busy(uint32_t tag)
+{
+    return !(tag & IPC_INTERN_READY) && (tag & IPC_INTERN_BUSY);
+}
+
+/**
+ * @brief One interned string; its index in the table is the string's id.
+ *
+ * Clients insert without /ipc_mutex: an empty entry is claimed by a CAS of
+ * @c tag from EMPTY to ipc_intern_busy(pid), filled, and published by
+ * storing the READY tag with release order. Published entries never change
+ * until the server restarts, so ids stay valid for the server's lifetime.
+ */
+typedef struct {
+    uint32_t tag;
+    uint8_t  len;
+    char     bytes[IPC_MAX_STRING_LEN + 1];
+    uint8_t  pad[10];
+} InternEntry;
+
+/** FNV-1a hash of an interned string; also its probe start. */
+static inline uint32_t ipc_intern_hash(const char *s, size_t len)
+{
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; ++i)
+        h = (h ^ (uint8_t)s[i]) * 16777619u;
+    return h;
+}
+
+/** Client table entry states (low bits of ClientEntry::state). */
+#define IPC_CLIENT_FREE    0u
+#define IPC_CLIENT_JOINING 1u   /**< Claimed; being filled in or torn down. */
+#define IPC_CLIENT_ACTIVE  2u
+#define IPC_CLIENT_STATE_MASK 3u
+
+/**
+ * @brief JOINING state word for @p pid.
+ *
+ * The pid of the process filling in or tearing down an entry is stored in
+ * the state word itself, so it is recorded by the same CAS that claims the
+ * entry. If that process dies before the entry is published or freed, the
+ * server's sweep can still tell whose it was. Linux pids fit in 22 bits.
+ */
+static inline uint32_t ipc_client_joining(pid_t pid)
+{
+    return ((uint32_t)pid << 2) | IPC_CLIENT_JOINING;
+}
+
+/** Protocol features a registered client implements (ClientEntry::capabilities). */
+#define IPC_CLIENT_CAP_DEADLINE (1u << 0)   /**< Sets MessageSlot::deadline_ns. */
+#define IPC_CLIENT_CAP_PRIORITY (1u << 1)   /**< Sets MessageSlot::priority. */
+#define IPC_CLIENT_CAP_NOTIFY   (1u << 2)   /**< Waits on slot semaphores only if notify is set. */
+#define IPC_CLIENT_CAP_ARENA    (1u << 3)   /**< Allocates from the data arena. */
+
+/**
+ * @brief One registered client process, a cache line each.
+ *
+ * A client joins without /ipc_mutex by a CAS of @c state from FREE to
+ * ipc_client_joining(pid), fills in the entry and publishes it by storing
+ * ACTIVE with release order; it leaves by a CAS back to FREE. On every request it copies
+ * SharedMemoryLayout::client_epoch into @c heartbeat, so the server only has
+ * to probe clients that have gone quiet. @c start_time (clock ticks after
+ * boot, /proc/<pid>/stat field 22) tells a dead client from a new process
+ * that reuses its pid.
+ */
+typedef struct {
+    uint32_t state;
+    pid_t    pid;
+    uint64_t start_time;
+    uint32_t capabilities;
+    uint32_t reserved;
+    uint64_t heartbeat;     /**< client_epoch at the last request. */
+    uint64_t joined_epoch;  /**< client_epoch when the client joined. */
+    uint64_t requests;      /**< Requests submitted. */
+    uint64_t arena_allocs;  /**< Arena buffers allocated. */
+    uint64_t pad;
+} __attribute__((aligned(IPC_ARENA_ALIGN))) ClientEntry;
 
 /**
  * @brief Layout of the entire shared memory region.
+ *
+ * The data arena is a separate, cache-line aligned byte region carved into
+ * ArenaBlockHeader-prefixed blocks and managed through @c arena_ctl. It is
+ * reset on every server start.
  */
 typedef struct {
-    uint64_t    server_generation;
+    uint64_t    server_generation;   /**< 0 until the server's semaphores exist and after it exits. */
     uint64_t    next_request_id;
+    uint64_t    client_epoch;   /**< Advanced by each server liveness sweep. */
     MessageSlot slots[IPC_MAX_SLOTS];
+    StreamRing  streams[IPC_MAX_STREAMS];
+    InternEntry interns[IPC_INTERN_CAPACITY];
+    ClientEntry clients[IPC_MAX_CLIENTS];
+    ArenaControl arena_ctl;
+    uint8_t     arena[IPC_ARENA_SIZE] __attribute__((aligned(IPC_ARENA_ALIGN)));
 } SharedMemoryLayout;
 
+/**
+ * @brief Check that [offset, offset + bytes) lies inside one in-use arena block.
+ *
+ * Used by the server to validate client-supplied arena offsets before
+ * touching them. Caller must hold /ipc_mutex; slab blocks are freed without
+ * it, but only by clients, which must not free buffers of in-flight requests.
+ */
+static inline int ipc_arena_span_valid(const SharedMemoryLayout *shm,
+                                       uint64_t offset, uint64_t bytes)
+{
+    if (offset < IPC_ARENA_ALIGN || offset >= IPC_ARENA_SIZE ||
+        offset % IPC_ARENA_ALIGN != 0)
+        return 0;
+    const ArenaBlockHeader *hdr =
+        (const ArenaBlockHeader *)(shm->arena + offset - IPC_ARENA_ALIGN);
+    if (hdr->magic != IPC_ARENA_MAGIC || hdr->state != IPC_ARENA_BLOCK_USED)
+        return 0;
+    /* The header is client-writable: read the size once and bound it before
+     * any arithmetic, so a forged size can neither underflow nor wrap. */
+    uint64_t block_start = offset - IPC_ARENA_ALIGN;
+    uint64_t size = *(const volatile uint64_t *)&hdr->size;
+    if (size < IPC_ARENA_ALIGN || size > IPC_ARENA_SIZE - block_start)
+        return 0;
+    return bytes <= size - IPC_ARENA_ALIGN;
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,415 @@
+/**
+ * @file arena_alloc.cpp
+ * @brief Shared data arena: TLSF heap plus lock-free slab stacks.
+ *
+ * TLSF bins: a block of size s lives in list (fl, sl) with fl = log2(s) and
+ * sl the next three bits, so each power of two is split into eight ranges.
+ * Every block in a bin above the request's own bin fits, so after a short
+ * probe of the request's bin the bitmaps find a block in O(1).
+ */
+#include "arena_alloc.h"
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+
+namespace {
+
+constexpr uint64_t kMinBlock = 2 * IPC_ARENA_ALIGN;
+constexpr int      kSlBits = 3;
+constexpr int      kSameBinProbes = 8;
+
+inline ArenaBlockHeader *block_at(SharedMemoryLayout *shm, uint64_t block_off)
+{
+    return reinterpret_cast<ArenaBlockHeader *>(shm->arena + block_off);
+}
+
+/* Update a field only written under /ipc_mutex but read by status reporters. */
+template <typename T>
+inline void store_shared(T *field, T value)
+{
+    __atomic_store_n(field, value, __ATOMIC_RELAXED);
+}
+
+inline void bin_of(uint64_t size, int *fl, int *sl)
+{
+    *fl = 63 - __builtin_clzll(size);
+    *sl = static_cast<int>((size >> (*fl - kSlBits)) & (IPC_ARENA_SL_COUNT - 1));
+}
+
+void list_insert(SharedMemoryLayout *shm, uint64_t block_off)
+{
+    ArenaControl &ctl = shm->arena_ctl;
+    ArenaBlockHeader *hdr = block_at(shm, block_off);
+    int fl, sl;
+    bin_of(hdr->size, &fl, &sl);
+    uint64_t head = ctl.free_heads[fl][sl];
+    hdr->prev_free = 0;
+    hdr->next_free = head;
+    if (head)
+        block_at(shm, head - IPC_ARENA_ALIGN)->prev_free = block_off + IPC_ARENA_ALIGN;
+    ctl.free_heads[fl][sl] = block_off + IPC_ARENA_ALIGN;
+    store_shared(&ctl.sl_bitmap[fl], ctl.sl_bitmap[fl] | (1u << sl));
+    store_shared(&ctl.fl_bitmap, ctl.fl_bitmap | (1u << fl));
+}
+
+void list_remove(SharedMemoryLayout *shm, uint64_t block_off)
+{
+    ArenaControl &ctl = shm->arena_ctl;
+    ArenaBlockHeader *hdr = block_at(shm, block_off);
+    int fl, sl;
+    bin_of(hdr->size, &fl, &sl);
+    if (hdr->prev_free)
+        block_at(shm, hdr->prev_free - IPC_ARENA_ALIGN)->next_free = hdr->next_free;
+    else
+        ctl.free_heads[fl][sl] = hdr->next_free;
+    if (hdr->next_free)
+        block_at(shm, hdr->next_free - IPC_ARENA_ALIGN)->prev_free = hdr->prev_free;
+    if (!ctl.free_heads[fl][sl]) {
+        store_shared(&ctl.sl_bitmap[fl], ctl.sl_bitmap[fl] & ~(1u << sl));
+        if (!ctl.sl_bitmap[fl])
+            store_shared(&ctl.fl_bitmap, ctl.fl_bitmap & ~(1u << fl));
+    }
+}
+
+/* Block offset of a free block of at least @p need bytes, or UINT64_MAX. */
+uint64_t find_free(SharedMemoryLayout *shm, uint64_t need)
+{
+    ArenaControl &ctl = shm->arena_ctl;
+    int fl, sl;
+    bin_of(need, &fl, &sl);
+
+    // Blocks in the request's own bin may be too small; probe a few.
+    uint64_t p = ctl.free_heads[fl][sl];
+    for (int probe = 0; p && probe < kSameBinProbes; ++probe) {
+        const ArenaBlockHeader *hdr = block_at(shm, p - IPC_ARENA_ALIGN);
+        if (hdr->size >= need)
+            return p - IPC_ARENA_ALIGN;
+        p = hdr->next_free;
+    }
+
+    uint32_t sl_map = ctl.sl_bitmap[fl] & (~0u << (sl + 1));
+    if (!sl_map) {
+        uint32_t fl_map = ctl.fl_bitmap & (~0u << (fl + 1));
+        if (!fl_map)
+            return UINT64_MAX;
+        fl = __builtin_ctz(fl_map);
+        sl_map = ctl.sl_bitmap[fl];
+    }
+    sl = __builtin_ctz(sl_map);
+    return ctl.free_heads[fl][sl] - IPC_ARENA_ALIGN;
+}
+
+void init_header(ArenaBlockHeader *hdr, uint32_t state, uint64_t size, uint32_t size_class)
+{
+    memset(hdr, 0, sizeof(*hdr));
+    hdr->magic = IPC_ARENA_MAGIC;
+    hdr->state = state;
+    hdr->size = size;
+    hdr->size_class = size_class;
+}
+
+inline uint64_t stack_index(uint64_t payload_off)
+{
+    return payload_off / IPC_ARENA_ALIGN;
+}
+
+bool pid_alive(pid_t pid)
+{
+    return pid > 0 && (kill(pid, 0) == 0 || errno != ESRCH);
+}
+
+/* Owners whose blocks may be reclaimed: dead and without requests in flight. */
+class ReclaimFilter {
+public:
+    explicit ReclaimFilter(const SharedMemoryLayout *shm)
+    {
+        for (const MessageSlot &slot : shm->slots) {
+            if (slot.state == IPC_SLOT_REQUEST_PENDING || slot.state == IPC_SLOT_PROCESSING)
+                busy_[busy_count_++] = slot.client_pid;
+        }
+    }
+
+    bool reclaimable(pid_t pid)
+    {
+        if (pid <= 0)
+            return false;
+        for (int i = 0; i < busy_count_; ++i) {
+            if (busy_[i] == pid)
+                return false;
+        }
+        for (int i = 0; i < seen_count_; ++i) {
+            if (seen_[i] == pid)
+                return !seen_alive_[i];
+        }
+        bool alive = pid_alive(pid);
+        if (seen_count_ < kSeen) {
+            seen_[seen_count_] = pid;
+            seen_alive_[seen_count_++] = alive;
+        }
+        return !alive;
+    }
+
+private:
+    static constexpr int kSeen = 64;
+    pid_t busy_[IPC_MAX_SLOTS];
+    int   busy_count_ = 0;
+    pid_t seen_[kSeen];
+    bool  seen_alive_[kSeen];
+    int   seen_count_ = 0;
+};
+
+} // namespace
+
+int arena_size_class(uint64_t size)
+{
+    for (int cls = 0; cls < IPC_ARENA_CLASSES; ++cls) {
+        if (size <= (uint64_t{IPC_ARENA_ALIGN} << cls))
+            return cls;
+    }
+    return -1;
+}
+
+uint64_t arena_class_block_size(int cls)
+{
+    return (uint64_t{IPC_ARENA_ALIGN} << cls) + IPC_ARENA_ALIGN;
+}
+
+ArenaBlockHeader *arena_header(SharedMemoryLayout *shm, uint64_t payload_off)
+{
+    if (payload_off < IPC_ARENA_ALIGN || payload_off >= IPC_ARENA_SIZE ||
+        payload_off % IPC_ARENA_ALIGN != 0)
+        return nullptr;
+    ArenaBlockHeader *hdr = block_at(shm, payload_off - IPC_ARENA_ALIGN);
+    return hdr->magic == IPC_ARENA_MAGIC ? hdr : nullptr;
+}
+
+void arena_init(SharedMemoryLayout *shm)
+{
+    memset(&shm->arena_ctl, 0, sizeof(shm->arena_ctl));
+    shm->arena_ctl.slab_next = kArenaHeapEnd;
+    shm->arena_ctl.free_bytes = kArenaHeapEnd;
+    init_header(block_at(shm, 0), IPC_ARENA_BLOCK_FREE, kArenaHeapEnd, IPC_ARENA_NO_CLASS);
+    list_insert(shm, 0);
+}
+
+uint64_t arena_tlsf_alloc(SharedMemoryLayout *shm, uint64_t size, pid_t owner)
+{
+    if (size == 0 || size > kArenaHeapEnd - IPC_ARENA_ALIGN)
+        return 0;
+    uint64_t need = (size + 2 * IPC_ARENA_ALIGN - 1) & ~uint64_t{IPC_ARENA_ALIGN - 1};
+    uint64_t block_off = find_free(shm, need);
+    if (block_off == UINT64_MAX)
+        return 0;
+
+    list_remove(shm, block_off);
+    ArenaBlockHeader *hdr = block_at(shm, block_off);
+    if (hdr->size - need >= kMinBlock) {
+        uint64_t rest_off = block_off + need;
+        init_header(block_at(shm, rest_off), IPC_ARENA_BLOCK_FREE, hdr->size - need,
+                    IPC_ARENA_NO_CLASS);
+        block_at(shm, rest_off)->prev_size = need;
+        uint64_t after = block_off + hdr->size;
+        if (after < kArenaHeapEnd)
+            block_at(shm, after)->prev_size = hdr->size - need;
+        hdr->size = need;
+        list_insert(shm, rest_off);
+    }
+    hdr->state = IPC_ARENA_BLOCK_USED;
+    hdr->owner_pid = owner;
+    hdr->size_class = IPC_ARENA_NO_CLASS;
+    hdr->refs = 0;
+    ArenaControl &ctl = shm->arena_ctl;
+    store_shared(&ctl.free_bytes, ctl.free_bytes - hdr->size);
+    store_shared(&ctl.used_blocks, ctl.used_blocks + 1);
+    return block_off + IPC_ARENA_ALIGN;
+}
+
+uint64_t arena_tlsf_free(SharedMemoryLayout *shm, uint64_t payload_off)
+{
+    uint64_t block_off = payload_off - IPC_ARENA_ALIGN;
+    ArenaBlockHeader *hdr = block_at(shm, block_off);
+    hdr->state = IPC_ARENA_BLOCK_FREE;
+    hdr->owner_pid = 0;
+    ArenaControl &ctl = shm->arena_ctl;
+    store_shared(&ctl.free_bytes, ctl.free_bytes + hdr->size);
+    store_shared(&ctl.used_blocks, ctl.used_blocks - 1);
+
+    uint64_t next_off = block_off + hdr->size;
+    if (next_off < kArenaHeapEnd && block_at(shm, next_off)->state == IPC_ARENA_BLOCK_FREE) {
+        list_remove(shm, next_off);
+        hdr->size += block_at(shm, next_off)->size;
+        block_at(shm, next_off)->magic = 0;
+    }
+    if (hdr->prev_size) {
+        uint64_t prev_off = block_off - hdr->prev_size;
+        ArenaBlockHeader *prev = block_at(shm, prev_off);
+        if (prev->state == IPC_ARENA_BLOCK_FREE) {
+            list_remove(shm, prev_off);
+            prev->size += hdr->size;
+            hdr->magic = 0;
+            block_off = prev_off;
+            hdr = prev;
+        }
+    }
+    uint64_t after = block_off + hdr->size;
+    if (after < kArenaHeapEnd)
+        block_at(shm, after)->prev_size = hdr->size;
+    list_insert(shm, block_off);
+    return block_off;
+}
+
+uint64_t arena_slab_pop(SharedMemoryLayout *shm, int cls)
+{
+    uint64_t *head = &shm->arena_ctl.slab[cls].head;
+    uint64_t old = __atomic_load_n(head, __ATOMIC_ACQUIRE);
+    while (static_cast<uint32_t>(old) != 0) {
+        uint64_t payload_off = static_cast<uint64_t>(static_cast<uint32_t>(old)) * IPC_ARENA_ALIGN;
+        // May read a block another thread just popped; the tag makes the CAS fail then.
+        uint64_t next = __atomic_load_n(&block_at(shm, payload_off - IPC_ARENA_ALIGN)->next_free,
+                                        __ATOMIC_RELAXED);
+        uint64_t desired = (((old >> 32) + 1) << 32) | stack_index(next);
+        if (__atomic_compare_exchange_n(head, &old, desired, true, __ATOMIC_ACQUIRE,
+                                        __ATOMIC_ACQUIRE))
+            return payload_off;
+    }
+    return 0;
+}
+
+void arena_slab_push(SharedMemoryLayout *shm, int cls, uint64_t payload_off)
+{
+    uint64_t *head = &shm->arena_ctl.slab[cls].head;
+    ArenaBlockHeader *hdr = block_at(shm, payload_off - IPC_ARENA_ALIGN);
+    uint64_t old = __atomic_load_n(head, __ATOMIC_RELAXED);
+    uint64_t desired;
+    do {
+        __atomic_store_n(&hdr->next_free,
+                         static_cast<uint64_t>(static_cast<uint32_t>(old)) * IPC_ARENA_ALIGN,
+                         __ATOMIC_RELAXED);
+        desired = (((old >> 32) + 1) << 32) | stack_index(payload_off);
+    } while (!__atomic_compare_exchange_n(head, &old, desired, true, __ATOMIC_RELEASE,
+                                          __ATOMIC_RELAXED));
+}
+
+uint32_t arena_slab_carve(SharedMemoryLayout *shm, int cls, pid_t owner,
+                          uint64_t *out, uint32_t max)
+{
+    ArenaControl &ctl = shm->arena_ctl;
+    uint64_t chunk;
+    if (ctl.slab_next + kArenaSlabChunk <= IPC_ARENA_SIZE) {
+        init_header(block_at(shm, ctl.slab_next), IPC_ARENA_BLOCK_SLAB, kArenaSlabChunk,
+                    static_cast<uint32_t>(cls));
+        chunk = ctl.slab_next + IPC_ARENA_ALIGN;
+        ctl.slab_next += kArenaSlabChunk;
+    } else {
+        chunk = arena_tlsf_alloc(shm, kArenaSlabChunk - IPC_ARENA_ALIGN, 0);
+        if (!chunk)
+            return 0;
+        store_shared(&ctl.used_blocks, ctl.used_blocks - 1);
+    }
+    store_shared(&ctl.slab_chunks, ctl.slab_chunks + 1);
+    ArenaBlockHeader *chunk_hdr = block_at(shm, chunk - IPC_ARENA_ALIGN);
+    chunk_hdr->state = IPC_ARENA_BLOCK_SLAB;
+    chunk_hdr->size_class = static_cast<uint32_t>(cls);
+
+    uint64_t block_size = arena_class_block_size(cls);
+    uint64_t blocks = (chunk_hdr->size - IPC_ARENA_ALIGN) / block_size;
+    uint32_t handed = 0;
+    for (uint64_t b = 0; b < blocks; ++b) {
+        uint64_t block_off = chunk + b * block_size;
+        ArenaBlockHeader *hdr = block_at(shm, block_off);
+        if (handed < max) {
+            init_header(hdr, IPC_ARENA_BLOCK_CACHED, block_size, static_cast<uint32_t>(cls));
+            hdr->owner_pid = owner;
+            out[handed++] = block_off + IPC_ARENA_ALIGN;
+        } else {
+            init_header(hdr, IPC_ARENA_BLOCK_FREE, block_size, static_cast<uint32_t>(cls));
+            arena_slab_push(shm, cls, block_off + IPC_ARENA_ALIGN);
+        }
+    }
+    return handed;
+}
+
+uint64_t arena_alloc_block(SharedMemoryLayout *shm, uint64_t size, pid_t owner)
+{
+    int cls = arena_size_class(size);
+    if (cls < 0)
+        return arena_tlsf_alloc(shm, size, owner);
+
+    uint64_t off = arena_slab_pop(shm, cls);
+    if (!off && arena_slab_carve(shm, cls, owner, &off, 1) == 0)
+        return 0;
+    ArenaBlockHeader *hdr = block_at(shm, off - IPC_ARENA_ALIGN);
+    hdr->owner_pid = owner;
+    __atomic_store_n(&hdr->state, IPC_ARENA_BLOCK_USED, __ATOMIC_RELEASE);
+    return off;
+}
+
+void arena_free_block(SharedMemoryLayout *shm, uint64_t payload_off)
+{
+    ArenaBlockHeader *hdr = block_at(shm, payload_off - IPC_ARENA_ALIGN);
+    hdr->refs = 0;
+    if (hdr->size_class == IPC_ARENA_NO_CLASS) {
+        arena_tlsf_free(shm, payload_off);
+        return;
+    }
+    hdr->owner_pid = 0;
+    __atomic_store_n(&hdr->state, IPC_ARENA_BLOCK_FREE, __ATOMIC_RELEASE);
+    arena_slab_push(shm, static_cast<int>(hdr->size_class), payload_off);
+}
+
+uint64_t arena_reclaim(SharedMemoryLayout *shm)
+{
+    // Heap blocks tile [0, kArenaHeapEnd) and region chunks follow them.
+    ReclaimFilter filter(shm);
+    uint64_t end = shm->arena_ctl.slab_next;
+    uint64_t reclaimed = 0;
+    uint64_t pos = 0;
+    while (pos < end) {
+        ArenaBlockHeader *hdr = block_at(shm, pos);
+        if (hdr->magic != IPC_ARENA_MAGIC || hdr->size < kMinBlock || hdr->size > end - pos)
+            break;   // corrupted; leave the rest alone
+
+        if (hdr->state == IPC_ARENA_BLOCK_USED && filter.reclaimable(hdr->owner_pid)) {
+            reclaimed += hdr->size;
+            pos = arena_tlsf_free(shm, pos + IPC_ARENA_ALIGN);
+            hdr = block_at(shm, pos);
+        } else if (hdr->state == IPC_ARENA_BLOCK_SLAB) {
+            int cls = static_cast<int>(hdr->size_class);
+            uint64_t block_size = arena_class_block_size(cls);
+            uint64_t blocks = (hdr->size - IPC_ARENA_ALIGN) / block_size;
+            for (uint64_t b = 0; b < blocks; ++b) {
+                uint64_t block_off = pos + IPC_ARENA_ALIGN + b * block_size;
+                ArenaBlockHeader *inner = block_at(shm, block_off);
+                uint32_t state = __atomic_load_n(&inner->state, __ATOMIC_ACQUIRE);
+                if ((state == IPC_ARENA_BLOCK_USED || state == IPC_ARENA_BLOCK_CACHED) &&
+                    filter.reclaimable(inner->owner_pid) &&
+                    __atomic_compare_exchange_n(&inner->state, &state, IPC_ARENA_BLOCK_FREE,
+                                                false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+                    inner->owner_pid = 0;
+                    inner->refs = 0;
+                    arena_slab_push(shm, cls, block_off + IPC_ARENA_ALIGN);
+                    reclaimed += block_size;
+                }
+            }
+        }
+        pos += hdr->size;
+    }
+    return reclaimed;
+}
+
+void arena_stats(const SharedMemoryLayout *shm, ArenaStats *out)
+{
+    const ArenaControl &ctl = shm->arena_ctl;
+    out->free_bytes = __atomic_load_n(&ctl.free_bytes, __ATOMIC_RELAXED);
+    out->used_blocks = __atomic_load_n(&ctl.used_blocks, __ATOMIC_RELAXED);
+    out->slab_chunks = __atomic_load_n(&ctl.slab_chunks, __ATOMIC_RELAXED);
+    out->largest_free = 0;
+    uint32_t fl_map = __atomic_load_n(&ctl.fl_bitmap, __ATOMIC_RELAXED);
+    if (fl_map) {
+        int fl = 31 - __builtin_clz(fl_map);
+        uint32_t sl_map = __atomic_load_n(&ctl.sl_bitmap[fl], __ATOMIC_RELAXED);
+        int sl = sl_map ? 31 - __builtin_clz(sl_map) : 0;
+        out->largest_free = (uint64_t{1} << fl) + (static_cast<uint64_t>(sl) << (fl - kSlBits));
+    }
+}
@@ -0,0 +1,114 @@
+/**
+ * @file arena_alloc.h
+ * @brief Allocator for the shared data arena (used by libipc and the server).
+ *
+ * Buffers of up to 4 KiB come from slabs: per size class, 64 KiB chunks are
+ * carved into equal blocks kept on a lock-free stack in shared memory, which
+ * clients front with per-thread magazines. Chunks come from a slab region at
+ * the top of the arena, so long-lived small buffers do not fragment the rest,
+ * and from the TLSF heap once the region is used up. Larger buffers come from
+ * a two-level segregated fit (TLSF) heap with O(1) allocate/free and immediate
+ * coalescing, guarded by /ipc_mutex.
+ */
+#ifndef ARENA_ALLOC_H
+#define ARENA_ALLOC_H
+
+#include "ipc_defs.h"
+
+#include <cstdint>
+
+/** Size of a slab chunk, including its own block header. */
+constexpr uint64_t kArenaSlabChunk = 64 * 1024;
+
+/** Slab region at the top of the arena; the TLSF heap covers the rest. */
+constexpr uint64_t kArenaSlabRegion = IPC_ARENA_SIZE / 8;
+constexpr uint64_t kArenaHeapEnd = IPC_ARENA_SIZE - kArenaSlabRegion;
+
+/** Slab class for a payload of @p size bytes, or -1 if it goes to TLSF. */
+int arena_size_class(uint64_t size);
+
+/** Whole block size (header included) of slab class @p cls. */
+uint64_t arena_class_block_size(int cls);
+
+/**
+ * @brief Header of the block whose payload starts at @p payload_off.
+ * @return nullptr unless the offset is in range, aligned and names a block.
+ */
+ArenaBlockHeader *arena_header(SharedMemoryLayout *shm, uint64_t payload_off);
+
+/** Reset the arena to one free TLSF block and an unused slab region (server start). */
+void arena_init(SharedMemoryLayout *shm);
+
+/**
+ * @brief Allocate a TLSF block with room for @p size payload bytes.
+ *
+ * Caller must hold /ipc_mutex.
+ *
+ * @return Payload offset of an IPC_ARENA_BLOCK_USED block, or 0 if no free
+ *         block is large enough.
+ */
+uint64_t arena_tlsf_alloc(SharedMemoryLayout *shm, uint64_t size, pid_t owner);
+
+/**
+ * @brief Free a TLSF block and merge it with free neighbours.
+ *
+ * Caller must hold /ipc_mutex.
+ *
+ * @return Block offset (header, not payload) of the resulting free block.
+ */
+uint64_t arena_tlsf_free(SharedMemoryLayout *shm, uint64_t payload_off);
+
+/** Pop a free block of class @p cls; lock-free. Returns its payload offset or 0. */
+uint64_t arena_slab_pop(SharedMemoryLayout *shm, int cls);
+
+/** Push a block (already marked free) onto the stack of class @p cls; lock-free. */
+void arena_slab_push(SharedMemoryLayout *shm, int cls, uint64_t payload_off);
+
+/**
+ * @brief Carve a new slab chunk for class @p cls.
+ *
+ * Up to @p max blocks are handed to the caller in @p out, marked
+ * IPC_ARENA_BLOCK_CACHED for @p owner; the rest go onto the class stack.
+ * Caller must hold /ipc_mutex.
+ *
+ * @return Number of blocks written to @p out; 0 if the TLSF heap is full.
+ */
+uint32_t arena_slab_carve(SharedMemoryLayout *shm, int cls, pid_t owner,
+                          uint64_t *out, uint32_t max);
+
+/**
+ * @brief Allocate a buffer of either kind for @p owner (server side).
+ *
+ * Small buffers come off the class stack (carving a chunk if it is empty),
+ * larger ones from the TLSF heap. Caller must hold /ipc_mutex.
+ *
+ * @return Payload offset of an IPC_ARENA_BLOCK_USED block, or 0.
+ */
+uint64_t arena_alloc_block(SharedMemoryLayout *shm, uint64_t size, pid_t owner);
+
+/** Free a block from arena_alloc_block(). Caller must hold /ipc_mutex. */
+void arena_free_block(SharedMemoryLayout *shm, uint64_t payload_off);
+
+/**
+ * @brief Return the blocks of dead clients to the free lists.
+ *
+ * A client's buffers belong to its in-flight requests until they complete,
+ * so owners with pending or processing slots are skipped. Caller must hold
+ * /ipc_mutex.
+ *
+ * @return Number of bytes reclaimed.
+ */
+uint64_t arena_reclaim(SharedMemoryLayout *shm);
+
+/** Occupancy snapshot for status reports. */
+struct ArenaStats {
+    uint64_t free_bytes;      ///< Bytes in free TLSF blocks.
+    uint64_t largest_free;    ///< Lower bound of the largest free TLSF block (its bin).
+    uint32_t used_blocks;     ///< TLSF blocks handed out to clients.
+    uint32_t slab_chunks;     ///< Chunks carved into slab blocks.
+};
+
+/** Read the occupancy counters; lock-free, so fields may be mutually stale. */
+void arena_stats(const SharedMemoryLayout *shm, ArenaStats *out);
+
+#endif /* ARENA_ALLOC_H */
@@ -0,0 +1,212 @@
+/**
+ * @file cache_snapshot.cpp
+ * @brief Cache snapshot file: serialization, atomic save, mapped load.
+ *
+ * File layout (all integers in host byte order; the file is not portable
+ * between architectures, and the version check does not pretend otherwise):
+ *
+ *   FileHeader                      64 bytes
+ *   SnapshotIntern[intern_count]    at intern_offset
+ *   pattern records                 at pattern_offset, each a uint32_t
+ *                                   length and the pattern bytes, padded to 8
+ */
+#include "cache_snapshot.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+namespace {
+
+constexpr char kMagic[8] = {'I', 'P', 'C', 'S', 'N', 'A', 'P', '\0'};
+
+struct FileHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t intern_capacity;      ///< IPC_INTERN_CAPACITY; ids are hash positions.
+    uint32_t intern_record_size;   ///< sizeof(SnapshotIntern).
+    uint32_t intern_count;
+    uint32_t pattern_count;
+    uint64_t intern_offset;
+    uint64_t pattern_offset;
+    uint64_t file_size;
+    uint64_t checksum;             ///< FNV-1a 64 of bytes [header_size, file_size).
+};
+static_assert(sizeof(FileHeader) == 64, "snapshot header layout changed");
+static_assert(sizeof(SnapshotIntern) % 8 == 0, "intern records must stay 8-byte aligned");
+
+uint64_t fnv1a64(const uint8_t *p, size_t n)
+{
+    uint64_t h = 14695981039346656037ull;
+    for (size_t i = 0; i < n; ++i)
+        h = (h ^ p[i]) * 1099511628211ull;
+    return h;
+}
+
+size_t pad8(size_t n)
+{
+    return (n + 7) & ~static_cast<size_t>(7);
+}
+
+bool write_all(int fd, const uint8_t *p, size_t n)
+{
+    while (n > 0) {
+        ssize_t w = write(fd, p, n);
+        if (w < 0 && errno == EINTR)
+            continue;
+        if (w <= 0)
+            return false;
+        p += w;
+        n -= static_cast<size_t>(w);
+    }
+    return true;
+}
+
+bool intern_record_valid(const SnapshotIntern &rec)
+{
+    const InternEntry &e = rec.entry;
+    if (rec.id >= IPC_INTERN_CAPACITY || e.len < 1 || e.len > IPC_MAX_STRING_LEN ||
+        e.bytes[e.len] != '\0')
+        return false;
+    uint32_t hash = ipc_intern_hash(e.bytes, e.len);
+    return e.tag == (IPC_INTERN_READY | (hash & ~IPC_INTERN_READY));
+}
+
+bool fail(std::string *error, const std::string &reason)
+{
+    if (error)
+        *error = reason;
+    return false;
+}
+
+} // namespace
+
+bool cache_snapshot_save(const char *path, const CacheSnapshot &snap, std::string *error)
+{
+    size_t pattern_bytes = 0;
+    for (const std::string &p : snap.patterns)
+        pattern_bytes += pad8(sizeof(uint32_t) + p.size());
+
+    FileHeader hdr{};
+    memcpy(hdr.magic, kMagic, sizeof(kMagic));
+    hdr.version = kCacheSnapshotVersion;
+    hdr.header_size = sizeof(FileHeader);
+    hdr.intern_capacity = IPC_INTERN_CAPACITY;
+    hdr.intern_record_size = sizeof(SnapshotIntern);
+    hdr.intern_count = static_cast<uint32_t>(snap.interns.size());
+    hdr.pattern_count = static_cast<uint32_t>(snap.patterns.size());
+    hdr.intern_offset = sizeof(FileHeader);
+    hdr.pattern_offset = hdr.intern_offset + snap.interns.size() * sizeof(SnapshotIntern);
+    hdr.file_size = hdr.pattern_offset + pattern_bytes;
+
+    std::vector<uint8_t> buf(hdr.file_size, 0);
+    if (!snap.interns.empty())
+        memcpy(buf.data() + hdr.intern_offset, snap.interns.data(),
+               snap.interns.size() * sizeof(SnapshotIntern));
+    size_t off = hdr.pattern_offset;
+    for (const std::string &p : snap.patterns) {
+        uint32_t len = static_cast<uint32_t>(p.size());
+        memcpy(buf.data() + off, &len, sizeof(len));
+        memcpy(buf.data() + off + sizeof(len), p.data(), p.size());
+        off += pad8(sizeof(len) + p.size());
+    }
+    hdr.checksum = fnv1a64(buf.data() + sizeof(FileHeader), buf.size() - sizeof(FileHeader));
+    memcpy(buf.data(), &hdr, sizeof(hdr));
+
+    std::string tmp = std::string(path) + ".tmp";
+    int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return fail(error, tmp + ": " + strerror(errno));
+    bool ok = write_all(fd, buf.data(), buf.size()) && fsync(fd) == 0;
+    int saved_errno = errno;
+    close(fd);
+    if (!ok || rename(tmp.c_str(), path) != 0) {
+        if (ok)
+            saved_errno = errno;
+        unlink(tmp.c_str());
+        return fail(error, std::string(path) + ": " + strerror(saved_errno));
+    }
+    return true;
+}
+
+bool cache_snapshot_load(const char *path, CacheSnapshot *snap, std::string *error)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return fail(error, strerror(errno));
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(FileHeader)) {
+        close(fd);
+        return fail(error, "not a cache snapshot");
+    }
+    size_t size = static_cast<size_t>(st.st_size);
+    void *map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return fail(error, strerror(errno));
+    const uint8_t *base = static_cast<const uint8_t *>(map);
+
+    FileHeader hdr;
+    memcpy(&hdr, base, sizeof(hdr));
+    std::string reason;
+    if (memcmp(hdr.magic, kMagic, sizeof(kMagic)) != 0 || hdr.header_size != sizeof(FileHeader))
+        reason = "not a cache snapshot";
+    else if (hdr.version != kCacheSnapshotVersion)
+        reason = "version " + std::to_string(hdr.version) + ", expected " +
+                 std::to_string(kCacheSnapshotVersion);
+    else if (hdr.intern_capacity != IPC_INTERN_CAPACITY ||
+             hdr.intern_record_size != sizeof(SnapshotIntern))
+        reason = "written for a different intern table layout";
+    else if (hdr.file_size != size || hdr.intern_offset != sizeof(FileHeader) ||
+             hdr.intern_count > IPC_INTERN_CAPACITY ||
+             hdr.pattern_offset != hdr.intern_offset +
+                                       uint64_t{hdr.intern_count} * sizeof(SnapshotIntern) ||
+             hdr.pattern_offset > size)
+        reason = "truncated or malformed";
+    else if (fnv1a64(base + sizeof(FileHeader), size - sizeof(FileHeader)) != hdr.checksum)
+        reason = "checksum mismatch";
+
+    CacheSnapshot out;
+    if (reason.empty()) {
+        out.interns.resize(hdr.intern_count);
+        if (hdr.intern_count > 0)
+            memcpy(out.interns.data(), base + hdr.intern_offset,
+                   out.interns.size() * sizeof(SnapshotIntern));
+        std::vector<bool> seen(IPC_INTERN_CAPACITY, false);
+        for (const SnapshotIntern &rec : out.interns) {
+            if (!intern_record_valid(rec) || seen[rec.id]) {
+                reason = "invalid intern record";
+                break;
+            }
+            seen[rec.id] = true;
+        }
+    }
+    size_t off = hdr.pattern_offset;
+    for (uint32_t i = 0; reason.empty() && i < hdr.pattern_count; ++i) {
+        uint32_t len;
+        if (size - off < sizeof(len)) {
+            reason = "truncated or malformed";
+            break;
+        }
+        memcpy(&len, base + off, sizeof(len));
+        if (size - off - sizeof(len) < len) {
+            reason = "truncated or malformed";
+            break;
+        }
+        out.patterns.emplace_back(reinterpret_cast<const char *>(base + off + sizeof(len)), len);
+        off += std::min(pad8(sizeof(len) + len), size - off);
+    }
+    munmap(map, size);
+
+    if (!reason.empty())
+        return fail(error, reason);
+    *snap = std::move(out);
+    return true;
+}
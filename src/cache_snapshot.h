@@ -0,0 +1,59 @@
+/**
+ * @file cache_snapshot.h
+ * @brief Warm-restart snapshot of the server's caches (server side).
+ *
+ * The snapshot file holds the published intern table entries (at their ids)
+ * and the texts of the cached regex patterns, most recently used first. It
+ * is laid out for mapping: a fixed header, then 8-byte aligned fixed-size
+ * intern records, then length-prefixed pattern records. The header carries
+ * a format version, the intern table geometry the ids depend on, and an
+ * FNV-1a checksum of everything after it; a file that fails any check is
+ * ignored as a whole and the server starts cold.
+ *
+ * Saves write a temporary file next to the target and rename it into place,
+ * so a crash mid-save leaves the previous snapshot intact.
+ */
+#ifndef CACHE_SNAPSHOT_H
+#define CACHE_SNAPSHOT_H
+
+#include "ipc_defs.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/** Bumped whenever the on-disk layout changes; older files are ignored. */
+constexpr uint32_t kCacheSnapshotVersion = 1;
+
+/** One published intern table entry and the id it was published under. */
+struct SnapshotIntern {
+    uint32_t    id;
+    uint32_t    reserved;
+    InternEntry entry;
+};
+
+/** In-memory contents of a snapshot file. */
+struct CacheSnapshot {
+    std::vector<SnapshotIntern> interns;
+    std::vector<std::string>    patterns;   ///< Most recently used first.
+};
+
+/**
+ * @brief Write @p snap to @p path atomically (temporary file + rename).
+ * @return false with a reason in @p error if the file could not be written.
+ */
+bool cache_snapshot_save(const char *path, const CacheSnapshot &snap, std::string *error);
+
+/**
+ * @brief Map @p path, validate it and copy its contents into @p snap.
+ *
+ * Intern records are checked individually too (id in range, length,
+ * READY tag matching the string's hash), so a snapshot never publishes an
+ * entry a client could not have created.
+ *
+ * @return false with a reason in @p error if the file is missing, from
+ *         another version or intern table geometry, truncated or corrupt.
+ */
+bool cache_snapshot_load(const char *path, CacheSnapshot *snap, std::string *error);
+
+#endif /* CACHE_SNAPSHOT_H */
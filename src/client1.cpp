@@ -9,39 +9,10 @@
 #include <cstdio>
 #include <vector>
 
-static int resubmit_pending(PendingRequest &req)
-{
-    uint64_t new_id = 0;
-    int rc = -1;
-    if (req.cmd == IPC_CMD_MUL) {
-        rc = ipc_multiply(req.a, req.b, &new_id);
-    } else if (req.cmd == IPC_CMD_CONCAT) {
-        rc = ipc_concat(req.s1.c_str(), req.s2.c_str(), &new_id);
-    }
-    if (rc == 0)
-        req.id = new_id;
-    return rc;
-}
-
 static void check_pending(std::vector<PendingRequest> &pending)
 {
     auto it = pending.begin();
     while (it != pending.end()) {
-        if (it->id == 0) {
-            int rc = resubmit_pending(*it);
-            if (rc == 0) {
-                printf("Re-submitted [%s], new request ID: %lu\n",
-                       it->description.c_str(), static_cast<unsigned long>(it->id));
-            } else if (rc != IPC_ERR_SERVER_RESTARTED) {
-                printf("Failed to re-submit [%s]; dropping this pending request.\n",
-                       it->description.c_str());
-                it = pending.erase(it);
-                continue;
-            }
-            ++it;
-            continue;
-        }
-
         ResponsePayload result;
         ipc_status_t status;
         int rc = ipc_get_result(it->id, &result, &status);
@@ -61,9 +32,6 @@ static void check_pending(std::vector<PendingRequest> &pending)
             it = pending.erase(it);
         } else if (rc == IPC_NOT_READY) {
             ++it;
-        } else if (rc == IPC_ERR_SERVER_RESTARTED) {
-            retry_pending_after_restart(pending, resubmit_pending);
-            return;
         } else {
             printf("Error: request %lu not found.\n",
                    static_cast<unsigned long>(it->id));
@@ -83,7 +51,7 @@ int main()
     bool running = true;
 
     while (running) {
-        if (pre_menu_restart_probe(pending, ipc_get_result, resubmit_pending))
+        if (pre_menu_restart_probe(pending, ipc_get_result))
             continue;
 
         printf("\n1. Add 2 numbers          (blocking)\n"
@@ -131,7 +99,7 @@ int main()
             int rc = ipc_multiply(a, b, &req_id);
             if (rc == 0) {
                 printf("Request ID: %lu\n", static_cast<unsigned long>(req_id));
-                pending.push_back({req_id, IPC_CMD_MUL, desc, a, b, "", ""});
+                pending.push_back({req_id, IPC_CMD_MUL, desc});
             } else if (rc == IPC_ERR_SERVER_RESTARTED) {
                 printf("Server restarted while submitting; reconnected. "
                        "Please retry this command.\n");
@@ -155,7 +123,7 @@ int main()
             int rc = ipc_concat(s1, s2, &req_id);
             if (rc == 0) {
                 printf("Request ID: %lu\n", static_cast<unsigned long>(req_id));
-                pending.push_back({req_id, IPC_CMD_CONCAT, desc, 0, 0, s1, s2});
+                pending.push_back({req_id, IPC_CMD_CONCAT, desc});
             } else if (rc == IPC_ERR_SERVER_RESTARTED) {
                 printf("Server restarted while submitting; reconnected. "
                        "Please retry this command.\n");
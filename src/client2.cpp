@@ -49,39 +49,10 @@ static void *open_ipc_library()
     return nullptr;
 }
 
-static int resubmit_pending(PendingRequest &req)
-{
-    uint64_t new_id = 0;
-    int rc = -1;
-    if (req.cmd == IPC_CMD_DIV) {
-        rc = fn_divide(req.a, req.b, &new_id);
-    } else if (req.cmd == IPC_CMD_SEARCH) {
-        rc = fn_search(req.s2.c_str(), req.s1.c_str(), &new_id);
-    }
-    if (rc == 0)
-        req.id = new_id;
-    return rc;
-}
-
 static void check_pending(std::vector<PendingRequest> &pending)
 {
     auto it = pending.begin();
     while (it != pending.end()) {
-        if (it->id == 0) {
-            int rc = resubmit_pending(*it);
-            if (rc == 0) {
-                printf("Re-submitted [%s], new request ID: %lu\n",
-                       it->description.c_str(), static_cast<unsigned long>(it->id));
-            } else if (rc != IPC_ERR_SERVER_RESTARTED) {
-                printf("Failed to re-submit [%s]; dropping this pending request.\n",
-                       it->description.c_str());
-                it = pending.erase(it);
-                continue;
-            }
-            ++it;
-            continue;
-        }
-
         ResponsePayload result;
         ipc_status_t status;
         int rc = fn_get_result(it->id, &result, &status);
@@ -106,9 +77,6 @@ static void check_pending(std::vector<PendingRequest> &pending)
             it = pending.erase(it);
         } else if (rc == IPC_NOT_READY) {
             ++it;
-        } else if (rc == IPC_ERR_SERVER_RESTARTED) {
-            retry_pending_after_restart(pending, resubmit_pending);
-            return;
         } else {
             printf("Error: request %lu not found.\n",
                    static_cast<unsigned long>(it->id));
@@ -149,7 +117,7 @@ int main()
     bool running = true;
 
     while (running) {
-        if (pre_menu_restart_probe(pending, fn_get_result, resubmit_pending))
+        if (pre_menu_restart_probe(pending, fn_get_result))
             continue;
 
         printf("\n1. Subtract 2 numbers        (blocking)\n"
@@ -197,7 +165,7 @@ int main()
             int rc = fn_divide(a, b, &req_id);
             if (rc == 0) {
                 printf("Request ID: %lu\n", static_cast<unsigned long>(req_id));
-                pending.push_back({req_id, IPC_CMD_DIV, desc, a, b, "", ""});
+                pending.push_back({req_id, IPC_CMD_DIV, desc});
             } else if (rc == IPC_ERR_SERVER_RESTARTED) {
                 printf("Server restarted while submitting; reconnected. "
                        "Please retry this command.\n");
@@ -222,7 +190,7 @@ int main()
             int rc = fn_search(s2, s1, &req_id);
             if (rc == 0) {
                 printf("Request ID: %lu\n", static_cast<unsigned long>(req_id));
-                pending.push_back({req_id, IPC_CMD_SEARCH, desc, 0, 0, s1, s2});
+                pending.push_back({req_id, IPC_CMD_SEARCH, desc});
             } else if (rc == IPC_ERR_SERVER_RESTARTED) {
                 printf("Server restarted while submitting; reconnected. "
                        "Please retry this command.\n");
@@ -13,10 +13,6 @@ struct PendingRequest {
     uint64_t    id;
     ipc_cmd_t   cmd;
     std::string description;
-    int32_t     a = 0;
-    int32_t     b = 0;
-    std::string s1;
-    std::string s2;
 };
 
 static inline void clear_input_line(void)
@@ -76,42 +72,11 @@ static inline bool read_short_string(const char *prompt, char *out, size_t out_s
     return true;
 }
 
-using ResubmitPendingFn = int (*)(PendingRequest &);
 using GetResultFn = int (*)(uint64_t, ResponsePayload *, ipc_status_t *);
 
-static inline void retry_pending_after_restart(std::vector<PendingRequest> &pending,
-                                               ResubmitPendingFn resubmit_pending)
-{
-    if (pending.empty())
-        return;
-
-    for (auto &req : pending) {
-        req.id = 0;
-    }
-
-    printf("\nNotice: server restart detected. Re-submitting %zu async request(s)...\n",
-           pending.size());
-    auto it = pending.begin();
-    while (it != pending.end()) {
-        int rc = resubmit_pending(*it);
-        if (rc == 0) {
-            printf("Re-submitted [%s], new request ID: %lu\n",
-                   it->description.c_str(), static_cast<unsigned long>(it->id));
-            ++it;
-        } else if (rc == IPC_ERR_SERVER_RESTARTED) {
-            printf("Server is still restarting; pending requests remain queued for retry.\n");
-            break;
-        } else {
-            printf("Failed to re-submit [%s]; dropping this pending request.\n",
-                   it->description.c_str());
-            it = pending.erase(it);
-        }
-    }
-}
-
-static inline bool pre_menu_restart_probe(std::vector<PendingRequest> &pending,
-                                          GetResultFn get_result,
-                                          ResubmitPendingFn resubmit_pending)
+/* libipc resubmits pending async requests itself; this only tells the user. */
+static inline bool pre_menu_restart_probe(const std::vector<PendingRequest> &pending,
+                                          GetResultFn get_result)
 {
     ResponsePayload probe_result{};
     ipc_status_t probe_status = IPC_STATUS_OK;
@@ -120,7 +85,8 @@ static inline bool pre_menu_restart_probe(std::vector<PendingRequest> &pending,
         if (pending.empty()) {
             printf("\nNotice: server restart detected. Reconnected to fresh IPC state.\n");
         } else {
-            retry_pending_after_restart(pending, resubmit_pending);
+            printf("\nNotice: server restart detected. libipc re-submitted %zu pending "
+                   "async request(s); their request IDs stay valid.\n", pending.size());
         }
         return true;
     }
@@ -0,0 +1,167 @@
+/**
+ * @file client_registry.cpp
+ * @brief Client registration table: CAS join/leave, heartbeats, liveness sweep.
+ */
+#include "client_registry.h"
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+/* Field 22 of /proc/<pid>/stat; fields 3 onwards follow the last ')'. */
+constexpr int kStartTimeField = 22;
+
+uint32_t pid_hash(pid_t pid)
+{
+    return static_cast<uint32_t>(pid) * 2654435761u;
+}
+
+void clear_entry(ClientEntry *entry)
+{
+    entry->pid = 0;
+    entry->start_time = 0;
+    entry->capabilities = 0;
+    entry->heartbeat = 0;
+    entry->joined_epoch = 0;
+    __atomic_store_n(&entry->requests, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&entry->arena_allocs, 0, __ATOMIC_RELAXED);
+}
+
+bool process_gone(const ClientEntry &entry)
+{
+    if (kill(entry.pid, 0) != 0 && errno == ESRCH)
+        return true;
+    // A live process with a different start time reuses the pid; 0 means
+    // /proc is unreadable (e.g. hidepid), so give the client the benefit.
+    uint64_t start_time = process_start_time(entry.pid);
+    return start_time != 0 && entry.start_time != 0 && start_time != entry.start_time;
+}
+
+} // namespace
+
+uint64_t process_start_time(pid_t pid)
+{
+    char path[32];
+    snprintf(path, sizeof(path), "/proc/%d/stat", static_cast<int>(pid));
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return 0;
+    char buf[512];
+    ssize_t n = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (n <= 0)
+        return 0;
+    buf[n] = '\0';
+
+    // The command name may contain spaces and parentheses; skip past the last ')'.
+    const char *p = strrchr(buf, ')');
+    if (!p)
+        return 0;
+    ++p;
+    for (int field = 3; field <= kStartTimeField; ++field) {
+        while (*p == ' ')
+            ++p;
+        if (field == kStartTimeField)
+            return strtoull(p, nullptr, 10);
+        while (*p && *p != ' ')
+            ++p;
+        if (!*p)
+            return 0;
+    }
+    return 0;
+}
+
+ClientEntry *client_join(SharedMemoryLayout *shm, pid_t pid, uint64_t start_time,
+                         uint32_t capabilities)
+{
+    uint32_t start = pid_hash(pid) % IPC_MAX_CLIENTS;
+    for (uint32_t probe = 0; probe < IPC_MAX_CLIENTS; ++probe) {
+        ClientEntry *entry = &shm->clients[(start + probe) % IPC_MAX_CLIENTS];
+        uint32_t expected = IPC_CLIENT_FREE;
+        if (__atomic_load_n(&entry->state, __ATOMIC_RELAXED) != IPC_CLIENT_FREE ||
+            !__atomic_compare_exchange_n(&entry->state, &expected, ipc_client_joining(pid),
+                                         false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            continue;
+        uint64_t epoch = __atomic_load_n(&shm->client_epoch, __ATOMIC_RELAXED);
+        clear_entry(entry);
+        entry->pid = pid;
+        entry->start_time = start_time;
+        entry->capabilities = capabilities;
+        entry->joined_epoch = epoch;
+        __atomic_store_n(&entry->heartbeat, epoch, __ATOMIC_RELAXED);
+        __atomic_store_n(&entry->state, IPC_CLIENT_ACTIVE, __ATOMIC_RELEASE);
+        return entry;
+    }
+    return nullptr;
+}
+
+void client_leave(ClientEntry *entry, pid_t pid)
+{
+    if (!entry || entry->pid != pid)
+        return;
+    uint32_t expected = IPC_CLIENT_ACTIVE;
+    __atomic_compare_exchange_n(&entry->state, &expected, IPC_CLIENT_FREE,
+                                false, __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+}
+
+void client_heartbeat(const SharedMemoryLayout *shm, ClientEntry *entry, uint64_t requests)
+{
+    uint64_t epoch = __atomic_load_n(&shm->client_epoch, __ATOMIC_RELAXED);
+    if (__atomic_load_n(&entry->heartbeat, __ATOMIC_RELAXED) != epoch)
+        __atomic_store_n(&entry->heartbeat, epoch, __ATOMIC_RELAXED);
+    if (requests)
+        __atomic_fetch_add(&entry->requests, requests, __ATOMIC_RELAXED);
+}
+
+ClientSweepResult client_sweep(SharedMemoryLayout *shm, std::vector<pid_t> *dead)
+{
+    ClientSweepResult result{};
+    uint64_t epoch = __atomic_add_fetch(&shm->client_epoch, 1, __ATOMIC_RELAXED);
+    pid_t self = getpid();
+    for (ClientEntry &entry : shm->clients) {
+        uint32_t state = __atomic_load_n(&entry.state, __ATOMIC_ACQUIRE);
+        if ((state & IPC_CLIENT_STATE_MASK) == IPC_CLIENT_JOINING) {
+            // Left half-joined (or half-reaped) by a process that died there.
+            pid_t owner = static_cast<pid_t>(state >> 2);
+            if (kill(owner, 0) == 0 || errno != ESRCH)
+                continue;
+            clear_entry(&entry);
+            if (__atomic_compare_exchange_n(&entry.state, &state, IPC_CLIENT_FREE,
+                                            false, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+                ++result.reaped;
+            continue;
+        }
+        if (state != IPC_CLIENT_ACTIVE)
+            continue;
+        // Clients that sent a request since the last sweep are alive.
+        if (__atomic_load_n(&entry.heartbeat, __ATOMIC_RELAXED) + 1 >= epoch) {
+            ++result.active;
+            continue;
+        }
+        ++result.probed;
+        ClientEntry probed = entry;
+        if (!process_gone(probed) ||
+            !__atomic_compare_exchange_n(&entry.state, &state, ipc_client_joining(self),
+                                         false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            ++result.active;
+            continue;
+        }
+        if (entry.pid != probed.pid || entry.start_time != probed.start_time) {
+            // Another client left and rejoined here since the probe.
+            __atomic_store_n(&entry.state, IPC_CLIENT_ACTIVE, __ATOMIC_RELEASE);
+            ++result.active;
+            continue;
+        }
+        dead->push_back(entry.pid);
+        clear_entry(&entry);
+        __atomic_store_n(&entry.state, IPC_CLIENT_FREE, __ATOMIC_RELEASE);
+        ++result.reaped;
+    }
+    return result;
+}
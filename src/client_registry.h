@@ -0,0 +1,73 @@
+/**
+ * @file client_registry.h
+ * @brief Shared client registration table (used by libipc and the server).
+ *
+ * Every connected client process owns one ClientEntry in shared memory,
+ * claimed and released with CAS only, so joining never contends on
+ * /ipc_mutex even with thousands of clients. Clients refresh their heartbeat
+ * on each request; the server's periodic sweep advances the epoch and probes
+ * only entries whose heartbeat has fallen behind, then frees those whose
+ * process is gone.
+ */
+#ifndef CLIENT_REGISTRY_H
+#define CLIENT_REGISTRY_H
+
+#include "ipc_defs.h"
+
+#include <cstdint>
+#include <vector>
+
+/** Protocol features implemented by this libipc build. */
+constexpr uint32_t kClientCapabilities = IPC_CLIENT_CAP_DEADLINE | IPC_CLIENT_CAP_PRIORITY |
+                                         IPC_CLIENT_CAP_NOTIFY | IPC_CLIENT_CAP_ARENA;
+
+/**
+ * @brief Start time of process @p pid in clock ticks after boot.
+ *
+ * Reads /proc/<pid>/stat with plain read(2), so it is safe in a fork child.
+ *
+ * @return 0 if the process does not exist or the file cannot be parsed.
+ */
+uint64_t process_start_time(pid_t pid);
+
+/**
+ * @brief Claim a free entry for @p pid; lock-free.
+ *
+ * Probing starts at a hash of the pid, so concurrent joins rarely collide.
+ *
+ * @return The ACTIVE entry, or nullptr if the table is full.
+ */
+ClientEntry *client_join(SharedMemoryLayout *shm, pid_t pid, uint64_t start_time,
+                         uint32_t capabilities);
+
+/** Release @p entry if it still belongs to @p pid (the server may have reaped it). */
+void client_leave(ClientEntry *entry, pid_t pid);
+
+/**
+ * Record @p requests requests (possibly 0) against @p entry; lock-free. The
+ * heartbeat is stored only when the epoch has moved, so the threads of one
+ * client mostly just read the entry's cache line.
+ */
+void client_heartbeat(const SharedMemoryLayout *shm, ClientEntry *entry, uint64_t requests = 1);
+
+/** Outcome of one client_sweep(). */
+struct ClientSweepResult {
+    uint32_t active;   ///< Entries left ACTIVE after the sweep.
+    uint32_t probed;   ///< Quiet entries whose process was checked.
+    uint32_t reaped;   ///< Entries freed because their process was gone.
+};
+
+/**
+ * @brief Advance the epoch and free the entries of dead clients (server side).
+ *
+ * Only entries whose heartbeat predates the previous sweep are probed, with
+ * kill(pid, 0) and a start-time check against pid reuse. The pids of freed
+ * entries are appended to @p dead so the caller can release their resources.
+ * Entries left JOINING by a process that died while joining (or a server
+ * that died while reaping) are freed too; they are counted in @c reaped but
+ * hold no resources, so they are not in @p dead. Lock-free; does not take
+ * /ipc_mutex.
+ */
+ClientSweepResult client_sweep(SharedMemoryLayout *shm, std::vector<pid_t> *dead);
+
+#endif /* CLIENT_REGISTRY_H */
@@ -0,0 +1,146 @@
+/**
+ * @file control.cpp
+ * @brief ControlServer: Unix socket accept loop, one client at a time.
+ *
+ * The serving thread waits in poll() on the listening socket and a wake-up
+ * pipe, so stop() never has to interrupt a blocking accept(). A client that
+ * stalls mid-line is dropped after kClientTimeoutSec.
+ */
+#include "control.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr int    kClientTimeoutSec = 5;
+constexpr size_t kMaxLineLen = 1024;
+
+bool write_all(int fd, const char *data, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        data += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+} // namespace
+
+bool ControlServer::start(const char *path, Handler handler)
+{
+    sockaddr_un addr{};
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "server: control socket path too long: %s\n", path);
+        return false;
+    }
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    listen_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0) {
+        perror("server: control socket");
+        return false;
+    }
+    // The instance lock is already held, so an existing socket is stale.
+    unlink(path);
+    if (bind(listen_fd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 ||
+        chmod(path, 0660) < 0 || listen(listen_fd_, 4) < 0 ||
+        pipe2(wake_pipe_, O_CLOEXEC) < 0) {
+        perror("server: control socket");
+        close(listen_fd_);
+        listen_fd_ = -1;
+        unlink(path);
+        return false;
+    }
+
+    path_ = path;
+    handler_ = std::move(handler);
+    thread_ = std::thread([this] { serve(); });
+    return true;
+}
+
+void ControlServer::stop()
+{
+    if (!thread_.joinable())
+        return;
+    char byte = 0;
+    ssize_t rc = write(wake_pipe_[1], &byte, 1);
+    (void)rc;
+    thread_.join();
+    close(listen_fd_);
+    close(wake_pipe_[0]);
+    close(wake_pipe_[1]);
+    listen_fd_ = -1;
+    wake_pipe_[0] = wake_pipe_[1] = -1;
+    unlink(path_.c_str());
+}
+
+void ControlServer::serve()
+{
+    while (true) {
+        pollfd fds[2] = {{listen_fd_, POLLIN, 0}, {wake_pipe_[0], POLLIN, 0}};
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("server: control poll");
+            return;
+        }
+        if (fds[1].revents)
+            return;
+        if (!(fds[0].revents & POLLIN))
+            continue;
+
+        int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0)
+            continue;
+        timeval timeout{kClientTimeoutSec, 0};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        serve_client(fd);
+        close(fd);
+    }
+}
+
+void ControlServer::serve_client(int fd)
+{
+    std::string pending;
+    char buf[256];
+    while (true) {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return;
+        pending.append(buf, static_cast<size_t>(n));
+
+        size_t eol;
+        while ((eol = pending.find('\n')) != std::string::npos) {
+            std::string line = pending.substr(0, eol);
+            pending.erase(0, eol + 1);
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+            std::string reply = handler_(line) + "\n";
+            if (!write_all(fd, reply.data(), reply.size()))
+                return;
+        }
+        if (pending.size() > kMaxLineLen) {
+            static const char kTooLong[] = "error: command too long\n";
+            write_all(fd, kTooLong, sizeof(kTooLong) - 1);
+            return;
+        }
+    }
+}
@@ -0,0 +1,47 @@
+/**
+ * @file control.h
+ * @brief Local control socket for live server reconfiguration (server side).
+ *
+ * ControlServer listens on a Unix stream socket and hands every received
+ * line to a handler on its own thread; the handler's reply is written back
+ * as one line. Commands are plain text (see `ipcctl help`), so the socket
+ * can also be driven with tools such as socat.
+ */
+#ifndef CONTROL_H
+#define CONTROL_H
+
+#include <functional>
+#include <string>
+#include <thread>
+
+class ControlServer {
+public:
+    /** Maps one command line (without newline) to a one-line reply. */
+    using Handler = std::function<std::string(const std::string &command)>;
+
+    ControlServer() = default;
+    ControlServer(const ControlServer &) = delete;
+    ControlServer &operator=(const ControlServer &) = delete;
+    ~ControlServer() { stop(); }
+
+    /**
+     * @brief Bind @p path (replacing a stale socket) and start serving.
+     * @return false if the socket could not be created.
+     */
+    bool start(const char *path, Handler handler);
+
+    /** Stop serving, join the thread and remove the socket. Idempotent. */
+    void stop();
+
+private:
+    void serve();
+    void serve_client(int fd);
+
+    Handler     handler_;
+    std::string path_;
+    std::thread thread_;
+    int         listen_fd_ = -1;
+    int         wake_pipe_[2] = {-1, -1};
+};
+
+#endif /* CONTROL_H */
@@ -0,0 +1,200 @@
+/**
+ * @file cpu_budget.cpp
+ * @brief Affinity mask and cgroup CPU quota detection.
+ *
+ * The cgroup hierarchy is located through /proc/self/mountinfo, so it is
+ * found wherever it is mounted. This includes hybrid hosts, which keep v2
+ * under /sys/fs/cgroup/unified and the v1 cpu controller under
+ * /sys/fs/cgroup/cpu. The process's path within each hierarchy comes from
+ * /proc/self/cgroup. Inside a cgroup namespace that path is "/" and the
+ * mount point is already the container's own cgroup.
+ */
+#include "cpu_budget.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sched.h>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+namespace {
+
+/** Splits @p text at @p sep; empty fields are kept. */
+std::vector<std::string> split(const std::string &text, char sep)
+{
+    std::vector<std::string> out;
+    std::string field;
+    std::istringstream in(text);
+    while (std::getline(in, field, sep))
+        out.push_back(field);
+    return out;
+}
+
+bool has_option(const std::string &options, const char *name)
+{
+    for (const std::string &opt : split(options, ','))
+        if (opt == name)
+            return true;
+    return false;
+}
+
+unsigned affinity_cpus(unsigned online)
+{
+    // The mask must cover every possible CPU id, which can exceed the online
+    // count; grow it until the kernel accepts the size.
+    for (size_t ncpus = std::max(online, 1024u); ncpus <= (1u << 18); ncpus *= 2) {
+        cpu_set_t *set = CPU_ALLOC(ncpus);
+        if (!set)
+            break;
+        size_t size = CPU_ALLOC_SIZE(ncpus);
+        CPU_ZERO_S(size, set);
+        int rc = sched_getaffinity(0, size, set);
+        unsigned count = rc == 0 ? static_cast<unsigned>(CPU_COUNT_S(size, set)) : 0;
+        CPU_FREE(set);
+        if (rc == 0)
+            return count;
+        if (errno != EINVAL)
+            break;
+    }
+    return online;
+}
+
+/**
+ * Mount point and mount root of the cgroup2 hierarchy (@p v2) or of the v1
+ * hierarchy carrying the cpu controller.
+ */
+bool find_cgroup_mount(bool v2, std::string *root, std::string *point)
+{
+    std::ifstream in("/proc/self/mountinfo");
+    std::string line;
+    while (std::getline(in, line)) {
+        // id parent major:minor root mount-point options [optional...] - fstype source super-options
+        size_t dash = line.find(" - ");
+        if (dash == std::string::npos)
+            continue;
+        std::istringstream pre(line.substr(0, dash)), post(line.substr(dash + 3));
+        std::string id, parent, dev, mroot, mpoint, fstype, source, super;
+        if (!(pre >> id >> parent >> dev >> mroot >> mpoint) || !(post >> fstype >> source >> super))
+            continue;
+        bool match = v2 ? fstype == "cgroup2" : fstype == "cgroup" && has_option(super, "cpu");
+        if (match) {
+            *root = mroot;
+            *point = mpoint;
+            return true;
+        }
+    }
+    return false;
+}
+
+/** The process's cgroup path in the v2 hierarchy or the v1 cpu hierarchy. */
+bool own_cgroup_path(bool v2, std::string *path)
+{
+    std::ifstream in("/proc/self/cgroup");
+    std::string line;
+    while (std::getline(in, line)) {
+        // hierarchy-id:controllers:path; v2 is "0::path".
+        size_t c1 = line.find(':');
+        size_t c2 = c1 == std::string::npos ? c1 : line.find(':', c1 + 1);
+        if (c2 == std::string::npos)
+            continue;
+        std::string controllers = line.substr(c1 + 1, c2 - c1 - 1);
+        bool match = v2 ? line.compare(0, c1, "0") == 0 && controllers.empty()
+                        : has_option(controllers, "cpu");
+        if (match) {
+            *path = line.substr(c2 + 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+/** Quota in CPUs set by one cgroup directory, or 0 if it sets none. */
+double cgroup_dir_quota(bool v2, const std::string &dir, std::string *file)
+{
+    double quota = 0, period = 0;
+    if (v2) {
+        // "max 100000" or "<quota> <period>", both in microseconds.
+        *file = dir + "/cpu.max";
+        std::ifstream in(*file);
+        std::string q;
+        if (!(in >> q >> period) || q == "max")
+            return 0;
+        quota = strtod(q.c_str(), nullptr);
+    } else {
+        // cfs_quota_us is -1 when unlimited.
+        *file = dir + "/cpu.cfs_quota_us";
+        std::ifstream q(*file), p(dir + "/cpu.cfs_period_us");
+        if (!(q >> quota) || !(p >> period))
+            return 0;
+    }
+    return quota > 0 && period > 0 ? quota / period : 0;
+}
+
+void apply_cgroup_quota(bool v2, CpuBudget *budget)
+{
+    std::string root, point, path;
+    if (!find_cgroup_mount(v2, &root, &point) || !own_cgroup_path(v2, &path))
+        return;
+    // A path outside the mount's root (e.g. another namespace's view) cannot
+    // be resolved; fall back to the mount point itself.
+    if (root != "/") {
+        if (path.compare(0, root.size(), root) == 0 &&
+            (path.size() == root.size() || path[root.size()] == '/'))
+            path.erase(0, root.size());
+        else
+            path.clear();
+    }
+    while (!path.empty() && path.back() == '/')
+        path.pop_back();
+
+    for (;;) {
+        std::string file;
+        double quota = cgroup_dir_quota(v2, point + path, &file);
+        if (quota > 0 && (budget->quota == 0 || quota < budget->quota)) {
+            budget->quota = quota;
+            budget->quota_file = file;
+        }
+        if (path.empty())
+            break;
+        path.erase(path.rfind('/'));
+    }
+}
+
+} // namespace
+
+CpuBudget cpu_budget_detect()
+{
+    CpuBudget budget{};
+    budget.online = std::max(std::thread::hardware_concurrency(), 1u);
+    budget.affinity = std::max(affinity_cpus(budget.online), 1u);
+    apply_cgroup_quota(true, &budget);
+    apply_cgroup_quota(false, &budget);
+
+    budget.usable = budget.affinity;
+    if (budget.quota > 0) {
+        // A fractional CPU is not worth a thread: 2.5 CPUs of quota keep two
+        // threads busy, and a third would only bring the throttling forward.
+        unsigned quota_cpus = static_cast<unsigned>(std::floor(budget.quota + 1e-9));
+        budget.usable = std::min(budget.usable, std::max(quota_cpus, 1u));
+    }
+    return budget;
+}
+
+std::string cpu_budget_describe(const CpuBudget &budget)
+{
+    std::string text = std::to_string(budget.online) + " online, " +
+                       std::to_string(budget.affinity) + " in affinity mask, ";
+    if (budget.quota > 0) {
+        char quota[32];
+        snprintf(quota, sizeof(quota), "%.2f", budget.quota);
+        text += std::string("cgroup quota ") + quota + " CPUs (" + budget.quota_file + ")";
+    } else {
+        text += "no cgroup quota";
+    }
+    return text + " -> " + std::to_string(budget.usable) + " usable";
+}
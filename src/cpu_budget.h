@@ -0,0 +1,45 @@
+/**
+ * @file cpu_budget.h
+ * @brief Number of CPUs the process can actually use (server and gateway).
+ *
+ * std::thread::hardware_concurrency() counts the CPUs online in the machine.
+ * In a container the process usually gets much less. Its affinity mask
+ * (cpuset) can leave out most CPUs, and a cgroup CPU quota can limit the
+ * whole group to fewer CPUs' worth of time per period than it has threads.
+ * Threads beyond that limit do not add throughput. They queue for a CPU, or
+ * use up the quota early and leave the group throttled until the next
+ * period. cpu_budget_detect() combines the three sources into the number of
+ * threads that can run at once.
+ */
+#ifndef CPU_BUDGET_H
+#define CPU_BUDGET_H
+
+#include <string>
+
+/** Where the process may run, and the resulting number of usable CPUs. */
+struct CpuBudget {
+    unsigned    online;      ///< CPUs online (hardware_concurrency()).
+    unsigned    affinity;    ///< CPUs in the sched_getaffinity() mask.
+    double      quota;       ///< Tightest cgroup CPU quota in CPUs (quota / period); 0 if none.
+    std::string quota_file;  ///< Control file that set @c quota.
+    unsigned    usable;      ///< min(affinity, floor(quota)), at least 1.
+};
+
+/**
+ * @brief Read the affinity mask and cgroup CPU limits of the calling process.
+ *
+ * Reads cgroup v2 `cpu.max` and, on hybrid hosts where the cpu controller
+ * is still mounted as v1, `cpu.cfs_quota_us` / `cpu.cfs_period_us`. Both are
+ * read for the process's cgroup and each of its ancestors up to the mount
+ * point, because a parent's limit caps all of its children. Unreadable
+ * files count as no limit.
+ */
+CpuBudget cpu_budget_detect();
+
+/**
+ * @brief One-line summary, e.g. "8 online, 4 in affinity mask, cgroup
+ *        quota 2.50 CPUs (/sys/fs/cgroup/app/cpu.max) -> 2 usable".
+ */
+std::string cpu_budget_describe(const CpuBudget &budget);
+
+#endif /* CPU_BUDGET_H */
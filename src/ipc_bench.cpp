@@ -0,0 +1,1208 @@
+/**
+ * @file ipc_bench.cpp
+ * @brief Benchmark suite for the IPC server (links libipc.so directly).
+ *
+ * Usage: ipc_bench <scenario> [args...]
+ *
+ * Scenarios:
+ *   matmul [size] [int32|float] [reps]  -- square IPC_CMD_MATMUL, reports GFLOP/s
+ *   strings [count] [reps]              -- bulk sort/dedupe/hash, reports Mstr/s
+ *   regex [hay_bytes] [requests]        -- cached IPC_CMD_REGEX_SEARCH, reports MB/s
+ *   search_batch [needles] [reps]       -- IPC_CMD_SEARCH_BATCH vs one IPC_CMD_SEARCH
+ *                                          per needle, reports Mneedles/s
+ *   stream [values] [batch]             -- streaming aggregation, reports Mvalues/s
+ *   arena [threads] [ops]               -- arena alloc/free pairs, reports ns/pair
+ *   cache [calls] [distinct]            -- ipc_add with and without the client
+ *                                          result cache, reports ns/call
+ *   edf [probes] [budget_us]            -- blocking ipc_add latency behind async
+ *                                          matmul load: plain, with a deadline
+ *                                          and at high priority, reports
+ *                                          p50/p99 us
+ *   spin [calls]                        -- blocking ipc_add with the adaptive
+ *                                          spin off and on, reports p50/p99 us
+ *                                          and spin hits vs sleeps
+ *   magazine [threads] [calls]          -- blocking ipc_add from many threads
+ *                                          without and with per-thread slot
+ *                                          magazines, reports ns/call
+ *   reconnect [clients] [kill|term]     -- restart the server under that many
+ *                                          connected client processes, reports
+ *                                          time to each one's first good call
+ *   latency [calls] [hogs]              -- paced blocking ipc_add under CPU hogs,
+ *                                          first against the running server, then
+ *                                          with it restarted under --rt-* and
+ *                                          --mlock and this thread at SCHED_FIFO;
+ *                                          reports p50/p99/p99.9/max and jitter
+ *
+ * The server must already be running; `reconnect` replaces it with a fresh
+ * instance started from the same command line, and `latency` restores the
+ * original command line when it is done. Results are printed one line per
+ * measurement so they can be collected with `make bench`.
+ */
+#include "libipc.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <pthread.h>
+#include <random>
+#include <sched.h>
+#include <signal.h>
+#include <string>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <thread>
+#include <type_traits>
+#include <unistd.h>
+#include <vector>
+
+using BenchClock = std::chrono::steady_clock;
+
+/* --- Helpers --- */
+
+static int wait_result(uint64_t request_id, ResponsePayload *result,
+                       ipc_status_t *status)
+{
+    while (true) {
+        int rc = ipc_get_result(request_id, result, status);
+        if (rc != IPC_NOT_READY)
+            return rc;
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+}
+
+static double seconds_since(BenchClock::time_point start)
+{
+    return std::chrono::duration<double>(BenchClock::now() - start).count();
+}
+
+/* --- matmul --- */
+
+template <typename T>
+static bool check_matmul_samples(const T *a, const T *b, const T *c, uint32_t n)
+{
+    // Spot-check a handful of entries against a naive dot product.
+    std::mt19937 rng(7);
+    for (int s = 0; s < 16; ++s) {
+        uint32_t i = rng() % n;
+        uint32_t j = rng() % n;
+        T expected = 0;
+        for (uint32_t p = 0; p < n; ++p) {
+            if constexpr (std::is_same_v<T, int32_t>) {
+                expected = static_cast<int32_t>(
+                    static_cast<uint32_t>(expected) +
+                    static_cast<uint32_t>(a[i * n + p]) * static_cast<uint32_t>(b[p * n + j]));
+            } else {
+                expected += a[i * n + p] * b[p * n + j];
+            }
+        }
+        T got = c[i * n + j];
+        bool ok;
+        if constexpr (std::is_same_v<T, int32_t>)
+            ok = (got == expected);
+        else
+            ok = std::fabs(got - expected) <= 1e-3f * (1.0f + std::fabs(expected));
+        if (!ok) {
+            fprintf(stderr, "matmul: mismatch at (%u,%u)\n", i, j);
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename T>
+static int bench_matmul_typed(uint32_t n, ipc_dtype_t dtype, int reps)
+{
+    size_t bytes = static_cast<size_t>(n) * n * sizeof(T);
+    uint64_t a_off = 0, b_off = 0, c_off = 0;
+    if (ipc_arena_alloc(bytes, &a_off) != 0 || ipc_arena_alloc(bytes, &b_off) != 0 ||
+        ipc_arena_alloc(bytes, &c_off) != 0) {
+        fprintf(stderr, "matmul: arena allocation of 3 x %zu bytes failed\n", bytes);
+        return 1;
+    }
+
+    T *a = static_cast<T *>(ipc_arena_ptr(a_off));
+    T *b = static_cast<T *>(ipc_arena_ptr(b_off));
+    T *c = static_cast<T *>(ipc_arena_ptr(c_off));
+    std::mt19937 rng(42);
+    for (size_t i = 0; i < static_cast<size_t>(n) * n; ++i) {
+        a[i] = static_cast<T>(static_cast<int>(rng() % 17) - 8);
+        b[i] = static_cast<T>(static_cast<int>(rng() % 17) - 8);
+    }
+
+    double best = 1e30;
+    double total = 0.0;
+    for (int r = 0; r < reps; ++r) {
+        auto start = BenchClock::now();
+        uint64_t req = 0;
+        if (ipc_matmul(n, n, n, dtype, a_off, b_off, c_off, &req) != 0) {
+            fprintf(stderr, "matmul: submit failed\n");
+            return 1;
+        }
+        ResponsePayload resp;
+        ipc_status_t status;
+        if (wait_result(req, &resp, &status) != 0 || status != IPC_STATUS_OK) {
+            fprintf(stderr, "matmul: request failed (status=%d)\n", status);
+            return 1;
+        }
+        double t = seconds_since(start);
+        best = std::min(best, t);
+        total += t;
+    }
+
+    bool ok = check_matmul_samples(a, b, c, n);
+    double flops = 2.0 * n * n * n;
+    printf("matmul dtype=%s n=%u reps=%d best=%.3f ms avg=%.3f ms "
+           "GFLOP/s(best)=%.2f verify=%s\n",
+           dtype == IPC_DTYPE_INT32 ? "int32" : "float", n, reps,
+           best * 1e3, total / reps * 1e3, flops / best * 1e-9,
+           ok ? "ok" : "FAILED");
+
+    ipc_arena_free(a_off);
+    ipc_arena_free(b_off);
+    ipc_arena_free(c_off);
+    return ok ? 0 : 1;
+}
+
+static int bench_matmul(int argc, char **argv)
+{
+    uint32_t n = argc > 0 ? static_cast<uint32_t>(atoi(argv[0])) : 512;
+    const char *type = argc > 1 ? argv[1] : "int32";
+    int reps = argc > 2 ? atoi(argv[2]) : 5;
+    if (n == 0 || reps <= 0) {
+        fprintf(stderr, "matmul: size and reps must be positive\n");
+        return 1;
+    }
+    if (strcmp(type, "float") == 0)
+        return bench_matmul_typed<float>(n, IPC_DTYPE_FLOAT32, reps);
+    if (strcmp(type, "int32") == 0)
+        return bench_matmul_typed<int32_t>(n, IPC_DTYPE_INT32, reps);
+    fprintf(stderr, "matmul: unknown dtype %s (use int32 or float)\n", type);
+    return 1;
+}
+
+/* --- strings --- */
+
+static int bench_strings(int argc, char **argv)
+{
+    uint32_t count = argc > 0 ? static_cast<uint32_t>(atoi(argv[0])) : 200000;
+    int reps = argc > 1 ? atoi(argv[1]) : 5;
+    if (count == 0 || reps <= 0) {
+        fprintf(stderr, "strings: count and reps must be positive\n");
+        return 1;
+    }
+
+    // Random lowercase keys of 4..23 bytes drawn from a smaller key space so
+    // that dedupe has duplicates to remove.
+    constexpr uint32_t kMaxLen = 24;
+    uint64_t data_off = 0, refs_off = 0, out_off = 0;
+    if (ipc_arena_alloc(static_cast<size_t>(count) * kMaxLen, &data_off) != 0 ||
+        ipc_arena_alloc(static_cast<size_t>(count) * sizeof(IpcStrRef), &refs_off) != 0 ||
+        ipc_arena_alloc(static_cast<size_t>(count) * sizeof(uint32_t), &out_off) != 0) {
+        fprintf(stderr, "strings: arena allocation for %u strings failed\n", count);
+        return 1;
+    }
+    uint8_t *data = static_cast<uint8_t *>(ipc_arena_ptr(data_off));
+    IpcStrRef *refs = static_cast<IpcStrRef *>(ipc_arena_ptr(refs_off));
+    std::mt19937 rng(42);
+    for (uint32_t i = 0; i < count; ++i) {
+        std::mt19937 key_rng(rng() % (count / 2 + 1));
+        uint32_t len = 4 + key_rng() % (kMaxLen - 4);
+        uint8_t *dst = data + static_cast<size_t>(i) * kMaxLen;
+        for (uint32_t c = 0; c < len; ++c)
+            dst[c] = static_cast<uint8_t>('a' + key_rng() % 26);
+        refs[i] = IpcStrRef{static_cast<uint32_t>(data_off + static_cast<size_t>(i) * kMaxLen), len};
+    }
+
+    struct Op {
+        const char *name;
+        int (*submit)(uint64_t refs, uint32_t n, uint64_t out, uint64_t *req);
+    };
+    static const Op kOps[] = {
+        {"sort", ipc_str_sort},
+        {"dedupe", ipc_str_dedupe},
+        {"crc32c", [](uint64_t r, uint32_t n, uint64_t o, uint64_t *q) {
+             return ipc_str_hash(r, n, IPC_HASH_CRC32C, o, q);
+         }},
+        {"xxh32", [](uint64_t r, uint32_t n, uint64_t o, uint64_t *q) {
+             return ipc_str_hash(r, n, IPC_HASH_XXH32, o, q);
+         }},
+    };
+
+    int rc = 0;
+    for (const Op &op : kOps) {
+        double best = 1e30;
+        uint32_t written = 0;
+        for (int r = 0; r < reps; ++r) {
+            auto start = BenchClock::now();
+            uint64_t req = 0;
+            ResponsePayload resp;
+            ipc_status_t status;
+            if (op.submit(refs_off, count, out_off, &req) != 0 ||
+                wait_result(req, &resp, &status) != 0 || status != IPC_STATUS_OK) {
+                fprintf(stderr, "strings: %s request failed\n", op.name);
+                rc = 1;
+                break;
+            }
+            best = std::min(best, seconds_since(start));
+            written = resp.count;
+        }
+        if (rc != 0)
+            break;
+        printf("strings op=%s n=%u reps=%d best=%.3f ms Mstr/s(best)=%.2f results=%u\n",
+               op.name, count, reps, best * 1e3, count / best * 1e-6, written);
+    }
+
+    ipc_arena_free(data_off);
+    ipc_arena_free(refs_off);
+    ipc_arena_free(out_off);
+    return rc;
+}
+
+/* --- regex --- */
+
+static int bench_regex(int argc, char **argv)
+{
+    uint32_t hay_len = argc > 0 ? static_cast<uint32_t>(atoi(argv[0])) : 65536;
+    int requests = argc > 1 ? atoi(argv[1]) : 200;
+    if (hay_len == 0 || requests <= 0) {
+        fprintf(stderr, "regex: haystack size and request count must be positive\n");
+        return 1;
+    }
+
+    // Log-like text with the only match at the very end, so every request
+    // scans the whole haystack.
+    static const char kPattern[] = "(error|fatal)[ :]+code=\\d{3,5}";
+    static const char kTail[] = "fatal: code=4711";
+    uint32_t pattern_len = sizeof(kPattern) - 1;
+    if (hay_len < sizeof(kTail))
+        hay_len = sizeof(kTail);
+    uint64_t pattern_off = 0, hay_off = 0;
+    if (ipc_arena_alloc(pattern_len, &pattern_off) != 0 ||
+        ipc_arena_alloc(hay_len, &hay_off) != 0) {
+        fprintf(stderr, "regex: arena allocation failed\n");
+        return 1;
+    }
+    memcpy(ipc_arena_ptr(pattern_off), kPattern, pattern_len);
+    char *hay = static_cast<char *>(ipc_arena_ptr(hay_off));
+    static const char kFiller[] = "info: request served in 12 ms; warn: retry=0 ";
+    for (uint32_t i = 0; i < hay_len; ++i)
+        hay[i] = kFiller[i % (sizeof(kFiller) - 1)];
+    memcpy(hay + hay_len - (sizeof(kTail) - 1), kTail, sizeof(kTail) - 1);
+
+    int rc = 0;
+    double first = 0.0;
+    auto start = BenchClock::now();
+    for (int r = 0; r < requests; ++r) {
+        auto t0 = BenchClock::now();
+        uint64_t req = 0;
+        ResponsePayload resp;
+        ipc_status_t status;
+        if (ipc_regex_search(pattern_off, pattern_len, hay_off, hay_len, &req) != 0 ||
+            wait_result(req, &resp, &status) != 0 || status != IPC_STATUS_OK ||
+            resp.match.position != static_cast<int32_t>(hay_len - (sizeof(kTail) - 1))) {
+            fprintf(stderr, "regex: request failed or wrong match\n");
+            rc = 1;
+            break;
+        }
+        if (r == 0)
+            first = seconds_since(t0);   // includes compiling the pattern (if not cached yet)
+    }
+    if (rc == 0) {
+        double total = seconds_since(start);
+        printf("regex hay=%u requests=%d first=%.3f ms avg=%.3f ms MB/s=%.1f\n",
+               hay_len, requests, first * 1e3, total / requests * 1e3,
+               static_cast<double>(hay_len) * requests / total * 1e-6);
+    }
+
+    ipc_arena_free(pattern_off);
+    ipc_arena_free(hay_off);
+    return rc;
+}
+
+/* --- search_batch --- */
+
+static int bench_search_batch(int argc, char **argv)
+{
+    uint32_t count = argc > 0 ? static_cast<uint32_t>(atoi(argv[0])) : 1024;
+    int reps = argc > 1 ? atoi(argv[1]) : 20;
+    if (count == 0 || reps <= 0) {
+        fprintf(stderr, "search_batch: needle count and repetitions must be positive\n");
+        return 1;
+    }
+
+    // A short haystack (the IPC_CMD_SEARCH limit) so both paths do the same
+    // work; roughly half of the needles occur in it.
+    static const char kHay[IPC_MAX_STRING_LEN + 1] = "user=42;tag=blue";
+    std::mt19937 rng(81);
+    std::vector<std::string> needles(count);
+    for (std::string &nd : needles) {
+        if (rng() % 2) {
+            uint32_t start = rng() % IPC_MAX_STRING_LEN;
+            nd.assign(kHay + start, 1 + rng() % (IPC_MAX_STRING_LEN - start));
+        } else {
+            nd.assign(1 + rng() % 6, static_cast<char>('a' + rng() % 26));
+        }
+    }
+
+    uint64_t hay_off = 0, data_off = 0, refs_off = 0, out_off = 0;
+    if (ipc_arena_alloc(IPC_MAX_STRING_LEN, &hay_off) != 0 ||
+        ipc_arena_alloc(static_cast<size_t>(count) * IPC_MAX_STRING_LEN, &data_off) != 0 ||
+        ipc_arena_alloc(count * sizeof(IpcStrRef), &refs_off) != 0 ||
+        ipc_arena_alloc(count * sizeof(int32_t), &out_off) != 0) {
+        fprintf(stderr, "search_batch: arena allocation failed\n");
+        return 1;
+    }
+    memcpy(ipc_arena_ptr(hay_off), kHay, IPC_MAX_STRING_LEN);
+    auto *data = static_cast<char *>(ipc_arena_ptr(data_off));
+    auto *refs = static_cast<IpcStrRef *>(ipc_arena_ptr(refs_off));
+    uint64_t pos = data_off;
+    for (uint32_t i = 0; i < count; ++i) {
+        memcpy(data + (pos - data_off), needles[i].data(), needles[i].size());
+        refs[i] = IpcStrRef{static_cast<uint32_t>(pos), static_cast<uint32_t>(needles[i].size())};
+        pos += needles[i].size();
+    }
+    const auto *out = static_cast<const int32_t *>(ipc_arena_ptr(out_off));
+
+    int rc = 0;
+    auto start = BenchClock::now();
+    for (int r = 0; r < reps && rc == 0; ++r) {
+        uint64_t req = 0;
+        ResponsePayload resp;
+        ipc_status_t status;
+        if (ipc_search_batch(hay_off, IPC_MAX_STRING_LEN, refs_off, count, out_off, &req) != 0 ||
+            wait_result(req, &resp, &status) != 0 || status != IPC_STATUS_OK) {
+            fprintf(stderr, "search_batch: batch request failed\n");
+            rc = 1;
+        }
+    }
+    double batch = seconds_since(start);
+
+    start = BenchClock::now();
+    for (int r = 0; r < reps && rc == 0; ++r) {
+        for (uint32_t i = 0; i < count; ++i) {
+            uint64_t req = 0;
+            ResponsePayload resp;
+            ipc_status_t status;
+            if (ipc_search(kHay, needles[i].c_str(), &req) != 0 ||
+                wait_result(req, &resp, &status) != 0 ||
+                (status == IPC_STATUS_OK ? resp.position : -1) != out[i]) {
+                fprintf(stderr, "search_batch: single search failed or disagrees\n");
+                rc = 1;
+                break;
+            }
+        }
+    }
+    double single = seconds_since(start);
+
+    if (rc == 0) {
+        double total = static_cast<double>(count) * reps;
+        printf("search_batch needles=%u reps=%d batch Mneedles/s=%.2f single Mneedles/s=%.3f "
+               "speedup=%.1fx\n",
+               count, reps, total / batch * 1e-6, total / single * 1e-6, single / batch);
+    }
+
+    ipc_arena_free(hay_off);
+    ipc_arena_free(data_off);
+    ipc_arena_free(refs_off);
+    ipc_arena_free(out_off);
+    return rc;
+}
+
+/* --- arena --- */
+
+static int bench_arena(int argc, char **argv)
+{
+    int threads = argc > 0 ? atoi(argv[0]) : 4;
+    int ops = argc > 1 ? atoi(argv[1]) : 1000000;
+    if (threads <= 0 || ops <= 0) {
+        fprintf(stderr, "arena: thread and op counts must be positive\n");
+        return 1;
+    }
+
+    // Each thread keeps a small working set live, so pairs interleave the
+    // way request buffers do, and touches every buffer it gets.
+    static constexpr int kLive = 8;
+    static const size_t kSizes[] = {64, 1000, 4096, 256 * 1024};
+    int rc = 0;
+    for (size_t size : kSizes) {
+        int pairs = size > 4096 ? std::max(ops / 100, 1) : ops;
+        std::atomic<bool> failed{false};
+        auto start = BenchClock::now();
+        std::vector<std::thread> pool;
+        for (int t = 0; t < threads; ++t) {
+            pool.emplace_back([&failed, size, pairs] {
+                uint64_t live[kLive] = {};
+                for (int i = 0; i < pairs && !failed.load(std::memory_order_relaxed); ++i) {
+                    uint64_t &slot = live[i % kLive];
+                    if (slot && ipc_arena_free(slot) != 0)
+                        failed = true;
+                    if (ipc_arena_alloc(size, &slot) != 0) {
+                        failed = true;
+                        slot = 0;
+                        break;
+                    }
+                    static_cast<char *>(ipc_arena_ptr(slot))[0] = static_cast<char>(i);
+                }
+                for (uint64_t off : live) {
+                    if (off)
+                        ipc_arena_free(off);
+                }
+            });
+        }
+        for (std::thread &th : pool)
+            th.join();
+        double total = seconds_since(start);
+        if (failed) {
+            fprintf(stderr, "arena: allocation failed for %zu-byte buffers\n", size);
+            rc = 1;
+            break;
+        }
+        printf("arena size=%zu threads=%d pairs/thread=%d ns/pair=%.1f Mpairs/s=%.2f\n",
+               size, threads, pairs, total * 1e9 / pairs,
+               static_cast<double>(pairs) * threads / total * 1e-6);
+    }
+    return rc;
+}
+
+/* --- stream --- */
+
+static int bench_stream(int argc, char **argv)
+{
+    uint64_t total = argc > 0 ? strtoull(argv[0], nullptr, 10) : 10000000;
+    uint32_t batch = argc > 1 ? static_cast<uint32_t>(atoi(argv[1])) : 256;
+    if (total == 0 || batch == 0) {
+        fprintf(stderr, "stream: values and batch must be positive\n");
+        return 1;
+    }
+
+    uint32_t stream_id = 0;
+    if (ipc_stream_open(&stream_id) != 0) {
+        fprintf(stderr, "stream: open failed\n");
+        return 1;
+    }
+
+    std::vector<int32_t> values(batch);
+    std::mt19937 rng(42);
+    int64_t expected_sum = 0;
+    uint64_t pushed = 0;
+    uint64_t full_spins = 0;
+    auto start = BenchClock::now();
+    while (pushed < total) {
+        uint32_t n = static_cast<uint32_t>(std::min<uint64_t>(batch, total - pushed));
+        for (uint32_t i = 0; i < n; ++i) {
+            values[i] = static_cast<int32_t>(rng() % 100000);
+            expected_sum += values[i];
+        }
+        uint32_t done = 0;
+        while (done < n) {
+            uint32_t accepted = 0;
+            if (ipc_stream_push(stream_id, values.data() + done, n - done, &accepted) != 0) {
+                fprintf(stderr, "stream: push failed\n");
+                return 1;
+            }
+            done += accepted;
+            if (accepted == 0) {
+                ++full_spins;
+                std::this_thread::yield();
+            }
+        }
+        pushed += n;
+    }
+    double push_time = seconds_since(start);
+
+    StreamStats stats{};
+    int rc = ipc_stream_close(stream_id, &stats);
+    double total_time = seconds_since(start);
+    bool ok = rc == 0 && stats.count == total && stats.sum == expected_sum;
+    printf("stream values=%llu batch=%u push=%.1f Mvalues/s end-to-end=%.1f Mvalues/s "
+           "ring_full=%llu p50=%d p99=%d verify=%s\n",
+           static_cast<unsigned long long>(total), batch,
+           total / push_time * 1e-6, total / total_time * 1e-6,
+           static_cast<unsigned long long>(full_spins), stats.p50, stats.p99,
+           ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
+
+/* --- cache --- */
+
+static int bench_cache(int argc, char **argv)
+{
+    int calls = argc > 0 ? atoi(argv[0]) : 200000;
+    int distinct = argc > 1 ? atoi(argv[1]) : 64;
+    if (calls <= 0 || distinct <= 0) {
+        fprintf(stderr, "cache: call and operand counts must be positive\n");
+        return 1;
+    }
+
+    // Operands cycle through a small working set, as in clients that repeat
+    // the same additions within a short window.
+    for (uint32_t entries : {0u, 1024u}) {
+        ipc_result_cache_enable(entries);
+        auto start = BenchClock::now();
+        for (int i = 0; i < calls; ++i) {
+            int32_t a = i % distinct;
+            int32_t sum = 0;
+            if (ipc_add(a, 1000, &sum) != 0 || sum != a + 1000) {
+                fprintf(stderr, "cache: ipc_add failed or returned a wrong sum\n");
+                return 1;
+            }
+        }
+        double total = seconds_since(start);
+        IpcCacheStats stats{};
+        ipc_result_cache_stats(&stats);
+        printf("cache entries=%u calls=%d distinct=%d ns/call=%.1f hits=%llu misses=%llu\n",
+               entries, calls, distinct, total * 1e9 / calls,
+               static_cast<unsigned long long>(stats.hits),
+               static_cast<unsigned long long>(stats.misses));
+    }
+    ipc_result_cache_enable(0);
+    return 0;
+}
+
+/* --- edf --- */
+
+static int bench_edf(int argc, char **argv)
+{
+    int probes = argc > 0 ? atoi(argv[0]) : 500;
+    int budget_us = argc > 1 ? atoi(argv[1]) : 1000;
+    if (probes <= 0 || budget_us <= 0) {
+        fprintf(stderr, "edf: probe count and budget must be positive\n");
+        return 1;
+    }
+
+    // A batch thread keeps the math pool backed up with async matmuls while
+    // this thread times blocking ipc_add probes: first plain (FIFO behind the
+    // batch work), then with a deadline, then at high priority.
+    constexpr uint32_t kN = 160;
+    constexpr int kInflight = 8;
+    size_t bytes = static_cast<size_t>(kN) * kN * sizeof(int32_t);
+    uint64_t a_off = 0, c_offs[kInflight] = {};
+    bool alloc_ok = ipc_arena_alloc(bytes, &a_off) == 0;
+    for (uint64_t &off : c_offs)
+        alloc_ok = alloc_ok && ipc_arena_alloc(bytes, &off) == 0;
+    if (!alloc_ok) {
+        fprintf(stderr, "edf: arena allocation failed\n");
+        return 1;
+    }
+    memset(ipc_arena_ptr(a_off), 1, bytes);
+
+    struct ProbeClass {
+        uint64_t       budget_ns;
+        ipc_priority_t priority;
+    };
+    const ProbeClass classes[] = {
+        {0, IPC_PRIORITY_NORMAL},
+        {static_cast<uint64_t>(budget_us) * 1000, IPC_PRIORITY_NORMAL},
+        {0, IPC_PRIORITY_HIGH},
+    };
+    int rc = 0;
+    for (const ProbeClass &probe : classes) {
+        std::atomic<bool> stop{false};
+        std::atomic<bool> failed{false};
+        std::thread batch([&] {
+            while (!stop.load(std::memory_order_relaxed)) {
+                uint64_t reqs[kInflight];
+                for (int i = 0; i < kInflight; ++i) {
+                    if (ipc_matmul(kN, kN, kN, IPC_DTYPE_INT32, a_off, a_off, c_offs[i],
+                                   &reqs[i]) != 0) {
+                        failed = true;
+                        return;
+                    }
+                }
+                for (uint64_t req : reqs) {
+                    ResponsePayload resp;
+                    ipc_status_t status;
+                    wait_result(req, &resp, &status);
+                }
+            }
+        });
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        ipc_set_deadline(probe.budget_ns);
+        ipc_set_priority(probe.priority);
+        std::vector<double> lat;
+        lat.reserve(static_cast<size_t>(probes));
+        for (int i = 0; i < probes && !failed.load(); ++i) {
+            int32_t sum = 0;
+            auto start = BenchClock::now();
+            if (ipc_add(i, 1, &sum) != 0 || sum != i + 1) {
+                failed = true;
+                break;
+            }
+            lat.push_back(seconds_since(start) * 1e6);
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+        ipc_set_deadline(0);
+        ipc_set_priority(IPC_PRIORITY_NORMAL);
+        stop = true;
+        batch.join();
+        if (failed || lat.empty()) {
+            fprintf(stderr, "edf: requests failed\n");
+            rc = 1;
+            break;
+        }
+        std::sort(lat.begin(), lat.end());
+        printf("edf budget_us=%llu priority=%s probes=%zu p50_us=%.1f p99_us=%.1f "
+               "max_us=%.1f\n",
+               static_cast<unsigned long long>(probe.budget_ns / 1000),
+               probe.priority == IPC_PRIORITY_HIGH ? "high" : "normal", lat.size(),
+               lat[lat.size() / 2], lat[lat.size() * 99 / 100], lat.back());
+    }
+
+    ipc_arena_free(a_off);
+    for (uint64_t off : c_offs)
+        ipc_arena_free(off);
+    return rc;
+}
+
+/* --- spin --- */
+
+static int bench_spin(int argc, char **argv)
+{
+    int calls = argc > 0 ? atoi(argv[0]) : 20000;
+    if (calls <= 0) {
+        fprintf(stderr, "spin: call count must be positive\n");
+        return 1;
+    }
+
+    IpcWaitStats defaults{};
+    ipc_wait_stats(&defaults);
+    std::vector<double> lat(static_cast<size_t>(calls));
+    for (uint64_t limit : {uint64_t{0}, defaults.spin_limit_ns}) {
+        ipc_set_spin_limit(limit);
+        IpcWaitStats before{};
+        ipc_wait_stats(&before);
+        for (int i = 0; i < calls; ++i) {
+            int32_t sum = 0;
+            auto start = BenchClock::now();
+            if (ipc_add(i, 1, &sum) != 0 || sum != i + 1) {
+                fprintf(stderr, "spin: ipc_add failed or returned a wrong sum\n");
+                ipc_set_spin_limit(defaults.spin_limit_ns);
+                return 1;
+            }
+            lat[static_cast<size_t>(i)] = seconds_since(start) * 1e6;
+        }
+        IpcWaitStats after{};
+        ipc_wait_stats(&after);
+        std::sort(lat.begin(), lat.end());
+        printf("spin limit_us=%llu calls=%d p50_us=%.1f p99_us=%.1f spin_hits=%llu "
+               "sleeps=%llu service_ns=%llu\n",
+               static_cast<unsigned long long>(limit / 1000), calls,
+               lat[lat.size() / 2], lat[lat.size() * 99 / 100],
+               static_cast<unsigned long long>(after.spin_hits - before.spin_hits),
+               static_cast<unsigned long long>(after.sleeps - before.sleeps),
+               static_cast<unsigned long long>(after.add_service_ns));
+    }
+    ipc_set_spin_limit(defaults.spin_limit_ns);
+    return 0;
+}
+
+/* --- magazine --- */
+
+static int bench_magazine(int argc, char **argv)
+{
+    int threads = argc > 0 ? atoi(argv[0]) : 8;
+    int calls = argc > 1 ? atoi(argv[1]) : 20000;
+    if (threads <= 0 || threads > IPC_MAX_SLOTS || calls <= 0) {
+        fprintf(stderr, "magazine: threads must be 1..%d and calls positive\n", IPC_MAX_SLOTS);
+        return 1;
+    }
+
+    // Every thread makes blocking adds; with a magazine each keeps one slot
+    // and claims it without /ipc_mutex.
+    for (uint32_t capacity : {0u, 1u}) {
+        std::atomic<bool> failed{false};
+        std::atomic<uint64_t> hits{0};
+        auto start = BenchClock::now();
+        std::vector<std::thread> pool;
+        for (int t = 0; t < threads; ++t) {
+            pool.emplace_back([&failed, &hits, capacity, calls] {
+                ipc_slot_magazine(capacity);
+                for (int i = 0; i < calls && !failed.load(std::memory_order_relaxed); ++i) {
+                    int32_t sum = 0;
+                    if (ipc_add(i, 1, &sum) != 0 || sum != i + 1)
+                        failed = true;
+                }
+                IpcSlotMagazineStats stats{};
+                ipc_slot_magazine_stats(&stats);
+                hits += stats.hits;
+                ipc_slot_magazine(0);
+            });
+        }
+        for (std::thread &th : pool)
+            th.join();
+        double total = seconds_since(start);
+        if (failed) {
+            fprintf(stderr, "magazine: ipc_add failed or returned a wrong sum\n");
+            return 1;
+        }
+        double all_calls = static_cast<double>(calls) * threads;
+        printf("magazine capacity=%u threads=%d calls/thread=%d ns/call=%.1f Mcalls/s=%.3f "
+               "magazine_hits=%.1f%%\n",
+               capacity, threads, calls, total * 1e9 / calls, all_calls / total * 1e-6,
+               100.0 * static_cast<double>(hits.load()) / all_calls);
+    }
+    return 0;
+}
+
+/* --- reconnect --- */
+
+/* One client's report, small enough for an atomic pipe write. */
+struct ReconnectSample {
+    uint64_t done_ns;        // ipc_monotonic_ns() of the first good call
+    uint64_t reconnect_ns;   // duration of the call that reported the restart
+    uint32_t attempts;       // calls made, including the good one
+    int32_t  ok;
+};
+
+/* Pid the running server wrote into its lock file; -1 if there is none. */
+static pid_t running_server_pid()
+{
+    FILE *f = fopen(IPC_SERVER_LOCK_FILE, "r");
+    if (!f)
+        return -1;
+    int pid = -1;
+    if (fscanf(f, "%d", &pid) != 1)
+        pid = -1;
+    fclose(f);
+    return pid;
+}
+
+/* Executable, working directory and argv of @p pid, read from /proc. */
+static bool server_command(pid_t pid, std::string *exe, std::string *cwd,
+                           std::vector<std::string> *args)
+{
+    char path[64];
+    char buf[4096];
+    snprintf(path, sizeof(path), "/proc/%d/exe", static_cast<int>(pid));
+    ssize_t n = readlink(path, buf, sizeof(buf) - 1);
+    if (n <= 0)
+        return false;
+    exe->assign(buf, static_cast<size_t>(n));
+    snprintf(path, sizeof(path), "/proc/%d/cwd", static_cast<int>(pid));
+    n = readlink(path, buf, sizeof(buf) - 1);
+    if (n <= 0)
+        return false;
+    cwd->assign(buf, static_cast<size_t>(n));
+
+    snprintf(path, sizeof(path), "/proc/%d/cmdline", static_cast<int>(pid));
+    FILE *f = fopen(path, "r");
+    if (!f)
+        return false;
+    size_t len = fread(buf, 1, sizeof(buf), f);
+    fclose(f);
+    for (size_t pos = 0; pos < len;) {
+        size_t end = pos;
+        while (end < len && buf[end] != '\0')
+            ++end;
+        args->emplace_back(buf + pos, end - pos);
+        pos = end + 1;
+    }
+    return !args->empty();
+}
+
+/* The server holds its lock file until it exits (even as a zombie it has released it). */
+static bool wait_server_exit(uint64_t timeout_ns)
+{
+    uint64_t until = ipc_monotonic_ns() + timeout_ns;
+    while (ipc_monotonic_ns() < until) {
+        int fd = open(IPC_SERVER_LOCK_FILE, O_RDWR | O_CLOEXEC);
+        if (fd < 0)
+            return true;   // removed on a clean exit
+        bool free = flock(fd, LOCK_EX | LOCK_NB) == 0;
+        close(fd);
+        if (free)
+            return true;
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    return false;
+}
+
+/* Start the server detached from this process, so it outlives the bench. */
+static bool respawn_server(const std::string &exe, const std::string &cwd,
+                           const std::vector<std::string> &args)
+{
+    pid_t child = fork();
+    if (child < 0)
+        return false;
+    if (child == 0) {
+        if (fork() != 0)
+            _exit(0);
+        setsid();
+        int devnull = open("/dev/null", O_RDWR);
+        dup2(devnull, STDIN_FILENO);
+        dup2(devnull, STDOUT_FILENO);
+        dup2(devnull, STDERR_FILENO);
+        if (chdir(cwd.c_str()) != 0)
+            _exit(127);
+        std::vector<char *> argv;
+        for (const std::string &a : args)
+            argv.push_back(const_cast<char *>(a.c_str()));
+        argv.push_back(nullptr);
+        execv(exe.c_str(), argv.data());
+        _exit(127);
+    }
+    int status = 0;
+    waitpid(child, &status, 0);
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+/* Generation published in the live segment; 0 while absent or starting. */
+static uint64_t live_generation()
+{
+    int fd = shm_open(IPC_SHM_NAME, O_RDONLY, 0);
+    if (fd < 0)
+        return 0;
+    void *map = mmap(nullptr, sizeof(uint64_t), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return 0;
+    uint64_t generation = __atomic_load_n(static_cast<const uint64_t *>(map), __ATOMIC_ACQUIRE);
+    munmap(map, sizeof(uint64_t));
+    return generation;
+}
+
+/* Forked client: connect, report ready, then time the first good call after "go". */
+static void reconnect_client(int ready_fd, int go_fd, int result_fd, int index)
+{
+    ipc_cleanup();   // the inherited connection belongs to the parent
+    int devnull = open("/dev/null", O_WRONLY);
+    dup2(devnull, STDERR_FILENO);   // "no free slots" from 128 clients sharing 16 slots
+    char byte = ipc_init() == 0 ? 1 : 0;
+    int32_t sum = 0;
+    if (byte && (ipc_add(index, 1, &sum) != 0 || sum != index + 1))
+        byte = 0;
+    if (write(ready_fd, &byte, 1) != 1 || !byte)
+        _exit(1);
+    while (read(go_fd, &byte, 1) > 0) {
+    }
+
+    ReconnectSample sample{0, 0, 0, 0};
+    uint64_t give_up = ipc_monotonic_ns() + 30'000'000'000ull;
+    while (ipc_monotonic_ns() < give_up) {
+        ++sample.attempts;
+        uint64_t call_ns = ipc_monotonic_ns();
+        int rc = ipc_add(index, 2, &sum);
+        if (rc == 0 && sum == index + 2) {
+            sample.ok = 1;
+            break;
+        }
+        if (rc == IPC_ERR_SERVER_RESTARTED && sample.reconnect_ns == 0)
+            sample.reconnect_ns = ipc_monotonic_ns() - call_ns;
+        if (rc == -1)   // e.g. all slots busy with the other clients
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    sample.done_ns = ipc_monotonic_ns();
+    ssize_t n = write(result_fd, &sample, sizeof(sample));
+    ipc_cleanup();
+    _exit(n == static_cast<ssize_t>(sizeof(sample)) ? 0 : 1);
+}
+
+static int bench_reconnect(int argc, char **argv)
+{
+    int clients = argc > 0 ? atoi(argv[0]) : 128;
+    const char *mode = argc > 1 ? argv[1] : "kill";
+    bool crash = strcmp(mode, "kill") == 0;
+    if (clients <= 0 || (!crash && strcmp(mode, "term") != 0)) {
+        fprintf(stderr, "reconnect: client count must be positive; mode is kill or term\n");
+        return 1;
+    }
+    pid_t server = running_server_pid();
+    std::string exe, cwd;
+    std::vector<std::string> args;
+    if (server <= 0 || !server_command(server, &exe, &cwd, &args)) {
+        fprintf(stderr, "reconnect: cannot find the running server via %s\n",
+                IPC_SERVER_LOCK_FILE);
+        return 1;
+    }
+
+    int ready[2], go[2], results[2];
+    if (pipe2(ready, O_CLOEXEC) != 0 || pipe2(go, O_CLOEXEC) != 0 ||
+        pipe2(results, O_CLOEXEC) != 0) {
+        perror("reconnect: pipe");
+        return 1;
+    }
+    std::vector<pid_t> children;
+    for (int i = 0; i < clients; ++i) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(ready[0]);
+            close(go[1]);
+            close(results[0]);
+            reconnect_client(ready[1], go[0], results[1], i);
+        }
+        if (pid < 0) {
+            perror("reconnect: fork");
+            break;
+        }
+        children.push_back(pid);
+    }
+    close(ready[1]);
+    close(go[0]);
+    close(results[1]);
+
+    int connected = 0;
+    char byte = 0;
+    for (size_t i = 0; i < children.size() && read(ready[0], &byte, 1) == 1; ++i)
+        connected += byte;
+
+    // Restart the server under the connected clients, then release them all
+    // at once as soon as the new instance has published its generation.
+    uint64_t old_generation = live_generation();
+    uint64_t kill_ns = ipc_monotonic_ns();
+    kill(server, crash ? SIGKILL : SIGTERM);
+    bool restarted = wait_server_exit(10'000'000'000ull);
+    uint64_t spawn_ns = ipc_monotonic_ns();
+    restarted = restarted && respawn_server(exe, cwd, args);
+    uint64_t generation = 0;
+    while (restarted && ipc_monotonic_ns() - spawn_ns < 10'000'000'000ull) {
+        generation = live_generation();
+        if (generation != 0 && generation != old_generation)
+            break;
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    uint64_t go_ns = ipc_monotonic_ns();
+    close(go[1]);
+
+    std::vector<double> ms;
+    std::vector<double> reconnect_us;
+    uint64_t attempts = 0;
+    ReconnectSample sample{};
+    while (read(results[0], &sample, sizeof(sample)) == static_cast<ssize_t>(sizeof(sample))) {
+        attempts += sample.attempts;
+        if (sample.ok)
+            ms.push_back((sample.done_ns - go_ns) / 1e6);
+        if (sample.reconnect_ns)
+            reconnect_us.push_back(sample.reconnect_ns / 1e3);
+    }
+    for (pid_t pid : children)
+        waitpid(pid, nullptr, 0);
+    close(ready[0]);
+    close(results[0]);
+
+    if (generation == 0 || generation == old_generation) {
+        fprintf(stderr, "reconnect: the server did not come back (%s)\n", exe.c_str());
+        return 1;
+    }
+    std::sort(ms.begin(), ms.end());
+    std::sort(reconnect_us.begin(), reconnect_us.end());
+    auto pct = [](const std::vector<double> &v, size_t num) {
+        return v.empty() ? 0.0 : v[std::min(v.size() - 1, v.size() * num / 100)];
+    };
+    printf("reconnect mode=%s clients=%d connected=%d down_ms=%.1f start_ms=%.1f ok=%zu "
+           "first_call_ms p50=%.2f p99=%.2f max=%.2f reconnect_us p50=%.0f p99=%.0f calls=%llu\n",
+           mode, clients, connected, (spawn_ns - kill_ns) / 1e6, (go_ns - spawn_ns) / 1e6,
+           ms.size(), pct(ms, 50), pct(ms, 99), pct(ms, 100), pct(reconnect_us, 50),
+           pct(reconnect_us, 99), static_cast<unsigned long long>(attempts));
+    return ms.size() == static_cast<size_t>(connected) ? 0 : 1;
+}
+
+/* --- latency --- */
+
+/* Server flags added for the real-time phase of `latency`. */
+static const char *const kRtServerArgs[] = {"--rt-dispatcher=80", "--rt-math=70",
+                                            "--rt-string=70", "--mlock"};
+
+/* Below the server's workers, so the caller's wait spin never holds them off a core. */
+static constexpr int kRtClientPriority = 60;
+
+/* Restart the server at @p pid with @p args; waits until the new one published its generation. */
+static bool restart_server_with(pid_t pid, const std::string &exe, const std::string &cwd,
+                                const std::vector<std::string> &args)
+{
+    uint64_t old_generation = live_generation();
+    kill(pid, SIGINT);
+    if (!wait_server_exit(10'000'000'000ull) || !respawn_server(exe, cwd, args))
+        return false;
+    uint64_t until = ipc_monotonic_ns() + 10'000'000'000ull;
+    while (ipc_monotonic_ns() < until) {
+        uint64_t generation = live_generation();
+        if (generation != 0 && generation != old_generation)
+            break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    // The first call after a restart reports it; later ones reach the new server.
+    int32_t sum = 0;
+    for (int i = 0; i < 100; ++i) {
+        if (ipc_add(1, 1, &sum) == 0)
+            return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return false;
+}
+
+/*
+ * Time @p calls blocking adds, paced like a periodic consumer, while @p hogs
+ * processes burn every core at normal priority.
+ */
+static bool measure_latency(const char *mode, int calls, int hogs)
+{
+    std::vector<pid_t> hog_pids;
+    for (int i = 0; i < hogs; ++i) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            // A hog inheriting the caller's SCHED_FIFO would never yield the core.
+            sched_param normal{};
+            sched_setscheduler(0, SCHED_OTHER, &normal);
+            volatile uint64_t spins = 0;
+            while (true)
+                spins = spins + 1;
+        }
+        if (pid > 0)
+            hog_pids.push_back(pid);
+    }
+    std::vector<double> lat;
+    lat.reserve(static_cast<size_t>(calls));
+    bool ok = true;
+    for (int i = 0; i < calls; ++i) {
+        int32_t sum = 0;
+        auto start = BenchClock::now();
+        if (ipc_add(i, 1, &sum) != 0 || sum != i + 1) {
+            ok = false;
+            break;
+        }
+        lat.push_back(seconds_since(start) * 1e6);
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    for (pid_t pid : hog_pids) {
+        kill(pid, SIGKILL);
+        waitpid(pid, nullptr, 0);
+    }
+    if (!ok || lat.empty()) {
+        fprintf(stderr, "latency: ipc_add failed or returned a wrong sum\n");
+        return false;
+    }
+
+    double mean = 0;
+    for (double v : lat)
+        mean += v;
+    mean /= static_cast<double>(lat.size());
+    double var = 0;
+    for (double v : lat)
+        var += (v - mean) * (v - mean);
+    std::sort(lat.begin(), lat.end());
+    printf("latency mode=%s hogs=%d calls=%zu p50_us=%.1f p99_us=%.1f p999_us=%.1f "
+           "max_us=%.1f jitter_us=%.1f\n",
+           mode, hogs, lat.size(), lat[lat.size() / 2], lat[lat.size() * 99 / 100],
+           lat[lat.size() * 999 / 1000], lat.back(),
+           std::sqrt(var / static_cast<double>(lat.size())));
+    return true;
+}
+
+static int bench_latency(int argc, char **argv)
+{
+    int calls = argc > 0 ? atoi(argv[0]) : 20000;
+    int hogs = argc > 1 ? atoi(argv[1]) : static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN));
+    if (calls <= 0 || hogs < 0) {
+        fprintf(stderr, "latency: call count must be positive, hogs non-negative\n");
+        return 1;
+    }
+    pid_t server = running_server_pid();
+    std::string exe, cwd;
+    std::vector<std::string> args;
+    if (server <= 0 || !server_command(server, &exe, &cwd, &args)) {
+        fprintf(stderr, "latency: cannot find the running server via %s\n",
+                IPC_SERVER_LOCK_FILE);
+        return 1;
+    }
+    if (!measure_latency("normal", calls, hogs))
+        return 1;
+
+    // Probe first: the server would fall back quietly, the bench would not notice.
+    sched_param param{};
+    param.sched_priority = kRtClientPriority;
+    int rc = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (rc != 0) {
+        printf("latency mode=rt skipped: %s (needs CAP_SYS_NICE or RLIMIT_RTPRIO)\n",
+               strerror(rc));
+        return 0;
+    }
+    param.sched_priority = 0;
+    pthread_setschedparam(pthread_self(), SCHED_OTHER, &param);
+
+    // Respawn from SCHED_OTHER, so the server's own threads do not inherit FIFO.
+    std::vector<std::string> rt_args;
+    for (const std::string &a : args) {
+        if (a.compare(0, 5, "--rt-") != 0 && a != "--mlock")
+            rt_args.push_back(a);
+    }
+    rt_args.insert(rt_args.end(), std::begin(kRtServerArgs), std::end(kRtServerArgs));
+    bool ok = restart_server_with(server, exe, cwd, rt_args);
+    if (ok) {
+        param.sched_priority = kRtClientPriority;
+        pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        ok = measure_latency("rt", calls, hogs);
+        param.sched_priority = 0;
+        pthread_setschedparam(pthread_self(), SCHED_OTHER, &param);
+    }
+    // Put the original server back, so the next scenario runs against it.
+    server = running_server_pid();
+    if (server <= 0 || !restart_server_with(server, exe, cwd, args)) {
+        fprintf(stderr, "latency: could not restart the server as %s\n", exe.c_str());
+        return 1;
+    }
+    return ok ? 0 : 1;
+}
+
+/* --- Main --- */
+
+struct Scenario {
+    const char *name;
+    const char *usage;
+    int (*run)(int argc, char **argv);
+};
+
+static const Scenario kScenarios[] = {
+    {"matmul", "matmul [size=512] [int32|float] [reps=5]", bench_matmul},
+    {"strings", "strings [count=200000] [reps=5]", bench_strings},
+    {"regex", "regex [hay_bytes=65536] [requests=200]", bench_regex},
+    {"search_batch", "search_batch [needles=1024] [reps=20]", bench_search_batch},
+    {"stream", "stream [values=10000000] [batch=256]", bench_stream},
+    {"arena", "arena [threads=4] [ops=1000000]", bench_arena},
+    {"cache", "cache [calls=200000] [distinct=64]", bench_cache},
+    {"edf", "edf [probes=500] [budget_us=1000]", bench_edf},
+    {"spin", "spin [calls=20000]", bench_spin},
+    {"magazine", "magazine [threads=8] [calls=20000]", bench_magazine},
+    {"reconnect", "reconnect [clients=128] [kill|term]", bench_reconnect},
+    {"latency", "latency [calls=20000] [hogs=<cpus>]", bench_latency},
+};
+
+static void print_usage()
+{
+    fprintf(stderr, "Usage: ipc_bench <scenario> [args...]\nScenarios:\n");
+    for (const Scenario &s : kScenarios)
+        fprintf(stderr, "  %s\n", s.usage);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        print_usage();
+        return 2;
+    }
+
+    const Scenario *scenario = nullptr;
+    for (const Scenario &s : kScenarios) {
+        if (strcmp(argv[1], s.name) == 0)
+            scenario = &s;
+    }
+    if (!scenario) {
+        print_usage();
+        return 2;
+    }
+
+    if (ipc_init() != 0) {
+        fprintf(stderr, "Failed to connect to server. Is it running?\n");
+        return 1;
+    }
+    int rc = scenario->run(argc - 2, argv + 2);
+    ipc_cleanup();
+    return rc;
+}
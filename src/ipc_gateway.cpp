@@ -0,0 +1,574 @@
+/**
+ * @file ipc_gateway.cpp
+ * @brief ipc_gateway: serves the scalar commands to remote clients over TCP.
+ *
+ * Usage: ipc_gateway [--bind ADDR] [--port N] [--loops N]
+ *
+ * Each event loop owns an edge-triggered epoll set and its own SO_REUSEPORT
+ * listening socket, so the kernel spreads connections across loops and the
+ * loops share no state. A loop decodes request frames (framing in
+ * ipc_defs.h) into a backlog, moves as much of it into free slots as it can
+ * with one ipc_submit_batch() per pass, and collects answers with
+ * ipc_reap(). While requests are outstanding it polls every 50 us, the
+ * interval the other async clients use; otherwise it sleeps in epoll_wait.
+ */
+#include "cpu_budget.h"
+#include "libipc.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+constexpr size_t   kMaxQueuedPerConn = 1024;        // decoded, not yet answered
+constexpr size_t   kMaxInputBytes = 64 * 1024;      // undecoded bytes per connection
+constexpr uint64_t kListenId = 0;
+constexpr uint64_t kWakeId = 1;
+constexpr auto     kPollInterval = std::chrono::microseconds(50);
+
+std::atomic<bool> g_stop{false};
+int g_wake_fd = -1;
+
+void stop_handler(int /*sig*/)
+{
+    g_stop.store(true);
+    uint64_t one = 1;
+    ssize_t rc = write(g_wake_fd, &one, sizeof(one));
+    (void)rc;
+}
+
+void put_u32(std::string &out, uint32_t v)
+{
+    char b[4] = {static_cast<char>(v), static_cast<char>(v >> 8),
+                 static_cast<char>(v >> 16), static_cast<char>(v >> 24)};
+    out.append(b, 4);
+}
+
+uint32_t get_u32(const char *p)
+{
+    const auto *u = reinterpret_cast<const unsigned char *>(p);
+    return static_cast<uint32_t>(u[0]) | static_cast<uint32_t>(u[1]) << 8 |
+           static_cast<uint32_t>(u[2]) << 16 | static_cast<uint32_t>(u[3]) << 24;
+}
+
+bool is_math(uint8_t cmd)
+{
+    return cmd == IPC_CMD_ADD || cmd == IPC_CMD_SUB || cmd == IPC_CMD_MUL ||
+           cmd == IPC_CMD_DIV;
+}
+
+/**
+ * @brief Decode one request payload into @p sub.
+ * @return false if the command is not served over TCP or the payload is malformed.
+ */
+bool decode_request(uint8_t cmd, const char *p, size_t len, IpcSubmission *sub)
+{
+    memset(sub, 0, sizeof(*sub));
+    sub->cmd = static_cast<ipc_cmd_t>(cmd);
+    if (is_math(cmd)) {
+        if (len != 8)
+            return false;
+        sub->request.math.a = static_cast<int32_t>(get_u32(p));
+        sub->request.math.b = static_cast<int32_t>(get_u32(p + 4));
+        return true;
+    }
+    if (cmd != IPC_CMD_CONCAT && cmd != IPC_CMD_SEARCH)
+        return false;
+    if (len < 1)
+        return false;
+    size_t len1 = static_cast<uint8_t>(p[0]);
+    if (len1 < 1 || len1 > IPC_MAX_STRING_LEN || len < 2 + len1)
+        return false;
+    size_t len2 = static_cast<uint8_t>(p[1 + len1]);
+    if (len2 < 1 || len2 > IPC_MAX_STRING_LEN || len != 2 + len1 + len2)
+        return false;
+    StringArgs &str = sub->request.str;
+    str.len1 = static_cast<uint8_t>(len1);
+    str.len2 = static_cast<uint8_t>(len2);
+    memcpy(str.s1, p + 1, len1);
+    memcpy(str.s2, p + 2 + len1, len2);
+    return true;
+}
+
+void encode_response(std::string &out, uint32_t tag, uint8_t cmd, uint8_t status,
+                     const ResponsePayload *resp)
+{
+    std::string body;
+    put_u32(body, tag);
+    body.push_back(static_cast<char>(status));
+    if (resp && status == IPC_STATUS_OK) {
+        if (cmd == IPC_CMD_CONCAT) {
+            size_t n = strnlen(resp->str_result, IPC_MAX_RESULT_LEN - 1);
+            body.push_back(static_cast<char>(n));
+            body.append(resp->str_result, n);
+        } else if (cmd == IPC_CMD_SEARCH) {
+            put_u32(body, static_cast<uint32_t>(resp->position));
+        } else {
+            put_u32(body, static_cast<uint32_t>(resp->math_result));
+        }
+    }
+    put_u32(out, static_cast<uint32_t>(body.size()));
+    out += body;
+}
+
+struct Conn {
+    int         fd = -1;
+    std::string in;
+    size_t      in_off = 0;     ///< Decoded prefix of @c in.
+    std::string out;
+    size_t      out_off = 0;    ///< Sent prefix of @c out.
+    size_t      queued = 0;     ///< Requests decoded but not yet answered.
+    bool        eof = false;    ///< Peer closed its side; close once answered.
+};
+
+struct Request {
+    uint64_t      conn;
+    uint32_t      tag;
+    IpcSubmission sub;
+};
+
+class EventLoop {
+public:
+    explicit EventLoop(int listen_fd) : listen_fd_(listen_fd) {}
+
+    bool init()
+    {
+        epfd_ = epoll_create1(EPOLL_CLOEXEC);
+        if (epfd_ < 0) {
+            perror("ipc_gateway: epoll_create1");
+            return false;
+        }
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLET;
+        ev.data.u64 = kListenId;
+        if (epoll_ctl(epfd_, EPOLL_CTL_ADD, listen_fd_, &ev) < 0)
+            return false;
+        ev.events = EPOLLIN;   // level-triggered: every loop sees the stop signal
+        ev.data.u64 = kWakeId;
+        return epoll_ctl(epfd_, EPOLL_CTL_ADD, g_wake_fd, &ev) == 0;
+    }
+
+    ~EventLoop()
+    {
+        for (auto &entry : conns_)
+            close(entry.second.fd);
+        if (epfd_ >= 0)
+            close(epfd_);
+        close(listen_fd_);
+    }
+
+    void run()
+    {
+        epoll_event events[64];
+        while (!g_stop.load()) {
+            bool busy = !backlog_.empty() || !inflight_.empty();
+            int n = epoll_wait(epfd_, events, 64, busy ? 0 : -1);
+            if (n < 0 && errno != EINTR) {
+                perror("ipc_gateway: epoll_wait");
+                break;
+            }
+            for (int i = 0; i < n; ++i)
+                handle_event(events[i]);
+            bool progress = submit_backlog();
+            progress |= reap();
+            if (busy && n <= 0 && !progress)
+                std::this_thread::sleep_for(kPollInterval);
+        }
+        // Collect what is still in flight so its slots are freed.
+        for (int i = 0; i < 20000 && !inflight_.empty(); ++i) {
+            if (!reap())
+                std::this_thread::sleep_for(kPollInterval);
+        }
+    }
+
+private:
+    void handle_event(const epoll_event &ev)
+    {
+        if (ev.data.u64 == kWakeId)
+            return;
+        if (ev.data.u64 == kListenId) {
+            accept_all();
+            return;
+        }
+        uint64_t id = ev.data.u64;
+        if (conns_.count(id) == 0)
+            return;
+        if (ev.events & (EPOLLERR | EPOLLHUP)) {
+            close_conn(id);
+            return;
+        }
+        if (ev.events & (EPOLLIN | EPOLLRDHUP))
+            pump(id);
+        if ((ev.events & EPOLLOUT) && conns_.count(id) != 0)
+            flush(id);
+    }
+
+    void accept_all()
+    {
+        while (true) {
+            int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno == EINTR)
+                    continue;
+                return;   // EAGAIN, or a transient error such as EMFILE
+            }
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            uint64_t id = next_conn_id_++;
+            epoll_event ev{};
+            ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+            ev.data.u64 = id;
+            if (epoll_ctl(epfd_, EPOLL_CTL_ADD, fd, &ev) < 0) {
+                close(fd);
+                continue;
+            }
+            conns_[id].fd = fd;
+        }
+    }
+
+    /** Read what the socket has (within the input limit) and decode frames. */
+    void pump(uint64_t id)
+    {
+        Conn &c = conns_[id];
+        char buf[16384];
+        while (!c.eof && c.in.size() - c.in_off < kMaxInputBytes) {
+            ssize_t n = recv(c.fd, buf, sizeof(buf), 0);
+            if (n > 0) {
+                c.in.append(buf, static_cast<size_t>(n));
+                continue;
+            }
+            if (n == 0)
+                c.eof = true;
+            else if (errno == EINTR)
+                continue;
+            else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                close_conn(id);
+                return;
+            }
+            break;
+        }
+        if (!decode(id))
+            return;
+        if (c.eof && c.queued == 0 && c.out_off == c.out.size())
+            close_conn(id);
+    }
+
+    /** Turn complete frames into backlog entries; false if the connection was dropped. */
+    bool decode(uint64_t id)
+    {
+        Conn &c = conns_[id];
+        while (c.queued < kMaxQueuedPerConn && c.in.size() - c.in_off >= 4) {
+            const char *p = c.in.data() + c.in_off;
+            uint32_t len = get_u32(p);
+            if (len < 5 || len > IPC_GW_MAX_FRAME) {
+                fprintf(stderr, "ipc_gateway: bad frame length %u, closing connection\n", len);
+                close_conn(id);
+                return false;
+            }
+            if (c.in.size() - c.in_off < 4 + static_cast<size_t>(len))
+                break;
+            uint32_t tag = get_u32(p + 4);
+            auto cmd = static_cast<uint8_t>(p[8]);
+            Request req{id, tag, {}};
+            if (decode_request(cmd, p + 9, len - 5, &req.sub)) {
+                backlog_.push_back(req);
+                ++c.queued;
+            } else {
+                encode_response(c.out, tag, cmd, IPC_GW_STATUS_REJECTED, nullptr);
+            }
+            c.in_off += 4 + len;
+        }
+        if (c.in_off == c.in.size()) {
+            c.in.clear();
+            c.in_off = 0;
+        } else if (c.in_off > kMaxInputBytes) {
+            c.in.erase(0, c.in_off);
+            c.in_off = 0;
+        }
+        flush(id);
+        return conns_.count(id) != 0;
+    }
+
+    void flush(uint64_t id)
+    {
+        auto it = conns_.find(id);
+        if (it == conns_.end())
+            return;
+        Conn &c = it->second;
+        while (c.out_off < c.out.size()) {
+            ssize_t n = send(c.fd, c.out.data() + c.out_off, c.out.size() - c.out_off,
+                             MSG_NOSIGNAL);
+            if (n > 0) {
+                c.out_off += static_cast<size_t>(n);
+                continue;
+            }
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                return;   // EPOLLOUT will fire when there is room
+            close_conn(id);
+            return;
+        }
+        c.out.clear();
+        c.out_off = 0;
+        if (c.eof && c.queued == 0)
+            close_conn(id);
+    }
+
+    void close_conn(uint64_t id)
+    {
+        auto it = conns_.find(id);
+        if (it == conns_.end())
+            return;
+        close(it->second.fd);   // also drops it from the epoll set
+        conns_.erase(it);
+    }
+
+    /** Answer a request that never reached the server or whose answer was lost. */
+    void reject(const Request &req)
+    {
+        auto it = conns_.find(req.conn);
+        if (it == conns_.end())
+            return;
+        --it->second.queued;
+        encode_response(it->second.out, req.tag, static_cast<uint8_t>(req.sub.cmd),
+                        IPC_GW_STATUS_REJECTED, nullptr);
+        touched_.push_back(req.conn);
+    }
+
+    bool submit_backlog()
+    {
+        bool progress = false;
+        while (!backlog_.empty()) {
+            IpcSubmission subs[IPC_MAX_SLOTS];
+            uint32_t count = 0;
+            for (auto it = backlog_.begin(); it != backlog_.end() && count < IPC_MAX_SLOTS; ++it)
+                subs[count++] = it->sub;
+            int rc = ipc_submit_batch(subs, count);
+            if (rc == IPC_ERR_SERVER_RESTARTED)
+                break;   // reconnected; try again next pass
+            if (rc < 0) {
+                fprintf(stderr, "ipc_gateway: server unavailable, rejecting %zu request(s)\n",
+                        backlog_.size());
+                for (const Request &req : backlog_)
+                    reject(req);
+                backlog_.clear();
+                progress = true;
+                break;
+            }
+            for (int i = 0; i < rc; ++i) {
+                Request req = backlog_.front();
+                backlog_.pop_front();
+                req.sub.request_id = subs[i].request_id;
+                inflight_.emplace(req.sub.request_id, req);
+            }
+            progress |= rc > 0;
+            if (static_cast<uint32_t>(rc) < count)
+                break;   // out of slots
+        }
+        flush_touched();
+        return progress;
+    }
+
+    bool reap()
+    {
+        if (inflight_.empty())
+            return false;
+        ids_.clear();
+        for (const auto &entry : inflight_)
+            ids_.push_back(entry.first);
+        completions_.resize(ids_.size());
+        int rc = ipc_reap(ids_.data(), static_cast<uint32_t>(ids_.size()), completions_.data());
+        if (rc < 0) {
+            // The server is gone; libipc already replayed what a restart could save.
+            for (const auto &entry : inflight_)
+                reject(entry.second);
+            inflight_.clear();
+            flush_touched();
+            return true;
+        }
+        for (int i = 0; i < rc; ++i) {
+            const IpcCompletion &done = completions_[static_cast<size_t>(i)];
+            auto it = inflight_.find(done.request_id);
+            if (it == inflight_.end())
+                continue;
+            Request req = it->second;
+            inflight_.erase(it);
+            if (done.rc != 0) {
+                reject(req);
+                continue;
+            }
+            auto conn = conns_.find(req.conn);
+            if (conn == conns_.end())
+                continue;   // client went away; the answer is dropped
+            --conn->second.queued;
+            encode_response(conn->second.out, req.tag, static_cast<uint8_t>(req.sub.cmd),
+                            static_cast<uint8_t>(done.status), &done.response);
+            touched_.push_back(req.conn);
+        }
+        flush_touched();
+        return rc > 0;
+    }
+
+    /** Send queued answers and resume decoding on connections that had hit the queue limit. */
+    void flush_touched()
+    {
+        for (uint64_t id : touched_) {
+            if (conns_.count(id) == 0)
+                continue;
+            flush(id);
+            if (conns_.count(id) != 0)
+                pump(id);
+        }
+        touched_.clear();
+    }
+
+    int listen_fd_;
+    int epfd_ = -1;
+    uint64_t next_conn_id_ = 2;
+    std::unordered_map<uint64_t, Conn> conns_;
+    std::deque<Request> backlog_;
+    std::unordered_map<uint64_t, Request> inflight_;   ///< By server request ID.
+    std::vector<uint64_t> ids_;
+    std::vector<IpcCompletion> completions_;
+    std::vector<uint64_t> touched_;
+};
+
+int open_listener(const sockaddr_in &addr)
+{
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("ipc_gateway: socket");
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+    if (bind(fd, reinterpret_cast<const sockaddr *>(&addr), sizeof(addr)) < 0 ||
+        listen(fd, SOMAXCONN) < 0) {
+        perror("ipc_gateway: bind/listen");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int usable_cpus()
+{
+    return static_cast<int>(cpu_budget_detect().usable);
+}
+
+void usage()
+{
+    fprintf(stderr, "Usage: ipc_gateway [--bind ADDR] [--port N] [--loops N]\n"
+                    "  --bind ADDR  IPv4 address to listen on (default 127.0.0.1)\n"
+                    "  --port N     TCP port, 0 picks a free one (default %d)\n"
+                    "  --loops N    event loops (default: one per usable CPU)\n",
+            IPC_GATEWAY_PORT);
+}
+
+} // namespace
+
+int main(int argc, const char *argv[])
+{
+    const char *bind_addr = "127.0.0.1";
+    long port = IPC_GATEWAY_PORT;
+    int loops = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--bind") == 0 && i + 1 < argc) {
+            bind_addr = argv[++i];
+        } else if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+            port = strtol(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--loops") == 0 && i + 1 < argc) {
+            loops = atoi(argv[++i]);
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (port < 0 || port > 65535) {
+        fprintf(stderr, "ipc_gateway: invalid port %ld\n", port);
+        return 2;
+    }
+    if (loops <= 0)
+        loops = std::max(usable_cpus(), 1);
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    if (inet_pton(AF_INET, bind_addr, &addr.sin_addr) != 1) {
+        fprintf(stderr, "ipc_gateway: invalid bind address %s\n", bind_addr);
+        return 2;
+    }
+
+    if (ipc_init() != 0) {
+        fprintf(stderr, "Failed to connect to server. Is it running?\n");
+        return 1;
+    }
+
+    g_wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = stop_handler;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+    signal(SIGPIPE, SIG_IGN);
+
+    // The first bind resolves port 0; the other loops join that port.
+    std::vector<std::unique_ptr<EventLoop>> event_loops;
+    for (int i = 0; i < loops; ++i) {
+        int fd = open_listener(addr);
+        if (fd < 0) {
+            event_loops.clear();
+            ipc_cleanup();
+            return 1;
+        }
+        if (i == 0) {
+            socklen_t len = sizeof(addr);
+            getsockname(fd, reinterpret_cast<sockaddr *>(&addr), &len);
+        }
+        event_loops.push_back(std::make_unique<EventLoop>(fd));
+        if (!event_loops.back()->init()) {
+            event_loops.clear();
+            ipc_cleanup();
+            return 1;
+        }
+    }
+
+    printf("Gateway listening on %s:%u with %d loop(s).\n", bind_addr,
+           static_cast<unsigned>(ntohs(addr.sin_port)), loops);
+    fflush(stdout);
+
+    std::vector<std::thread> threads;
+    for (auto &loop : event_loops)
+        threads.emplace_back([&loop] { loop->run(); });
+    for (std::thread &t : threads)
+        t.join();
+    event_loops.clear();
+
+    close(g_wake_fd);
+    ipc_cleanup();
+    printf("Gateway shut down.\n");
+    return 0;
+}
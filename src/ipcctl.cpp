@@ -0,0 +1,102 @@
+/**
+ * @file ipcctl.cpp
+ * @brief ipcctl: send one command to a running server's control socket.
+ *
+ * Usage: ipcctl [--socket PATH] <command...>
+ *
+ * Commands:
+ *   get                                   -- print the live settings
+ *   status                                -- print a JSON status snapshot
+ *   clients                               -- list registered clients, busiest first
+ *   workers                               -- show what every pool worker is doing
+ *   set threads.math|threads.string <n>   -- resize a worker pool (1-256)
+ *   set shutdown drain|immediate          -- change the shutdown mode
+ *   set regex_cache <n>                   -- resize the compiled-regex cache
+ *   set status_format text|json|both      -- change the SIGUSR1 report format
+ *   set watchdog_ms <n>                   -- stuck-worker threshold (0 disables)
+ *   help                                  -- list the commands
+ *
+ * The server's one-line reply is printed as is. Exit status is 0 when it
+ * starts with "ok", 1 otherwise, and 2 on usage or connection errors.
+ */
+#include "ipc_defs.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static void usage()
+{
+    fprintf(stderr, "Usage: ipcctl [--socket PATH] <command...>  (try: ipcctl help)\n");
+}
+
+int main(int argc, const char *argv[])
+{
+    const char *path = IPC_CONTROL_SOCKET;
+    int first = 1;
+    if (argc > 2 && strcmp(argv[1], "--socket") == 0) {
+        path = argv[2];
+        first = 3;
+    }
+    if (first >= argc) {
+        usage();
+        return 2;
+    }
+
+    std::string line;
+    for (int i = first; i < argc; ++i) {
+        if (i > first)
+            line += ' ';
+        line += argv[i];
+    }
+    line += '\n';
+
+    sockaddr_un addr{};
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "ipcctl: socket path too long: %s\n", path);
+        return 2;
+    }
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("ipcctl: socket");
+        return 2;
+    }
+    if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0) {
+        fprintf(stderr, "ipcctl: cannot connect to %s: %s (is the server running?)\n",
+                path, strerror(errno));
+        close(fd);
+        return 2;
+    }
+    if (send(fd, line.data(), line.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(line.size())) {
+        perror("ipcctl: send");
+        close(fd);
+        return 2;
+    }
+
+    std::string reply;
+    char buf[512];
+    while (reply.find('\n') == std::string::npos) {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        reply.append(buf, static_cast<size_t>(n));
+    }
+    close(fd);
+
+    if (reply.empty()) {
+        fprintf(stderr, "ipcctl: no reply from server\n");
+        return 2;
+    }
+    reply.erase(reply.find_last_not_of('\n') + 1);
+    printf("%s\n", reply.c_str());
+    return reply.compare(0, 2, "ok") == 0 ? 0 : 1;
+}
@@ -3,16 +3,24 @@
  * @brief Implementation of the IPC communication library (libipc.so).
  */
 #include "libipc.h"
+#include "arena_alloc.h"
+#include "client_registry.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cerrno>
 #include <cstdio>
 #include <cstring>
 #include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
 #include <semaphore.h>
+#include <signal.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <time.h>
 #include <unistd.h>
+#include <utility>
 
 /* --- Internal state (per-process) --- */
 
@@ -22,18 +30,38 @@ static sem_t *g_server_sem = nullptr;
 static sem_t *g_slot_sems[IPC_MAX_SLOTS] = {};
 static int    g_shm_fd = -1;
 static uint64_t g_known_generation = 0;
+static pid_t  g_self_pid = 0;   // getpid() is a syscall; refreshed in forked children
+static uint64_t g_self_start_time = 0;
+static ClientEntry *g_client = nullptr;   // our registration, nullptr if the table was full
+
+static void refresh_self_pid()
+{
+    g_self_pid = getpid();
+    g_self_start_time = process_start_time(g_self_pid);
+}
+
+/* A forked child inherits the mapping but not the parent's registration. */
+static void journal_clear();
+static void magazine_release();
+
+static void rejoin_after_fork()
+{
+    journal_clear();
+    refresh_self_pid();
+    g_client = g_shm ? client_join(g_shm, g_self_pid, g_self_start_time, kClientCapabilities)
+                     : nullptr;
+}
 
 /* --- Helper: build slot semaphore name --- */
 
-static int sem_wait_with_timeout(sem_t *sem, int timeout_sec)
+/* Wait on @p sem until ipc_monotonic_ns() reaches @p deadline_ns; immune to clock jumps. */
+static int sem_wait_until(sem_t *sem, uint64_t deadline_ns)
 {
+    timespec ts{};
+    ts.tv_sec = static_cast<time_t>(deadline_ns / 1'000'000'000);
+    ts.tv_nsec = static_cast<long>(deadline_ns % 1'000'000'000);
     while (true) {
-        timespec ts{};
-        if (clock_gettime(CLOCK_REALTIME, &ts) != 0)
-            return -1;
-        ts.tv_sec += timeout_sec;
-
-        if (sem_timedwait(sem, &ts) == 0)
+        if (sem_clockwait(sem, CLOCK_MONOTONIC, &ts) == 0)
             return 0;
         if (errno == EINTR)
             continue;
@@ -41,6 +69,11 @@ static int sem_wait_with_timeout(sem_t *sem, int timeout_sec)
     }
 }
 
+static int sem_wait_with_timeout(sem_t *sem, int timeout_sec)
+{
+    return sem_wait_until(sem, ipc_monotonic_ns() + uint64_t(timeout_sec) * 1'000'000'000);
+}
+
 static bool shm_object_replaced()
 {
     if (g_shm_fd < 0)
@@ -60,12 +93,236 @@ static bool shm_object_replaced()
     return replaced;
 }
 
+/* --- Connection setup --- */
+
+/*
+ * Identity of a shared object, so a reconnect can tell an object the new
+ * server recreated from one it kept (a crashed server's successor reuses the
+ * segment but always recreates the semaphores).
+ */
+struct ObjectId {
+    dev_t dev = 0;
+    ino_t ino = 0;
+
+    bool operator==(const ObjectId &o) const { return dev == o.dev && ino == o.ino; }
+};
+
+static ObjectId g_shm_id;
+static ObjectId g_mutex_id;
+static ObjectId g_server_sem_id;
+static ObjectId g_slot_sem_ids[IPC_MAX_SLOTS];
+
+enum class AttachStatus {
+    Ok,         ///< Connected to a running server.
+    NoServer,   ///< No segment: the server is not running.
+    Starting,   ///< The server has not published its generation yet.
+    Failed,     ///< Any other error.
+};
+
+/* Retry schedule while a restarted server comes up: full jitter, doubling. */
+static constexpr uint64_t kReconnectBackoffMinNs = 1'000'000;
+static constexpr uint64_t kReconnectBackoffMaxNs = 64'000'000;
+static constexpr uint64_t kReconnectBudgetNs = 2'000'000'000;
+
+/* Serializes reconnects, so threads that notice one restart together pay for it once. */
+static pthread_mutex_t g_reconnect_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Uniform in [0, bound); xorshift seeded per thread, so clients do not retry in step. */
+static uint64_t jitter_below(uint64_t bound)
+{
+    static thread_local uint64_t state = 0;
+    if (state == 0)
+        state = ((uint64_t(g_self_pid) << 32) ^ ipc_monotonic_ns()) | 1;
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state % bound;
+}
+
+/* glibc keeps named semaphores as /dev/shm/sem.<name>; false if that is not the case here. */
+static bool sem_object_id(const char *name, ObjectId *id)
+{
+    char path[96];
+    snprintf(path, sizeof(path), "/dev/shm/sem.%s", name[0] == '/' ? name + 1 : name);
+    struct stat st{};
+    if (stat(path, &st) != 0)
+        return false;
+    id->dev = st.st_dev;
+    id->ino = st.st_ino;
+    return true;
+}
+
+/* Point @p sem at the live semaphore @p name, reopening only if it was recreated. */
+static AttachStatus attach_sem(const char *name, sem_t **sem, ObjectId *id, bool verbose)
+{
+    ObjectId live;
+    bool known = sem_object_id(name, &live);
+    if (known && *sem && live == *id)
+        return AttachStatus::Ok;
+
+    sem_t *fresh = sem_open(name, 0);
+    if (fresh == SEM_FAILED) {
+        if (errno == ENOENT)
+            return AttachStatus::Starting;
+        if (verbose)
+            fprintf(stderr, "ipc_init: sem_open %s: %s\n", name, strerror(errno));
+        return AttachStatus::Failed;
+    }
+    if (*sem)
+        sem_close(*sem);
+    *sem = fresh;
+    *id = known ? live : ObjectId{};
+    return AttachStatus::Ok;
+}
+
+static void detach_shm()
+{
+    client_leave(g_client, g_self_pid);
+    g_client = nullptr;
+    if (g_shm) {
+        munmap(g_shm, sizeof(SharedMemoryLayout));
+        g_shm = nullptr;
+    }
+    if (g_shm_fd >= 0) {
+        close(g_shm_fd);
+        g_shm_fd = -1;
+    }
+    g_shm_id = ObjectId{};
+}
+
+/* Map the live segment unless the one already mapped is still it. */
+static AttachStatus attach_shm(bool verbose)
+{
+    int fd = shm_open(IPC_SHM_NAME, O_RDWR, 0666);
+    if (fd < 0) {
+        if (verbose)
+            perror("ipc_init: shm_open");
+        return errno == ENOENT ? AttachStatus::NoServer : AttachStatus::Failed;
+    }
+    struct stat st{};
+    if (fstat(fd, &st) != 0) {
+        if (verbose)
+            perror("ipc_init: fstat");
+        close(fd);
+        return AttachStatus::Failed;
+    }
+    // The server sizes a new segment right after creating it.
+    if (st.st_size < static_cast<off_t>(sizeof(SharedMemoryLayout))) {
+        close(fd);
+        return AttachStatus::Starting;
+    }
+    ObjectId live;
+    live.dev = st.st_dev;
+    live.ino = st.st_ino;
+    if (g_shm && live == g_shm_id) {
+        close(fd);
+        return AttachStatus::Ok;
+    }
+
+    void *map = mmap(nullptr, sizeof(SharedMemoryLayout),
+                     PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        if (verbose)
+            perror("ipc_init: mmap");
+        close(fd);
+        return AttachStatus::Failed;
+    }
+    detach_shm();
+    g_shm = static_cast<SharedMemoryLayout *>(map);
+    g_shm_fd = fd;
+    g_shm_id = live;
+    return AttachStatus::Ok;
+}
+
+/*
+ * Bring the connection up to date with the running server. Only objects the
+ * server recreated are reopened; the rest, usually including the mapping,
+ * are kept. The server publishes its generation after creating every
+ * semaphore, so generation 0 means it is still starting.
+ */
+static AttachStatus attach_server(bool verbose)
+{
+    AttachStatus st = attach_shm(verbose);
+    if (st != AttachStatus::Ok)
+        return st;
+    uint64_t generation = __atomic_load_n(&g_shm->server_generation, __ATOMIC_ACQUIRE);
+    if (generation == 0)
+        return AttachStatus::Starting;
+
+    st = attach_sem(IPC_MUTEX_NAME, &g_mutex_sem, &g_mutex_id, verbose);
+    if (st == AttachStatus::Ok)
+        st = attach_sem(IPC_SERVER_SEM_NAME, &g_server_sem, &g_server_sem_id, verbose);
+    for (int i = 0; i < IPC_MAX_SLOTS && st == AttachStatus::Ok; ++i) {
+        char name[64];
+        ipc_slot_sem_name(i, name, sizeof(name));
+        st = attach_sem(name, &g_slot_sems[i], &g_slot_sem_ids[i], verbose);
+    }
+    if (st != AttachStatus::Ok)
+        return st;
+    // Restarted again while we were looking: go round once more.
+    if (__atomic_load_n(&g_shm->server_generation, __ATOMIC_ACQUIRE) != generation)
+        return AttachStatus::Starting;
+
+    if (generation != g_known_generation || !g_client) {
+        // Unregistered clients work all the same; the server just cannot tell
+        // when they die before it runs into their leftovers.
+        client_leave(g_client, g_self_pid);
+        g_client = client_join(g_shm, g_self_pid, g_self_start_time, kClientCapabilities);
+        g_known_generation = generation;
+    }
+    return AttachStatus::Ok;
+}
+
+/*
+ * attach_server() until it succeeds, backing off with jitter while the
+ * server is starting (and, with @p wait_for_segment, while it is absent).
+ */
+static AttachStatus attach_with_backoff(bool wait_for_segment, bool verbose)
+{
+    uint64_t give_up_ns = ipc_monotonic_ns() + kReconnectBudgetNs;
+    uint64_t backoff_ns = kReconnectBackoffMinNs;
+    while (true) {
+        AttachStatus st = attach_server(verbose);
+        if (st == AttachStatus::Ok || st == AttachStatus::Failed ||
+            (st == AttachStatus::NoServer && !wait_for_segment))
+            return st;
+        uint64_t now = ipc_monotonic_ns();
+        if (now >= give_up_ns)
+            return st;
+        uint64_t pause_ns = std::min(jitter_below(backoff_ns), give_up_ns - now);
+        timespec ts{};
+        ts.tv_sec = static_cast<time_t>(pause_ns / 1'000'000'000);
+        ts.tv_nsec = static_cast<long>(pause_ns % 1'000'000'000);
+        nanosleep(&ts, nullptr);
+        backoff_ns = std::min(backoff_ns * 2, kReconnectBackoffMaxNs);
+    }
+}
+
+static uint32_t journal_replay_locked();
+
+/*
+ * Revalidate the connection after the server changed under us, then
+ * resubmit the journaled async requests to the new server in one pass.
+ * Returns IPC_ERR_SERVER_RESTARTED once connected to the current server
+ * (possibly by another thread that got here first), so the caller
+ * resubmits; -1 and a torn-down connection if no server came up within
+ * kReconnectBudgetNs.
+ */
 static int reconnect_after_server_restart()
 {
-    ipc_cleanup();
-    if (ipc_init() == 0)
-        return IPC_ERR_SERVER_RESTARTED;
-    return -1;
+    pthread_mutex_lock(&g_reconnect_lock);
+    AttachStatus st = attach_with_backoff(true, false);
+    if (st != AttachStatus::Ok) {
+        ipc_cleanup();
+    } else if (sem_wait_with_timeout(g_mutex_sem, 1) == 0) {
+        // On a timeout the entries are resubmitted lazily when next polled.
+        uint32_t replayed = journal_replay_locked();
+        sem_post(g_mutex_sem);
+        if (replayed > 0)
+            sem_post(g_server_sem);
+    }
+    pthread_mutex_unlock(&g_reconnect_lock);
+    return st == AttachStatus::Ok ? IPC_ERR_SERVER_RESTARTED : -1;
 }
 
 static int ensure_fresh_connection()
@@ -106,257 +363,428 @@ static int lock_shared_mutex_with_recovery()
 
 extern "C" int ipc_init(void)
 {
-    g_shm_fd = shm_open(IPC_SHM_NAME, O_RDWR, 0666);
-    if (g_shm_fd < 0) {
-        perror("ipc_init: shm_open");
-        return -1;
-    }
-
-    g_shm = static_cast<SharedMemoryLayout *>(
-        mmap(nullptr, sizeof(SharedMemoryLayout),
-             PROT_READ | PROT_WRITE, MAP_SHARED, g_shm_fd, 0));
-    if (g_shm == MAP_FAILED) {
-        perror("ipc_init: mmap");
-        close(g_shm_fd);
-        g_shm_fd = -1;
-        g_shm = nullptr;
-        return -1;
-    }
-
-    g_mutex_sem = sem_open(IPC_MUTEX_NAME, 0);
-    if (g_mutex_sem == SEM_FAILED) {
-        perror("ipc_init: sem_open mutex");
-        goto fail;
-    }
-
-    g_server_sem = sem_open(IPC_SERVER_SEM_NAME, 0);
-    if (g_server_sem == SEM_FAILED) {
-        perror("ipc_init: sem_open server_notify");
-        goto fail;
-    }
-
-    for (int i = 0; i < IPC_MAX_SLOTS; ++i) {
-        char name[64];
-        ipc_slot_sem_name(i, name, sizeof(name));
-        g_slot_sems[i] = sem_open(name, 0);
-        if (g_slot_sems[i] == SEM_FAILED) {
-            perror("ipc_init: sem_open slot");
-            goto fail;
-        }
-    }
-
-    g_known_generation = g_shm->server_generation;
-    return 0;
+    static const int atfork_registered = pthread_atfork(nullptr, nullptr, rejoin_after_fork);
+    (void)atfork_registered;
+    refresh_self_pid();
 
-fail:
-    ipc_cleanup();
-    return -1;
+    pthread_mutex_lock(&g_reconnect_lock);
+    AttachStatus st = attach_with_backoff(false, true);
+    if (st == AttachStatus::Starting)
+        fprintf(stderr, "ipc_init: server did not finish starting\n");
+    if (st != AttachStatus::Ok)
+        ipc_cleanup();
+    pthread_mutex_unlock(&g_reconnect_lock);
+    return st == AttachStatus::Ok ? 0 : -1;
 }
 
 extern "C" void ipc_cleanup(void)
 {
+    magazine_release();
     for (int i = 0; i < IPC_MAX_SLOTS; ++i) {
         if (g_slot_sems[i] && g_slot_sems[i] != SEM_FAILED) {
             sem_close(g_slot_sems[i]);
             g_slot_sems[i] = nullptr;
         }
+        g_slot_sem_ids[i] = ObjectId{};
     }
     if (g_server_sem && g_server_sem != SEM_FAILED) {
         sem_close(g_server_sem);
         g_server_sem = nullptr;
     }
+    g_server_sem_id = ObjectId{};
     if (g_mutex_sem && g_mutex_sem != SEM_FAILED) {
         sem_close(g_mutex_sem);
         g_mutex_sem = nullptr;
     }
-    if (g_shm && g_shm != MAP_FAILED) {
-        munmap(g_shm, sizeof(SharedMemoryLayout));
-        g_shm = nullptr;
-    }
-    if (g_shm_fd >= 0) {
-        close(g_shm_fd);
-        g_shm_fd = -1;
-    }
+    g_mutex_id = ObjectId{};
+    detach_shm();
     g_known_generation = 0;
+    journal_clear();
 }
 
 /* --- Internal helpers --- */
 
+/*
+ * Take a RESERVED slot from whichever magazine holds it (see "Slot
+ * magazines"). Fails if the slot is not reserved or its owner got there
+ * first; on success the slot is the caller's, still marked RESERVED.
+ */
+static bool take_reserved_slot(MessageSlot *slot, uint64_t tag)
+{
+    return tag != 0 && __atomic_compare_exchange_n(&slot->magazine_tag, &tag, 0, false,
+                                                   __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+/* Caller must hold /ipc_mutex. With none free, takes a slot idle in a magazine. */
 static int find_free_slot(void)
 {
     for (int i = 0; i < IPC_MAX_SLOTS; ++i) {
-        if (g_shm->slots[i].state == IPC_SLOT_FREE)
+        if (__atomic_load_n(&g_shm->slots[i].state, __ATOMIC_ACQUIRE) == IPC_SLOT_FREE)
+            return i;
+    }
+    for (int i = 0; i < IPC_MAX_SLOTS; ++i) {
+        MessageSlot *slot = &g_shm->slots[i];
+        if (take_reserved_slot(slot, __atomic_load_n(&slot->magazine_tag, __ATOMIC_RELAXED)))
             return i;
     }
     return -1;
 }
 
-static int submit_request(ipc_cmd_t cmd, const RequestPayload *payload,
-                          int *out_slot, uint64_t *out_id)
-{
-    int rc = ensure_fresh_connection();
-    if (rc != 0)
-        return rc;
-
-    rc = lock_shared_mutex_with_recovery();
-    if (rc != 0)
-        return rc;
-
-    if (g_shm->server_generation != g_known_generation) {
-        sem_post(g_mutex_sem);
-        return reconnect_after_server_restart();
-    }
+/* Latency budget for requests submitted by this thread; 0 = no deadline. */
+static thread_local uint64_t t_deadline_budget_ns = 0;
 
-    int idx = find_free_slot();
-    if (idx < 0) {
-        sem_post(g_mutex_sem);
-        fprintf(stderr, "submit_request: no free slots\n");
-        return -1;
-    }
+/* Priority of requests submitted by this thread. */
+static thread_local uint8_t t_priority = IPC_PRIORITY_NORMAL;
 
-    MessageSlot *slot = &g_shm->slots[idx];
-    slot->request_id = g_shm->next_request_id++;
-    slot->client_pid = getpid();
-    slot->command    = cmd;
-    slot->request    = *payload;
-    slot->state      = IPC_SLOT_REQUEST_PENDING;
+static uint64_t request_deadline(void)
+{
+    return t_deadline_budget_ns ? ipc_monotonic_ns() + t_deadline_budget_ns : 0;
+}
 
-    if (out_slot) *out_slot = idx;
-    if (out_id)   *out_id = slot->request_id;
+/* Fill in a claimed slot's header; the caller writes the payload, then the state. */
+static void init_slot(MessageSlot *slot, uint64_t request_id, ipc_cmd_t cmd,
+                      uint64_t deadline_ns, bool notify)
+{
+    slot->request_id  = request_id;
+    slot->client_pid  = g_self_pid;
+    slot->command     = cmd;
+    slot->priority    = t_priority;
+    slot->notify      = notify ? 1 : 0;
+    slot->cancelled   = 0;
+    slot->deadline_ns = deadline_ns;
+}
 
-    sem_post(g_mutex_sem);
-    sem_post(g_server_sem);
-    return 0;
+/* Claim a free slot under /ipc_mutex, with an id from the shared counter. */
+static void claim_slot_locked(MessageSlot *slot, ipc_cmd_t cmd, uint64_t deadline_ns,
+                              bool notify)
+{
+    init_slot(slot, __atomic_fetch_add(&g_shm->next_request_id, 1, __ATOMIC_RELAXED),
+              cmd, deadline_ns, notify);
+    if (g_client)
+        client_heartbeat(g_shm, g_client);
 }
 
-/* --- Blocking calls --- */
+/* --- Slot magazines --- */
 
-static int blocking_math(ipc_cmd_t cmd, int32_t a, int32_t b, int32_t *result)
-{
-    if (!result) return -1;
+/*
+ * Per-thread caches of reserved message slots (ipc_slot_magazine()). A
+ * magazine slot is IPC_SLOT_RESERVED with the thread's token in
+ * magazine_tag, and whoever clears the tag by CAS owns it. The owner does
+ * that without /ipc_mutex; a claimant short of free slots and the server
+ * (idle or orphaned slots) do it under the mutex. An entry whose CAS fails
+ * was taken back and is dropped. Ids come from the shared counter in
+ * blocks of kSlotIdBatch, and the client entry's request count is updated
+ * once per block, so the fast path writes only the slot's own cache lines.
+ */
+static constexpr uint64_t kSlotIdBatch = 64;
 
-    RequestPayload payload;
-    payload.math.a = a;
-    payload.math.b = b;
+static std::atomic<uint32_t> g_thread_serial{0};
 
-    int slot_idx = -1;
-    uint64_t expected_request_id = 0;
-    int submit_rc = submit_request(cmd, &payload, &slot_idx, &expected_request_id);
-    if (submit_rc != 0)
-        return submit_rc;
-    // Blocking calls are completed via per-slot semaphores. Validate that the slot
-    // truly contains this request's response to guard against stale semaphore wakeups.
-    static constexpr int kMaxSlotWaitTimeoutRetries = 16;
-    int retries = 0;
-    while (retries < kMaxSlotWaitTimeoutRetries) {
-        if (sem_wait_with_timeout(g_slot_sems[slot_idx], 1) == 0) {
-            int rc = lock_shared_mutex_with_recovery();
-            if (rc != 0)
-                return rc;
+struct SlotMagazine {
+    uint32_t capacity = 0;
+    uint32_t count = 0;
+    int      slots[IPC_SLOT_MAGAZINE_MAX];
+    uint64_t generation = 0;
+    pid_t    pid = 0;
+    uint64_t tag = 0;          ///< pid << 32 | thread serial; unique across clients.
+    uint64_t next_id = 0;
+    uint64_t id_end = 0;
+    uint64_t unreported = 0;   ///< Fast-path requests not yet added to g_client.
+    IpcSlotMagazineStats stats{};
 
-            MessageSlot *slot = &g_shm->slots[slot_idx];
-            if (slot->request_id == expected_request_id &&
-                slot->state == IPC_SLOT_RESPONSE_READY) {
-                *result = slot->response.math_result;
-                int ret = (slot->status == IPC_STATUS_OK) ? 0 : -1;
-                slot->state = IPC_SLOT_FREE;
-                sem_post(g_mutex_sem);
-                return ret;
-            }
+    /* Drop slots and ids of an earlier connection or of the parent process. */
+    void refresh()
+    {
+        if (generation == g_known_generation && pid == g_self_pid)
+            return;
+        count = 0;
+        next_id = id_end = 0;
+        unreported = 0;
+        generation = g_known_generation;
+        if (pid != g_self_pid) {
+            pid = g_self_pid;
+            tag = (static_cast<uint64_t>(pid) << 32) |
+                  (g_thread_serial.fetch_add(1, std::memory_order_relaxed) + 1);
+        }
+    }
 
-            sem_post(g_mutex_sem);
-            ++retries;
-            continue;
+    uint64_t request_id()
+    {
+        if (next_id == id_end) {
+            next_id = __atomic_fetch_add(&g_shm->next_request_id, kSlotIdBatch, __ATOMIC_RELAXED);
+            id_end = next_id + kSlotIdBatch;
+            report_requests();
         }
-        if (errno == ETIMEDOUT) {
-            int rc = ensure_fresh_connection();
-            if (rc != 0)
-                return rc;
-            ++retries;
-            continue;
+        return next_id++;
+    }
+
+    void report_requests()
+    {
+        if (g_client && unreported)
+            client_heartbeat(g_shm, g_client, unreported);
+        unreported = 0;
+    }
+
+    /* Free the slots beyond the first @p keep. */
+    void trim(uint32_t keep)
+    {
+        while (count > keep) {
+            MessageSlot *slot = &g_shm->slots[slots[--count]];
+            if (take_reserved_slot(slot, tag))
+                __atomic_store_n(&slot->state, IPC_SLOT_FREE, __ATOMIC_RELEASE);
+            else
+                ++stats.lost;
         }
+    }
+
+    ~SlotMagazine()
+    {
+        if (!g_shm || generation != g_known_generation || pid != g_self_pid)
+            return;
+        trim(0);
+        report_requests();
+    }
+};
+
+static thread_local SlotMagazine t_slot_magazine;
+
+/* Free the calling thread's magazine slots, before it disconnects. */
+static void magazine_release()
+{
+    if (!g_shm)
+        return;
+    t_slot_magazine.refresh();
+    t_slot_magazine.trim(0);
+    t_slot_magazine.report_requests();
+}
+
+/* Take a slot from the calling thread's magazine and mark it CLAIMED; -1 if none is left. */
+static int magazine_take()
+{
+    SlotMagazine &mag = t_slot_magazine;
+    if (mag.capacity == 0)
         return -1;
+    mag.refresh();
+    while (mag.count > 0) {
+        int idx = mag.slots[--mag.count];
+        MessageSlot *slot = &g_shm->slots[idx];
+        if (take_reserved_slot(slot, mag.tag)) {
+            __atomic_store_n(&slot->state, IPC_SLOT_CLAIMED, __ATOMIC_RELAXED);
+            ++mag.stats.hits;
+            return idx;
+        }
+        ++mag.stats.lost;
     }
-    if (retries >= kMaxSlotWaitTimeoutRetries)
-        return reconnect_after_server_restart();
+    ++mag.stats.misses;
     return -1;
 }
 
-extern "C" int ipc_add(int32_t a, int32_t b, int32_t *result)
+/* Reserve an answered slot of this thread for its magazine; false if there is no room. */
+static bool magazine_keep(int idx)
 {
-    return blocking_math(IPC_CMD_ADD, a, b, result);
+    SlotMagazine &mag = t_slot_magazine;
+    if (mag.capacity == 0)
+        return false;
+    mag.refresh();
+    bool listed = std::find(mag.slots, mag.slots + mag.count, idx) != mag.slots + mag.count;
+    if (!listed && mag.count >= mag.capacity)
+        return false;
+    MessageSlot *slot = &g_shm->slots[idx];
+    __atomic_store_n(&slot->reserved_epoch,
+                     __atomic_load_n(&g_shm->client_epoch, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->state, IPC_SLOT_RESERVED, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->magazine_tag, mag.tag, __ATOMIC_RELEASE);
+    if (!listed)   // a stale entry for this slot is live again
+        mag.slots[mag.count++] = idx;
+    return true;
 }
 
-extern "C" int ipc_subtract(int32_t a, int32_t b, int32_t *result)
+extern "C" int ipc_slot_magazine(uint32_t slots)
 {
-    return blocking_math(IPC_CMD_SUB, a, b, result);
+    if (slots > IPC_SLOT_MAGAZINE_MAX)
+        return -1;
+    SlotMagazine &mag = t_slot_magazine;
+    if (g_shm) {
+        mag.refresh();
+        mag.trim(slots);
+    }
+    mag.capacity = slots;
+    return 0;
 }
 
-/* --- Non-blocking calls --- */
-
-static int async_math(ipc_cmd_t cmd, int32_t a, int32_t b,
-                      uint64_t *request_id)
+extern "C" void ipc_slot_magazine_stats(IpcSlotMagazineStats *stats)
 {
-    if (!request_id) return -1;
+    if (!stats)
+        return;
+    SlotMagazine &mag = t_slot_magazine;
+    if (g_shm)
+        mag.refresh();
+    *stats = mag.stats;
+    stats->held = mag.count;
+    stats->capacity = mag.capacity;
+}
+
+/* --- Restart journal --- */
 
-    RequestPayload payload;
-    payload.math.a = a;
-    payload.math.b = b;
+/*
+ * Outstanding async requests whose payload is self-contained (ADD through
+ * SEARCH; the others point at arena data, interned ids or streams, which do
+ * not survive a restart). After a restart each one is resubmitted and the id
+ * the caller holds is mapped to the new submission, so callers keep polling
+ * the same id. Server ids embed the generation (see server main), so an old
+ * id never collides with a new one. An entry submitted to the current server
+ * holds one of its slots until it is collected, so at most IPC_MAX_SLOTS
+ * entries are current. Entries left over from an older server hold none;
+ * those the replay could not place, or whose ids the caller abandoned, are
+ * dropped oldest first, with a diagnostic, when a new request needs room.
+ * Guarded by /ipc_mutex.
+ */
+struct JournalEntry {
+    uint64_t       id;            ///< Id handed to the caller; 0 = unused.
+    uint64_t       live_id;       ///< Id of the submission to the current server.
+    uint64_t       generation;    ///< Server generation @c live_id belongs to.
+    uint64_t       deadline_ns;
+    ipc_cmd_t      cmd;
+    uint8_t        priority;
+    RequestPayload request;
+};
+
+static JournalEntry g_journal[IPC_MAX_SLOTS];
 
-    return submit_request(cmd, &payload, nullptr, request_id);
+static bool replayable(ipc_cmd_t cmd)
+{
+    return cmd <= IPC_CMD_SEARCH;
 }
 
-static int async_string(ipc_cmd_t cmd, const char *s1, const char *s2,
-                        uint64_t *request_id)
+static JournalEntry *journal_find(uint64_t id)
 {
-    if (!request_id) return -1;
-    if (ipc_validate_string(s1) != 0 || ipc_validate_string(s2) != 0) {
-        fprintf(stderr, "async_string: invalid string length "
-                "(must be 1..%d chars)\n", IPC_MAX_STRING_LEN);
-        return -1;
+    if (id == 0)
+        return nullptr;
+    for (JournalEntry &e : g_journal) {
+        if (e.id == id)
+            return &e;
     }
+    return nullptr;
+}
 
-    RequestPayload payload;
-    memset(&payload, 0, sizeof(payload));
-    strncpy(payload.str.s1, s1, IPC_MAX_STRING_LEN);
-    payload.str.s1[IPC_MAX_STRING_LEN] = '\0';
-    strncpy(payload.str.s2, s2, IPC_MAX_STRING_LEN);
-    payload.str.s2[IPC_MAX_STRING_LEN] = '\0';
-
-    return submit_request(cmd, &payload, nullptr, request_id);
+/*
+ * Room for one more entry, dropping the oldest entry not yet resubmitted to
+ * the current server if the table is full. Returns nullptr if every entry is
+ * current; the caller must then fail the request rather than leave it
+ * unjournaled.
+ */
+static JournalEntry *journal_reserve_locked()
+{
+    JournalEntry *stale = nullptr;
+    for (JournalEntry &e : g_journal) {
+        if (e.id == 0)
+            return &e;
+        if (e.generation != g_known_generation && (!stale || e.id < stale->id))
+            stale = &e;
+    }
+    if (stale) {
+        fprintf(stderr, "ipc: restart journal full; request %llu will not be resubmitted\n",
+                static_cast<unsigned long long>(stale->id));
+        stale->id = 0;
+    }
+    return stale;
 }
 
-extern "C" int ipc_multiply(int32_t a, int32_t b, uint64_t *request_id)
+/* Record the request just published in @p slot in @p e (from journal_reserve_locked()). */
+static void journal_add_locked(JournalEntry *e, const MessageSlot *slot)
 {
-    return async_math(IPC_CMD_MUL, a, b, request_id);
+    e->id = slot->request_id;
+    e->live_id = slot->request_id;
+    e->generation = g_known_generation;
+    e->deadline_ns = slot->deadline_ns;
+    e->cmd = static_cast<ipc_cmd_t>(slot->command);
+    e->priority = slot->priority;
+    e->request = slot->request;
 }
 
-extern "C" int ipc_divide(int32_t a, int32_t b, uint64_t *request_id)
+static void journal_remove(JournalEntry *e)
 {
-    return async_math(IPC_CMD_DIV, a, b, request_id);
+    if (e)
+        e->id = 0;
 }
 
-extern "C" int ipc_concat(const char *s1, const char *s2,
-                           uint64_t *request_id)
+/*
+ * Point @p e at a submission to the current server, resubmitting it if its
+ * live one belongs to an older server. Returns false if no slot is free; the
+ * entry is then retried the next time it is polled.
+ */
+static bool journal_resubmit_locked(JournalEntry *e, bool *submitted)
 {
-    return async_string(IPC_CMD_CONCAT, s1, s2, request_id);
+    if (e->generation == g_known_generation)
+        return true;
+    int idx = find_free_slot();
+    if (idx < 0)
+        return false;
+    MessageSlot *slot = &g_shm->slots[idx];
+    claim_slot_locked(slot, e->cmd, e->deadline_ns, false);
+    slot->priority = e->priority;
+    slot->request = e->request;
+    slot->state = IPC_SLOT_REQUEST_PENDING;
+    e->live_id = slot->request_id;
+    e->generation = g_known_generation;
+    *submitted = true;
+    return true;
 }
 
-extern "C" int ipc_search(const char *haystack, const char *needle,
-                           uint64_t *request_id)
+/* Resubmit every journaled request left behind by a restart; returns how many went out. */
+static uint32_t journal_replay_locked()
 {
-    return async_string(IPC_CMD_SEARCH, haystack, needle, request_id);
+    uint32_t replayed = 0;
+    for (JournalEntry &e : g_journal) {
+        bool submitted = false;
+        if (e.id == 0)
+            continue;
+        if (!journal_resubmit_locked(&e, &submitted))
+            break;
+        replayed += submitted ? 1 : 0;
+    }
+    return replayed;
 }
 
-extern "C" int ipc_get_result(uint64_t request_id, ResponsePayload *result,
-                               ipc_status_t *status)
+/* A forked child does not own its parent's requests. */
+static void journal_clear()
 {
-    if (!result || !status) return -1;
+    for (JournalEntry &e : g_journal)
+        e.id = 0;
+}
 
+/*
+ * Claim a free slot and publish a request. The fill callback writes the
+ * payload straight into the slot while the mutex is held, so callers never
+ * stage a RequestPayload copy of their own. With @p notify the server posts
+ * the slot semaphore when the response is ready; with @p journal the request
+ * is recorded for resubmission after a server restart.
+ */
+template <typename Fill>
+static int submit_request_with(ipc_cmd_t cmd, Fill &&fill, int *out_slot, uint64_t *out_id,
+                               bool notify = false, bool journal = false)
+{
     int rc = ensure_fresh_connection();
     if (rc != 0)
         return rc;
 
+    uint64_t deadline_ns = request_deadline();
+
+    int idx = journal ? -1 : magazine_take();
+    if (idx >= 0) {
+        MessageSlot *slot = &g_shm->slots[idx];
+        init_slot(slot, t_slot_magazine.request_id(), cmd, deadline_ns, notify);
+        ++t_slot_magazine.unreported;
+        if (g_client)
+            client_heartbeat(g_shm, g_client, 0);
+        fill(slot->request);
+        __atomic_store_n(&slot->state, IPC_SLOT_REQUEST_PENDING, __ATOMIC_RELEASE);
+        if (out_slot) *out_slot = idx;
+        if (out_id)   *out_id = slot->request_id;
+        sem_post(g_server_sem);
+        return 0;
+    }
+
     rc = lock_shared_mutex_with_recovery();
     if (rc != 0)
         return rc;
@@ -366,21 +794,1222 @@ extern "C" int ipc_get_result(uint64_t request_id, ResponsePayload *result,
         return reconnect_after_server_restart();
     }
 
-    for (int i = 0; i < IPC_MAX_SLOTS; ++i) {
-        MessageSlot *slot = &g_shm->slots[i];
-        if (slot->request_id == request_id) {
-            if (slot->state == IPC_SLOT_RESPONSE_READY) {
-                *result = slot->response;
-                *status = slot->status;
-                slot->state = IPC_SLOT_FREE;
-                sem_post(g_mutex_sem);
-                return 0;
+    idx = find_free_slot();
+    if (idx < 0) {
+        sem_post(g_mutex_sem);
+        fprintf(stderr, "submit_request: no free slots\n");
+        return -1;
+    }
+    JournalEntry *entry = journal ? journal_reserve_locked() : nullptr;
+    if (journal && !entry) {
+        sem_post(g_mutex_sem);
+        fprintf(stderr, "submit_request: restart journal full\n");
+        return -1;
+    }
+
+    MessageSlot *slot = &g_shm->slots[idx];
+    claim_slot_locked(slot, cmd, deadline_ns, notify);
+    fill(slot->request);
+    slot->state      = IPC_SLOT_REQUEST_PENDING;
+    if (entry)
+        journal_add_locked(entry, slot);
+
+    if (out_slot) *out_slot = idx;
+    if (out_id)   *out_id = slot->request_id;
+
+    sem_post(g_mutex_sem);
+    sem_post(g_server_sem);
+    return 0;
+}
+
+extern "C" void ipc_set_deadline(uint64_t budget_ns)
+{
+    t_deadline_budget_ns = budget_ns;
+}
+
+extern "C" int ipc_set_priority(ipc_priority_t priority)
+{
+    if (priority < IPC_PRIORITY_LOW || priority > IPC_PRIORITY_HIGH)
+        return -1;
+    t_priority = static_cast<uint8_t>(priority);
+    return 0;
+}
+
+/*
+ * Submit a journaled async request. A restart noticed on the way is absorbed
+ * by submitting to the new server, so callers only see the extra latency.
+ */
+template <typename Fill>
+static int submit_async(ipc_cmd_t cmd, Fill &&fill, uint64_t *request_id)
+{
+    int rc = submit_request_with(cmd, fill, nullptr, request_id, false, true);
+    if (rc == IPC_ERR_SERVER_RESTARTED)
+        rc = submit_request_with(cmd, fill, nullptr, request_id, false, true);
+    return rc;
+}
+
+/* --- Blocking calls --- */
+
+/* Default timeout of blocking calls made by this thread, in microseconds; 0 = none. */
+static thread_local uint64_t t_timeout_us = 0;
+
+extern "C" void ipc_set_timeout(uint64_t timeout_us)
+{
+    t_timeout_us = timeout_us;
+}
+
+/*
+ * Give up on a blocking request. A request still waiting for the dispatcher
+ * is withdrawn; one the server is working on is flagged, so the server
+ * frees the slot instead of answering. Returns 0 with the response if it
+ * arrived meanwhile, IPC_ERR_TIMEOUT otherwise.
+ */
+static int cancel_request(int slot_idx, uint64_t request_id,
+                          ResponsePayload *response, ipc_status_t *status)
+{
+    int rc = lock_shared_mutex_with_recovery();
+    if (rc != 0)
+        return rc;
+    MessageSlot *slot = &g_shm->slots[slot_idx];
+    rc = IPC_ERR_TIMEOUT;
+    if (slot->request_id == request_id) {
+        switch (slot->state) {
+        case IPC_SLOT_REQUEST_PENDING:
+            slot->state = IPC_SLOT_FREE;
+            break;
+        case IPC_SLOT_PROCESSING:
+            slot->cancelled = 1;
+            slot->notify = 0;
+            break;
+        case IPC_SLOT_RESPONSE_READY:
+            *response = slot->response;
+            *status = slot->status;
+            slot->state = IPC_SLOT_FREE;
+            rc = 0;
+            break;
+        default:
+            break;
+        }
+    }
+    sem_post(g_mutex_sem);
+    return rc;
+}
+
+/* --- Adaptive wait --- */
+
+/*
+ * ADD/SUB are typically answered within microseconds, long before a sleeping
+ * caller could be woken. A blocking call therefore first spins on its slot's
+ * state word, for twice the command's recent service time (an exponential
+ * moving average with weight 1/8), and sleeps on the slot semaphore only if
+ * that budget runs out. Commands slower than the spin limit sleep at once,
+ * but every kSpinProbeInterval-th call still spins, so the estimate recovers
+ * when the server speeds up again.
+ */
+static constexpr uint64_t kDefaultSpinLimitNs = 50'000;
+static constexpr uint32_t kSpinProbeInterval = 16;
+static constexpr int      kCommandSlots = IPC_CMD_SEARCH_INTERNED + 1;
+
+static std::atomic<uint64_t> g_spin_limit_ns{kDefaultSpinLimitNs};
+static std::atomic<uint64_t> g_service_ema_ns[kCommandSlots];
+static std::atomic<uint64_t> g_spin_hits{0};
+static std::atomic<uint64_t> g_sleeps{0};
+static thread_local uint32_t t_slow_waits = 0;
+
+static uint64_t spin_budget(ipc_cmd_t cmd)
+{
+    uint64_t limit = g_spin_limit_ns.load(std::memory_order_relaxed);
+    if (limit == 0 || cmd >= kCommandSlots)
+        return 0;
+    uint64_t ema = g_service_ema_ns[cmd].load(std::memory_order_relaxed);
+    uint64_t budget = ema == 0 ? limit : 2 * ema;
+    if (budget <= limit)
+        return budget;
+    return t_slow_waits++ % kSpinProbeInterval == 0 ? limit : 0;
+}
+
+static void record_service_time(ipc_cmd_t cmd, uint64_t elapsed_ns)
+{
+    if (cmd >= kCommandSlots)
+        return;
+    // Racing updates from other threads may be lost; the estimate stays close.
+    std::atomic<uint64_t> &ema = g_service_ema_ns[cmd];
+    uint64_t old = ema.load(std::memory_order_relaxed);
+    uint64_t next = old == 0 ? elapsed_ns
+                             : old - old / 8 + elapsed_ns / 8;
+    ema.store(next ? next : 1, std::memory_order_relaxed);
+}
+
+static inline void cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+/*
+ * Spin until @p slot holds the response to @p request_id or the clock passes
+ * @p until_ns. On a single CPU the server can only run when we step aside,
+ * so every round yields instead.
+ */
+static bool spin_for_response(const MessageSlot *slot, uint64_t request_id, uint64_t until_ns)
+{
+    static const bool single_cpu = sysconf(_SC_NPROCESSORS_ONLN) <= 1;
+    for (uint32_t round = 1;; ++round) {
+        if (__atomic_load_n(&slot->state, __ATOMIC_ACQUIRE) == IPC_SLOT_RESPONSE_READY &&
+            slot->request_id == request_id)
+            return true;
+        if (single_cpu || round % 64 == 0) {
+            if (ipc_monotonic_ns() >= until_ns)
+                return false;
+            if (single_cpu)
+                sched_yield();
+        } else {
+            cpu_relax();
+        }
+    }
+}
+
+/*
+ * Take the response out of a slot that holds it. The slot belongs to the
+ * caller until it is marked free, so this needs no mutex; the release store
+ * publishes the free slot to the next claimant. With room in the thread's
+ * slot magazine the slot is reserved for the thread instead.
+ */
+static void consume_response(MessageSlot *slot, ResponsePayload *response, ipc_status_t *status)
+{
+    *response = slot->response;
+    *status = slot->status;
+    if (!magazine_keep(static_cast<int>(slot - g_shm->slots)))
+        __atomic_store_n(&slot->state, IPC_SLOT_FREE, __ATOMIC_RELEASE);
+}
+
+extern "C" void ipc_set_spin_limit(uint64_t max_ns)
+{
+    g_spin_limit_ns.store(max_ns, std::memory_order_relaxed);
+}
+
+extern "C" void ipc_wait_stats(IpcWaitStats *stats)
+{
+    if (!stats)
+        return;
+    stats->spin_hits = g_spin_hits.load(std::memory_order_relaxed);
+    stats->sleeps = g_sleeps.load(std::memory_order_relaxed);
+    stats->add_service_ns = g_service_ema_ns[IPC_CMD_ADD].load(std::memory_order_relaxed);
+    stats->spin_limit_ns = g_spin_limit_ns.load(std::memory_order_relaxed);
+}
+
+/*
+ * Submit a request and wait for its response: spin on the slot first (see
+ * spin_budget()), then arm the notify flag and sleep on the slot semaphore,
+ * which the server posts for slots with the flag set. With a timeout (in
+ * microseconds, counted from before submission) the wait ends at that
+ * CLOCK_MONOTONIC deadline and the request is cancelled; without one, the
+ * wait gives up only when the server looks gone.
+ */
+template <typename Fill>
+static int blocking_request_with(ipc_cmd_t cmd, Fill &&fill,
+                                 ResponsePayload *response, ipc_status_t *status,
+                                 uint64_t timeout_us)
+{
+    uint64_t start_ns = ipc_monotonic_ns();
+    uint64_t deadline_ns = timeout_us ? start_ns + timeout_us * 1000 : 0;
+    uint64_t budget_ns = spin_budget(cmd);
+    int slot_idx = -1;
+    uint64_t expected_request_id = 0;
+    int submit_rc = submit_request_with(cmd, std::forward<Fill>(fill),
+                                        &slot_idx, &expected_request_id, budget_ns == 0);
+    if (submit_rc != 0)
+        return submit_rc;
+    MessageSlot *slot = &g_shm->slots[slot_idx];
+
+    if (budget_ns != 0) {
+        uint64_t spin_until = start_ns + budget_ns;
+        if (deadline_ns)
+            spin_until = std::min(spin_until, deadline_ns);
+        if (spin_for_response(slot, expected_request_id, spin_until)) {
+            consume_response(slot, response, status);
+            g_spin_hits.fetch_add(1, std::memory_order_relaxed);
+            record_service_time(cmd, ipc_monotonic_ns() - start_ns);
+            return 0;
+        }
+        // Arm the wake-up; the server reads the flag under the same mutex.
+        int rc = lock_shared_mutex_with_recovery();
+        if (rc != 0)
+            return rc;
+        if (slot->request_id == expected_request_id &&
+            slot->state == IPC_SLOT_RESPONSE_READY) {
+            consume_response(slot, response, status);
+            sem_post(g_mutex_sem);
+            record_service_time(cmd, ipc_monotonic_ns() - start_ns);
+            return 0;
+        }
+        slot->notify = 1;
+        sem_post(g_mutex_sem);
+    }
+    g_sleeps.fetch_add(1, std::memory_order_relaxed);
+
+    // Blocking calls are completed via per-slot semaphores. Validate that the slot
+    // truly contains this request's response to guard against stale semaphore wakeups.
+    static constexpr int kMaxSlotWaitTimeoutRetries = 16;
+    int retries = 0;
+    while (retries < kMaxSlotWaitTimeoutRetries) {
+        int wait_rc = deadline_ns ? sem_wait_until(g_slot_sems[slot_idx], deadline_ns)
+                                  : sem_wait_with_timeout(g_slot_sems[slot_idx], 1);
+        if (wait_rc == 0) {
+            int rc = lock_shared_mutex_with_recovery();
+            if (rc != 0)
+                return rc;
+
+            if (slot->request_id == expected_request_id &&
+                slot->state == IPC_SLOT_RESPONSE_READY) {
+                consume_response(slot, response, status);
+                sem_post(g_mutex_sem);
+                record_service_time(cmd, ipc_monotonic_ns() - start_ns);
+                return 0;
+            }
+
+            sem_post(g_mutex_sem);
+            if (!deadline_ns)
+                ++retries;
+            continue;
+        }
+        if (errno == ETIMEDOUT) {
+            int rc = ensure_fresh_connection();
+            if (rc != 0)
+                return rc;
+            if (deadline_ns)
+                return cancel_request(slot_idx, expected_request_id, response, status);
+            ++retries;
+            continue;
+        }
+        return -1;
+    }
+    if (retries >= kMaxSlotWaitTimeoutRetries)
+        return reconnect_after_server_restart();
+    return -1;
+}
+
+/* --- Client-side result cache (opt-in) --- */
+
+/*
+ * Direct-mapped table of pure blocking results, one seqlock per entry. A
+ * writer claims an entry by CAS-ing @c seq from even to odd and publishes by
+ * storing the next even value; readers never wait -- a busy or torn entry is
+ * a miss. Entries are tagged with the server generation they were computed
+ * under and the enable epoch, so a restart or a resize invalidates them all
+ * without touching the table.
+ */
+struct CacheEntry {
+    uint32_t seq;
+    uint32_t epoch;
+    uint64_t generation;
+    uint32_t cmd;
+    int32_t  a;
+    int32_t  b;
+    int32_t  result;
+};
+
+static constexpr uint32_t kResultCacheMaxEntries = 4096;
+static CacheEntry g_cache[kResultCacheMaxEntries];
+static std::atomic<uint32_t> g_cache_entries{0};   // 0 while disabled
+static std::atomic<uint32_t> g_cache_epoch{0};
+static std::atomic<uint64_t> g_cache_hits{0};
+static std::atomic<uint64_t> g_cache_misses{0};
+
+static CacheEntry *cache_entry(uint32_t entries, ipc_cmd_t cmd, int32_t a, int32_t b)
+{
+    uint64_t key = (uint64_t{static_cast<uint32_t>(a)} << 32) | static_cast<uint32_t>(b);
+    key = (key ^ static_cast<uint64_t>(cmd)) * 0x9E3779B97F4A7C15ull;
+    return &g_cache[(key >> 32) & (entries - 1)];
+}
+
+/*
+ * Hits are checked against the generation the server publishes now, not the
+ * one this client last attached to, so a result cached before a restart is
+ * never returned before the client has noticed the restart.
+ */
+static bool cache_lookup(uint32_t entries, uint32_t epoch, ipc_cmd_t cmd,
+                         int32_t a, int32_t b, int32_t *result)
+{
+    uint64_t generation = __atomic_load_n(&g_shm->server_generation, __ATOMIC_ACQUIRE);
+    if (generation != g_known_generation)
+        return false;
+    CacheEntry *e = cache_entry(entries, cmd, a, b);
+    uint32_t seq = __atomic_load_n(&e->seq, __ATOMIC_ACQUIRE);
+    if (seq & 1u)
+        return false;
+    bool match = __atomic_load_n(&e->epoch, __ATOMIC_RELAXED) == epoch &&
+                 __atomic_load_n(&e->generation, __ATOMIC_RELAXED) == generation &&
+                 __atomic_load_n(&e->cmd, __ATOMIC_RELAXED) == static_cast<uint32_t>(cmd) &&
+                 __atomic_load_n(&e->a, __ATOMIC_RELAXED) == a &&
+                 __atomic_load_n(&e->b, __ATOMIC_RELAXED) == b;
+    int32_t value = __atomic_load_n(&e->result, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (!match || __atomic_load_n(&e->seq, __ATOMIC_RELAXED) != seq)
+        return false;
+    *result = value;
+    return true;
+}
+
+static void cache_store(uint32_t entries, uint32_t epoch, uint64_t generation,
+                        ipc_cmd_t cmd, int32_t a, int32_t b, int32_t result)
+{
+    CacheEntry *e = cache_entry(entries, cmd, a, b);
+    uint32_t seq = __atomic_load_n(&e->seq, __ATOMIC_RELAXED);
+    if ((seq & 1u) || !__atomic_compare_exchange_n(&e->seq, &seq, seq + 1, false,
+                                                   __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        return;   // another writer has it; losing one store is fine
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&e->epoch, epoch, __ATOMIC_RELAXED);
+    __atomic_store_n(&e->generation, generation, __ATOMIC_RELAXED);
+    __atomic_store_n(&e->cmd, static_cast<uint32_t>(cmd), __ATOMIC_RELAXED);
+    __atomic_store_n(&e->a, a, __ATOMIC_RELAXED);
+    __atomic_store_n(&e->b, b, __ATOMIC_RELAXED);
+    __atomic_store_n(&e->result, result, __ATOMIC_RELAXED);
+    __atomic_store_n(&e->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+extern "C" int ipc_result_cache_enable(uint32_t entries)
+{
+    if (entries > kResultCacheMaxEntries)
+        return -1;
+    uint32_t size = 0;
+    if (entries > 0) {
+        size = 1;
+        while (size < entries)
+            size <<= 1;
+    }
+    g_cache_epoch.fetch_add(1, std::memory_order_relaxed);
+    g_cache_hits.store(0, std::memory_order_relaxed);
+    g_cache_misses.store(0, std::memory_order_relaxed);
+    g_cache_entries.store(size, std::memory_order_release);
+    return 0;
+}
+
+extern "C" void ipc_result_cache_stats(IpcCacheStats *stats)
+{
+    if (!stats)
+        return;
+    stats->hits = g_cache_hits.load(std::memory_order_relaxed);
+    stats->misses = g_cache_misses.load(std::memory_order_relaxed);
+    stats->entries = g_cache_entries.load(std::memory_order_relaxed);
+}
+
+static int blocking_math(ipc_cmd_t cmd, int32_t a, int32_t b, int32_t *result,
+                         uint64_t timeout_us)
+{
+    if (!result) return -1;
+
+    // Only add/subtract come through here; both are pure.
+    uint32_t entries = g_cache_entries.load(std::memory_order_acquire);
+    uint32_t epoch = 0;
+    uint64_t generation = g_known_generation;
+    if (entries && g_shm) {
+        epoch = g_cache_epoch.load(std::memory_order_relaxed);
+        if (cache_lookup(entries, epoch, cmd, a, b, result)) {
+            g_cache_hits.fetch_add(1, std::memory_order_relaxed);
+            return 0;
+        }
+        g_cache_misses.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    ResponsePayload response;
+    ipc_status_t status = IPC_STATUS_OK;
+    int rc = blocking_request_with(
+        cmd,
+        [a, b](RequestPayload &dst) {
+            dst.math.a = a;
+            dst.math.b = b;
+        },
+        &response, &status, timeout_us);
+    if (rc != 0)
+        return rc;
+    *result = response.math_result;
+    if (status != IPC_STATUS_OK)
+        return -1;
+    if (entries && generation == g_known_generation)
+        cache_store(entries, epoch, generation, cmd, a, b, response.math_result);
+    return 0;
+}
+
+extern "C" int ipc_add(int32_t a, int32_t b, int32_t *result)
+{
+    return blocking_math(IPC_CMD_ADD, a, b, result, t_timeout_us);
+}
+
+extern "C" int ipc_subtract(int32_t a, int32_t b, int32_t *result)
+{
+    return blocking_math(IPC_CMD_SUB, a, b, result, t_timeout_us);
+}
+
+extern "C" int ipc_add_timed(int32_t a, int32_t b, int32_t *result, uint64_t timeout_us)
+{
+    return blocking_math(IPC_CMD_ADD, a, b, result, timeout_us);
+}
+
+extern "C" int ipc_subtract_timed(int32_t a, int32_t b, int32_t *result, uint64_t timeout_us)
+{
+    return blocking_math(IPC_CMD_SUB, a, b, result, timeout_us);
+}
+
+/* --- Non-blocking calls --- */
+
+static int async_math(ipc_cmd_t cmd, int32_t a, int32_t b,
+                      uint64_t *request_id)
+{
+    if (!request_id) return -1;
+
+    return submit_async(
+        cmd,
+        [=](RequestPayload &dst) {
+            dst.math.a = a;
+            dst.math.b = b;
+        },
+        request_id);
+}
+
+static int async_string(ipc_cmd_t cmd, const char *s1, const char *s2,
+                        uint64_t *request_id)
+{
+    if (!request_id) return -1;
+    int len1 = ipc_string_length(s1);
+    int len2 = ipc_string_length(s2);
+    if (len1 < 0 || len2 < 0) {
+        fprintf(stderr, "async_string: invalid string length "
+                "(must be 1..%d chars)\n", IPC_MAX_STRING_LEN);
+        return -1;
+    }
+
+    return submit_async(
+        cmd,
+        [=](RequestPayload &dst) {
+            StringArgs &str = dst.str;
+            str.len1 = static_cast<uint8_t>(len1);
+            str.len2 = static_cast<uint8_t>(len2);
+            memcpy(str.s1, s1, static_cast<size_t>(len1));
+            str.s1[len1] = '\0';
+            memcpy(str.s2, s2, static_cast<size_t>(len2));
+            str.s2[len2] = '\0';
+        },
+        request_id);
+}
+
+extern "C" int ipc_multiply(int32_t a, int32_t b, uint64_t *request_id)
+{
+    return async_math(IPC_CMD_MUL, a, b, request_id);
+}
+
+extern "C" int ipc_divide(int32_t a, int32_t b, uint64_t *request_id)
+{
+    return async_math(IPC_CMD_DIV, a, b, request_id);
+}
+
+extern "C" int ipc_concat(const char *s1, const char *s2,
+                           uint64_t *request_id)
+{
+    return async_string(IPC_CMD_CONCAT, s1, s2, request_id);
+}
+
+extern "C" int ipc_search(const char *haystack, const char *needle,
+                           uint64_t *request_id)
+{
+    return async_string(IPC_CMD_SEARCH, haystack, needle, request_id);
+}
+
+/* --- String interning --- */
+
+/* Yields between liveness checks of the process filling a BUSY entry. */
+static constexpr int kInternBusyYields = 1000;
+
+static bool intern_owner_dead(uint32_t busy_tag)
+{
+    pid_t owner = static_cast<pid_t>(busy_tag >> 1);
+    return kill(owner, 0) != 0 && errno == ESRCH;
+}
+
+extern "C" int ipc_intern(const char *s, uint32_t *id)
+{
+    if (!id) return -1;
+    int len = ipc_string_length(s);
+    if (len < 0) {
+        fprintf(stderr, "ipc_intern: invalid string length (must be 1..%d chars)\n",
+                IPC_MAX_STRING_LEN);
+        return -1;
+    }
+    int rc = ensure_fresh_connection();
+    if (rc != 0)
+        return rc;
+
+    uint32_t hash = ipc_intern_hash(s, static_cast<size_t>(len));
+    uint32_t ready_tag = IPC_INTERN_READY | (hash & ~IPC_INTERN_READY);
+    uint32_t busy_tag = ipc_intern_busy(getpid());
+    for (uint32_t probe = 0; probe < IPC_INTERN_CAPACITY; ++probe) {
+        uint32_t idx = (hash + probe) & (IPC_INTERN_CAPACITY - 1);
+        InternEntry *entry = &g_shm->interns[idx];
+        uint32_t tag = __atomic_load_n(&entry->tag, __ATOMIC_ACQUIRE);
+        while (tag == IPC_INTERN_EMPTY || ipc_intern_is_busy(tag)) {
+            // Claim an empty entry, or take over one whose inserter died.
+            if (tag == IPC_INTERN_EMPTY || intern_owner_dead(tag)) {
+                if (__atomic_compare_exchange_n(&entry->tag, &tag, busy_tag, false,
+                                                __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+                    entry->len = static_cast<uint8_t>(len);
+                    memcpy(entry->bytes, s, static_cast<size_t>(len));
+                    entry->bytes[len] = '\0';
+                    __atomic_store_n(&entry->tag, ready_tag, __ATOMIC_RELEASE);
+                    *id = idx;
+                    return 0;
+                }
+                continue;   // lost the race; tag holds the winner's
+            }
+            // A live process is inserting, possibly this very string: wait
+            // for it rather than skip ahead and publish a second id.
+            uint32_t busy = tag;
+            for (int y = 0; tag == busy && y < kInternBusyYields; ++y) {
+                sched_yield();
+                tag = __atomic_load_n(&entry->tag, __ATOMIC_ACQUIRE);
+            }
+        }
+        if (tag == ready_tag && entry->len == len &&
+            memcmp(entry->bytes, s, static_cast<size_t>(len)) == 0) {
+            *id = idx;
+            return 0;
+        }
+    }
+    fprintf(stderr, "ipc_intern: intern table full\n");
+    return -1;
+}
+
+static int async_interned(ipc_cmd_t cmd, uint32_t id1, uint32_t id2,
+                          uint64_t *request_id)
+{
+    if (!request_id) return -1;
+
+    return submit_request_with(
+        cmd, [=](RequestPayload &dst) { dst.intern = InternArgs{id1, id2}; },
+        nullptr, request_id);
+}
+
+extern "C" int ipc_concat_interned(uint32_t id1, uint32_t id2, uint64_t *request_id)
+{
+    return async_interned(IPC_CMD_CONCAT_INTERNED, id1, id2, request_id);
+}
+
+extern "C" int ipc_search_interned(uint32_t haystack_id, uint32_t needle_id,
+                                   uint64_t *request_id)
+{
+    return async_interned(IPC_CMD_SEARCH_INTERNED, haystack_id, needle_id, request_id);
+}
+
+extern "C" int ipc_matmul(uint32_t m, uint32_t n, uint32_t k, ipc_dtype_t dtype,
+                           uint64_t a_off, uint64_t b_off, uint64_t c_off,
+                           uint64_t *request_id)
+{
+    if (!request_id) return -1;
+    if (m == 0 || n == 0 || k == 0 ||
+        (dtype != IPC_DTYPE_INT32 && dtype != IPC_DTYPE_FLOAT32)) {
+        fprintf(stderr, "ipc_matmul: invalid dimensions or dtype\n");
+        return -1;
+    }
+
+    return submit_request_with(
+        IPC_CMD_MATMUL,
+        [=](RequestPayload &dst) {
+            dst.matmul = MatmulArgs{m, n, k, static_cast<uint32_t>(dtype),
+                                    a_off, b_off, c_off};
+        },
+        nullptr, request_id);
+}
+
+static int submit_str_array(ipc_cmd_t cmd, uint64_t refs_off, uint32_t count,
+                            uint32_t algo, uint64_t out_off, uint64_t *request_id)
+{
+    if (!request_id) return -1;
+    if (count == 0) {
+        fprintf(stderr, "bulk string request: empty string array\n");
+        return -1;
+    }
+
+    return submit_request_with(
+        cmd,
+        [=](RequestPayload &dst) {
+            dst.str_array = StrArrayArgs{refs_off, out_off, count, algo};
+        },
+        nullptr, request_id);
+}
+
+extern "C" int ipc_str_sort(uint64_t refs_off, uint32_t count, uint64_t out_off,
+                             uint64_t *request_id)
+{
+    return submit_str_array(IPC_CMD_STR_SORT, refs_off, count, 0, out_off, request_id);
+}
+
+extern "C" int ipc_str_dedupe(uint64_t refs_off, uint32_t count, uint64_t out_off,
+                               uint64_t *request_id)
+{
+    return submit_str_array(IPC_CMD_STR_DEDUPE, refs_off, count, 0, out_off, request_id);
+}
+
+extern "C" int ipc_str_hash(uint64_t refs_off, uint32_t count, ipc_hash_t algo,
+                             uint64_t out_off, uint64_t *request_id)
+{
+    if (algo != IPC_HASH_CRC32C && algo != IPC_HASH_XXH32) {
+        fprintf(stderr, "ipc_str_hash: unknown hash algorithm\n");
+        return -1;
+    }
+    return submit_str_array(IPC_CMD_STR_HASH, refs_off, count,
+                            static_cast<uint32_t>(algo), out_off, request_id);
+}
+
+extern "C" int ipc_regex_search(uint64_t pattern_off, uint32_t pattern_len,
+                                 uint64_t hay_off, uint32_t hay_len,
+                                 uint64_t *request_id)
+{
+    if (!request_id) return -1;
+
+    return submit_request_with(
+        IPC_CMD_REGEX_SEARCH,
+        [=](RequestPayload &dst) {
+            dst.regex = RegexArgs{pattern_off, hay_off, pattern_len, hay_len};
+        },
+        nullptr, request_id);
+}
+
+extern "C" int ipc_search_batch(uint64_t hay_off, uint32_t hay_len, uint64_t refs_off,
+                                 uint32_t count, uint64_t out_off, uint64_t *request_id)
+{
+    if (!request_id) return -1;
+    if (count == 0) {
+        fprintf(stderr, "ipc_search_batch: no needles\n");
+        return -1;
+    }
+
+    return submit_request_with(
+        IPC_CMD_SEARCH_BATCH,
+        [=](RequestPayload &dst) {
+            dst.search_batch = SearchBatchArgs{hay_off, refs_off, out_off, hay_len, count};
+        },
+        nullptr, request_id);
+}
+
+/* --- Streaming aggregation --- */
+
+static int stream_control(ipc_cmd_t cmd, uint32_t stream_id,
+                          ResponsePayload *response)
+{
+    ipc_status_t status = IPC_STATUS_OK;
+    int rc = blocking_request_with(
+        cmd, [stream_id](RequestPayload &dst) { dst.stream.stream_id = stream_id; },
+        response, &status, t_timeout_us);
+    if (rc != 0)
+        return rc;
+    return (status == IPC_STATUS_OK) ? 0 : -1;
+}
+
+extern "C" int ipc_stream_open(uint32_t *stream_id)
+{
+    if (!stream_id) return -1;
+    ResponsePayload response;
+    int rc = stream_control(IPC_CMD_STREAM_OPEN, 0, &response);
+    if (rc == 0)
+        *stream_id = response.stream_id;
+    return rc;
+}
+
+extern "C" int ipc_stream_push(uint32_t stream_id, const int32_t *values,
+                               uint32_t count, uint32_t *accepted)
+{
+    if (!accepted || (!values && count > 0) || !g_shm || stream_id >= IPC_MAX_STREAMS)
+        return -1;
+    *accepted = 0;
+
+    StreamRing *ring = &g_shm->streams[stream_id];
+    if (__atomic_load_n(&ring->state, __ATOMIC_ACQUIRE) != IPC_STREAM_OPEN ||
+        ring->owner_pid != g_self_pid) {
+        // Closed, not ours, or the server went away (it marks rings free on exit).
+        int rc = ensure_fresh_connection();
+        return rc != 0 ? rc : -1;
+    }
+
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    uint64_t space = IPC_STREAM_CAPACITY - std::min<uint64_t>(head - tail, IPC_STREAM_CAPACITY);
+    uint32_t n = static_cast<uint32_t>(std::min<uint64_t>(count, space));
+    if (n == 0) {
+        // A full ring is also how a crashed server shows up.
+        if (count > 0) {
+            int rc = ensure_fresh_connection();
+            if (rc != 0)
+                return rc;
+        }
+        return 0;
+    }
+
+    uint64_t pos = head & (IPC_STREAM_CAPACITY - 1);
+    uint32_t first = static_cast<uint32_t>(std::min<uint64_t>(n, IPC_STREAM_CAPACITY - pos));
+    memcpy(ring->values + pos, values, first * sizeof(int32_t));
+    memcpy(ring->values, values + first, (n - first) * sizeof(int32_t));
+    __atomic_store_n(&ring->head, head + n, __ATOMIC_RELEASE);
+    *accepted = n;
+
+    // Pairs with the consumer's need_wakeup store + fence: either it sees the
+    // new head, or we see its wakeup request and ring the doorbell.
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ring->need_wakeup, __ATOMIC_RELAXED) &&
+        __atomic_exchange_n(&ring->need_wakeup, 0u, __ATOMIC_SEQ_CST)) {
+        __atomic_store_n(&ring->doorbell, 1u, __ATOMIC_RELEASE);
+        sem_post(g_server_sem);
+    }
+    return 0;
+}
+
+extern "C" int ipc_stream_query(uint32_t stream_id, StreamStats *stats)
+{
+    if (!stats) return -1;
+    ResponsePayload response;
+    int rc = stream_control(IPC_CMD_STREAM_QUERY, stream_id, &response);
+    if (rc == 0)
+        *stats = response.stream;
+    return rc;
+}
+
+extern "C" int ipc_stream_close(uint32_t stream_id, StreamStats *final_stats)
+{
+    ResponsePayload response;
+    int rc = stream_control(IPC_CMD_STREAM_CLOSE, stream_id, &response);
+    if (rc == 0 && final_stats)
+        *final_stats = response.stream;
+    return rc;
+}
+
+/* --- Shared data arena --- */
+
+/*
+ * Per-thread magazines of slab blocks. Blocks in a magazine stay marked
+ * IPC_ARENA_BLOCK_CACHED for this process, so allocating or freeing from
+ * one touches only the block header: no lock, no syscall, no atomics on
+ * shared lists. Magazines refill and drain in batches from the shared
+ * per-class stacks and are dropped when the library reconnects.
+ */
+static constexpr uint32_t kMagazineSize = 32;
+static constexpr uint32_t kMagazineBatch = kMagazineSize / 2;
+
+struct Magazine {
+    uint32_t count = 0;
+    uint64_t blocks[kMagazineSize];
+};
+
+struct ThreadMagazines {
+    uint64_t generation = 0;
+    Magazine classes[IPC_ARENA_CLASSES];
+
+    Magazine &get(int cls)
+    {
+        if (generation != g_known_generation) {
+            // Blocks of a previous connection belong to an unmapped segment.
+            for (Magazine &mag : classes)
+                mag.count = 0;
+            generation = g_known_generation;
+        }
+        return classes[cls];
+    }
+
+    /* Move the top @p n blocks of @p cls back to the shared stack. */
+    void drain(int cls, uint32_t n)
+    {
+        Magazine &mag = classes[cls];
+        while (n-- > 0 && mag.count > 0) {
+            uint64_t off = mag.blocks[--mag.count];
+            ArenaBlockHeader *hdr = arena_header(g_shm, off);
+            hdr->owner_pid = 0;
+            __atomic_store_n(&hdr->state, IPC_ARENA_BLOCK_FREE, __ATOMIC_RELEASE);
+            arena_slab_push(g_shm, cls, off);
+        }
+    }
+
+    ~ThreadMagazines()
+    {
+        if (!g_shm || generation != g_known_generation)
+            return;
+        for (int cls = 0; cls < IPC_ARENA_CLASSES; ++cls)
+            drain(cls, kMagazineSize);
+    }
+};
+
+static thread_local ThreadMagazines t_magazines;
+
+/* TLSF allocation under the mutex; reclaims dead clients' blocks once if full. */
+template <typename Alloc>
+static auto alloc_with_reclaim(Alloc &&alloc) -> decltype(alloc())
+{
+    auto result = alloc();
+    if (!result && arena_reclaim(g_shm) > 0)
+        result = alloc();
+    return result;
+}
+
+static int refill_magazine(int cls)
+{
+    int rc = ensure_fresh_connection();
+    if (rc != 0)
+        return rc;
+    Magazine &fresh = t_magazines.get(cls);   // drops stale blocks after a reconnect
+    pid_t self = g_self_pid;
+    while (fresh.count < kMagazineBatch) {
+        uint64_t off = arena_slab_pop(g_shm, cls);
+        if (!off)
+            break;
+        ArenaBlockHeader *hdr = arena_header(g_shm, off);
+        hdr->owner_pid = self;
+        __atomic_store_n(&hdr->state, IPC_ARENA_BLOCK_CACHED, __ATOMIC_RELAXED);
+        fresh.blocks[fresh.count++] = off;
+    }
+    if (fresh.count > 0)
+        return 0;
+
+    rc = lock_shared_mutex_with_recovery();
+    if (rc != 0)
+        return rc;
+    fresh.count = alloc_with_reclaim([&] {
+        return arena_slab_carve(g_shm, cls, self, fresh.blocks, kMagazineBatch);
+    });
+    sem_post(g_mutex_sem);
+    return fresh.count > 0 ? 0 : -1;
+}
+
+static void count_arena_alloc()
+{
+    if (g_client)
+        __atomic_fetch_add(&g_client->arena_allocs, 1, __ATOMIC_RELAXED);
+}
+
+extern "C" int ipc_arena_alloc(size_t size, uint64_t *offset)
+{
+    if (!offset || size == 0 || size > IPC_ARENA_SIZE - IPC_ARENA_ALIGN)
+        return -1;
+    if (!g_shm)
+        return -1;
+
+    int cls = arena_size_class(size);
+    if (cls >= 0) {
+        if (t_magazines.get(cls).count == 0) {
+            int rc = refill_magazine(cls);
+            if (rc != 0) {
+                if (rc == -1)
+                    fprintf(stderr, "ipc_arena_alloc: out of arena space (%zu bytes requested)\n",
+                            size);
+                return rc;
             }
+        }
+        Magazine &mag = t_magazines.get(cls);
+        uint64_t off = mag.blocks[--mag.count];
+        __atomic_store_n(&arena_header(g_shm, off)->state, IPC_ARENA_BLOCK_USED,
+                         __ATOMIC_RELAXED);
+        count_arena_alloc();
+        *offset = off;
+        return 0;
+    }
+
+    int rc = ensure_fresh_connection();
+    if (rc != 0)
+        return rc;
+    rc = lock_shared_mutex_with_recovery();
+    if (rc != 0)
+        return rc;
+    uint64_t off = alloc_with_reclaim([size] { return arena_tlsf_alloc(g_shm, size, g_self_pid); });
+    sem_post(g_mutex_sem);
+    if (!off) {
+        fprintf(stderr, "ipc_arena_alloc: out of arena space (%zu bytes requested)\n", size);
+        return -1;
+    }
+    count_arena_alloc();
+    *offset = off;
+    return 0;
+}
+
+extern "C" int ipc_arena_free(uint64_t offset)
+{
+    if (!g_shm)
+        return -1;
+    ArenaBlockHeader *hdr = arena_header(g_shm, offset);
+    if (!hdr)
+        return -1;
+
+    if (hdr->size_class < IPC_ARENA_CLASSES) {
+        // Slab block: USED -> CACHED claims it exactly once, even across threads.
+        uint32_t expected = IPC_ARENA_BLOCK_USED;
+        if (!__atomic_compare_exchange_n(&hdr->state, &expected, IPC_ARENA_BLOCK_CACHED, false,
+                                         __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+            return -1;
+        hdr->owner_pid = g_self_pid;
+        hdr->refs = 0;
+        int cls = static_cast<int>(hdr->size_class);
+        Magazine &mag = t_magazines.get(cls);
+        if (mag.count == kMagazineSize)
+            t_magazines.drain(cls, kMagazineBatch);
+        mag.blocks[mag.count++] = offset;
+        return 0;
+    }
+
+    int rc = ensure_fresh_connection();
+    if (rc != 0)
+        return rc;
+    rc = lock_shared_mutex_with_recovery();
+    if (rc != 0)
+        return rc;
+
+    if (!ipc_arena_span_valid(g_shm, offset, 0)) {
+        sem_post(g_mutex_sem);
+        return -1;
+    }
+    arena_tlsf_free(g_shm, offset);
+    sem_post(g_mutex_sem);
+    return 0;
+}
+
+extern "C" void *ipc_arena_ptr(uint64_t offset)
+{
+    if (!g_shm || offset < IPC_ARENA_ALIGN || offset >= IPC_ARENA_SIZE)
+        return nullptr;
+    return g_shm->arena + offset;
+}
+
+/*
+ * Lock /ipc_mutex on a connection that is current. @p restarted reports
+ * whether a restart was noticed (and the journal replayed) on the way.
+ */
+static int lock_current_connection(bool *restarted)
+{
+    *restarted = false;
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        int rc = ensure_fresh_connection();
+        if (rc == 0)
+            rc = lock_shared_mutex_with_recovery();
+        if (rc == 0 && g_shm->server_generation != g_known_generation) {
+            sem_post(g_mutex_sem);
+            rc = reconnect_after_server_restart();
+        }
+        if (rc == 0)
+            return 0;
+        if (rc != IPC_ERR_SERVER_RESTARTED)
+            return rc;
+        *restarted = true;
+    }
+    return IPC_ERR_SERVER_RESTARTED;
+}
+
+extern "C" int ipc_get_result(uint64_t request_id, ResponsePayload *result,
+                               ipc_status_t *status)
+{
+    if (!result || !status) return -1;
+
+    bool restarted = false;
+    int rc = lock_current_connection(&restarted);
+    if (rc != 0)
+        return rc;
+
+    // Journaled requests were resubmitted on reconnect; look up their new id.
+    JournalEntry *entry = journal_find(request_id);
+    if (restarted && !entry) {
+        sem_post(g_mutex_sem);
+        return IPC_ERR_SERVER_RESTARTED;
+    }
+    uint64_t live_id = request_id;
+    bool resubmitted = false;
+    if (entry) {
+        if (!journal_resubmit_locked(entry, &resubmitted)) {
             sem_post(g_mutex_sem);
             return IPC_NOT_READY;
         }
+        live_id = entry->live_id;
     }
 
+    rc = -1;
+    for (int i = 0; i < IPC_MAX_SLOTS; ++i) {
+        MessageSlot *slot = &g_shm->slots[i];
+        if (slot->request_id == live_id) {
+            if (slot->state == IPC_SLOT_RESPONSE_READY) {
+                *result = slot->response;
+                *status = slot->status;
+                slot->state = IPC_SLOT_FREE;
+                rc = 0;
+            } else {
+                rc = IPC_NOT_READY;
+            }
+            break;
+        }
+    }
+    if (rc != IPC_NOT_READY)
+        journal_remove(entry);
+
     sem_post(g_mutex_sem);
-    return -1;
+    if (resubmitted)
+        sem_post(g_server_sem);
+    return rc;
+}
+
+extern "C" int ipc_submit_batch(IpcSubmission *subs, uint32_t count)
+{
+    if (!subs) return -1;
+    if (count == 0) return 0;
+
+    int rc = ensure_fresh_connection();
+    if (rc != 0)
+        return rc;
+
+    uint64_t deadline_ns = request_deadline();
+
+    rc = lock_shared_mutex_with_recovery();
+    if (rc != 0)
+        return rc;
+
+    if (g_shm->server_generation != g_known_generation) {
+        sem_post(g_mutex_sem);
+        return reconnect_after_server_restart();
+    }
+
+    uint32_t submitted = 0;
+    int idx;
+    while (submitted < count && (idx = find_free_slot()) >= 0) {
+        IpcSubmission &sub = subs[submitted];
+        JournalEntry *entry = replayable(sub.cmd) ? journal_reserve_locked() : nullptr;
+        if (replayable(sub.cmd) && !entry) {
+            fprintf(stderr, "ipc_submit_batch: restart journal full\n");
+            break;
+        }
+        MessageSlot *slot = &g_shm->slots[idx];
+        claim_slot_locked(slot, sub.cmd, deadline_ns, false);
+        slot->request = sub.request;
+        slot->state = IPC_SLOT_REQUEST_PENDING;
+        sub.request_id = slot->request_id;
+        if (entry)
+            journal_add_locked(entry, slot);
+        ++submitted;
+    }
+
+    sem_post(g_mutex_sem);
+    if (submitted > 0)
+        sem_post(g_server_sem);   // the dispatcher scans every slot per wake-up
+    return static_cast<int>(submitted);
+}
+
+extern "C" int ipc_reap(const uint64_t *request_ids, uint32_t count,
+                        IpcCompletion *completions)
+{
+    if (!request_ids || !completions) return -1;
+    if (count == 0) return 0;
+
+    bool restarted = false;
+    int rc = lock_current_connection(&restarted);
+    if (rc != 0)
+        return rc;
+
+    uint32_t done = 0;
+    bool resubmitted = false;
+    for (uint32_t r = 0; r < count; ++r) {
+        JournalEntry *entry = journal_find(request_ids[r]);
+        uint64_t live_id = request_ids[r];
+        if (entry) {
+            if (!journal_resubmit_locked(entry, &resubmitted))
+                continue;   // no slot yet; resubmitted on a later pass
+            live_id = entry->live_id;
+        }
+        MessageSlot *found = nullptr;
+        for (MessageSlot &slot : g_shm->slots) {
+            if (slot.state != IPC_SLOT_FREE && slot.request_id == live_id) {
+                found = &slot;
+                break;
+            }
+        }
+        if (found && found->state != IPC_SLOT_RESPONSE_READY)
+            continue;
+        IpcCompletion &c = completions[done++];
+        c.request_id = request_ids[r];
+        if (found) {
+            c.rc = 0;
+            c.status = found->status;
+            c.response = found->response;
+            found->state = IPC_SLOT_FREE;
+        } else {
+            c.rc = -1;
+            c.status = IPC_STATUS_INTERNAL_ERROR;
+            memset(&c.response, 0, sizeof(c.response));
+        }
+        journal_remove(entry);
+    }
+
+    sem_post(g_mutex_sem);
+    if (resubmitted)
+        sem_post(g_server_sem);
+    return static_cast<int>(done);
+}
+
+extern "C" int ipc_result_view(uint64_t request_id, IpcResultView *view,
+                                ipc_status_t *status)
+{
+    if (!view) return -1;
+
+    ResponsePayload resp;
+    int rc = ipc_get_result(request_id, &resp, status);
+    if (rc != 0)
+        return rc;
+
+    *view = IpcResultView{nullptr, 0, resp.result.count, 0};
+    if (*status == IPC_STATUS_OK && resp.result.offset != 0) {
+        view->handle = resp.result.offset;
+        view->bytes = resp.result.bytes;
+        view->data = g_shm->arena + resp.result.offset;
+    }
+    return 0;
+}
+
+/* Refcounted result buffers are USED blocks with refs > 0 (see ResultBufferRef). */
+static ArenaBlockHeader *result_header(uint64_t handle)
+{
+    if (!g_shm || __atomic_load_n(&g_shm->server_generation, __ATOMIC_RELAXED) !=
+                      g_known_generation)
+        return nullptr;
+    ArenaBlockHeader *hdr = arena_header(g_shm, handle);
+    if (!hdr || __atomic_load_n(&hdr->state, __ATOMIC_ACQUIRE) != IPC_ARENA_BLOCK_USED)
+        return nullptr;
+    return hdr;
+}
+
+extern "C" int ipc_result_view_retain(const IpcResultView *view)
+{
+    if (!view || view->handle == 0)
+        return -1;
+    ArenaBlockHeader *hdr = result_header(view->handle);
+    if (!hdr)
+        return -1;
+    uint32_t refs = __atomic_load_n(&hdr->refs, __ATOMIC_RELAXED);
+    do {
+        if (refs == 0)
+            return -1;
+    } while (!__atomic_compare_exchange_n(&hdr->refs, &refs, refs + 1, true,
+                                          __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    return 0;
+}
+
+extern "C" int ipc_result_view_release(IpcResultView *view)
+{
+    if (!view)
+        return -1;
+    if (view->handle == 0)
+        return 0;
+    ArenaBlockHeader *hdr = result_header(view->handle);
+    if (!hdr)
+        return -1;
+    uint32_t refs = __atomic_load_n(&hdr->refs, __ATOMIC_RELAXED);
+    do {
+        if (refs == 0)
+            return -1;
+    } while (!__atomic_compare_exchange_n(&hdr->refs, &refs, refs - 1, true,
+                                          __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+
+    uint64_t handle = view->handle;
+    *view = IpcResultView{nullptr, 0, 0, 0};
+    return refs == 1 ? ipc_arena_free(handle) : 0;
 }
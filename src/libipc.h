@@ -32,7 +32,8 @@ int ipc_init(void);
  * @brief Disconnect and release local mappings.
  *
  * Calls munmap and sem_close. Does NOT unlink IPC objects (the server
- * owns that responsibility).
+ * owns that responsibility). Forgets the async requests journaled for
+ * resubmission, so their IDs are not replayed after a later ipc_init().
  */
 void ipc_cleanup(void);
 
@@ -64,10 +65,174 @@ int ipc_add(int32_t a, int32_t b, int32_t *result);
  */
 int ipc_subtract(int32_t a, int32_t b, int32_t *result);
 
+/**
+ * @brief ipc_add() that gives up after @p timeout_us microseconds.
+ *
+ * The timeout counts from the call, including submission, and is measured
+ * on CLOCK_MONOTONIC, so wall-clock changes do not affect it. On expiry the
+ * request is cancelled: if the server has not started it, it never runs;
+ * otherwise the server discards the answer and frees the slot.
+ *
+ * @param[in]  timeout_us  Timeout in microseconds; 0 waits like ipc_add().
+ * @return 0 on success, -1 on error, IPC_ERR_TIMEOUT if the timeout expired,
+ *         IPC_ERR_SERVER_RESTARTED if the server restarted.
+ */
+int ipc_add_timed(int32_t a, int32_t b, int32_t *result, uint64_t timeout_us);
+
+/** @brief ipc_subtract() with a timeout; see ipc_add_timed(). */
+int ipc_subtract_timed(int32_t a, int32_t b, int32_t *result, uint64_t timeout_us);
+
+/**
+ * @brief Set the default timeout of blocking calls made by the calling thread.
+ *
+ * Applies to ipc_add(), ipc_subtract() and the stream open/query/close
+ * calls, with the semantics of ipc_add_timed(). Without a timeout (the
+ * default) a blocking call waits until the server answers or appears to
+ * have gone away.
+ *
+ * @param[in] timeout_us  Timeout in microseconds, or 0 for none.
+ */
+void ipc_set_timeout(uint64_t timeout_us);
+
+/** Hit statistics of the client-side result cache. */
+typedef struct {
+    uint64_t hits;
+    uint64_t misses;
+    uint32_t entries;   /**< Table size, 0 while the cache is disabled. */
+} IpcCacheStats;
+
+/**
+ * @brief Enable (or resize, or disable) the client-side result cache.
+ *
+ * When enabled, ipc_add() and ipc_subtract() answer repeated operands from a
+ * per-process table without touching shared memory; lookups are lock-free.
+ * Cached results are dropped when the library reconnects to a restarted
+ * server, but a hit does not itself check for a restart. Every call clears
+ * the cache and its statistics. Disabled by default.
+ *
+ * @param[in] entries  Table size (rounded up to a power of two, at most
+ *                     4096), or 0 to disable.
+ * @return 0 on success, -1 if @p entries is too large.
+ */
+int ipc_result_cache_enable(uint32_t entries);
+
+/** @brief Read the result cache statistics since it was last enabled. */
+void ipc_result_cache_stats(IpcCacheStats *stats);
+
+/** Statistics of the adaptive wait in blocking calls. */
+typedef struct {
+    uint64_t spin_hits;       /**< Responses caught while spinning. */
+    uint64_t sleeps;          /**< Waits that slept on the slot semaphore. */
+    uint64_t add_service_ns;  /**< Current service-time estimate of ipc_add(). */
+    uint64_t spin_limit_ns;   /**< Longest spin allowed (ipc_set_spin_limit()). */
+} IpcWaitStats;
+
+/**
+ * @brief Cap the time a blocking call spins before it sleeps.
+ *
+ * Blocking calls spin on their slot for twice the command's recent service
+ * time (a moving average), but never longer than this limit, before falling
+ * back to the slot semaphore. Fast requests then cost no context switches.
+ * The default is 50 us; 0 disables spinning. Process-wide.
+ *
+ * @param[in] max_ns  Spin limit in nanoseconds.
+ */
+void ipc_set_spin_limit(uint64_t max_ns);
+
+/** @brief Read the adaptive wait statistics (process-wide, since start). */
+void ipc_wait_stats(IpcWaitStats *stats);
+
+/** Largest slot magazine a thread can keep (see ipc_slot_magazine()). */
+#define IPC_SLOT_MAGAZINE_MAX 4
+
+/** Slot magazine counters of the calling thread. */
+typedef struct {
+    uint64_t hits;      /**< Requests published from a magazine slot, without /ipc_mutex. */
+    uint64_t misses;    /**< Requests that found the magazine empty and took the locked path. */
+    uint64_t lost;      /**< Magazine slots taken back by another claimant or the server. */
+    uint32_t held;      /**< Slots in the magazine now. */
+    uint32_t capacity;  /**< Current capacity, 0 while disabled. */
+} IpcSlotMagazineStats;
+
+/**
+ * @brief Let the calling thread keep up to @p slots message slots for itself.
+ *
+ * Normally every request claims a free slot under the shared /ipc_mutex, so
+ * many busy client threads keep passing the mutex and the slot table's cache
+ * lines between cores. With a magazine, the slot of each answered blocking
+ * call (ipc_add() and the other calls that wait) stays reserved for this
+ * thread instead of being freed. The thread's next request takes it back
+ * with one atomic operation on that slot alone. Request ids are drawn from
+ * the shared counter in blocks for the same reason. Any later request from
+ * the thread can use a magazine slot, except the async calls the library
+ * journals for restarts (ipc_multiply() through ipc_search()), which
+ * always take the locked path.
+ *
+ * Reserved slots are not lost to other clients. A claimant that finds no
+ * free slot takes a reserved one. The server takes back slots that stay
+ * unused for about five seconds, and slots of clients that died. The
+ * magazine is dropped when the library reconnects or the process forks, and
+ * its slots are freed when the thread exits or calls ipc_cleanup(). Disabled
+ * by default; the slot table has only IPC_MAX_SLOTS entries, so enable it
+ * for the few threads that make most of the calls.
+ *
+ * @param[in] slots  Capacity, 1..IPC_SLOT_MAGAZINE_MAX, or 0 to disable.
+ *                   Shrinking frees the slots beyond the new capacity.
+ * @return 0 on success, -1 if @p slots is too large.
+ */
+int ipc_slot_magazine(uint32_t slots);
+
+/** @brief Read the calling thread's slot magazine counters (since its first request). */
+void ipc_slot_magazine_stats(IpcSlotMagazineStats *stats);
+
+/* ------------------------------------------------------------------ */
+/*  Scheduling                                                         */
+/* ------------------------------------------------------------------ */
+
+/**
+ * @brief Set the latency budget for requests submitted by the calling thread.
+ *
+ * Each later request from this thread is due @p budget_ns after submission,
+ * and the server pools run queued work earliest deadline first. Requests
+ * without a budget are due 50 ms after the server queues them, so an
+ * interactive thread with a budget of, say, 1 ms overtakes bulk work queued
+ * by others while that work is still guaranteed to run. A missed deadline is
+ * not an error; the request is simply served as soon as possible.
+ *
+ * @param[in] budget_ns  Budget in nanoseconds, or 0 for no deadline (default).
+ */
+void ipc_set_deadline(uint64_t budget_ns);
+
+/**
+ * @brief Set the priority of requests submitted by the calling thread.
+ *
+ * Each server pool keeps one queue per level and serves the highest
+ * non-empty one, earliest deadline first within it. Work that is past its
+ * deadline (see ipc_set_deadline()) is served ahead of every level, so
+ * IPC_PRIORITY_LOW requests without a deadline age to the front after
+ * 50 ms rather than starve.
+ *
+ * @param[in] priority  IPC_PRIORITY_LOW, IPC_PRIORITY_NORMAL (default) or
+ *                      IPC_PRIORITY_HIGH.
+ * @return 0 on success, -1 if @p priority is not a valid level.
+ */
+int ipc_set_priority(ipc_priority_t priority);
+
 /* ------------------------------------------------------------------ */
 /*  Non-blocking (asynchronous) calls                                  */
 /* ------------------------------------------------------------------ */
 
+/*
+ * ipc_multiply, ipc_divide, ipc_concat and ipc_search requests (and the same
+ * commands through ipc_submit_batch) are journaled until their result is
+ * collected. After a server restart libipc resubmits them and keeps their
+ * request IDs valid, so callers only see added latency. Requests that refer
+ * to arena data, interned strings or streams cannot be replayed; their IDs
+ * are lost on a restart. The journal has IPC_MAX_SLOTS entries; when it is
+ * full, the oldest entry not yet resubmitted to the current server is
+ * dropped with a message on stderr, and if there is none the request fails.
+ */
+
 /**
  * @brief Multiply two 32-bit signed integers (non-blocking).
  *
@@ -77,8 +242,8 @@ int ipc_subtract(int32_t a, int32_t b, int32_t *result);
  * @param[in]  a           First operand.
  * @param[in]  b           Second operand.
  * @param[out] request_id  Pointer to store the assigned request ID.
- * @return 0 on success, -1 on error, IPC_ERR_SERVER_RESTARTED if the server
- *         restarted and this request context was invalidated.
+ * @return 0 on success, -1 on error. A restart noticed while submitting is
+ *         handled by submitting to the new server.
  */
 int ipc_multiply(int32_t a, int32_t b, uint64_t *request_id);
 
@@ -91,8 +256,8 @@ int ipc_multiply(int32_t a, int32_t b, uint64_t *request_id);
  * @param[in]  a           Dividend.
  * @param[in]  b           Divisor.
  * @param[out] request_id  Pointer to store the assigned request ID.
- * @return 0 on success, -1 on error, IPC_ERR_SERVER_RESTARTED if the server
- *         restarted and this request context was invalidated.
+ * @return 0 on success, -1 on error. A restart noticed while submitting is
+ *         handled by submitting to the new server.
  */
 int ipc_divide(int32_t a, int32_t b, uint64_t *request_id);
 
@@ -104,8 +269,7 @@ int ipc_divide(int32_t a, int32_t b, uint64_t *request_id);
  * @param[in]  s1          First string.
  * @param[in]  s2          Second string.
  * @param[out] request_id  Pointer to store the assigned request ID.
- * @return 0 on success, -1 on error (e.g., string too long or empty),
- *         IPC_ERR_SERVER_RESTARTED if the server restarted.
+ * @return 0 on success, -1 on error (e.g., string too long or empty).
  */
 int ipc_concat(const char *s1, const char *s2, uint64_t *request_id);
 
@@ -119,10 +283,252 @@ int ipc_concat(const char *s1, const char *s2, uint64_t *request_id);
  * @param[in]  haystack    The string to search in (1..16 chars).
  * @param[in]  needle      The substring to find (1..16 chars).
  * @param[out] request_id  Pointer to store the assigned request ID.
+ * @return 0 on success, -1 on error.
+ */
+int ipc_search(const char *haystack, const char *needle, uint64_t *request_id);
+
+/* ------------------------------------------------------------------ */
+/*  String interning                                                   */
+/* ------------------------------------------------------------------ */
+
+/**
+ * @brief Intern a string in the shared intern table.
+ *
+ * Equal strings get equal ids across all clients; ids stay valid until the
+ * server restarts, and past a restart when the server reloads its cache
+ * snapshot. Interning takes no lock and sends no request. A client
+ * that dies mid-insert can, at worst, cause one string to get a second id.
+ *
+ * @param[in]  s   String of 1..16 chars.
+ * @param[out] id  The string's id (0..IPC_INTERN_CAPACITY-1).
+ * @return 0 on success, -1 on invalid input or a full table,
+ *         IPC_ERR_SERVER_RESTARTED if the server restarted.
+ */
+int ipc_intern(const char *s, uint32_t *id);
+
+/**
+ * @brief ipc_concat() on two interned strings (non-blocking).
+ *
+ * Only the two ids travel in the request. Unknown ids are reported as
+ * IPC_STATUS_INVALID_INPUT.
+ */
+int ipc_concat_interned(uint32_t id1, uint32_t id2, uint64_t *request_id);
+
+/**
+ * @brief ipc_search() on two interned strings (non-blocking).
+ *
+ * The server builds a shift-and table for each interned haystack once, so
+ * repeated searches in the same haystack cost one AND per needle byte.
+ */
+int ipc_search_interned(uint32_t haystack_id, uint32_t needle_id, uint64_t *request_id);
+
+/* ------------------------------------------------------------------ */
+/*  Shared data arena                                                  */
+/* ------------------------------------------------------------------ */
+
+/**
+ * @brief Allocate a buffer in the shared data arena.
+ *
+ * Arena buffers carry variable-size payloads (e.g. matrices) that do not fit
+ * in a message slot. The returned offset is the handle passed to commands
+ * such as ipc_matmul(); use ipc_arena_ptr() to access the bytes. Buffers are
+ * 64-byte aligned and stay valid until freed or until the server restarts.
+ *
+ * Buffers of up to 4 KiB are served from a per-thread cache without taking
+ * the shared mutex, so a restart may not be reported until the next call
+ * that reaches the server. Buffers left behind by clients that exited are
+ * reclaimed when the arena runs out of space.
+ *
+ * @param[in]  size    Number of bytes (> 0).
+ * @param[out] offset  Pointer to store the arena offset of the buffer.
+ * @return 0 on success, -1 on error (including arena exhaustion),
+ *         IPC_ERR_SERVER_RESTARTED if the server restarted.
+ */
+int ipc_arena_alloc(size_t size, uint64_t *offset);
+
+/**
+ * @brief Release a buffer obtained from ipc_arena_alloc().
+ *
+ * Do not free a buffer while a request referencing it is still in flight.
+ * Any thread may free a buffer allocated by another thread.
+ *
+ * @param[in] offset  Arena offset returned by ipc_arena_alloc().
+ * @return 0 on success, -1 if the offset does not name a live buffer,
+ *         IPC_ERR_SERVER_RESTARTED if the server restarted (the arena was
+ *         reset, so there is nothing left to free).
+ */
+int ipc_arena_free(uint64_t offset);
+
+/**
+ * @brief Translate an arena offset into a pointer in this process.
+ *
+ * The pointer is invalidated when a call reports IPC_ERR_SERVER_RESTARTED
+ * (the library remaps shared memory on reconnect).
+ *
+ * @param[in] offset  Arena offset returned by ipc_arena_alloc().
+ * @return Pointer to the buffer, or NULL if not connected or out of range.
+ */
+void *ipc_arena_ptr(uint64_t offset);
+
+/**
+ * @brief Multiply two matrices stored in the arena (non-blocking).
+ *
+ * Computes C[m x n] = A[m x k] * B[k x n] on row-major matrices. The server
+ * splits the work across its math workers; the buffers must remain allocated
+ * until the result is collected with ipc_get_result() (status
+ * IPC_STATUS_INVALID_INPUT reports bad dimensions or buffers).
+ *
+ * @param[in]  m, n, k     Matrix dimensions (each 1..65536).
+ * @param[in]  dtype       Element type (IPC_DTYPE_INT32 or IPC_DTYPE_FLOAT32).
+ * @param[in]  a_off       Arena offset of A (m * k elements).
+ * @param[in]  b_off       Arena offset of B (k * n elements).
+ * @param[in]  c_off       Arena offset of the output C (m * n elements), or 0
+ *                         to have the server allocate it (see ipc_result_view()).
+ *                         C must not overlap A or B.
+ * @param[out] request_id  Pointer to store the assigned request ID.
  * @return 0 on success, -1 on error, IPC_ERR_SERVER_RESTARTED if the server
  *         restarted and this request context was invalidated.
  */
-int ipc_search(const char *haystack, const char *needle, uint64_t *request_id);
+int ipc_matmul(uint32_t m, uint32_t n, uint32_t k, ipc_dtype_t dtype,
+               uint64_t a_off, uint64_t b_off, uint64_t c_off,
+               uint64_t *request_id);
+
+/**
+ * @brief Sort an array of arena strings (non-blocking).
+ *
+ * Strings are compared bytewise; a proper prefix sorts first and equal
+ * strings keep their input order. The server writes the sorted permutation
+ * (indices into the reference table) to the output buffer and reports
+ * @c count in ResponsePayload::count.
+ *
+ * @param[in]  refs_off    Arena offset of @p count IpcStrRef entries.
+ * @param[in]  count       Number of strings (at least 1).
+ * @param[in]  out_off     Arena offset of @p count uint32_t outputs, or 0 to
+ *                         have the server allocate them (see ipc_result_view()).
+ * @param[out] request_id  Pointer to store the assigned request ID.
+ * @return 0 on success, -1 on error, IPC_ERR_SERVER_RESTARTED if the server
+ *         restarted and this request context was invalidated.
+ */
+int ipc_str_sort(uint64_t refs_off, uint32_t count, uint64_t out_off,
+                 uint64_t *request_id);
+
+/**
+ * @brief Find the distinct strings of an arena string array (non-blocking).
+ *
+ * The server writes the index of the first occurrence of every distinct
+ * string, in ascending order, and reports how many in ResponsePayload::count.
+ * Parameters are as for ipc_str_sort().
+ */
+int ipc_str_dedupe(uint64_t refs_off, uint32_t count, uint64_t out_off,
+                   uint64_t *request_id);
+
+/**
+ * @brief Hash every string of an arena string array (non-blocking).
+ *
+ * out[i] receives the hash of string i: CRC32C (Castagnoli, as in iSCSI)
+ * or xxHash32 with seed 0. Other parameters are as for ipc_str_sort().
+ *
+ * @param[in] algo  IPC_HASH_CRC32C or IPC_HASH_XXH32.
+ */
+int ipc_str_hash(uint64_t refs_off, uint32_t count, ipc_hash_t algo,
+                 uint64_t out_off, uint64_t *request_id);
+
+/**
+ * @brief Search for a regular expression in an arena haystack (non-blocking).
+ *
+ * The server compiles each distinct pattern once into a lazily built DFA and
+ * keeps it in an LRU cache (see `server --regex-cache=N`), so repeating a
+ * pattern costs no recompilation. Matching is bytewise and leftmost-longest;
+ * the span is returned in ResponsePayload::match. Status is
+ * IPC_STATUS_NOT_FOUND without a match, IPC_STATUS_STR_TOO_LONG for patterns
+ * over 1024 bytes and IPC_STATUS_INVALID_INPUT for bad syntax or buffers.
+ *
+ * @param[in]  pattern_off  Arena offset of the pattern bytes.
+ * @param[in]  pattern_len  Pattern length in bytes.
+ * @param[in]  hay_off      Arena offset of the haystack bytes.
+ * @param[in]  hay_len      Haystack length in bytes.
+ * @param[out] request_id   Pointer to store the assigned request ID.
+ * @return 0 on success, -1 on error, IPC_ERR_SERVER_RESTARTED if the server
+ *         restarted and this request context was invalidated.
+ */
+int ipc_regex_search(uint64_t pattern_off, uint32_t pattern_len,
+                     uint64_t hay_off, uint32_t hay_len, uint64_t *request_id);
+
+/**
+ * @brief Search one arena haystack for many needles at once (non-blocking).
+ *
+ * Replaces @p count separate IPC_CMD_SEARCH requests on the same haystack:
+ * one slot, one haystack copy, one pass. out[i] receives the first position
+ * of needle i, -1 if it does not occur, and 0 for an empty needle.
+ * ResponsePayload::count reports how many needles were found.
+ *
+ * @param[in]  hay_off     Arena offset of the haystack bytes.
+ * @param[in]  hay_len     Haystack length in bytes.
+ * @param[in]  refs_off    Arena offset of @p count IpcStrRef needle entries.
+ * @param[in]  count       Number of needles (at least 1).
+ * @param[in]  out_off     Arena offset of @p count int32_t outputs, or 0 to
+ *                         have the server allocate them (see ipc_result_view()).
+ * @param[out] request_id  Pointer to store the assigned request ID.
+ * @return 0 on success, -1 on error, IPC_ERR_SERVER_RESTARTED if the server
+ *         restarted and this request context was invalidated.
+ */
+int ipc_search_batch(uint64_t hay_off, uint32_t hay_len, uint64_t refs_off,
+                     uint32_t count, uint64_t out_off, uint64_t *request_id);
+
+/* ------------------------------------------------------------------ */
+/*  Streaming aggregation                                              */
+/* ------------------------------------------------------------------ */
+
+/**
+ * @brief Open a streaming aggregation channel (blocking).
+ *
+ * A stream is a shared single-producer ring of int32 values owned by the
+ * calling process. Values appended with ipc_stream_push() cost no slot or
+ * semaphore round trip; the server folds them into running aggregates
+ * (count, sum, mean, min, max, approximate p50/p90/p99) in the background.
+ *
+ * @param[out] stream_id  Handle of the opened stream (0..IPC_MAX_STREAMS-1).
+ * @return 0 on success, -1 on error or if all streams are in use,
+ *         IPC_ERR_SERVER_RESTARTED if the server restarted.
+ */
+int ipc_stream_open(uint32_t *stream_id);
+
+/**
+ * @brief Append values to a stream owned by this process (non-blocking).
+ *
+ * Copies as many values as fit in the ring (IPC_STREAM_CAPACITY) and
+ * reports how many were taken; callers retry the rest once the server has
+ * drained the ring.
+ *
+ * @param[in]  stream_id  Stream handle from ipc_stream_open().
+ * @param[in]  values     Values to append.
+ * @param[in]  count      Number of values.
+ * @param[out] accepted   Number of values appended (0..count).
+ * @return 0 on success, -1 on error (bad or closed stream),
+ *         IPC_ERR_SERVER_RESTARTED if the server restarted (the stream is gone).
+ */
+int ipc_stream_push(uint32_t stream_id, const int32_t *values, uint32_t count,
+                    uint32_t *accepted);
+
+/**
+ * @brief Snapshot a stream's aggregates (blocking).
+ *
+ * The snapshot covers every value pushed before the call. Any process may
+ * query any open stream.
+ *
+ * @return 0 on success, -1 on error, IPC_ERR_SERVER_RESTARTED if the server
+ *         restarted.
+ */
+int ipc_stream_query(uint32_t stream_id, StreamStats *stats);
+
+/**
+ * @brief Close a stream owned by this process (blocking).
+ *
+ * @param[out] final_stats  Optional final aggregates (may be NULL).
+ * @return 0 on success, -1 on error, IPC_ERR_SERVER_RESTARTED if the server
+ *         restarted.
+ */
+int ipc_stream_close(uint32_t stream_id, StreamStats *final_stats);
 
 /**
  * @brief Poll for the result of a non-blocking call.
@@ -130,13 +536,122 @@ int ipc_search(const char *haystack, const char *needle, uint64_t *request_id);
  * @param[in]  request_id  The request ID returned by the async call.
  * @param[out] result      Pointer to store the response payload.
  * @param[out] status      Pointer to store the response status code.
- * @return 0 if result is ready, IPC_NOT_READY if still processing,
- *         IPC_ERR_SERVER_RESTARTED if the server restarted and old request IDs
- *         were invalidated, -1 on other errors.
+ * @return 0 if result is ready, IPC_NOT_READY if still processing (or
+ *         resubmitted after a restart), IPC_ERR_SERVER_RESTARTED if the server
+ *         restarted and @p request_id was not journaled, -1 on other errors.
  */
 int ipc_get_result(uint64_t request_id, ResponsePayload *result,
                    ipc_status_t *status);
 
+/* ------------------------------------------------------------------ */
+/*  Batched submission and completion reaping                          */
+/* ------------------------------------------------------------------ */
+
+/** One request for ipc_submit_batch(). */
+typedef struct {
+    ipc_cmd_t      cmd;          /**< Command to run. */
+    RequestPayload request;      /**< Its arguments, as for the single calls. */
+    uint64_t       request_id;   /**< Out: assigned request ID. */
+} IpcSubmission;
+
+/** One finished request reported by ipc_reap(). */
+typedef struct {
+    uint64_t        request_id;
+    int32_t         rc;          /**< 0, or -1 if the request is unknown (lost). */
+    ipc_status_t    status;
+    ResponsePayload response;
+} IpcCompletion;
+
+/**
+ * @brief Submit several non-blocking requests at once.
+ *
+ * Claims free slots for @p subs in order under a single /ipc_mutex
+ * acquisition and wakes the server once. Submission stops when the slots or
+ * the restart journal run out, so the return value may be less than
+ * @p count; retry the rest after reaping. Arguments are not validated client-side; the server reports bad
+ * ones with IPC_STATUS_INVALID_INPUT.
+ *
+ * @param[in,out] subs   Requests; @c request_id is set for submitted ones.
+ * @param[in]     count  Number of entries in @p subs.
+ * @return Number of requests submitted (the first N of @p subs), -1 on error,
+ *         IPC_ERR_SERVER_RESTARTED if the server restarted.
+ */
+int ipc_submit_batch(IpcSubmission *subs, uint32_t count);
+
+/**
+ * @brief Collect whichever of @p request_ids have finished.
+ *
+ * Looks the IDs up under one /ipc_mutex acquisition. Each finished request
+ * is written to @p completions (in @p request_ids order) and its slot freed;
+ * unfinished ones are skipped. An ID that no longer has a slot is reported
+ * with @c rc -1, so callers never wait on it forever. Journaled requests
+ * survive a server restart (see the non-blocking calls); other IDs are then
+ * reported with @c rc -1.
+ *
+ * @param[in]  request_ids  Outstanding request IDs.
+ * @param[in]  count        Number of IDs.
+ * @param[out] completions  Room for @p count entries.
+ * @return Number of completions written, -1 on error.
+ */
+int ipc_reap(const uint64_t *request_ids, uint32_t count, IpcCompletion *completions);
+
+/* ------------------------------------------------------------------ */
+/*  Zero-copy result views                                             */
+/* ------------------------------------------------------------------ */
+
+/**
+ * @brief In-place view of a bulk result.
+ *
+ * Filled by ipc_result_view(). When the request asked the server for its
+ * output buffer (output offset 0), @c data points into the shared arena and
+ * @c handle names the buffer; otherwise both are 0/NULL and the output is in
+ * the caller's own buffer.
+ */
+typedef struct {
+    const void *data;    /**< Result bytes, valid until the last release. */
+    uint64_t    bytes;   /**< Size of the result buffer. */
+    uint32_t    count;   /**< ResponsePayload::count of the request. */
+    uint64_t    handle;  /**< Arena offset of the result buffer, 0 if none. */
+} IpcResultView;
+
+/**
+ * @brief Collect a bulk result without copying it (non-blocking poll).
+ *
+ * Like ipc_get_result(), but the output of ipc_matmul(), ipc_str_sort(),
+ * ipc_str_dedupe(), ipc_str_hash() or ipc_search_batch() called with an
+ * output offset of 0 is returned as a view of the server-allocated buffer.
+ * The slot is recycled immediately; the buffer stays until released. A full
+ * arena is reported as IPC_STATUS_BUSY.
+ *
+ * @param[in]  request_id  The request ID returned by the async call.
+ * @param[out] view        Filled in when the result is ready.
+ * @param[out] status      Pointer to store the response status code.
+ * @return As for ipc_get_result().
+ */
+int ipc_result_view(uint64_t request_id, IpcResultView *view, ipc_status_t *status);
+
+/**
+ * @brief Take another reference to a result buffer.
+ *
+ * Lets several threads hold the same result; each reference is dropped with
+ * ipc_result_view_release() on its own copy of the view. References are
+ * tied to the requesting process: its buffers are reclaimed once it exits.
+ *
+ * @return 0 on success, -1 if the view holds no live buffer.
+ */
+int ipc_result_view_retain(const IpcResultView *view);
+
+/**
+ * @brief Drop a reference to a result buffer and clear @p view.
+ *
+ * The buffer returns to the arena with its last reference. Releasing a view
+ * without a buffer is a no-op.
+ *
+ * @return 0 on success, -1 if the buffer is not live (e.g. already fully
+ *         released or the server restarted).
+ */
+int ipc_result_view_release(IpcResultView *view);
+
 #ifdef __cplusplus
 }
 #endif
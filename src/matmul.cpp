@@ -0,0 +1,175 @@
+/**
+ * @file matmul.cpp
+ * @brief Matrix multiply kernels: packed B blocks feeding 4 x 16 register tiles.
+ *
+ * Blocking scheme (per worker, over its band of rows):
+ *   - B is processed in kKC x kNC blocks that are packed into kNR-wide,
+ *     depth-major column panels (zero padded on the right edge);
+ *   - each 4-row slice of A is multiplied against every panel by a register
+ *     tile of 4 x 16 accumulators, written with GCC vector extensions so the
+ *     same source yields SSE2 or AVX2 code.
+ * On x86-64 the entry points are built twice (baseline and AVX2) and the
+ * dynamic loader picks the best clone for the running CPU.
+ */
+#include "matmul.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define IPC_KERNEL_CLONES __attribute__((target_clones("avx2", "default")))
+#else
+#define IPC_KERNEL_CLONES
+#endif
+
+#define IPC_ALWAYS_INLINE inline __attribute__((always_inline))
+
+namespace {
+
+typedef uint32_t u32x8 __attribute__((vector_size(32)));
+typedef float    f32x8 __attribute__((vector_size(32)));
+
+constexpr uint32_t kLanes = 8;            // elements per vector
+constexpr uint32_t kMR = 4;               // rows per register tile
+constexpr uint32_t kNR = 2 * kLanes;      // columns per register tile
+constexpr uint32_t kKC = 256;             // depth of a packed B block
+constexpr uint32_t kNC = 256;             // width of a packed B block
+
+// Vectors travel by reference: passing 32-byte vectors by value would make
+// the baseline (non-AVX) clone ABI-dependent.
+template <typename V, typename T>
+IPC_ALWAYS_INLINE void load_vec(V &v, const T *p)
+{
+    memcpy(&v, p, sizeof(v));
+}
+
+template <typename V, typename T>
+IPC_ALWAYS_INLINE void store_vec(T *p, const V &v)
+{
+    memcpy(p, &v, sizeof(v));
+}
+
+/*
+ * Pack B[k0 .. k0+kc) x [j0 .. j0+nc) into kNR-wide column panels. Panel jp
+ * starts at packed + jp * kc and stores kNR consecutive elements per depth
+ * step, so the micro-kernel streams it linearly.
+ */
+template <typename T>
+IPC_ALWAYS_INLINE void pack_b(const T *b, uint32_t n, uint32_t k0, uint32_t kc,
+                              uint32_t j0, uint32_t nc, T *packed)
+{
+    for (uint32_t jp = 0; jp < nc; jp += kNR) {
+        uint32_t width = std::min(kNR, nc - jp);
+        T *panel = packed + static_cast<size_t>(jp) * kc;
+        for (uint32_t p = 0; p < kc; ++p) {
+            const T *src = b + static_cast<size_t>(k0 + p) * n + j0 + jp;
+            T *dst = panel + static_cast<size_t>(p) * kNR;
+            uint32_t j = 0;
+            for (; j < width; ++j)
+                dst[j] = src[j];
+            for (; j < kNR; ++j)
+                dst[j] = T(0);
+        }
+    }
+}
+
+/*
+ * C[mr x nr] (+)= A[mr x kc] * panel[kc x kNR]. Rows past mr alias the last
+ * valid row so the tile is always full width; their results are dropped.
+ */
+template <typename V, typename T>
+IPC_ALWAYS_INLINE void micro_kernel(uint32_t kc, const T *a, uint32_t lda,
+                                    uint32_t mr, const T *panel,
+                                    T *c, uint32_t ldc, uint32_t nr,
+                                    bool accumulate)
+{
+    const T *arow[kMR];
+    for (uint32_t r = 0; r < kMR; ++r)
+        arow[r] = a + static_cast<size_t>(std::min(r, mr - 1)) * lda;
+
+    V acc[kMR][2] = {};
+    for (uint32_t p = 0; p < kc; ++p) {
+        V b0, b1;
+        load_vec(b0, panel + static_cast<size_t>(p) * kNR);
+        load_vec(b1, panel + static_cast<size_t>(p) * kNR + kLanes);
+        for (uint32_t r = 0; r < kMR; ++r) {
+            T av = arow[r][p];
+            acc[r][0] += av * b0;
+            acc[r][1] += av * b1;
+        }
+    }
+
+    for (uint32_t r = 0; r < mr; ++r) {
+        T *crow = c + static_cast<size_t>(r) * ldc;
+        if (nr == kNR) {
+            if (accumulate) {
+                V c0, c1;
+                load_vec(c0, crow);
+                load_vec(c1, crow + kLanes);
+                acc[r][0] += c0;
+                acc[r][1] += c1;
+            }
+            store_vec(crow, acc[r][0]);
+            store_vec(crow + kLanes, acc[r][1]);
+            continue;
+        }
+        T tile[kNR];
+        store_vec(tile, acc[r][0]);
+        store_vec(tile + kLanes, acc[r][1]);
+        for (uint32_t j = 0; j < nr; ++j)
+            crow[j] = accumulate ? crow[j] + tile[j] : tile[j];
+    }
+}
+
+template <typename V, typename T>
+IPC_ALWAYS_INLINE void matmul_rows(const T *a, const T *b, T *c,
+                                   uint32_t n, uint32_t k,
+                                   uint32_t row_begin, uint32_t row_end)
+{
+    // One packing buffer per worker thread, reused across requests.
+    thread_local std::vector<T> packed;
+    packed.resize(static_cast<size_t>(kKC) * kNC);
+
+    for (uint32_t j0 = 0; j0 < n; j0 += kNC) {
+        uint32_t nc = std::min(kNC, n - j0);
+        for (uint32_t k0 = 0; k0 < k; k0 += kKC) {
+            uint32_t kc = std::min(kKC, k - k0);
+            pack_b(b, n, k0, kc, j0, nc, packed.data());
+            for (uint32_t i = row_begin; i < row_end; i += kMR) {
+                uint32_t mr = std::min(kMR, row_end - i);
+                const T *a_tile = a + static_cast<size_t>(i) * k + k0;
+                T *c_row = c + static_cast<size_t>(i) * n + j0;
+                for (uint32_t jp = 0; jp < nc; jp += kNR) {
+                    micro_kernel<V>(kc, a_tile, k, mr,
+                                    packed.data() + static_cast<size_t>(jp) * kc,
+                                    c_row + jp, n, std::min(kNR, nc - jp),
+                                    k0 != 0);
+                }
+            }
+        }
+    }
+}
+
+} // namespace
+
+IPC_KERNEL_CLONES
+void matmul_rows_i32(const int32_t *a, const int32_t *b, int32_t *c,
+                     uint32_t n, uint32_t k,
+                     uint32_t row_begin, uint32_t row_end)
+{
+    // Unsigned lanes give well-defined wrap-around on overflow.
+    matmul_rows<u32x8>(reinterpret_cast<const uint32_t *>(a),
+                       reinterpret_cast<const uint32_t *>(b),
+                       reinterpret_cast<uint32_t *>(c),
+                       n, k, row_begin, row_end);
+}
+
+IPC_KERNEL_CLONES
+void matmul_rows_f32(const float *a, const float *b, float *c,
+                     uint32_t n, uint32_t k,
+                     uint32_t row_begin, uint32_t row_end)
+{
+    matmul_rows<f32x8>(a, b, c, n, k, row_begin, row_end);
+}
@@ -0,0 +1,33 @@
+/**
+ * @file matmul.h
+ * @brief Cache-blocked, SIMD-vectorized matrix multiply kernels (server side).
+ *
+ * The kernels compute a horizontal band of rows of C = A * B so that one
+ * IPC_CMD_MATMUL request can be split across several math_pool workers.
+ * All matrices are dense and row-major.
+ */
+#ifndef MATMUL_H
+#define MATMUL_H
+
+#include <cstdint>
+
+/** Row granularity used when splitting a multiply into parallel parts. */
+constexpr uint32_t kMatmulRowsPerPart = 64;
+
+/**
+ * @brief Compute rows [row_begin, row_end) of C[m x n] = A[m x k] * B[k x n].
+ *
+ * Int32 arithmetic wraps on overflow (two's complement).
+ */
+void matmul_rows_i32(const int32_t *a, const int32_t *b, int32_t *c,
+                     uint32_t n, uint32_t k,
+                     uint32_t row_begin, uint32_t row_end);
+
+/**
+ * @brief Float32 variant of matmul_rows_i32().
+ */
+void matmul_rows_f32(const float *a, const float *b, float *c,
+                     uint32_t n, uint32_t k,
+                     uint32_t row_begin, uint32_t row_end);
+
+#endif /* MATMUL_H */
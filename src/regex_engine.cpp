@@ -0,0 +1,837 @@
+/**
+ * @file regex_engine.cpp
+ * @brief Regex parser, Thompson NFA compiler, lazy DFA search and LRU cache.
+ *
+ * Program layout: instructions 0..2 form an unanchored prefix loop
+ * (`Split 1,3; Byte any; Jmp 0`), the pattern starts at 3 and ends in Match.
+ * Byte/Begin/End fall through to pc + 1. Every Regex also carries the
+ * reversed pattern (concatenations reversed, `^` and `$` swapped), which the
+ * search runs backwards over the text to find where the leftmost match starts.
+ *
+ * The DFA alphabet is the set of byte equivalence classes induced by the
+ * pattern's byte sets, so a transition row has one entry per class rather
+ * than per byte. When the DFA grows past kMaxDfaStates the cache is flushed
+ * and rebuilt from the current state, which bounds memory for patterns with
+ * exponential DFAs.
+ */
+#include "regex_engine.h"
+
+#include <algorithm>
+#include <array>
+#include <utility>
+
+namespace {
+
+constexpr size_t   kMaxProgramSize = 16384;
+constexpr size_t   kMaxDfaStates = 4096;
+constexpr int      kMaxNesting = 200;
+constexpr int      kMaxRepeat = 1000;
+constexpr int32_t  kUnbuilt = -1;
+
+using ByteSet = std::array<uint64_t, 4>;
+
+inline void set_add(ByteSet &s, uint8_t b) { s[b >> 6] |= uint64_t{1} << (b & 63); }
+inline bool set_has(const ByteSet &s, uint8_t b) { return (s[b >> 6] >> (b & 63)) & 1u; }
+
+inline void set_add_range(ByteSet &s, int lo, int hi)
+{
+    for (int b = lo; b <= hi; ++b)
+        set_add(s, static_cast<uint8_t>(b));
+}
+
+inline ByteSet set_not(const ByteSet &s)
+{
+    return ByteSet{~s[0], ~s[1], ~s[2], ~s[3]};
+}
+
+inline void set_union(ByteSet &dst, const ByteSet &src)
+{
+    for (int i = 0; i < 4; ++i)
+        dst[i] |= src[i];
+}
+
+ByteSet set_of(const char *bytes)
+{
+    ByteSet s{};
+    for (; *bytes; ++bytes)
+        set_add(s, static_cast<uint8_t>(*bytes));
+    return s;
+}
+
+ByteSet digit_set()
+{
+    ByteSet s{};
+    set_add_range(s, '0', '9');
+    return s;
+}
+
+ByteSet word_set()
+{
+    ByteSet s = digit_set();
+    set_add_range(s, 'a', 'z');
+    set_add_range(s, 'A', 'Z');
+    set_add(s, '_');
+    return s;
+}
+
+ByteSet space_set() { return set_of(" \t\n\r\f\v"); }
+
+/* ------------------------------------------------------------------ */
+/*  AST                                                                */
+/* ------------------------------------------------------------------ */
+
+enum class NodeKind { Empty, Bytes, Begin, End, Concat, Alt, Repeat };
+
+struct Node {
+    explicit Node(NodeKind k) : kind(k) {}
+
+    NodeKind kind;
+    ByteSet  set{};          // Bytes
+    std::vector<int> kids;   // Concat/Alt: operands, Repeat: one child
+    int min = 0;             // Repeat bounds; max < 0 means unbounded
+    int max = 0;
+};
+
+int hex_value(uint8_t c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+/* Recursive-descent parser: alt := concat ('|' concat)*, concat := repeat*. */
+class Parser {
+public:
+    Parser(const uint8_t *p, size_t len) : p_(p), end_(p + len) {}
+
+    bool parse(std::vector<Node> &nodes, int &root)
+    {
+        nodes_ = &nodes;
+        root = parse_alt(0);
+        return ok_ && p_ == end_;
+    }
+
+private:
+    int add(Node n)
+    {
+        nodes_->push_back(std::move(n));
+        return static_cast<int>(nodes_->size()) - 1;
+    }
+
+    int fail()
+    {
+        ok_ = false;
+        return add(Node{NodeKind::Empty});
+    }
+
+    bool at(char c) const { return p_ < end_ && *p_ == static_cast<uint8_t>(c); }
+
+    int parse_alt(int depth)
+    {
+        if (depth > kMaxNesting)
+            return fail();
+        Node alt{NodeKind::Alt};
+        alt.kids.push_back(parse_concat(depth));
+        while (ok_ && at('|')) {
+            ++p_;
+            alt.kids.push_back(parse_concat(depth));
+        }
+        if (alt.kids.size() == 1)
+            return alt.kids[0];
+        return add(std::move(alt));
+    }
+
+    int parse_concat(int depth)
+    {
+        Node cat{NodeKind::Concat};
+        while (ok_ && p_ < end_ && !at('|') && !at(')'))
+            cat.kids.push_back(parse_repeat(depth));
+        if (cat.kids.empty())
+            return add(Node{NodeKind::Empty});
+        if (cat.kids.size() == 1)
+            return cat.kids[0];
+        return add(std::move(cat));
+    }
+
+    /* Parses "{m}", "{m,}" or "{m,n}"; leaves p_ untouched if not a bound. */
+    bool parse_bound(int &min, int &max)
+    {
+        const uint8_t *q = p_ + 1;
+        auto number = [&](int &out) {
+            if (q >= end_ || *q < '0' || *q > '9')
+                return false;
+            out = 0;
+            while (q < end_ && *q >= '0' && *q <= '9') {
+                out = out * 10 + (*q++ - '0');
+                if (out > kMaxRepeat)
+                    return false;
+            }
+            return true;
+        };
+        if (!number(min))
+            return false;
+        max = min;
+        if (q < end_ && *q == ',') {
+            ++q;
+            max = -1;
+            if (q < end_ && *q != '}' && !number(max))
+                return false;
+        }
+        if (q >= end_ || *q != '}')
+            return false;
+        p_ = q + 1;
+        return true;
+    }
+
+    int parse_repeat(int depth)
+    {
+        int atom = parse_atom(depth);
+        while (ok_ && p_ < end_) {
+            Node rep{NodeKind::Repeat};
+            if (at('*')) {
+                rep.min = 0; rep.max = -1; ++p_;
+            } else if (at('+')) {
+                rep.min = 1; rep.max = -1; ++p_;
+            } else if (at('?')) {
+                rep.min = 0; rep.max = 1; ++p_;
+            } else if (at('{') && parse_bound(rep.min, rep.max)) {
+                if (rep.max >= 0 && rep.max < rep.min)
+                    return fail();
+            } else {
+                break;
+            }
+            if (at('?'))
+                ++p_;   // lazy form: same language, longest match anyway
+            NodeKind k = (*nodes_)[atom].kind;
+            if (k == NodeKind::Begin || k == NodeKind::End)
+                return fail();
+            rep.kids.push_back(atom);
+            atom = add(std::move(rep));
+        }
+        return atom;
+    }
+
+    /* Escape after a backslash; fills @p set. Returns false on error. */
+    bool parse_escape(ByteSet &set)
+    {
+        if (p_ >= end_)
+            return false;
+        uint8_t c = *p_++;
+        switch (c) {
+        case 'd': set = digit_set(); return true;
+        case 'D': set = set_not(digit_set()); return true;
+        case 'w': set = word_set(); return true;
+        case 'W': set = set_not(word_set()); return true;
+        case 's': set = space_set(); return true;
+        case 'S': set = set_not(space_set()); return true;
+        case 't': set = ByteSet{}; set_add(set, '\t'); return true;
+        case 'n': set = ByteSet{}; set_add(set, '\n'); return true;
+        case 'r': set = ByteSet{}; set_add(set, '\r'); return true;
+        case 'f': set = ByteSet{}; set_add(set, '\f'); return true;
+        case 'v': set = ByteSet{}; set_add(set, '\v'); return true;
+        case 'x': {
+            if (end_ - p_ < 2)
+                return false;
+            int hi = hex_value(p_[0]);
+            int lo = hex_value(p_[1]);
+            if (hi < 0 || lo < 0)
+                return false;
+            p_ += 2;
+            set = ByteSet{};
+            set_add(set, static_cast<uint8_t>(hi * 16 + lo));
+            return true;
+        }
+        default:
+            // Only punctuation may be escaped literally; unknown letter or
+            // digit escapes are reserved.
+            if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9'))
+                return false;
+            set = ByteSet{};
+            set_add(set, c);
+            return true;
+        }
+    }
+
+    int parse_class()
+    {
+        ByteSet set{};
+        bool negate = at('^');
+        if (negate)
+            ++p_;
+        bool first = true;
+        while (p_ < end_ && (first || !at(']'))) {
+            first = false;
+            ByteSet item{};
+            int lo = 0;
+            if (at('\\')) {
+                ++p_;
+                if (!parse_escape(item))
+                    return fail();
+                int count = 0;
+                for (int b = 0; b < 256; ++b) {
+                    if (set_has(item, static_cast<uint8_t>(b))) {
+                        lo = b;
+                        ++count;
+                    }
+                }
+                if (count != 1) {
+                    set_union(set, item);   // \d, \w, ... cannot start a range
+                    continue;
+                }
+            } else {
+                lo = *p_++;
+            }
+            if (p_ + 1 < end_ && at('-') && p_[1] != ']') {
+                ++p_;
+                int hi;
+                if (at('\\')) {
+                    ++p_;
+                    ByteSet hi_set{};
+                    if (!parse_escape(hi_set))
+                        return fail();
+                    hi = -1;
+                    for (int b = 0; b < 256; ++b) {
+                        if (set_has(hi_set, static_cast<uint8_t>(b))) {
+                            if (hi >= 0)
+                                return fail();
+                            hi = b;
+                        }
+                    }
+                } else {
+                    hi = *p_++;
+                }
+                if (hi < lo)
+                    return fail();
+                set_add_range(set, lo, hi);
+            } else {
+                set_add(set, static_cast<uint8_t>(lo));
+            }
+        }
+        if (!at(']'))
+            return fail();
+        ++p_;
+        Node n{NodeKind::Bytes};
+        n.set = negate ? set_not(set) : set;
+        return add(std::move(n));
+    }
+
+    int parse_atom(int depth)
+    {
+        uint8_t c = *p_++;
+        Node n{NodeKind::Bytes};
+        switch (c) {
+        case '(': {
+            if (end_ - p_ >= 2 && p_[0] == '?' && p_[1] == ':')
+                p_ += 2;
+            int inner = parse_alt(depth + 1);
+            if (!at(')'))
+                return fail();
+            ++p_;
+            return inner;
+        }
+        case '[':
+            return parse_class();
+        case '.':
+            n.set = set_not(set_of("\n"));
+            return add(std::move(n));
+        case '^':
+            return add(Node{NodeKind::Begin});
+        case '$':
+            return add(Node{NodeKind::End});
+        case '\\':
+            if (!parse_escape(n.set))
+                return fail();
+            return add(std::move(n));
+        case '*':
+        case '+':
+        case '?':
+        case ')':
+            return fail();   // nothing to repeat / unbalanced
+        default:
+            set_add(n.set, c);
+            return add(std::move(n));
+        }
+    }
+
+    const uint8_t *p_;
+    const uint8_t *end_;
+    std::vector<Node> *nodes_ = nullptr;
+    bool ok_ = true;
+};
+
+} // namespace
+
+/* ------------------------------------------------------------------ */
+/*  Compiler                                                           */
+/* ------------------------------------------------------------------ */
+
+class RegexCompiler {
+public:
+    RegexCompiler(Regex &re, const std::vector<Node> &nodes, bool reversed)
+        : re_(re), nodes_(nodes), reversed_(reversed) {}
+
+    /* Program for the pattern rooted at @p root, or nullptr if it is too large. */
+    static std::unique_ptr<Regex> build(const std::vector<Node> &nodes, int root, bool reversed);
+
+    bool emit(int id)
+    {
+        if (re_.prog_.size() > kMaxProgramSize)
+            return false;
+        const Node &n = nodes_[id];
+        switch (n.kind) {
+        case NodeKind::Empty:
+            return true;
+        case NodeKind::Bytes:
+            push(Regex::Op::Byte, byte_set_index(n.set));
+            return true;
+        case NodeKind::Begin:
+            push(reversed_ ? Regex::Op::End : Regex::Op::Begin);
+            return true;
+        case NodeKind::End:
+            push(reversed_ ? Regex::Op::Begin : Regex::Op::End);
+            return true;
+        case NodeKind::Concat:
+            for (size_t i = 0; i < n.kids.size(); ++i) {
+                if (!emit(n.kids[reversed_ ? n.kids.size() - 1 - i : i]))
+                    return false;
+            }
+            return true;
+        case NodeKind::Alt: {
+            // Split L1, next; L1: a; Jmp end; next: Split L2, ...; last alternative.
+            std::vector<int32_t> jumps;
+            for (size_t i = 0; i + 1 < n.kids.size(); ++i) {
+                int32_t split = push(Regex::Op::Split);
+                re_.prog_[split].x = pc();
+                if (!emit(n.kids[i]))
+                    return false;
+                jumps.push_back(push(Regex::Op::Jmp));
+                re_.prog_[split].y = pc();
+            }
+            if (!emit(n.kids.back()))
+                return false;
+            for (int32_t j : jumps)
+                re_.prog_[j].x = pc();
+            return true;
+        }
+        case NodeKind::Repeat:
+            return emit_repeat(n.kids[0], n.min, n.max);
+        }
+        return false;
+    }
+
+    int32_t push(Regex::Op op, uint16_t set = 0)
+    {
+        re_.prog_.push_back(Regex::Inst{op, set, 0, 0});
+        return pc() - 1;
+    }
+
+private:
+    int32_t pc() const { return static_cast<int32_t>(re_.prog_.size()); }
+
+    uint16_t byte_set_index(const ByteSet &set)
+    {
+        auto &sets = re_.byte_sets_;
+        for (size_t i = 0; i < sets.size(); ++i) {
+            if (sets[i] == set)
+                return static_cast<uint16_t>(i);
+        }
+        sets.push_back(set);
+        return static_cast<uint16_t>(sets.size() - 1);
+    }
+
+    bool emit_repeat(int kid, int min, int max)
+    {
+        for (int i = 0; i < min; ++i) {
+            if (!emit(kid))
+                return false;
+        }
+        if (max < 0) {
+            // L: Split body, out; body; Jmp L; out:
+            int32_t split = push(Regex::Op::Split);
+            re_.prog_[split].x = pc();
+            if (!emit(kid))
+                return false;
+            int32_t jmp = push(Regex::Op::Jmp);
+            re_.prog_[jmp].x = split;
+            re_.prog_[split].y = pc();
+            return true;
+        }
+        // Optional copies: Split body, out; body; ... all outs jump past the end.
+        std::vector<int32_t> splits;
+        for (int i = min; i < max; ++i) {
+            int32_t split = push(Regex::Op::Split);
+            re_.prog_[split].x = pc();
+            splits.push_back(split);
+            if (!emit(kid))
+                return false;
+        }
+        for (int32_t s : splits)
+            re_.prog_[s].y = pc();
+        return true;
+    }
+
+    Regex &re_;
+    const std::vector<Node> &nodes_;
+    bool reversed_;
+};
+
+std::unique_ptr<Regex> RegexCompiler::build(const std::vector<Node> &nodes, int root,
+                                            bool reversed)
+{
+    using Op = Regex::Op;
+    std::unique_ptr<Regex> re(new Regex());
+    RegexCompiler compiler(*re, nodes, reversed);
+
+    // Unanchored prefix loop shared by every search.
+    ByteSet any{~uint64_t{0}, ~uint64_t{0}, ~uint64_t{0}, ~uint64_t{0}};
+    re->byte_sets_.push_back(any);
+    int32_t loop = compiler.push(Op::Split);
+    compiler.push(Op::Byte, 0);
+    int32_t back = compiler.push(Op::Jmp);
+    re->prog_[back].x = loop;
+    re->prog_[loop].x = loop + 1;
+    re->prog_[loop].y = back + 1;
+    re->unanchored_entry_ = loop;
+    re->anchored_entry_ = back + 1;
+
+    if (!compiler.emit(root) || re->prog_.size() >= kMaxProgramSize)
+        return nullptr;
+    compiler.push(Op::Match);
+
+    re->build_byte_classes();
+    re->flush_dfa();
+    return re;
+}
+
+std::unique_ptr<Regex> Regex::compile(const uint8_t *pattern, size_t len)
+{
+    if (len > kRegexMaxPatternLen)
+        return nullptr;
+
+    std::vector<Node> nodes;
+    int root = 0;
+    Parser parser(pattern, len);
+    if (!parser.parse(nodes, root))
+        return nullptr;
+
+    std::unique_ptr<Regex> re = RegexCompiler::build(nodes, root, false);
+    if (!re)
+        return nullptr;
+    re->reverse_ = RegexCompiler::build(nodes, root, true);
+    if (!re->reverse_)
+        return nullptr;
+    return re;
+}
+
+/* ------------------------------------------------------------------ */
+/*  Lazy DFA                                                           */
+/* ------------------------------------------------------------------ */
+
+void Regex::build_byte_classes()
+{
+    // Refine the partition of 0..255 by every byte set used in the program.
+    byte_class_.fill(0);
+    num_classes_ = 1;
+    for (const ByteSet &set : byte_sets_) {
+        std::array<int, 512> remap;
+        remap.fill(-1);
+        uint32_t next = 0;
+        for (int b = 0; b < 256; ++b) {
+            int key = byte_class_[b] * 2 + (set_has(set, static_cast<uint8_t>(b)) ? 1 : 0);
+            if (remap[key] < 0)
+                remap[key] = static_cast<int>(next++);
+            byte_class_[b] = static_cast<uint8_t>(remap[key]);
+        }
+        num_classes_ = next;
+    }
+}
+
+void Regex::add_closure(std::vector<int32_t> &out, std::vector<uint32_t> &seen,
+                        int32_t pc, bool at_begin, bool at_end) const
+{
+    // Iterative DFS; seen[] marks visited instructions for this closure.
+    std::vector<int32_t> stack{pc};
+    while (!stack.empty()) {
+        int32_t cur = stack.back();
+        stack.pop_back();
+        if (seen[cur])
+            continue;
+        seen[cur] = 1;
+        const Inst &in = prog_[cur];
+        switch (in.op) {
+        case Op::Byte:
+        case Op::Match:
+            out.push_back(cur);
+            break;
+        case Op::Split:
+            stack.push_back(in.y);
+            stack.push_back(in.x);
+            break;
+        case Op::Jmp:
+            stack.push_back(in.x);
+            break;
+        case Op::Begin:
+            if (at_begin)
+                stack.push_back(cur + 1);
+            break;
+        case Op::End:
+            if (at_end)
+                stack.push_back(cur + 1);
+            else
+                out.push_back(cur);   // may still succeed at end of text
+            break;
+        }
+    }
+}
+
+void Regex::flush_dfa()
+{
+    states_.clear();
+    accepting_.clear();
+    trans_.clear();
+    index_.clear();
+    for (auto &row : starts_)
+        row[0] = row[1] = kUnbuilt;
+    dead_ = intern({});
+}
+
+int32_t Regex::intern(std::vector<int32_t> &&insts)
+{
+    std::sort(insts.begin(), insts.end());
+    auto it = index_.find(insts);
+    if (it != index_.end())
+        return it->second;
+
+    DState st;
+    st.accept = std::any_of(insts.begin(), insts.end(),
+                            [this](int32_t pc) { return prog_[pc].op == Op::Match; });
+    st.end_accept[0] = st.end_accept[1] = -1;
+    st.insts = insts;
+    int32_t id = static_cast<int32_t>(states_.size());
+    accepting_.push_back(st.accept ? 1 : 0);
+    states_.push_back(std::move(st));
+    trans_.resize(trans_.size() + num_classes_, kUnbuilt);
+    index_.emplace(std::move(insts), id);
+    return id;
+}
+
+int32_t Regex::start_state(bool anchored, bool at_begin)
+{
+    int32_t &slot = starts_[anchored][at_begin];
+    if (slot == kUnbuilt) {
+        std::vector<int32_t> insts;
+        std::vector<uint32_t> seen(prog_.size(), 0);
+        add_closure(insts, seen, anchored ? anchored_entry_ : unanchored_entry_,
+                    at_begin, false);
+        slot = intern(std::move(insts));
+    }
+    return slot;
+}
+
+int32_t Regex::step(int32_t state, uint8_t byte)
+{
+    size_t cell = static_cast<size_t>(state) * num_classes_ + byte_class_[byte];
+    int32_t next;
+    std::vector<int32_t> insts;
+    std::vector<uint32_t> seen(prog_.size(), 0);
+    for (int32_t pc : states_[state].insts) {
+        const Inst &in = prog_[pc];
+        if (in.op == Op::Byte && set_has(byte_sets_[in.byte_set], byte))
+            add_closure(insts, seen, pc + 1, false, false);
+    }
+
+    if (states_.size() >= kMaxDfaStates) {
+        // Out of budget: start over. The caller only keeps the returned id.
+        flush_dfa();
+        return intern(std::move(insts));
+    }
+    next = intern(std::move(insts));
+    trans_[cell] = tag(next);
+    return next;
+}
+
+bool Regex::accepts_at_end(int32_t state, bool text_empty)
+{
+    int8_t &memo = states_[state].end_accept[text_empty];
+    if (memo < 0) {
+        bool ok = states_[state].accept;
+        std::vector<int32_t> insts;
+        std::vector<uint32_t> seen(prog_.size(), 0);
+        for (int32_t pc : states_[state].insts) {
+            if (!ok && prog_[pc].op == Op::End)
+                add_closure(insts, seen, pc + 1, text_empty, true);
+        }
+        for (int32_t pc : insts)
+            ok = ok || prog_[pc].op == Op::Match;
+        memo = ok ? 1 : 0;
+    }
+    return memo == 1;
+}
+
+bool Regex::search(const uint8_t *text, size_t len, size_t *match_pos, size_t *match_len)
+{
+    std::scoped_lock lock(mutex_);
+    const bool text_empty = (len == 0);
+
+    // Pass 1: unanchored scan for the earliest position where any match ends.
+    // This is the only pass for texts without a match.
+    int32_t s = tag(start_state(false, true));
+    size_t earliest_end = len + 1;
+    if (s & 1) {
+        earliest_end = 0;
+    } else {
+        for (size_t i = 0; i < len; ++i) {
+            s = next_tagged(s, text[i]);
+            if (s & 1) {
+                earliest_end = i + 1;
+                break;
+            }
+        }
+        if (earliest_end > len && accepts_at_end(untag(s), text_empty))
+            earliest_end = len;
+    }
+    if (earliest_end > len)
+        return false;
+
+    // Pass 2: the reversed pattern, run unanchored from the end of the text
+    // back to its start, accepts exactly where some match begins. The last
+    // acceptance is the leftmost start. It cannot stop at earliest_end: the
+    // leftmost match may end later (`abcd|c` on "abcd").
+    Regex &rev = *reverse_;
+    s = rev.tag(rev.start_state(false, true));
+    size_t start = (s & 1) ? len : len + 1;
+    for (size_t i = len; i > 0; --i) {
+        s = rev.next_tagged(s, text[i - 1]);
+        if (s & 1)
+            start = i - 1;
+    }
+    if (rev.accepts_at_end(rev.untag(s), text_empty))
+        start = 0;
+    if (start > len)
+        return false;   // unreachable: pass 1 proved a match exists
+
+    // Pass 3: one anchored run from that start for the longest match.
+    const int32_t dead = tag(dead_);
+    s = tag(start_state(true, start == 0));
+    size_t best = (s & 1) ? start : len + 1;
+    size_t i = start;
+    for (; i < len; ++i) {
+        s = next_tagged(s, text[i]);
+        if (s == dead)
+            break;
+        if (s & 1)
+            best = i + 1;
+    }
+    if (i == len && accepts_at_end(untag(s), text_empty))
+        best = len;
+    if (best > len)
+        return false;   // unreachable: pass 2 found a match starting here
+    *match_pos = start;
+    *match_len = best - start;
+    return true;
+}
+
+size_t Regex::dfa_states() const
+{
+    std::scoped_lock lock(mutex_);
+    return states_.size();
+}
+
+/* ------------------------------------------------------------------ */
+/*  RegexCache                                                         */
+/* ------------------------------------------------------------------ */
+
+void RegexCache::set_capacity(size_t capacity)
+{
+    std::scoped_lock lock(mutex_);
+    capacity_.store(capacity, std::memory_order_relaxed);
+    evict_locked();
+}
+
+void RegexCache::evict_locked()
+{
+    while (lru_.size() > capacity_.load(std::memory_order_relaxed)) {
+        map_.erase(lru_.back().first);
+        lru_.pop_back();
+    }
+    size_.store(lru_.size(), std::memory_order_relaxed);
+}
+
+std::shared_ptr<Regex> RegexCache::get(const std::string &pattern)
+{
+    {
+        std::scoped_lock lock(mutex_);
+        auto it = map_.find(pattern);
+        if (it != map_.end()) {
+            hits_.fetch_add(1, std::memory_order_relaxed);
+            lru_.splice(lru_.begin(), lru_, it->second);
+            return it->second->second;
+        }
+        misses_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Compile without the lock; a concurrent miss on the same pattern
+    // compiles twice and the first insertion wins.
+    std::shared_ptr<Regex> re = Regex::compile(
+        reinterpret_cast<const uint8_t *>(pattern.data()), pattern.size());
+
+    std::scoped_lock lock(mutex_);
+    if (capacity_.load(std::memory_order_relaxed) == 0)
+        return re;
+    auto it = map_.find(pattern);
+    if (it != map_.end())
+        return it->second->second;
+    lru_.emplace_front(pattern, re);
+    map_.emplace(pattern, lru_.begin());
+    evict_locked();
+    return re;
+}
+
+std::vector<std::string> RegexCache::patterns() const
+{
+    std::scoped_lock lock(mutex_);
+    std::vector<std::string> out;
+    out.reserve(lru_.size());
+    for (const Entry &e : lru_)
+        out.push_back(e.first);
+    return out;
+}
+
+size_t RegexCache::preload(const std::vector<std::string> &patterns)
+{
+    size_t inserted = 0;
+    // Least recently used first, so the most recent one ends up at the front.
+    for (auto p = patterns.rbegin(); p != patterns.rend(); ++p) {
+        std::shared_ptr<Regex> re = Regex::compile(
+            reinterpret_cast<const uint8_t *>(p->data()), p->size());
+        std::scoped_lock lock(mutex_);
+        if (capacity_.load(std::memory_order_relaxed) == 0 || map_.count(*p) != 0)
+            continue;
+        lru_.emplace_front(*p, re);
+        map_.emplace(*p, lru_.begin());
+        evict_locked();
+        ++inserted;
+    }
+    return inserted;
+}
+
+size_t RegexCache::size() const
+{
+    return size_.load(std::memory_order_relaxed);
+}
+
+size_t RegexCache::capacity() const
+{
+    return capacity_.load(std::memory_order_relaxed);
+}
+
+uint64_t RegexCache::hits() const
+{
+    return hits_.load(std::memory_order_relaxed);
+}
+
+uint64_t RegexCache::misses() const
+{
+    return misses_.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,175 @@
+/**
+ * @file regex_engine.h
+ * @brief Byte-oriented regular expressions on a lazily built DFA (server side).
+ *
+ * Patterns are parsed into a Thompson NFA once; DFA states (sets of NFA
+ * states) and their transitions are created on demand while searching and
+ * kept with the compiled Regex, so repeated searches with the same pattern
+ * run at one table lookup per input byte. RegexCache keeps recently used
+ * compiled patterns keyed by pattern text.
+ *
+ * Supported syntax: literals, `.` (any byte but newline), `[...]` / `[^...]`
+ * classes with ranges, `\d \D \w \W \s \S \t \n \r \f \v \xHH` and escaped
+ * punctuation, `( )` / `(?: )` grouping, `|`, `* + ?`, `{m}`, `{m,}`,
+ * `{m,n}`, and the anchors `^` (start of text) and `$` (end of text).
+ * Matching is leftmost-longest; lazy quantifiers are accepted and behave
+ * like their greedy forms.
+ */
+#ifndef REGEX_ENGINE_H
+#define REGEX_ENGINE_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/** Longest accepted pattern, in bytes. */
+constexpr size_t kRegexMaxPatternLen = 1024;
+
+class Regex {
+public:
+    /**
+     * @brief Compile a pattern.
+     * @return The compiled regex, or nullptr if the pattern is invalid or
+     *         too large.
+     */
+    static std::unique_ptr<Regex> compile(const uint8_t *pattern, size_t len);
+
+    /**
+     * @brief Find the leftmost-longest match in @p text.
+     *
+     * Linear in @p len: a forward scan to the earliest match end, a backward
+     * scan with the reversed pattern for the leftmost start, and one anchored
+     * forward run from there. Safe to call from several threads; searches on
+     * one Regex are serialized because they share its DFA caches.
+     *
+     * @return true and the match span, or false if there is no match.
+     */
+    bool search(const uint8_t *text, size_t len, size_t *match_pos, size_t *match_len);
+
+    /** Number of DFA states currently materialized (for diagnostics). */
+    size_t dfa_states() const;
+
+    enum class Op : uint8_t { Byte, Split, Jmp, Match, Begin, End };
+
+    struct Inst {
+        Op       op;
+        uint16_t byte_set;   ///< Op::Byte: index into byte_sets_.
+        int32_t  x;          ///< Split/Jmp target.
+        int32_t  y;          ///< Split second target.
+    };
+
+private:
+    struct DState {
+        std::vector<int32_t> insts;   ///< Sorted Byte/Match/End instructions.
+        bool   accept;
+        int8_t end_accept[2];         ///< Indexed by "text is empty"; -1 = unknown.
+    };
+
+    Regex() = default;
+
+    void    build_byte_classes();
+    void    add_closure(std::vector<int32_t> &out, std::vector<uint32_t> &seen,
+                        int32_t pc, bool at_begin, bool at_end) const;
+    int32_t intern(std::vector<int32_t> &&insts);
+    int32_t start_state(bool anchored, bool at_begin);
+    int32_t step(int32_t state, uint8_t byte);
+    bool    accepts_at_end(int32_t state, bool text_empty);
+
+    /*
+     * The search loops carry states "tagged": the state's row offset in
+     * trans_ shifted left by one, with the accept flag in bit 0. trans_
+     * stores tagged successors, so a built transition is a single load.
+     */
+    int32_t tag(int32_t state) const
+    {
+        return static_cast<int32_t>((static_cast<size_t>(state) * num_classes_) << 1) |
+               accepting_[state];
+    }
+
+    int32_t untag(int32_t tagged) const
+    {
+        return static_cast<int32_t>((static_cast<uint32_t>(tagged) >> 1) / num_classes_);
+    }
+
+    int32_t next_tagged(int32_t tagged, uint8_t byte)
+    {
+        int32_t next = trans_[(static_cast<uint32_t>(tagged) >> 1) + byte_class_[byte]];
+        return next >= 0 ? next : tag(step(untag(tagged), byte));
+    }
+    void    flush_dfa();
+
+    std::vector<Inst>                  prog_;
+    std::vector<std::array<uint64_t, 4>> byte_sets_;
+    int32_t                            anchored_entry_ = 0;
+    int32_t                            unanchored_entry_ = 0;
+
+    std::array<uint8_t, 256>           byte_class_{};
+    uint32_t                           num_classes_ = 0;
+    std::unique_ptr<Regex>             reverse_;      ///< Reversed pattern; used under mutex_.
+
+    mutable std::mutex                 mutex_;
+    std::vector<DState>                states_;
+    std::vector<uint8_t>               accepting_;    ///< Copy of DState::accept, dense.
+    std::vector<int32_t>               trans_;        ///< states x classes, tagged; -1 = not built.
+    std::map<std::vector<int32_t>, int32_t> index_;
+    int32_t                            starts_[2][2];
+    int32_t                            dead_ = -1;    ///< Always state 0 (interned first).
+
+    friend class RegexCompiler;
+};
+
+/**
+ * @brief Thread-safe LRU cache of compiled patterns keyed by pattern text.
+ *
+ * Invalid patterns are cached too (as nullptr) so a client repeating a bad
+ * pattern does not pay the parse each time. The statistics accessors read
+ * atomic counters and never take the cache lock.
+ */
+class RegexCache {
+public:
+    explicit RegexCache(size_t capacity) : capacity_(capacity) {}
+
+    /** Change the capacity, evicting least recently used entries as needed. */
+    void set_capacity(size_t capacity);
+
+    /** Look up or compile @p pattern. Returns nullptr for invalid patterns. */
+    std::shared_ptr<Regex> get(const std::string &pattern);
+
+    /** Cached pattern texts, most recently used first (for snapshots). */
+    std::vector<std::string> patterns() const;
+
+    /**
+     * @brief Compile and insert @p patterns (most recently used first)
+     *        without counting hits or misses; already cached ones are kept.
+     * @return The number of patterns inserted.
+     */
+    size_t preload(const std::vector<std::string> &patterns);
+
+    size_t size() const;
+    size_t capacity() const;
+    uint64_t hits() const;
+    uint64_t misses() const;
+
+private:
+    using Entry = std::pair<std::string, std::shared_ptr<Regex>>;
+
+    void evict_locked();
+
+    mutable std::mutex mutex_;
+    std::atomic<size_t> capacity_;   ///< Written under mutex_.
+    std::atomic<size_t> size_{0};    ///< Mirrors lru_.size(); written under mutex_.
+    std::list<Entry> lru_;   ///< Most recently used first.
+    std::unordered_map<std::string, std::list<Entry>::iterator> map_;
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+};
+
+#endif /* REGEX_ENGINE_H */
@@ -3,27 +3,50 @@
  * @brief IPC server: creates shared memory, dispatches requests to thread pools.
  */
 #include "ipc_defs.h"
+#include "arena_alloc.h"
+#include "cache_snapshot.h"
+#include "client_registry.h"
+#include "control.h"
+#include "cpu_budget.h"
+#include "matmul.h"
+#include "regex_engine.h"
+#include "stream_stats.h"
+#include "string_bulk.h"
 
+#include <algorithm>
 #include <atomic>
 #include <cerrno>
+#include <chrono>
+#include <cmath>
 #include <condition_variable>
 #include <csignal>
+#include <cstddef>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <fcntl.h>
 #include <functional>
+#include <memory>
 #include <mutex>
+#include <pthread.h>
 #include <queue>
+#include <sched.h>
 #include <semaphore.h>
+#include <sstream>
+#include <string>
 #include <sys/file.h>
 #include <sys/mman.h>
+#include <sys/resource.h>
 #include <sys/stat.h>
 #include <thread>
 #include <time.h>
 #include <unistd.h>
 #include <vector>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 /* ================================================================== */
 /*  ShutdownMode                                                       */
 /* ================================================================== */
@@ -34,279 +57,2250 @@ enum class ShutdownMode { Drain, Immediate };
 /*  ThreadPool -- simplified C++17 pool based on CPP11_ThreadPool      */
 /* ================================================================== */
 
+/**
+ * @brief One unit of pool work.
+ *
+ * Most requests are a single task (part 0 of 1). Splittable requests such as
+ * IPC_CMD_MATMUL are queued as @c parts tasks for the same slot; each worker
+ * handles its share and the last one to finish publishes the response.
+ * Stream drain tasks carry no slot (@c slot_index -1) but a @c stream_index.
+ */
+struct PoolTask {
+    int      slot_index;
+    uint32_t part;
+    uint32_t parts;
+    int      stream_index;
+    uint64_t deadline_ns;   ///< Effective deadline; see ThreadPool.
+    uint64_t seq;           ///< Queue order, breaks deadline ties FIFO.
+};
+
+/**
+ * Work without a deadline is due this long after it is queued, so slack
+ * requests yield to tight ones but cannot be starved by them.
+ */
+static constexpr uint64_t kDefaultSlackNs = 50'000'000;
+
+/** Heap order for the pool queue: earliest deadline on top. */
+struct LaterDeadline {
+    bool operator()(const PoolTask &a, const PoolTask &b) const
+    {
+        return a.deadline_ns != b.deadline_ns ? a.deadline_ns > b.deadline_ns
+                                              : a.seq > b.seq;
+    }
+};
+
+/** A worker the watchdog found running one task for too long. */
+struct StallReport {
+    size_t   worker;
+    int      slot_index;     ///< Slot of the task, -1 for a stream drain.
+    int      stream_index;
+    uint64_t elapsed_ns;
+    bool     replaced;       ///< False if the replacement limit was reached.
+};
+
+/** What one worker is doing, for `ipcctl workers`. */
+struct WorkerInfo {
+    uint64_t busy_ns;        ///< Time on the current task, 0 if idle.
+    uint64_t idle_ns;        ///< Time since the last task, 0 if busy.
+    int      slot_index;     ///< Slot of the current task, -1 for none or a stream.
+    bool     set_aside;      ///< Replaced by the watchdog, still on its task.
+    bool     retiring;       ///< Removed by a resize, still on its task.
+};
+
+/**
+ * @brief Worker pool with one earliest-deadline-first queue per priority.
+ *
+ * Workers take the highest non-empty level, except that a task whose
+ * deadline has passed is aged past every level: overdue tasks are served
+ * first, earliest deadline first. Tasks whose request carries no deadline
+ * get one kDefaultSlackNs after they are queued, so a pool without
+ * priority or deadline traffic stays FIFO and low-priority work waits at
+ * most that long behind a stream of higher-priority requests (plus the
+ * overdue work ahead of it).
+ *
+ * Every worker publishes when it took its current task and when it last
+ * finished one. check_stalls() moves a worker that has been on one task for
+ * too long aside and starts a replacement in its place, so the pool keeps
+ * its capacity; the stuck worker exits as soon as its task returns.
+ *
+ * Every worker, including those started later by resize() or
+ * check_stalls(), first runs @c thread_init on its own thread (used for the
+ * real-time scheduling options).
+ */
 class ThreadPool {
 public:
-    ThreadPool(size_t num_threads, std::function<void(int)> handler)
-        : task_handler_(std::move(handler))
+    using TaskHandler = std::function<void(const PoolTask &)>;
+
+    ThreadPool(size_t num_threads, TaskHandler handler,
+               std::function<void()> thread_init = nullptr)
+        : task_handler_(std::make_shared<const TaskHandler>(std::move(handler))),
+          thread_init_(std::move(thread_init)),
+          target_(num_threads)
     {
         workers_.reserve(num_threads);
-        for (size_t i = 0; i < num_threads; ++i) {
-            workers_.emplace_back([this] {
-                while (true) {
-                    int slot_index;
-                    {
-                        std::unique_lock lock(mutex_);
-                        cv_.wait(lock, [this] {
-                            return stop_.load() || !queue_.empty();
-                        });
-                        if (stop_.load() && queue_.empty())
-                            return;
-                        slot_index = queue_.front();
-                        queue_.pop();
-                    }
-                    task_handler_(slot_index);
-                }
-            });
-        }
+        for (size_t i = 0; i < num_threads; ++i)
+            workers_.push_back(spawn_worker());
     }
 
     ~ThreadPool() { shutdown(); }
 
-    bool submit(int slot_index)
+    bool submit(int slot_index, uint64_t deadline_ns = 0,
+                uint8_t priority = IPC_PRIORITY_NORMAL)
+    {
+        return submit_parts(slot_index, 1, deadline_ns, priority);
+    }
+
+    /**
+     * @brief Queue @p parts tasks for one slot under a single lock acquisition.
+     * @param deadline_ns Request deadline (ipc_monotonic_ns()), 0 for none.
+     * @param priority    ipc_priority_t level; larger values are clamped.
+     */
+    bool submit_parts(int slot_index, uint32_t parts, uint64_t deadline_ns = 0,
+                      uint8_t priority = IPC_PRIORITY_NORMAL)
+    {
+        uint64_t due = effective_deadline(deadline_ns);
+        TaskQueue &queue = queues_[std::min<int>(priority, IPC_PRIORITY_LEVELS - 1)];
+        {
+            std::scoped_lock lock(mutex_);
+            if (stop_.load())
+                return false;
+            for (uint32_t part = 0; part < parts; ++part)
+                queue.push(PoolTask{slot_index, part, parts, -1, due, next_seq_++});
+            pending_.fetch_add(parts, std::memory_order_relaxed);
+        }
+        if (parts == 1)
+            cv_.notify_one();
+        else
+            cv_.notify_all();
+        return true;
+    }
+
+    /** Queue a drain of stream ring @p stream_index. */
+    bool submit_stream(int stream_index)
     {
+        uint64_t due = effective_deadline(0);
         {
             std::scoped_lock lock(mutex_);
             if (stop_.load())
                 return false;
-            queue_.push(slot_index);
+            queues_[IPC_PRIORITY_NORMAL].push(
+                PoolTask{-1, 0, 1, stream_index, due, next_seq_++});
+            pending_.fetch_add(1, std::memory_order_relaxed);
         }
         cv_.notify_one();
         return true;
     }
 
+    /**
+     * @brief Grow or shrink the pool to @p num_threads workers.
+     *
+     * Retiring workers finish the task in hand and exit; queued tasks stay
+     * for the others. They are not waited for: like workers replaced by
+     * check_stalls() they are set aside and joined once their task returns,
+     * so a task that never returns cannot hang the caller. Returns false
+     * after shutdown.
+     */
+    bool resize(size_t num_threads)
+    {
+        std::scoped_lock resize_lock(resize_mutex_);
+        if (stop_.load() || num_threads == 0)
+            return false;
+        join_finished_set_aside();
+        size_t current = workers_.size();
+        {
+            std::scoped_lock lock(mutex_);
+            target_.store(num_threads);
+            for (size_t i = num_threads; i < current; ++i) {
+                workers_[i].state->replaced.store(true);
+                workers_[i].state->retired = true;
+            }
+        }
+        if (num_threads < current) {
+            // Also re-delivers any wake-up a retiring worker swallowed.
+            cv_.notify_all();
+            for (size_t i = num_threads; i < current; ++i)
+                stalled_.push_back(std::move(workers_[i]));
+            workers_.erase(workers_.begin() + static_cast<std::ptrdiff_t>(num_threads),
+                           workers_.end());
+        } else {
+            for (size_t i = current; i < num_threads; ++i)
+                workers_.push_back(spawn_worker());
+        }
+        return true;
+    }
+
+    /**
+     * @brief Replace workers that have been on one task for @p threshold_ns.
+     *
+     * Each stuck task is reported once in @p out. At most as many workers
+     * as the pool has may be set aside at a time; beyond that stuck workers
+     * are reported but not replaced. Also joins set-aside workers whose task
+     * has returned. Returns the number of workers replaced.
+     */
+    size_t check_stalls(uint64_t threshold_ns, std::vector<StallReport> *out)
+    {
+        std::scoped_lock resize_lock(resize_mutex_);
+        if (stop_.load())
+            return 0;
+        join_finished_set_aside();
+
+        size_t replaced = 0;
+        size_t stuck = 0;
+        uint64_t now = ipc_monotonic_ns();
+        // Set-aside workers include ones retired by resize() on an ordinary task.
+        for (const Worker &w : stalled_) {
+            uint64_t start = w.state->task_start_ns.load(std::memory_order_acquire);
+            if (start != 0 && now - start >= threshold_ns)
+                ++stuck;
+        }
+        for (size_t i = 0; i < workers_.size(); ++i) {
+            WorkerState &st = *workers_[i].state;
+            uint64_t start = st.task_start_ns.load(std::memory_order_acquire);
+            if (start == 0 || now - start < threshold_ns)
+                continue;
+            ++stuck;
+            if (st.reported_start == start)
+                continue;
+            st.reported_start = start;
+            StallReport report{i, st.slot_index.load(std::memory_order_relaxed),
+                               st.stream_index.load(std::memory_order_relaxed),
+                               now - start, false};
+            if (stalled_.size() < workers_.size()) {
+                {
+                    std::scoped_lock lock(mutex_);
+                    st.replaced.store(true);
+                }
+                cv_.notify_all();   // in case it went idle meanwhile
+                stalled_.push_back(std::move(workers_[i]));
+                workers_[i] = spawn_worker();
+                report.replaced = true;
+                ++replaced;
+            }
+            out->push_back(report);
+        }
+        stuck_.store(stuck, std::memory_order_relaxed);
+        replaced_.fetch_add(replaced, std::memory_order_relaxed);
+        return replaced;
+    }
+
     size_t shutdown(ShutdownMode mode = ShutdownMode::Drain)
     {
+        std::scoped_lock resize_lock(resize_mutex_);
         size_t discarded = 0;
         if (stop_.exchange(true))
             return 0;
         if (mode == ShutdownMode::Immediate) {
             std::scoped_lock lock(mutex_);
-            discarded = queue_.size();
-            std::queue<int> empty;
-            queue_.swap(empty);
+            for (TaskQueue &queue : queues_) {
+                discarded += queue.size();
+                TaskQueue empty;
+                queue.swap(empty);
+            }
+            pending_.store(0, std::memory_order_relaxed);
+        }
+        cv_.notify_all();
+        for (auto &w : workers_) {
+            if (w.thread.joinable())
+                w.thread.join();
+        }
+        // A set-aside worker may never return from its task. It owns its
+        // state and a reference to the handler it is running, and touches
+        // nothing of the pool once the task returns, so it can be left behind.
+        for (auto &w : stalled_) {
+            if (w.state->done.load())
+                w.thread.join();
+            else
+                w.thread.detach();
+        }
+        stalled_.clear();
+        return discarded;
+    }
+
+    /** Queued tasks; lock-free, so status readers never contend with submit(). */
+    size_t pending_count() const
+    {
+        return pending_.load(std::memory_order_relaxed);
+    }
+
+    size_t thread_count() const { return target_.load(std::memory_order_relaxed); }
+
+    /** Per-worker snapshot: current workers first, then set-aside ones. */
+    std::vector<WorkerInfo> workers()
+    {
+        std::scoped_lock resize_lock(resize_mutex_);
+        std::vector<WorkerInfo> out;
+        uint64_t now = ipc_monotonic_ns();
+        auto describe = [&](const Worker &w, bool set_aside) {
+            const WorkerState &st = *w.state;
+            if (st.done.load())
+                return;
+            uint64_t start = st.task_start_ns.load(std::memory_order_acquire);
+            uint64_t beat = st.heartbeat_ns.load(std::memory_order_relaxed);
+            WorkerInfo info{0, 0, -1, set_aside && !st.retired, st.retired};
+            if (start != 0) {
+                info.busy_ns = now > start ? now - start : 0;
+                info.slot_index = st.slot_index.load(std::memory_order_relaxed);
+            } else {
+                info.idle_ns = now > beat ? now - beat : 0;
+            }
+            out.push_back(info);
+        };
+        for (const Worker &w : workers_)
+            describe(w, false);
+        for (const Worker &w : stalled_)
+            describe(w, true);
+        return out;
+    }
+
+    /** Workers on a task past the threshold at the last check_stalls(). */
+    size_t stuck_count() const { return stuck_.load(std::memory_order_relaxed); }
+
+    /** Workers replaced by check_stalls() since start. */
+    uint64_t replaced_count() const { return replaced_.load(std::memory_order_relaxed); }
+
+private:
+    /** What a worker publishes for the watchdog; outlives the pool if detached. */
+    struct WorkerState {
+        std::atomic<uint64_t> task_start_ns{0};   ///< 0 while idle.
+        std::atomic<uint64_t> heartbeat_ns{0};    ///< Last task taken or finished.
+        std::atomic<int>      slot_index{-1};
+        std::atomic<int>      stream_index{-1};
+        std::atomic<bool>     replaced{false};    ///< Set aside or retired; exit after the task.
+        std::atomic<bool>     done{false};        ///< Exited after being set aside.
+        uint64_t              reported_start = 0; ///< Watchdog only, under resize_mutex_.
+        bool                  retired = false;    ///< Set aside by resize(); under resize_mutex_.
+    };
+
+    struct Worker {
+        std::thread                  thread;
+        std::shared_ptr<WorkerState> state;
+    };
+
+    Worker spawn_worker()
+    {
+        auto state = std::make_shared<WorkerState>();
+        state->heartbeat_ns.store(ipc_monotonic_ns(), std::memory_order_relaxed);
+        return Worker{std::thread([this, state, handler = task_handler_] {
+                          worker_loop(*state, *handler);
+                      }),
+                      state};
+    }
+
+    /** Join set-aside workers that have exited; caller holds resize_mutex_. */
+    void join_finished_set_aside()
+    {
+        for (auto it = stalled_.begin(); it != stalled_.end();) {
+            if (it->state->done.load()) {
+                it->thread.join();
+                it = stalled_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    using TaskQueue = std::priority_queue<PoolTask, std::vector<PoolTask>, LaterDeadline>;
+
+    static uint64_t effective_deadline(uint64_t deadline_ns)
+    {
+        return deadline_ns != 0 ? deadline_ns : ipc_monotonic_ns() + kDefaultSlackNs;
+    }
+
+    /** Queue to serve next (see class comment); caller holds mutex_. */
+    TaskQueue *next_queue_locked()
+    {
+        TaskQueue *overdue = nullptr;
+        TaskQueue *highest = nullptr;
+        uint64_t now = 0;
+        for (int level = IPC_PRIORITY_LEVELS - 1; level >= 0; --level) {
+            TaskQueue &queue = queues_[level];
+            if (queue.empty())
+                continue;
+            if (!highest) {
+                highest = &queue;
+                continue;
+            }
+            // Only lower levels can age past the highest one.
+            if (now == 0)
+                now = ipc_monotonic_ns();
+            uint64_t due = queue.top().deadline_ns;
+            if (due <= now && (!overdue || due < overdue->top().deadline_ns))
+                overdue = &queue;
+        }
+        if (overdue && highest->top().deadline_ns > overdue->top().deadline_ns)
+            return overdue;
+        return highest;
+    }
+
+    void worker_loop(WorkerState &st, const TaskHandler &handler)
+    {
+        if (thread_init_)
+            thread_init_();
+        while (true) {
+            PoolTask task;
+            {
+                std::unique_lock lock(mutex_);
+                TaskQueue *queue = nullptr;
+                cv_.wait(lock, [this, &st, &queue] {
+                    queue = next_queue_locked();
+                    return stop_.load() || queue || st.replaced.load();
+                });
+                if (st.replaced.load()) {
+                    st.done.store(true);
+                    return;
+                }
+                if (!queue)
+                    return;   // stopped and drained
+                task = queue->top();
+                queue->pop();
+                pending_.fetch_sub(1, std::memory_order_relaxed);
+            }
+            uint64_t now = ipc_monotonic_ns();
+            st.slot_index.store(task.slot_index, std::memory_order_relaxed);
+            st.stream_index.store(task.stream_index, std::memory_order_relaxed);
+            st.heartbeat_ns.store(now, std::memory_order_relaxed);
+            st.task_start_ns.store(now, std::memory_order_release);
+            handler(task);
+            st.task_start_ns.store(0, std::memory_order_relaxed);
+            st.heartbeat_ns.store(ipc_monotonic_ns(), std::memory_order_relaxed);
+            if (st.replaced.load()) {
+                st.done.store(true);   // the pool may be gone; touch nothing else
+                return;
+            }
+        }
+    }
+
+    std::vector<Worker>                     workers_;
+    std::vector<Worker>                     stalled_;        ///< Set aside by check_stalls().
+    TaskQueue                               queues_[IPC_PRIORITY_LEVELS];
+    uint64_t                                next_seq_ = 0;   ///< Guarded by mutex_.
+    mutable std::mutex                      mutex_;
+    std::condition_variable                 cv_;
+    std::atomic<bool>                       stop_{false};
+    std::atomic<size_t>                     pending_{0};
+    std::shared_ptr<const TaskHandler>      task_handler_;   ///< Shared with every worker.
+    std::function<void()>                   thread_init_;
+    std::atomic<size_t>                     target_;         ///< Workers wanted.
+    std::mutex                              resize_mutex_;   ///< Serializes resize/shutdown/check_stalls.
+    std::atomic<size_t>                     stuck_{0};
+    std::atomic<uint64_t>                   replaced_{0};
+};
+
+/* ================================================================== */
+/*  Global state                                                       */
+/* ================================================================== */
+
+static const char *LOCK_FILE = IPC_SERVER_LOCK_FILE;
+static const char *GENERATION_FILE = "/tmp/ipc_server.generation";
+
+static std::atomic<bool> g_running{true};
+
+enum class StatusFormat { Text, Json, Both };
+static std::atomic<StatusFormat> g_status_format{StatusFormat::Text};
+
+/** Posted by the SIGUSR1 handler (sem_post is async-signal-safe). */
+static sem_t g_status_sem;
+
+/** Request counters for status reports. */
+static std::atomic<uint64_t> g_requests_dispatched{0};
+static std::atomic<uint64_t> g_requests_completed{0};
+static std::atomic<ShutdownMode> g_shutdown_mode{ShutdownMode::Drain};
+static int g_lock_fd = -1;
+static SharedMemoryLayout *g_shm = nullptr;
+static int g_shm_fd = -1;
+static sem_t *g_mutex_sem = nullptr;
+static sem_t *g_server_sem = nullptr;
+static sem_t *g_slot_sems[IPC_MAX_SLOTS] = {};
+
+/** Outstanding parts of a split request, indexed by slot. */
+static std::atomic<uint32_t> g_parts_remaining[IPC_MAX_SLOTS];
+
+/**
+ * Arguments of a split request, copied and validated once by the dispatcher
+ * so every part works on the same snapshot whatever the client writes to the
+ * slot or its reference table meanwhile. Written before the request's parts
+ * are submitted.
+ */
+struct SplitRequest {
+    ipc_cmd_t cmd = IPC_CMD_ADD;   ///< Copied for every request; workers dispatch on it.
+    bool      valid = false;
+    union {
+        MatmulArgs      matmul;
+        StrArrayArgs    str_array;
+        SearchBatchArgs search_batch;
+    } args{};
+    std::vector<StrView> views;    ///< IpcStrRef table snapshot of string arrays or needles.
+};
+
+static SplitRequest g_split_requests[IPC_MAX_SLOTS];
+
+/** Output buffer the server allocated for the request in a slot. */
+struct ResultBuffer {
+    uint64_t offset = 0;
+    uint64_t bytes = 0;
+    bool     failed = false;   ///< Requested, but the arena was full.
+};
+
+/** Written by the dispatcher before the request's parts are submitted. */
+static ResultBuffer g_result_buffers[IPC_MAX_SLOTS];
+
+static uint64_t next_server_generation()
+{
+    int fd = open(GENERATION_FILE, O_CREAT | O_RDWR, 0666);
+    if (fd < 0) {
+        return static_cast<uint64_t>(time(nullptr));
+    }
+
+    if (flock(fd, LOCK_EX) < 0) {
+        close(fd);
+        return static_cast<uint64_t>(time(nullptr));
+    }
+
+    uint64_t gen = 0;
+    ssize_t n = read(fd, &gen, sizeof(gen));
+    if (n != static_cast<ssize_t>(sizeof(gen))) {
+        gen = 0;
+    }
+    ++gen;
+
+    lseek(fd, 0, SEEK_SET);
+    ssize_t written = write(fd, &gen, sizeof(gen));
+    if (written == static_cast<ssize_t>(sizeof(gen))) {
+        ftruncate(fd, sizeof(gen));
+    }
+
+    flock(fd, LOCK_UN);
+    close(fd);
+    return gen;
+}
+
+/* ================================================================== */
+/*  Pool sizing                                                        */
+/* ================================================================== */
+
+/** Threads per pool for @p cpus usable CPUs: one is left for the dispatcher. */
+static size_t threads_for_cpus(unsigned cpus)
+{
+    if (cpus <= 2)
+        return 1;
+    return (cpus - 1) / 2;
+}
+
+/** Calibration windows. The parallel one spans 2.5 CFS periods (100 ms),
+ *  so a cgroup quota shows up as throttling inside it. */
+constexpr std::chrono::milliseconds kCalibrateSoloWindow(100);
+constexpr std::chrono::milliseconds kCalibrateGroupWindow(250);
+constexpr uint32_t kCalibrateMatrixDim = 64;
+constexpr uint32_t kCalibrateStrings   = 1024;
+
+/**
+ * Runs @p kernel (given the thread index) on @p threads threads at once
+ * until @p window has passed and returns the combined calls per second.
+ */
+static double calibration_rate(unsigned threads, std::chrono::milliseconds window,
+                               const std::function<void(unsigned)> &kernel)
+{
+    std::atomic<bool> go{false};
+    std::chrono::steady_clock::time_point end;
+    std::vector<uint64_t> calls(threads, 0);
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            while (!go.load(std::memory_order_acquire))
+                std::this_thread::yield();
+            uint64_t n = 0;
+            do {
+                kernel(t);
+                ++n;
+            } while (std::chrono::steady_clock::now() < end);
+            calls[t] = n;
+        });
+    }
+    auto start = std::chrono::steady_clock::now();
+    end = start + window;
+    go.store(true, std::memory_order_release);
+    for (std::thread &w : workers)
+        w.join();
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    uint64_t total = 0;
+    for (uint64_t n : calls)
+        total += n;
+    return static_cast<double>(total) / secs;
+}
+
+/** Throughput of @p threads threads relative to one, for one kernel. */
+static double calibration_speedup(unsigned threads, const std::function<void(unsigned)> &kernel)
+{
+    double solo = calibration_rate(1, kCalibrateSoloWindow, kernel);
+    double group = calibration_rate(threads, kCalibrateGroupWindow, kernel);
+    return solo > 0 ? group / solo : 1.0;
+}
+
+/**
+ * @brief Measure how many CPUs' worth of math and string work actually run
+ *        in parallel on @p cpus threads.
+ *
+ * The limits read by cpu_budget_detect() do not show CPUs shared with other
+ * tenants, SMT siblings, or a quota held by a parent cgroup that the process
+ * cannot read. This runs the pools' own kernels (an int32 matmul band and a
+ * CRC32C bulk_hash) on one thread and then on @p cpus threads, and takes the
+ * lower of the two speedups, rounded to the nearest CPU. The result is never
+ * above @p cpus; calibration only sizes down.
+ */
+static unsigned calibrate_cpus(unsigned cpus, std::string *report)
+{
+    constexpr uint32_t dim = kCalibrateMatrixDim;
+    std::vector<std::vector<int32_t>> mats(cpus, std::vector<int32_t>(3 * dim * dim, 1));
+    double math = calibration_speedup(cpus, [&](unsigned t) {
+        int32_t *m = mats[t].data();
+        matmul_rows_i32(m, m + dim * dim, m + 2 * dim * dim, dim, dim, 0, dim);
+    });
+
+    std::string text(kCalibrateStrings * IPC_MAX_STRING_LEN, 'a');
+    for (size_t i = 0; i < text.size(); ++i)
+        text[i] = static_cast<char>('a' + (i * 7) % 26);
+    std::vector<StrView> views(kCalibrateStrings);
+    for (uint32_t i = 0; i < kCalibrateStrings; ++i)
+        views[i] = {reinterpret_cast<const uint8_t *>(text.data()) + i * IPC_MAX_STRING_LEN,
+                    IPC_MAX_STRING_LEN};
+    std::vector<std::vector<uint32_t>> hashes(cpus, std::vector<uint32_t>(kCalibrateStrings));
+    double strings = calibration_speedup(cpus, [&](unsigned t) {
+        bulk_hash(views.data(), 0, kCalibrateStrings, IPC_HASH_CRC32C, hashes[t].data());
+    });
+
+    long measured = std::lround(std::min(math, strings));
+    unsigned result = static_cast<unsigned>(std::clamp(measured, 1L, static_cast<long>(cpus)));
+    char buf[128];
+    snprintf(buf, sizeof(buf), "calibration on %u threads: math %.2fx, string %.2fx -> %u usable",
+             cpus, math, strings, result);
+    *report = buf;
+    return result;
+}
+
+/* ================================================================== */
+/*  Signal handler                                                     */
+/* ================================================================== */
+
+static void signal_handler(int /*sig*/)
+{
+    g_running.store(false);
+    if (g_server_sem)
+        sem_post(g_server_sem);
+}
+
+static void status_handler(int /*sig*/)
+{
+    sem_post(&g_status_sem);
+}
+
+/* ================================================================== */
+/*  Worker functions                                                   */
+/* ================================================================== */
+
+/*
+ * Complete a request. A slot whose caller timed out and cancelled it is
+ * freed instead; returns false in that case, so resources created for the
+ * response can be released.
+ */
+static bool publish_response(MessageSlot *slot, const ResponsePayload &resp,
+                             ipc_status_t status)
+{
+    sem_wait(g_mutex_sem);
+    bool notify = slot->notify != 0;
+    bool delivered = slot->cancelled == 0;
+    if (delivered) {
+        slot->response = resp;
+        slot->status = status;
+        // Spinning callers read the response as soon as they see this store.
+        __atomic_store_n(&slot->state, IPC_SLOT_RESPONSE_READY, __ATOMIC_RELEASE);
+    } else {
+        slot->cancelled = 0;
+        slot->state = IPC_SLOT_FREE;
+    }
+    sem_post(g_mutex_sem);
+    g_requests_completed.fetch_add(1, std::memory_order_relaxed);
+    // Blocking callers wait on the slot semaphore; async ones poll, and a
+    // post nobody consumes would wake the slot's next blocking caller early.
+    if (notify && delivered)
+        sem_post(g_slot_sems[slot - g_shm->slots]);
+    return delivered;
+}
+
+/*
+ * Publish the response of a bulk command. A server-allocated output buffer is
+ * handed to the client on success and freed otherwise.
+ */
+static void publish_bulk_response(int slot_index, ResponsePayload resp, ipc_status_t status)
+{
+    ResultBuffer buf = g_result_buffers[slot_index];
+    g_result_buffers[slot_index] = ResultBuffer{};
+    if (buf.failed) {
+        status = IPC_STATUS_BUSY;
+        resp.result.count = 0;
+    }
+    resp.result.reserved = 0;
+    resp.result.offset = 0;
+    resp.result.bytes = 0;
+    if (buf.offset && status == IPC_STATUS_OK) {
+        resp.result.offset = buf.offset;
+        resp.result.bytes = buf.bytes;
+    } else if (buf.offset) {
+        sem_wait(g_mutex_sem);
+        arena_free_block(g_shm, buf.offset);
+        sem_post(g_mutex_sem);
+    }
+    if (!publish_response(&g_shm->slots[slot_index], resp, status) && resp.result.offset) {
+        sem_wait(g_mutex_sem);
+        arena_free_block(g_shm, resp.result.offset);
+        sem_post(g_mutex_sem);
+    }
+}
+
+/*
+ * Count one finished part of a (possibly split) request. Returns true for the
+ * part that completes the request and must publish the response.
+ */
+static bool finish_part(const PoolTask &task)
+{
+    if (task.parts == 1)
+        return true;
+    return g_parts_remaining[task.slot_index].fetch_sub(1, std::memory_order_acq_rel) == 1;
+}
+
+/* Caller must hold g_mutex_sem (arena offsets are checked against live block headers). */
+static bool matmul_args_valid(const MatmulArgs &args)
+{
+    static constexpr uint32_t kMaxDim = 1u << 16;
+    if (args.m == 0 || args.n == 0 || args.k == 0 ||
+        args.m > kMaxDim || args.n > kMaxDim || args.k > kMaxDim)
+        return false;
+    if (args.dtype != IPC_DTYPE_INT32 && args.dtype != IPC_DTYPE_FLOAT32)
+        return false;
+    uint64_t elem = 4;
+    uint64_t a_bytes = elem * args.m * args.k;
+    uint64_t b_bytes = elem * args.k * args.n;
+    uint64_t c_bytes = elem * args.m * args.n;
+    if (!ipc_arena_span_valid(g_shm, args.a_off, a_bytes) ||
+        !ipc_arena_span_valid(g_shm, args.b_off, b_bytes) ||
+        !ipc_arena_span_valid(g_shm, args.c_off, c_bytes))
+        return false;
+    // Parts write row bands of C while other parts still read A and B.
+    auto overlaps = [](uint64_t x, uint64_t x_bytes, uint64_t y, uint64_t y_bytes) {
+        return x < y + y_bytes && y < x + x_bytes;
+    };
+    return !overlaps(args.c_off, c_bytes, args.a_off, a_bytes) &&
+           !overlaps(args.c_off, c_bytes, args.b_off, b_bytes);
+}
+
+/*
+ * One part of a split matrix multiply. Parts own disjoint row bands of C, so
+ * they run without coordination; the last part to finish publishes the
+ * response. Arena buffers are read without the mutex -- clients must keep
+ * them allocated until the result has been collected.
+ */
+static void process_matmul(const PoolTask &task, const SplitRequest &req)
+{
+    const MatmulArgs &args = req.args.matmul;
+    if (req.valid) {
+        uint32_t band = (args.m + task.parts - 1) / task.parts;
+        uint32_t row_begin = task.part * band;
+        uint32_t row_end = std::min(args.m, row_begin + band);
+        if (row_begin < row_end) {
+            uint8_t *arena = g_shm->arena;
+            if (args.dtype == IPC_DTYPE_INT32) {
+                matmul_rows_i32(reinterpret_cast<const int32_t *>(arena + args.a_off),
+                                reinterpret_cast<const int32_t *>(arena + args.b_off),
+                                reinterpret_cast<int32_t *>(arena + args.c_off),
+                                args.n, args.k, row_begin, row_end);
+            } else {
+                matmul_rows_f32(reinterpret_cast<const float *>(arena + args.a_off),
+                                reinterpret_cast<const float *>(arena + args.b_off),
+                                reinterpret_cast<float *>(arena + args.c_off),
+                                args.n, args.k, row_begin, row_end);
+            }
+        }
+    }
+
+    if (!finish_part(task))
+        return;
+
+    ResponsePayload resp{};
+    resp.result.count = 0;
+    publish_bulk_response(task.slot_index, resp,
+                          req.valid ? IPC_STATUS_OK : IPC_STATUS_INVALID_INPUT);
+}
+
+/* ================================================================== */
+/*  Streams                                                            */
+/* ================================================================== */
+
+/*
+ * Server half of a stream. Whoever holds @c mutex is the ring's single
+ * consumer: drain tasks, and queries/close draining the remainder first.
+ */
+struct StreamConsumer {
+    std::mutex      mutex;
+    StreamAggregate aggregate;
+};
+
+static StreamConsumer g_stream_consumers[IPC_MAX_STREAMS];
+
+/** Values folded per drain task before yielding the worker to other requests. */
+static constexpr uint64_t kStreamDrainBudget = 64 * 1024;
+
+static void ring_stream_doorbell(StreamRing *ring)
+{
+    __atomic_store_n(&ring->doorbell, 1u, __ATOMIC_RELEASE);
+    sem_post(g_server_sem);
+}
+
+/*
+ * Consume up to @p budget values from the ring into its aggregate. When the
+ * ring runs dry the consumer arms need_wakeup and re-checks head, so a value
+ * published concurrently is either seen here or announced by the producer.
+ * Caller holds the stream's consumer mutex.
+ */
+static void drain_stream_locked(int idx, uint64_t budget)
+{
+    StreamRing *ring = &g_shm->streams[idx];
+    StreamAggregate &agg = g_stream_consumers[idx].aggregate;
+    uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+
+    while (true) {
+        uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        if (head == tail) {
+            __atomic_store_n(&ring->need_wakeup, 1u, __ATOMIC_SEQ_CST);
+            __atomic_thread_fence(__ATOMIC_SEQ_CST);
+            if (__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == tail)
+                return;
+            // More data arrived. Take the wakeup back unless the producer
+            // already claimed it (then a drain task is on its way).
+            if (__atomic_exchange_n(&ring->need_wakeup, 0u, __ATOMIC_SEQ_CST) == 0)
+                return;
+            continue;
+        }
+        if (budget == 0) {
+            ring_stream_doorbell(ring);
+            return;
+        }
+
+        // The producer is untrusted: never consume more than one ring's worth.
+        uint64_t avail = std::min<uint64_t>(head - tail, IPC_STREAM_CAPACITY);
+        avail = std::min(avail, budget);
+        uint64_t pos = tail & (IPC_STREAM_CAPACITY - 1);
+        uint64_t first = std::min<uint64_t>(avail, IPC_STREAM_CAPACITY - pos);
+        agg.add(ring->values + pos, first);
+        agg.add(ring->values, avail - first);
+        tail += avail;
+        budget -= avail;
+        __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+    }
+}
+
+static void drain_stream_task(int idx)
+{
+    std::scoped_lock lock(g_stream_consumers[idx].mutex);
+    if (__atomic_load_n(&g_shm->streams[idx].state, __ATOMIC_ACQUIRE) != IPC_STREAM_OPEN)
+        return;   // stale doorbell for a stream closed meanwhile
+    drain_stream_locked(idx, kStreamDrainBudget);
+}
+
+/* Reclaim streams whose owner exited without closing them. Caller holds g_mutex_sem. */
+static bool stream_owner_gone(const StreamRing &ring)
+{
+    return ring.state == IPC_STREAM_OPEN && kill(ring.owner_pid, 0) != 0 && errno == ESRCH;
+}
+
+static void process_stream(MessageSlot *slot, ipc_cmd_t cmd)
+{
+    ResponsePayload resp;
+    memset(&resp, 0, sizeof(resp));
+    ipc_status_t status = IPC_STATUS_OK;
+
+    sem_wait(g_mutex_sem);
+    pid_t client = slot->client_pid;
+    uint32_t idx = slot->request.stream.stream_id;
+
+    if (cmd == IPC_CMD_STREAM_OPEN) {
+        int found = -1;
+        for (int i = 0; i < IPC_MAX_STREAMS && found < 0; ++i) {
+            StreamRing &ring = g_shm->streams[i];
+            if (ring.state == IPC_STREAM_FREE || stream_owner_gone(ring))
+                found = i;
+        }
+        if (found < 0) {
+            sem_post(g_mutex_sem);
+            publish_response(slot, resp, IPC_STATUS_BUSY);
+            return;
+        }
+        StreamRing &ring = g_shm->streams[found];
+        ring.owner_pid = client;
+        __atomic_store_n(&ring.state, IPC_STREAM_OPEN, __ATOMIC_RELEASE);
+        sem_post(g_mutex_sem);
+
+        // The owner cannot push before it gets the response, so resetting
+        // under the consumer mutex races only with stale drain tasks.
+        {
+            std::scoped_lock lock(g_stream_consumers[found].mutex);
+            g_stream_consumers[found].aggregate.reset();
+            __atomic_store_n(&ring.head, 0, __ATOMIC_RELAXED);
+            __atomic_store_n(&ring.tail, 0, __ATOMIC_RELAXED);
+            __atomic_store_n(&ring.doorbell, 0u, __ATOMIC_RELAXED);
+            __atomic_store_n(&ring.need_wakeup, 1u, __ATOMIC_RELAXED);
+        }
+        resp.stream_id = static_cast<uint32_t>(found);
+        if (!publish_response(slot, resp, IPC_STATUS_OK)) {
+            // The opener timed out and will never learn the stream id.
+            sem_wait(g_mutex_sem);
+            __atomic_store_n(&ring.state, IPC_STREAM_FREE, __ATOMIC_RELEASE);
+            ring.owner_pid = 0;
+            sem_post(g_mutex_sem);
+        }
+        return;
+    }
+
+    // QUERY is open to any client; CLOSE only to the owner.
+    bool valid = idx < IPC_MAX_STREAMS && g_shm->streams[idx].state == IPC_STREAM_OPEN &&
+                 (cmd == IPC_CMD_STREAM_QUERY || g_shm->streams[idx].owner_pid == client);
+    sem_post(g_mutex_sem);
+    if (!valid) {
+        publish_response(slot, resp, IPC_STATUS_INVALID_INPUT);
+        return;
+    }
+
+    {
+        // Drain everything pushed before this request, then snapshot.
+        std::scoped_lock lock(g_stream_consumers[idx].mutex);
+        drain_stream_locked(static_cast<int>(idx), UINT64_MAX);
+        g_stream_consumers[idx].aggregate.snapshot(&resp.stream);
+        if (cmd == IPC_CMD_STREAM_CLOSE) {
+            sem_wait(g_mutex_sem);
+            __atomic_store_n(&g_shm->streams[idx].state, IPC_STREAM_FREE, __ATOMIC_RELEASE);
+            g_shm->streams[idx].owner_pid = 0;
+            sem_post(g_mutex_sem);
+        }
+    }
+    publish_response(slot, resp, status);
+}
+
+static void process_math(const PoolTask &task)
+{
+    if (task.stream_index >= 0) {
+        drain_stream_task(task.stream_index);
+        return;
+    }
+
+    int slot_idx = task.slot_index;
+    sem_wait(g_mutex_sem);
+    MessageSlot *slot = &g_shm->slots[slot_idx];
+    ipc_cmd_t cmd = g_split_requests[slot_idx].cmd;
+    if (cmd == IPC_CMD_STREAM_OPEN || cmd == IPC_CMD_STREAM_QUERY ||
+        cmd == IPC_CMD_STREAM_CLOSE) {
+        sem_post(g_mutex_sem);
+        process_stream(slot, cmd);
+        return;
+    }
+    if (cmd == IPC_CMD_MATMUL) {
+        sem_post(g_mutex_sem);
+        process_matmul(task, g_split_requests[slot_idx]);
+        return;
+    }
+    int32_t a = slot->request.math.a;
+    int32_t b = slot->request.math.b;
+    sem_post(g_mutex_sem);
+
+    if (cmd == IPC_CMD_MUL || cmd == IPC_CMD_DIV)
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+
+    int32_t result = 0;
+    ipc_status_t status = IPC_STATUS_OK;
+
+    switch (cmd) {
+    case IPC_CMD_ADD: result = a + b; break;
+    case IPC_CMD_SUB: result = a - b; break;
+    case IPC_CMD_MUL: result = a * b; break;
+    case IPC_CMD_DIV:
+        if (b == 0) {
+            status = IPC_STATUS_DIV_BY_ZERO;
+        } else {
+            result = a / b;
+        }
+        break;
+    default:
+        status = IPC_STATUS_INVALID_INPUT;
+        break;
+    }
+
+    ResponsePayload resp{};
+    resp.math_result = result;
+    publish_response(slot, resp, status);
+}
+
+/*
+ * String kernels operate on (ptr, len) pairs copied out of the slot. Inputs
+ * are at most IPC_MAX_STRING_LEN (16) bytes, so each operand fits a single
+ * fixed-width 16-byte load/store and no terminator scan is ever needed.
+ */
+
+/** Haystack staging buffer: one 16-byte block plus zero padding for the shifted load. */
+struct alignas(16) SearchBlock {
+    char bytes[2 * IPC_MAX_STRING_LEN];
+};
+
+static void concat_kernel(const char *s1, size_t len1,
+                          const char *s2, size_t len2, char *out)
+{
+    // Both copies are full 16-byte blocks; the second overwrites the tail of
+    // the first starting at len1. out holds IPC_MAX_RESULT_LEN (33) bytes.
+    memcpy(out, s1, IPC_MAX_STRING_LEN);
+    memcpy(out + len1, s2, IPC_MAX_STRING_LEN);
+    out[len1 + len2] = '\0';
+}
+
+static int32_t search_kernel(const SearchBlock &hay, size_t hay_len,
+                             const char *needle, size_t needle_len)
+{
+    if (needle_len > hay_len)
+        return -1;
+    // Candidate start positions are 0..hay_len-needle_len.
+    uint32_t valid = (1u << (hay_len - needle_len + 1)) - 1u;
+
+#if defined(__SSE2__)
+    // Match the first and last needle bytes at every offset in one pass, then
+    // verify the (at most 14) interior bytes of each surviving candidate.
+    __m128i head = _mm_load_si128(reinterpret_cast<const __m128i *>(hay.bytes));
+    __m128i tail = _mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(hay.bytes + needle_len - 1));
+    __m128i eq_first = _mm_cmpeq_epi8(head, _mm_set1_epi8(needle[0]));
+    __m128i eq_last  = _mm_cmpeq_epi8(tail, _mm_set1_epi8(needle[needle_len - 1]));
+    uint32_t candidates = static_cast<uint32_t>(
+        _mm_movemask_epi8(_mm_and_si128(eq_first, eq_last))) & valid;
+#else
+    uint32_t candidates = 0;
+    for (size_t i = 0; i + needle_len <= hay_len; ++i) {
+        if (hay.bytes[i] == needle[0] &&
+            hay.bytes[i + needle_len - 1] == needle[needle_len - 1])
+            candidates |= 1u << i;
+    }
+    candidates &= valid;
+#endif
+
+    while (candidates) {
+        int pos = __builtin_ctz(candidates);
+        if (needle_len <= 2 ||
+            memcmp(hay.bytes + pos + 1, needle + 1, needle_len - 2) == 0)
+            return pos;
+        candidates &= candidates - 1;
+    }
+    return -1;
+}
+
+/* Caller must hold g_mutex_sem. */
+static bool str_array_args_valid(const StrArrayArgs &args)
+{
+    static constexpr uint32_t kMaxStrings = IPC_ARENA_SIZE / sizeof(IpcStrRef);
+    if (args.count == 0 || args.count > kMaxStrings)
+        return false;
+    return ipc_arena_span_valid(g_shm, args.refs_off, uint64_t{sizeof(IpcStrRef)} * args.count) &&
+           ipc_arena_span_valid(g_shm, args.out_off, uint64_t{sizeof(uint32_t)} * args.count);
+}
+
+/*
+ * Snapshot the IpcStrRef table into views. Each reference is copied once and
+ * bounds-checked against the arena, so later client writes to the table can
+ * not steer the kernels outside shared memory.
+ */
+static bool load_str_views(uint64_t refs_off, uint32_t count, std::vector<StrView> &views)
+{
+    const IpcStrRef *refs = reinterpret_cast<const IpcStrRef *>(g_shm->arena + refs_off);
+    views.resize(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        IpcStrRef ref = refs[i];
+        if (ref.offset > IPC_ARENA_SIZE || ref.len > IPC_ARENA_SIZE - ref.offset)
+            return false;
+        views[i] = StrView{g_shm->arena + ref.offset, ref.len};
+    }
+    return true;
+}
+
+/*
+ * Sort/hash run as independent parts over the same view table (see
+ * bulk_sort_part); dedupe is a single pass. The finishing part publishes.
+ */
+static void process_str_array(const PoolTask &task, const SplitRequest &req)
+{
+    const StrArrayArgs &args = req.args.str_array;
+    const std::vector<StrView> &views = req.views;
+    ipc_cmd_t cmd = req.cmd;
+    uint32_t written = args.count;
+    if (req.valid) {
+        uint32_t *out = reinterpret_cast<uint32_t *>(g_shm->arena + args.out_off);
+        if (cmd == IPC_CMD_STR_SORT) {
+            bulk_sort_part(views.data(), args.count, task.part, task.parts, out);
+        } else if (cmd == IPC_CMD_STR_HASH) {
+            uint32_t chunk = (args.count + task.parts - 1) / task.parts;
+            uint32_t begin = std::min(args.count, task.part * chunk);
+            uint32_t end = std::min(args.count, begin + chunk);
+            bulk_hash(views.data(), begin, end, args.algo, out);
+        } else {
+            written = bulk_dedupe(views.data(), args.count, out);
+        }
+    }
+
+    if (!finish_part(task))
+        return;
+
+    ResponsePayload resp{};
+    resp.result.count = req.valid ? written : 0;
+    publish_bulk_response(task.slot_index, resp,
+                          req.valid ? IPC_STATUS_OK : IPC_STATUS_INVALID_INPUT);
+}
+
+/* Caller must hold g_mutex_sem. */
+static bool search_batch_args_valid(const SearchBatchArgs &args)
+{
+    static constexpr uint32_t kMaxNeedles = IPC_ARENA_SIZE / sizeof(IpcStrRef);
+    if (args.count == 0 || args.count > kMaxNeedles)
+        return false;
+    return ipc_arena_span_valid(g_shm, args.hay_off, args.hay_len) &&
+           ipc_arena_span_valid(g_shm, args.refs_off, uint64_t{sizeof(IpcStrRef)} * args.count) &&
+           ipc_arena_span_valid(g_shm, args.out_off, uint64_t{sizeof(int32_t)} * args.count);
+}
+
+/*
+ * Each part searches the haystack for its own needle range; the finishing
+ * part counts the needles found across all parts.
+ */
+static void process_search_batch(const PoolTask &task, const SplitRequest &req)
+{
+    const SearchBatchArgs &args = req.args.search_batch;
+    const std::vector<StrView> &views = req.views;
+    int32_t *out = reinterpret_cast<int32_t *>(g_shm->arena + args.out_off);
+    if (req.valid) {
+        uint32_t chunk = (args.count + task.parts - 1) / task.parts;
+        uint32_t begin = std::min(args.count, task.part * chunk);
+        uint32_t end = std::min(args.count, begin + chunk);
+        bulk_search(g_shm->arena + args.hay_off, args.hay_len, views.data(), begin, end, out);
+    }
+
+    if (!finish_part(task))
+        return;
+
+    ResponsePayload resp{};
+    resp.result.count = 0;
+    if (req.valid) {
+        for (uint32_t i = 0; i < args.count; ++i)
+            resp.result.count += (out[i] >= 0);
+    }
+    publish_bulk_response(task.slot_index, resp,
+                          req.valid ? IPC_STATUS_OK : IPC_STATUS_INVALID_INPUT);
+}
+
+/* Compiled patterns shared by all string workers; sized by --regex-cache. */
+static constexpr size_t kDefaultRegexCacheSize = 128;
+static RegexCache g_regex_cache(kDefaultRegexCacheSize);
+
+/*
+ * The pattern is copied out of the arena (it is the cache key); the haystack
+ * is scanned in place.
+ */
+static void process_regex(MessageSlot *slot, const RegexArgs &args, bool spans_valid)
+{
+    ResponsePayload resp{};
+    resp.match = RegexMatch{-1, 0};
+    ipc_status_t status = IPC_STATUS_INVALID_INPUT;
+
+    if (args.pattern_len > kRegexMaxPatternLen) {
+        status = IPC_STATUS_STR_TOO_LONG;
+    } else if (spans_valid) {
+        std::string pattern(reinterpret_cast<const char *>(g_shm->arena + args.pattern_off),
+                            args.pattern_len);
+        std::shared_ptr<Regex> re = g_regex_cache.get(pattern);
+        size_t pos = 0, len = 0;
+        if (!re) {
+            status = IPC_STATUS_INVALID_INPUT;
+        } else if (re->search(g_shm->arena + args.hay_off, args.hay_len, &pos, &len)) {
+            resp.match = RegexMatch{static_cast<int32_t>(pos), static_cast<uint32_t>(len)};
+            status = IPC_STATUS_OK;
+        } else {
+            status = IPC_STATUS_NOT_FOUND;
+        }
+    }
+    publish_response(slot, resp, status);
+}
+
+/*
+ * Interned operands are read without /ipc_mutex: a published entry never
+ * changes, so the acquire load of its tag is all the synchronization needed.
+ */
+static bool load_interned(uint32_t id, InternEntry *out)
+{
+    if (id >= IPC_INTERN_CAPACITY)
+        return false;
+    const InternEntry &entry = g_shm->interns[id];
+    if (!(__atomic_load_n(&entry.tag, __ATOMIC_ACQUIRE) & IPC_INTERN_READY))
+        return false;
+    memcpy(out, &entry, sizeof(*out));
+    return out->len >= 1 && out->len <= IPC_MAX_STRING_LEN;
+}
+
+/** Shift-and table of an interned haystack: bit i of occ[b] is set when byte i is b. */
+struct InternSearchTable {
+    uint16_t occ[256];
+    uint8_t  len;
+};
+
+/* Built on first search per id and kept for the server's lifetime, like the ids. */
+static std::atomic<const InternSearchTable *> g_intern_tables[IPC_INTERN_CAPACITY];
+
+static const InternSearchTable *intern_search_table(uint32_t id, const InternEntry &hay)
+{
+    const InternSearchTable *table = g_intern_tables[id].load(std::memory_order_acquire);
+    if (table)
+        return table;
+    auto *fresh = new InternSearchTable{};
+    fresh->len = hay.len;
+    for (uint32_t i = 0; i < hay.len; ++i)
+        fresh->occ[static_cast<uint8_t>(hay.bytes[i])] |= static_cast<uint16_t>(1u << i);
+    if (g_intern_tables[id].compare_exchange_strong(table, fresh, std::memory_order_acq_rel,
+                                                    std::memory_order_acquire))
+        return fresh;
+    delete fresh;   // another worker published first
+    return table;
+}
+
+/* One AND per needle byte; no haystack bytes are touched. */
+static int32_t shift_and_search(const InternSearchTable &table, const char *needle,
+                                size_t needle_len)
+{
+    if (needle_len > table.len)
+        return -1;
+    uint32_t starts = (1u << (table.len - needle_len + 1)) - 1u;
+    for (size_t j = 0; j < needle_len && starts; ++j)
+        starts &= static_cast<uint32_t>(table.occ[static_cast<uint8_t>(needle[j])]) >> j;
+    return starts ? __builtin_ctz(starts) : -1;
+}
+
+static void process_interned(MessageSlot *slot, ipc_cmd_t cmd, const InternArgs &args)
+{
+    ipc_status_t status = IPC_STATUS_OK;
+    ResponsePayload resp{};
+    InternEntry s1;
+    InternEntry s2;
+
+    if (!load_interned(args.id1, &s1) || !load_interned(args.id2, &s2)) {
+        status = IPC_STATUS_INVALID_INPUT;
+        resp.position = -1;
+    } else if (cmd == IPC_CMD_CONCAT_INTERNED) {
+        concat_kernel(s1.bytes, s1.len, s2.bytes, s2.len, resp.str_result);
+    } else {
+        resp.position = shift_and_search(*intern_search_table(args.id1, s1), s2.bytes, s2.len);
+        if (resp.position < 0)
+            status = IPC_STATUS_NOT_FOUND;
+    }
+    publish_response(slot, resp, status);
+}
+
+static void process_string(const PoolTask &task)
+{
+    int slot_idx = task.slot_index;
+    sem_wait(g_mutex_sem);
+    MessageSlot *slot = &g_shm->slots[slot_idx];
+    ipc_cmd_t cmd = g_split_requests[slot_idx].cmd;
+    if (cmd == IPC_CMD_STR_SORT || cmd == IPC_CMD_STR_DEDUPE || cmd == IPC_CMD_STR_HASH) {
+        sem_post(g_mutex_sem);
+        process_str_array(task, g_split_requests[slot_idx]);
+        return;
+    }
+    if (cmd == IPC_CMD_SEARCH_BATCH) {
+        sem_post(g_mutex_sem);
+        process_search_batch(task, g_split_requests[slot_idx]);
+        return;
+    }
+    if (cmd == IPC_CMD_REGEX_SEARCH) {
+        RegexArgs regex_args = slot->request.regex;
+        // Haystacks are capped at INT32_MAX so the position fits the response.
+        bool valid = regex_args.hay_len <= INT32_MAX &&
+                     ipc_arena_span_valid(g_shm, regex_args.pattern_off, regex_args.pattern_len) &&
+                     ipc_arena_span_valid(g_shm, regex_args.hay_off, regex_args.hay_len);
+        sem_post(g_mutex_sem);
+        process_regex(slot, regex_args, valid);
+        return;
+    }
+    if (cmd == IPC_CMD_CONCAT_INTERNED || cmd == IPC_CMD_SEARCH_INTERNED) {
+        InternArgs intern_args = slot->request.intern;
+        sem_post(g_mutex_sem);
+        process_interned(slot, cmd, intern_args);
+        return;
+    }
+    StringArgs args = slot->request.str;
+    sem_post(g_mutex_sem);
+
+    ipc_status_t status = IPC_STATUS_OK;
+    ResponsePayload resp{};
+    size_t len1 = args.len1;
+    size_t len2 = args.len2;
+
+    if (len1 < 1 || len1 > IPC_MAX_STRING_LEN ||
+        len2 < 1 || len2 > IPC_MAX_STRING_LEN) {
+        status = IPC_STATUS_STR_TOO_LONG;
+        resp.position = -1;
+    } else if (cmd == IPC_CMD_CONCAT) {
+        concat_kernel(args.s1, len1, args.s2, len2, resp.str_result);
+    } else if (cmd == IPC_CMD_SEARCH) {
+        SearchBlock hay{};
+        memcpy(hay.bytes, args.s1, IPC_MAX_STRING_LEN);
+        resp.position = search_kernel(hay, len1, args.s2, len2);
+        if (resp.position < 0)
+            status = IPC_STATUS_NOT_FOUND;
+    } else {
+        status = IPC_STATUS_INVALID_INPUT;
+        resp.position = -1;
+    }
+
+    publish_response(slot, resp, status);
+
+    // String operations are async-only in this project and are collected via polling.
+}
+
+/* ================================================================== */
+/*  Dispatch helpers                                                   */
+/* ================================================================== */
+
+static bool is_string_command(ipc_cmd_t cmd)
+{
+    switch (cmd) {
+    case IPC_CMD_CONCAT:
+    case IPC_CMD_SEARCH:
+    case IPC_CMD_STR_SORT:
+    case IPC_CMD_STR_DEDUPE:
+    case IPC_CMD_STR_HASH:
+    case IPC_CMD_REGEX_SEARCH:
+    case IPC_CMD_SEARCH_BATCH:
+    case IPC_CMD_CONCAT_INTERNED:
+    case IPC_CMD_SEARCH_INTERNED:
+        return true;
+    default:
+        // Math commands, plus unknown ones (answered with INVALID_INPUT).
+        return false;
+    }
+}
+
+/*
+ * Bulk commands given an output offset of 0 get their output buffer from the
+ * server, so clients need not size it up front and read the result in place.
+ * The buffer belongs to the requesting client (dead clients' buffers are
+ * reclaimed like any other) and starts with one reference. Oversized or empty
+ * outputs get no buffer and fail validation. Caller holds g_mutex_sem.
+ */
+static ResultBuffer alloc_result_buffer(MessageSlot &slot)
+{
+    uint64_t *out_off;
+    uint64_t elems;
+    switch (slot.command) {
+    case IPC_CMD_MATMUL:
+        out_off = &slot.request.matmul.c_off;
+        elems = uint64_t{slot.request.matmul.m} * slot.request.matmul.n;
+        break;
+    case IPC_CMD_STR_SORT:
+    case IPC_CMD_STR_DEDUPE:
+    case IPC_CMD_STR_HASH:
+        out_off = &slot.request.str_array.out_off;
+        elems = slot.request.str_array.count;
+        break;
+    case IPC_CMD_SEARCH_BATCH:
+        out_off = &slot.request.search_batch.out_off;
+        elems = slot.request.search_batch.count;
+        break;
+    default:
+        return ResultBuffer{};
+    }
+    // Every bulk output element is 4 bytes wide.
+    if (*out_off != 0 || elems == 0 || elems > IPC_ARENA_SIZE / 4)
+        return ResultBuffer{};
+    uint64_t bytes = elems * 4;
+
+    uint64_t off = arena_alloc_block(g_shm, bytes, slot.client_pid);
+    if (!off && arena_reclaim(g_shm) > 0)
+        off = arena_alloc_block(g_shm, bytes, slot.client_pid);
+    if (!off)
+        return ResultBuffer{0, 0, true};
+    arena_header(g_shm, off)->refs = 1;
+    *out_off = off;
+    return ResultBuffer{off, bytes, false};
+}
+
+/*
+ * Copy and validate the arguments of a request whose parts share them. Runs
+ * after alloc_result_buffer(), so a server-allocated output is checked like a
+ * client one. Caller holds g_mutex_sem.
+ */
+static void prepare_split_request(const MessageSlot &slot, SplitRequest &req)
+{
+    req.cmd = slot.command;
+    req.valid = false;
+    switch (req.cmd) {
+    case IPC_CMD_MATMUL:
+        req.args.matmul = slot.request.matmul;
+        req.valid = matmul_args_valid(req.args.matmul);
+        break;
+    case IPC_CMD_STR_SORT:
+    case IPC_CMD_STR_DEDUPE:
+    case IPC_CMD_STR_HASH:
+        req.args.str_array = slot.request.str_array;
+        req.valid = str_array_args_valid(req.args.str_array) &&
+                    (req.cmd != IPC_CMD_STR_HASH || req.args.str_array.algo <= IPC_HASH_XXH32);
+        break;
+    case IPC_CMD_SEARCH_BATCH:
+        req.args.search_batch = slot.request.search_batch;
+        // Haystacks are capped at INT32_MAX so positions fit the output.
+        req.valid = req.args.search_batch.hay_len <= INT32_MAX &&
+                    search_batch_args_valid(req.args.search_batch);
+        break;
+    default:
+        break;
+    }
+}
+
+/*
+ * Snapshot the reference table of a validated request once for all of its
+ * parts. Runs without g_mutex_sem, like the kernels that read the arena.
+ */
+static void load_split_views(SplitRequest &req)
+{
+    if (!req.valid)
+        return;
+    switch (req.cmd) {
+    case IPC_CMD_STR_SORT:
+    case IPC_CMD_STR_DEDUPE:
+    case IPC_CMD_STR_HASH:
+        req.valid = load_str_views(req.args.str_array.refs_off, req.args.str_array.count,
+                                   req.views);
+        break;
+    case IPC_CMD_SEARCH_BATCH:
+        req.valid = load_str_views(req.args.search_batch.refs_off, req.args.search_batch.count,
+                                   req.views);
+        break;
+    default:
+        break;
+    }
+}
+
+/*
+ * Number of pool tasks a request is split into. Arguments are validated by
+ * prepare_split_request(), so the sizes read here are only hints. Caller
+ * holds g_mutex_sem.
+ */
+static uint32_t request_parts(const MessageSlot &slot, size_t pool_threads)
+{
+    uint64_t units;
+    uint64_t per_part;
+    switch (slot.command) {
+    case IPC_CMD_MATMUL:
+        units = slot.request.matmul.m;
+        per_part = kMatmulRowsPerPart;
+        break;
+    case IPC_CMD_STR_SORT:
+    case IPC_CMD_STR_HASH:
+        units = slot.request.str_array.count;
+        per_part = kBulkStringsPerPart;
+        break;
+    case IPC_CMD_SEARCH_BATCH:
+        units = slot.request.search_batch.count;
+        per_part = kSearchBatchNeedlesPerPart;
+        break;
+    default:
+        return 1;
+    }
+    uint64_t wanted = (units + per_part - 1) / per_part;
+    return static_cast<uint32_t>(
+        std::clamp<uint64_t>(wanted, 1, std::max<size_t>(pool_threads, 1)));
+}
+
+/* ================================================================== */
+/*  Cleanup                                                            */
+/* ================================================================== */
+
+static void cleanup_ipc(void)
+{
+    for (int i = 0; i < IPC_MAX_SLOTS; ++i) {
+        if (g_slot_sems[i] && g_slot_sems[i] != SEM_FAILED) {
+            sem_close(g_slot_sems[i]);
+            char name[64];
+            ipc_slot_sem_name(i, name, sizeof(name));
+            sem_unlink(name);
+        }
+    }
+    if (g_server_sem && g_server_sem != SEM_FAILED) {
+        sem_close(g_server_sem);
+        sem_unlink(IPC_SERVER_SEM_NAME);
+    }
+    if (g_mutex_sem && g_mutex_sem != SEM_FAILED) {
+        sem_close(g_mutex_sem);
+        sem_unlink(IPC_MUTEX_NAME);
+    }
+    if (g_shm && g_shm != MAP_FAILED) {
+        // Producers only notice a vanished server through the ring state.
+        for (StreamRing &ring : g_shm->streams)
+            __atomic_store_n(&ring.state, IPC_STREAM_FREE, __ATOMIC_RELEASE);
+        // Clients still mapping the unlinked segment see the restart too.
+        __atomic_store_n(&g_shm->server_generation, 0, __ATOMIC_RELEASE);
+        munmap(g_shm, sizeof(SharedMemoryLayout));
+    }
+    if (g_shm_fd >= 0) {
+        close(g_shm_fd);
+    }
+    shm_unlink(IPC_SHM_NAME);
+    if (g_lock_fd >= 0) {
+        unlink(LOCK_FILE);
+        close(g_lock_fd);
+    }
+}
+
+/* ================================================================== */
+/*  Client liveness                                                    */
+/* ================================================================== */
+
+static constexpr auto kClientSweepInterval = std::chrono::seconds(1);
+
+static std::atomic<uint64_t> g_clients_reaped{0};
+/* Background threads sleep on this pair; shutdown wakes them all. */
+static std::mutex g_monitor_mutex;
+static std::condition_variable g_monitor_cv;
+
+/* Liveness sweeps a slot may sit unused in a client's magazine before it is freed. */
+static constexpr uint64_t kMagazineIdleSweeps = 5;
+
+/*
+ * Take a RESERVED slot away from the client thread whose magazine holds it
+ * and mark it free. The CAS on the tag decides between the server, the
+ * owner and other claimants (see MessageSlot), so this needs no mutex.
+ */
+static bool free_magazine_slot(MessageSlot &slot)
+{
+    uint64_t tag = __atomic_load_n(&slot.magazine_tag, __ATOMIC_ACQUIRE);
+    if (tag == 0 || !__atomic_compare_exchange_n(&slot.magazine_tag, &tag, 0, false,
+                                                 __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        return false;
+    __atomic_store_n(&slot.state, IPC_SLOT_FREE, __ATOMIC_RELEASE);
+    return true;
+}
+
+/* Free magazine slots unused for kMagazineIdleSweeps sweeps; returns how many. */
+static int reclaim_idle_magazine_slots()
+{
+    uint64_t epoch = __atomic_load_n(&g_shm->client_epoch, __ATOMIC_RELAXED);
+    int freed = 0;
+    for (MessageSlot &slot : g_shm->slots) {
+        if (__atomic_load_n(&slot.magazine_tag, __ATOMIC_RELAXED) != 0 &&
+            epoch - __atomic_load_n(&slot.reserved_epoch, __ATOMIC_RELAXED) >=
+                kMagazineIdleSweeps &&
+            free_magazine_slot(slot))
+            ++freed;
+    }
+    return freed;
+}
+
+/*
+ * Release what dead clients left behind: answered slots nobody will collect,
+ * slots in their magazines, then, in one arena_reclaim() pass, their arena
+ * blocks. Returns the pids that still have requests in flight; their slots
+ * and buffers are released on a later pass, once the requests complete.
+ */
+static std::vector<pid_t> release_client_leftovers(const std::vector<pid_t> &dead)
+{
+    std::vector<pid_t> in_flight;
+    int freed_slots = 0;
+    sem_wait(g_mutex_sem);
+    for (pid_t pid : dead) {
+        bool busy = false;
+        for (MessageSlot &slot : g_shm->slots) {
+            if (slot.client_pid != pid)
+                continue;
+            if (slot.state == IPC_SLOT_RESPONSE_READY || slot.state == IPC_SLOT_CLAIMED) {
+                slot.state = IPC_SLOT_FREE;
+                ++freed_slots;
+            } else if (slot.state == IPC_SLOT_RESERVED) {
+                freed_slots += free_magazine_slot(slot) ? 1 : 0;
+            } else if (slot.state != IPC_SLOT_FREE) {
+                busy = true;
+            }
+        }
+        if (busy)
+            in_flight.push_back(pid);
+    }
+    uint64_t reclaimed = arena_reclaim(g_shm);
+    sem_post(g_mutex_sem);
+
+    if (freed_slots > 0 || reclaimed > 0) {
+        printf("[CLIENTS] released %d slot(s) and %llu KiB of arena from dead clients\n",
+               freed_slots, static_cast<unsigned long long>(reclaimed / 1024));
+        fflush(stdout);
+    }
+    return in_flight;
+}
+
+/*
+ * Monitor thread: one client_sweep() per kClientSweepInterval. Busy clients
+ * cost nothing beyond the epoch check; quiet ones one kill() and one /proc
+ * read each, so thousands of registered clients stay cheap to watch.
+ */
+static void client_monitor()
+{
+    std::vector<pid_t> dead;
+    std::unique_lock<std::mutex> lock(g_monitor_mutex);
+    while (!g_monitor_cv.wait_for(lock, kClientSweepInterval,
+                                  [] { return !g_running.load(); })) {
+        lock.unlock();
+        ClientSweepResult sweep = client_sweep(g_shm, &dead);
+        if (sweep.reaped > 0) {
+            g_clients_reaped.fetch_add(sweep.reaped, std::memory_order_relaxed);
+            printf("[CLIENTS] reaped %u dead client(s), %u still registered\n",
+                   sweep.reaped, sweep.active);
+            fflush(stdout);
         }
-        cv_.notify_all();
-        for (auto &w : workers_) {
-            if (w.joinable())
-                w.join();
+        if (!dead.empty())
+            dead = release_client_leftovers(dead);
+        int idle_slots = reclaim_idle_magazine_slots();
+        if (idle_slots > 0) {
+            printf("[CLIENTS] took back %d idle magazine slot(s)\n", idle_slots);
+            fflush(stdout);
         }
-        return discarded;
+        lock.lock();
     }
+}
 
-    size_t pending_count() const
-    {
-        std::scoped_lock lock(mutex_);
-        return queue_.size();
+/* ================================================================== */
+/*  Worker watchdog                                                    */
+/* ================================================================== */
+
+/** Default for --watchdog-ms: a task running this long counts as stuck. */
+static constexpr uint64_t kDefaultWatchdogMs = 5000;
+
+static std::atomic<uint64_t> g_watchdog_ms{kDefaultWatchdogMs};   ///< 0 disables.
+
+static void report_stalls(const char *pool_name, const std::vector<StallReport> &reports)
+{
+    for (const StallReport &r : reports) {
+        char task[48];
+        if (r.slot_index >= 0)
+            snprintf(task, sizeof(task), "slot %d", r.slot_index);
+        else
+            snprintf(task, sizeof(task), "stream %d", r.stream_index);
+        printf("[WATCHDOG] %s worker %zu stuck for %llu ms on %s; %s\n", pool_name,
+               r.worker, static_cast<unsigned long long>(r.elapsed_ns / 1'000'000), task,
+               r.replaced ? "started a replacement" : "replacement limit reached");
     }
+    if (!reports.empty())
+        fflush(stdout);
+}
 
-private:
-    std::vector<std::thread>     workers_;
-    std::queue<int>              queue_;
-    mutable std::mutex           mutex_;
-    std::condition_variable      cv_;
-    std::atomic<bool>            stop_{false};
-    std::function<void(int)>     task_handler_;
-};
+/*
+ * Watchdog thread: checks both pools four times per threshold (at most once
+ * per second, at least every 10 ms). It runs apart from the client monitor,
+ * which may itself wait on /ipc_mutex -- the lock a stuck worker is most
+ * likely blocked on.
+ */
+static void worker_watchdog(ThreadPool *math_pool, ThreadPool *string_pool)
+{
+    std::vector<StallReport> reports;
+    std::unique_lock<std::mutex> lock(g_monitor_mutex);
+    while (true) {
+        uint64_t threshold_ms = g_watchdog_ms.load();
+        uint64_t tick_ms = threshold_ms == 0 ? 1000
+                                             : std::clamp<uint64_t>(threshold_ms / 4, 10, 1000);
+        if (g_monitor_cv.wait_for(lock, std::chrono::milliseconds(tick_ms),
+                                  [] { return !g_running.load(); }))
+            return;
+        if (threshold_ms == 0)
+            continue;
+        lock.unlock();
+        uint64_t threshold_ns = threshold_ms * 1'000'000;
+        reports.clear();
+        math_pool->check_stalls(threshold_ns, &reports);
+        report_stalls("math", reports);
+        reports.clear();
+        string_pool->check_stalls(threshold_ns, &reports);
+        report_stalls("string", reports);
+        lock.lock();
+    }
+}
 
 /* ================================================================== */
-/*  Global state                                                       */
+/*  Cache snapshot                                                     */
 /* ================================================================== */
 
-static const char *LOCK_FILE = "/tmp/ipc_server.lock";
-static const char *GENERATION_FILE = "/tmp/ipc_server.generation";
+/** Default for --snapshot-interval: seconds between periodic snapshots. */
+static constexpr uint64_t kDefaultSnapshotIntervalSec = 60;
 
-static std::atomic<bool> g_running{true};
-static std::atomic<bool> g_status_requested{false};
-static ShutdownMode g_shutdown_mode = ShutdownMode::Drain;
-static int g_lock_fd = -1;
-static SharedMemoryLayout *g_shm = nullptr;
-static int g_shm_fd = -1;
-static sem_t *g_mutex_sem = nullptr;
-static sem_t *g_server_sem = nullptr;
-static sem_t *g_slot_sems[IPC_MAX_SLOTS] = {};
+static std::string g_cache_file = IPC_CACHE_SNAPSHOT_FILE;   ///< Empty disables.
+static uint64_t g_snapshot_interval_sec = kDefaultSnapshotIntervalSec;   ///< 0: shutdown only.
+/* Cache contents at the last load or save; a snapshot is skipped if unchanged. */
+static uint64_t g_snapshot_fingerprint = 0;
 
-static uint64_t next_server_generation()
+/*
+ * Regex misses only grow and published interns are never removed, so their
+ * sum changes whenever either cache gained an entry.
+ */
+static uint64_t cache_fingerprint(uint32_t interns)
 {
-    int fd = open(GENERATION_FILE, O_CREAT | O_RDWR, 0666);
-    if (fd < 0) {
-        return static_cast<uint64_t>(time(nullptr));
-    }
+    return g_regex_cache.misses() + interns;
+}
 
-    if (flock(fd, LOCK_EX) < 0) {
-        close(fd);
-        return static_cast<uint64_t>(time(nullptr));
+/* Published entries never change, so the table is copied without /ipc_mutex. */
+static CacheSnapshot collect_cache_snapshot()
+{
+    CacheSnapshot snap;
+    for (uint32_t id = 0; id < IPC_INTERN_CAPACITY; ++id) {
+        const InternEntry &entry = g_shm->interns[id];
+        if (!(__atomic_load_n(&entry.tag, __ATOMIC_ACQUIRE) & IPC_INTERN_READY))
+            continue;
+        SnapshotIntern rec{};
+        rec.id = id;
+        memcpy(&rec.entry, &entry, sizeof(entry));
+        snap.interns.push_back(rec);
     }
+    snap.patterns = g_regex_cache.patterns();
+    return snap;
+}
 
-    uint64_t gen = 0;
-    ssize_t n = read(fd, &gen, sizeof(gen));
-    if (n != static_cast<ssize_t>(sizeof(gen))) {
-        gen = 0;
+/* Called by the snapshot thread and, after it has exited, at shutdown. */
+static void save_cache_snapshot()
+{
+    if (g_cache_file.empty())
+        return;
+    CacheSnapshot snap = collect_cache_snapshot();
+    uint64_t fingerprint = cache_fingerprint(static_cast<uint32_t>(snap.interns.size()));
+    if (fingerprint == g_snapshot_fingerprint)
+        return;
+    std::string error;
+    if (!cache_snapshot_save(g_cache_file.c_str(), snap, &error)) {
+        fprintf(stderr, "[SNAPSHOT] save failed: %s\n", error.c_str());
+        return;
     }
-    ++gen;
+    g_snapshot_fingerprint = fingerprint;
+    printf("[SNAPSHOT] saved %zu interned string(s) and %zu regex pattern(s) to %s\n",
+           snap.interns.size(), snap.patterns.size(), g_cache_file.c_str());
+    fflush(stdout);
+}
 
-    lseek(fd, 0, SEEK_SET);
-    ssize_t written = write(fd, &gen, sizeof(gen));
-    if (written == static_cast<ssize_t>(sizeof(gen))) {
-        ftruncate(fd, sizeof(gen));
+/*
+ * Restore a snapshot before the generation is published, so no client can
+ * intern concurrently. Interned strings go back under their old ids (clients
+ * keep using ids from before the restart) with their search tables rebuilt;
+ * patterns are recompiled into the regex cache.
+ */
+static void load_cache_snapshot()
+{
+    if (g_cache_file.empty())
+        return;
+    struct stat st;
+    if (stat(g_cache_file.c_str(), &st) != 0)
+        return;   // first start: nothing saved yet
+    CacheSnapshot snap;
+    std::string error;
+    if (!cache_snapshot_load(g_cache_file.c_str(), &snap, &error)) {
+        fprintf(stderr, "[SNAPSHOT] ignoring %s: %s; starting cold\n", g_cache_file.c_str(),
+                error.c_str());
+        return;
     }
-
-    flock(fd, LOCK_UN);
-    close(fd);
-    return gen;
+    for (const SnapshotIntern &rec : snap.interns) {
+        g_shm->interns[rec.id] = rec.entry;
+        intern_search_table(rec.id, rec.entry);
+    }
+    size_t patterns = g_regex_cache.preload(snap.patterns);
+    g_snapshot_fingerprint = cache_fingerprint(static_cast<uint32_t>(snap.interns.size()));
+    printf("[SNAPSHOT] loaded %zu interned string(s) and %zu regex pattern(s) from %s\n",
+           snap.interns.size(), patterns, g_cache_file.c_str());
+    fflush(stdout);
 }
 
-static size_t default_threads_per_pool()
+static void cache_snapshotter()
 {
-    unsigned hw = std::thread::hardware_concurrency();
-    if (hw <= 2)
-        return 1;
-    return (hw - 1) / 2;
+    std::unique_lock<std::mutex> lock(g_monitor_mutex);
+    while (!g_monitor_cv.wait_for(lock, std::chrono::seconds(g_snapshot_interval_sec),
+                                  [] { return !g_running.load(); })) {
+        lock.unlock();
+        save_cache_snapshot();
+        lock.lock();
+    }
 }
 
 /* ================================================================== */
-/*  Signal handler                                                     */
+/*  Status reporter                                                    */
 /* ================================================================== */
 
-static void signal_handler(int /*sig*/)
+struct StatusSources {
+    time_t            start_time;
+    const ThreadPool *math_pool;
+    const ThreadPool *string_pool;
+};
+
+/** One status report; every field comes from an atomic counter or load. */
+struct StatusSnapshot {
+    long       uptime;
+    size_t     math_threads;
+    size_t     string_threads;
+    size_t     math_pending;
+    size_t     string_pending;
+    size_t     math_stuck;
+    size_t     string_stuck;
+    uint64_t   workers_replaced;
+    int        free_slots;
+    int        reserved_slots;
+    int        pending_slots;
+    int        proc_slots;
+    int        ready_slots;
+    uint64_t   dispatched;
+    uint64_t   completed;
+    ArenaStats arena;
+    uint32_t   clients;
+    uint64_t   clients_reaped;
+    size_t     regex_size;
+    size_t     regex_capacity;
+    uint64_t   regex_hits;
+    uint64_t   regex_misses;
+};
+
+static void gather_status(const StatusSources &src, StatusSnapshot *out)
 {
-    g_running.store(false);
-    if (g_server_sem)
-        sem_post(g_server_sem);
+    memset(out, 0, sizeof(*out));
+    out->uptime = static_cast<long>(difftime(time(nullptr), src.start_time));
+    out->math_threads = src.math_pool->thread_count();
+    out->string_threads = src.string_pool->thread_count();
+    out->math_pending = src.math_pool->pending_count();
+    out->string_pending = src.string_pool->pending_count();
+    out->math_stuck = src.math_pool->stuck_count();
+    out->string_stuck = src.string_pool->stuck_count();
+    out->workers_replaced = src.math_pool->replaced_count() + src.string_pool->replaced_count();
+    // Slot states are read one by one without /ipc_mutex; the counts are a
+    // close, not an exact, picture of a busy server.
+    for (const MessageSlot &slot : g_shm->slots) {
+        switch (__atomic_load_n(&slot.state, __ATOMIC_RELAXED)) {
+        case IPC_SLOT_FREE:            ++out->free_slots;     break;
+        case IPC_SLOT_RESERVED:        ++out->reserved_slots; break;
+        case IPC_SLOT_CLAIMED:
+        case IPC_SLOT_REQUEST_PENDING: ++out->pending_slots;  break;
+        case IPC_SLOT_PROCESSING:      ++out->proc_slots;     break;
+        case IPC_SLOT_RESPONSE_READY:  ++out->ready_slots;    break;
+        }
+    }
+    out->dispatched = g_requests_dispatched.load(std::memory_order_relaxed);
+    out->completed = g_requests_completed.load(std::memory_order_relaxed);
+    arena_stats(g_shm, &out->arena);
+    for (const ClientEntry &entry : g_shm->clients) {
+        if (__atomic_load_n(&entry.state, __ATOMIC_RELAXED) == IPC_CLIENT_ACTIVE)
+            ++out->clients;
+    }
+    out->clients_reaped = g_clients_reaped.load(std::memory_order_relaxed);
+    out->regex_size = g_regex_cache.size();
+    out->regex_capacity = g_regex_cache.capacity();
+    out->regex_hits = g_regex_cache.hits();
+    out->regex_misses = g_regex_cache.misses();
 }
 
-static void status_handler(int /*sig*/)
+static const char *shutdown_mode_name(ShutdownMode mode)
 {
-    g_status_requested.store(true);
-    if (g_server_sem)
-        sem_post(g_server_sem);
+    return mode == ShutdownMode::Drain ? "drain" : "immediate";
+}
+
+static void print_status_text(const StatusSnapshot &st)
+{
+    printf("[STATUS] PID=%d, uptime=%ldh%02ldm%02lds, mode=%s, "
+           "threads: %zu math, %zu string\n",
+           getpid(), st.uptime / 3600, (st.uptime % 3600) / 60, st.uptime % 60,
+           shutdown_mode_name(g_shutdown_mode), st.math_threads, st.string_threads);
+    printf("[STATUS] math_pool: %zu pending, string_pool: %zu pending\n",
+           st.math_pending, st.string_pending);
+    printf("[STATUS] watchdog: %zu math, %zu string worker(s) stuck, %llu replaced\n",
+           st.math_stuck, st.string_stuck,
+           static_cast<unsigned long long>(st.workers_replaced));
+    printf("[STATUS] slots: %d free, %d reserved, %d pending, %d processing, %d ready\n",
+           st.free_slots, st.reserved_slots, st.pending_slots, st.proc_slots, st.ready_slots);
+    printf("[STATUS] requests: %llu dispatched, %llu completed\n",
+           static_cast<unsigned long long>(st.dispatched),
+           static_cast<unsigned long long>(st.completed));
+    printf("[STATUS] arena: %llu KiB free (largest >= %llu KiB), %u buffers, "
+           "%u slab chunks\n",
+           static_cast<unsigned long long>(st.arena.free_bytes / 1024),
+           static_cast<unsigned long long>(st.arena.largest_free / 1024),
+           st.arena.used_blocks, st.arena.slab_chunks);
+    printf("[STATUS] clients: %u registered, %llu reaped\n",
+           st.clients, static_cast<unsigned long long>(st.clients_reaped));
+    printf("[STATUS] regex cache: %zu/%zu patterns, %llu hits, %llu misses\n",
+           st.regex_size, st.regex_capacity,
+           static_cast<unsigned long long>(st.regex_hits),
+           static_cast<unsigned long long>(st.regex_misses));
+}
+
+/* One JSON object on one line, for log scrapers and `ipcctl status`. */
+static std::string format_status_json(const StatusSnapshot &st)
+{
+    char buf[1536];
+    snprintf(buf, sizeof(buf),
+           "{\"pid\":%d,\"uptime_s\":%ld,\"mode\":\"%s\","
+           "\"threads\":{\"math\":%zu,\"string\":%zu},"
+           "\"math_pending\":%zu,\"string_pending\":%zu,"
+           "\"watchdog\":{\"stuck\":{\"math\":%zu,\"string\":%zu},\"replaced\":%llu},"
+           "\"slots\":{\"free\":%d,\"reserved\":%d,\"pending\":%d,\"processing\":%d,"
+           "\"ready\":%d},"
+           "\"requests\":{\"dispatched\":%llu,\"completed\":%llu},"
+           "\"arena\":{\"free_bytes\":%llu,\"largest_free_min\":%llu,"
+           "\"used_blocks\":%u,\"slab_chunks\":%u},"
+           "\"clients\":{\"registered\":%u,\"reaped\":%llu},"
+           "\"regex_cache\":{\"size\":%zu,\"capacity\":%zu,\"hits\":%llu,"
+           "\"misses\":%llu}}",
+           getpid(), st.uptime, shutdown_mode_name(g_shutdown_mode),
+           st.math_threads, st.string_threads,
+           st.math_pending, st.string_pending,
+           st.math_stuck, st.string_stuck, static_cast<unsigned long long>(st.workers_replaced),
+           st.free_slots, st.reserved_slots, st.pending_slots, st.proc_slots, st.ready_slots,
+           static_cast<unsigned long long>(st.dispatched),
+           static_cast<unsigned long long>(st.completed),
+           static_cast<unsigned long long>(st.arena.free_bytes),
+           static_cast<unsigned long long>(st.arena.largest_free),
+           st.arena.used_blocks, st.arena.slab_chunks,
+           st.clients, static_cast<unsigned long long>(st.clients_reaped),
+           st.regex_size, st.regex_capacity,
+           static_cast<unsigned long long>(st.regex_hits),
+           static_cast<unsigned long long>(st.regex_misses));
+    return buf;
+}
+
+/*
+ * Reporter thread: sleeps on g_status_sem at SCHED_IDLE priority and prints a
+ * report per SIGUSR1. It reads only atomics, so neither gathering nor the
+ * stdout writes ever hold up the dispatcher or the workers.
+ */
+static void status_reporter(StatusSources src)
+{
+    sched_param param{};
+    pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+    while (true) {
+        if (sem_wait(&g_status_sem) != 0)
+            continue;   // EINTR
+        if (!g_running.load())
+            return;
+        StatusSnapshot st;
+        gather_status(src, &st);
+        StatusFormat format = g_status_format;
+        if (format != StatusFormat::Json)
+            print_status_text(st);
+        if (format != StatusFormat::Text)
+            printf("%s\n", format_status_json(st).c_str());
+        fflush(stdout);
+    }
 }
 
 /* ================================================================== */
-/*  Worker functions                                                   */
+/*  Control channel                                                    */
 /* ================================================================== */
 
-static void process_math(int slot_idx)
-{
-    sem_wait(g_mutex_sem);
-    MessageSlot *slot = &g_shm->slots[slot_idx];
-    ipc_cmd_t cmd = slot->command;
-    int32_t a = slot->request.math.a;
-    int32_t b = slot->request.math.b;
-    sem_post(g_mutex_sem);
+static constexpr size_t kMaxThreadsPerPool = 256;
 
-    if (cmd == IPC_CMD_MUL || cmd == IPC_CMD_DIV)
-        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+static const char *const kControlHelp =
+    "ok commands: get | status | clients | workers | set threads.math <1-256> | "
+    "set threads.string <1-256> | set shutdown drain|immediate | "
+    "set regex_cache <n> | set status_format text|json|both | set watchdog_ms <n>";
 
-    int32_t result = 0;
-    ipc_status_t status = IPC_STATUS_OK;
+/** Parse a decimal count in [min, max]; false on junk or out of range. */
+static bool parse_count(const std::string &text, size_t min, size_t max, size_t *out)
+{
+    if (text.empty() || text[0] == '-')
+        return false;
+    char *end = nullptr;
+    errno = 0;
+    unsigned long long val = strtoull(text.c_str(), &end, 10);
+    if (errno != 0 || *end != '\0' || val < min || val > max)
+        return false;
+    *out = static_cast<size_t>(val);
+    return true;
+}
 
-    switch (cmd) {
-    case IPC_CMD_ADD: result = a + b; break;
-    case IPC_CMD_SUB: result = a - b; break;
-    case IPC_CMD_MUL: result = a * b; break;
-    case IPC_CMD_DIV:
-        if (b == 0) {
-            status = IPC_STATUS_DIV_BY_ZERO;
-        } else {
-            result = a / b;
-        }
-        break;
-    default:
-        status = IPC_STATUS_INVALID_INPUT;
-        break;
+static const char *status_format_name(StatusFormat format)
+{
+    switch (format) {
+    case StatusFormat::Json: return "json";
+    case StatusFormat::Both: return "both";
+    default:                 return "text";
     }
+}
 
-    sem_wait(g_mutex_sem);
-    slot->response.math_result = result;
-    slot->status = status;
-    slot->state = IPC_SLOT_RESPONSE_READY;
-    sem_post(g_mutex_sem);
-
-    if (cmd == IPC_CMD_ADD || cmd == IPC_CMD_SUB)
-        sem_post(g_slot_sems[slot_idx]);
+static std::string control_settings(const StatusSources &src)
+{
+    char buf[256];
+    snprintf(buf, sizeof(buf),
+             "ok threads.math=%zu threads.string=%zu shutdown=%s regex_cache=%zu "
+             "status_format=%s watchdog_ms=%llu",
+             src.math_pool->thread_count(), src.string_pool->thread_count(),
+             shutdown_mode_name(g_shutdown_mode), g_regex_cache.capacity(),
+             status_format_name(g_status_format),
+             static_cast<unsigned long long>(g_watchdog_ms.load()));
+    return buf;
 }
 
-static void process_string(int slot_idx)
+static constexpr size_t kMaxListedClients = 16;
+
+/* Registered clients, busiest first: "ok N registered; pid=.. requests=.. ...". */
+static std::string control_clients()
 {
-    sem_wait(g_mutex_sem);
-    MessageSlot *slot = &g_shm->slots[slot_idx];
-    ipc_cmd_t cmd = slot->command;
-    char s1[IPC_MAX_STRING_LEN + 1];
-    char s2[IPC_MAX_STRING_LEN + 1];
-    strncpy(s1, slot->request.str.s1, IPC_MAX_STRING_LEN + 1);
-    strncpy(s2, slot->request.str.s2, IPC_MAX_STRING_LEN + 1);
-    s1[IPC_MAX_STRING_LEN] = '\0';
-    s2[IPC_MAX_STRING_LEN] = '\0';
-    sem_post(g_mutex_sem);
+    std::vector<const ClientEntry *> active;
+    for (const ClientEntry &entry : g_shm->clients) {
+        if (__atomic_load_n(&entry.state, __ATOMIC_ACQUIRE) == IPC_CLIENT_ACTIVE)
+            active.push_back(&entry);
+    }
+    auto requests = [](const ClientEntry *e) {
+        return __atomic_load_n(&e->requests, __ATOMIC_RELAXED);
+    };
+    size_t listed = std::min(active.size(), kMaxListedClients);
+    std::partial_sort(active.begin(), active.begin() + listed, active.end(),
+                      [&](const ClientEntry *a, const ClientEntry *b) {
+                          return requests(a) > requests(b);
+                      });
 
-    ipc_status_t status = IPC_STATUS_OK;
-    ResponsePayload resp;
-    memset(&resp, 0, sizeof(resp));
+    uint64_t epoch = __atomic_load_n(&g_shm->client_epoch, __ATOMIC_RELAXED);
+    std::string reply = "ok " + std::to_string(active.size()) + " registered";
+    for (size_t i = 0; i < listed; ++i) {
+        const ClientEntry *e = active[i];
+        uint64_t heartbeat = __atomic_load_n(&e->heartbeat, __ATOMIC_RELAXED);
+        char buf[160];
+        snprintf(buf, sizeof(buf), "; pid=%d requests=%llu arena_allocs=%llu idle=%llu",
+                 static_cast<int>(e->pid), static_cast<unsigned long long>(requests(e)),
+                 static_cast<unsigned long long>(
+                     __atomic_load_n(&e->arena_allocs, __ATOMIC_RELAXED)),
+                 static_cast<unsigned long long>(epoch > heartbeat ? epoch - heartbeat : 0));
+        reply += buf;
+    }
+    if (listed < active.size())
+        reply += "; ...";
+    return reply;
+}
 
-    size_t len1 = strlen(s1);
-    size_t len2 = strlen(s2);
-    if (ipc_validate_string(s1) != 0 || ipc_validate_string(s2) != 0) {
-        status = IPC_STATUS_STR_TOO_LONG;
-    } else if (cmd == IPC_CMD_CONCAT) {
-        if (len1 + len2 > IPC_MAX_RESULT_LEN - 1) {
-            status = IPC_STATUS_STR_TOO_LONG;
-        } else {
-            snprintf(resp.str_result, IPC_MAX_RESULT_LEN, "%s%s", s1, s2);
-        }
-    } else if (cmd == IPC_CMD_SEARCH) {
-        const char *pos = strstr(s1, s2);
-        if (pos) {
-            resp.position = static_cast<int32_t>(pos - s1);
-        } else {
-            resp.position = -1;
-            status = IPC_STATUS_NOT_FOUND;
+/* Worker states per pool: "ok math: idle 12ms, busy 840ms (slot 3); string: ...". */
+static std::string control_workers(ThreadPool &math_pool, ThreadPool &string_pool)
+{
+    std::string reply = "ok";
+    for (auto [name, pool] : {std::pair<const char *, ThreadPool *>{"math", &math_pool},
+                              std::pair<const char *, ThreadPool *>{"string", &string_pool}}) {
+        reply += reply.size() > 2 ? "; " : " ";
+        reply += name;
+        reply += ":";
+        bool first = true;
+        for (const WorkerInfo &w : pool->workers()) {
+            char buf[80];
+            if (w.busy_ns == 0)
+                snprintf(buf, sizeof(buf), "idle %llums",
+                         static_cast<unsigned long long>(w.idle_ns / 1'000'000));
+            else
+                snprintf(buf, sizeof(buf), "%s %llums (slot %d)",
+                         w.set_aside ? "stuck" : w.retiring ? "retiring" : "busy",
+                         static_cast<unsigned long long>(w.busy_ns / 1'000'000), w.slot_index);
+            reply += first ? " " : ", ";
+            reply += buf;
+            first = false;
         }
-    } else {
-        status = IPC_STATUS_INVALID_INPUT;
     }
+    return reply;
+}
 
-    sem_wait(g_mutex_sem);
-    slot->response = resp;
-    slot->status = status;
-    slot->state = IPC_SLOT_RESPONSE_READY;
-    sem_post(g_mutex_sem);
+/**
+ * @brief Apply one control-socket command (see kControlHelp).
+ *
+ * Runs on the control thread and takes effect immediately; retiring workers
+ * finish their current task after the reply. Replies start with "ok" or
+ * "error:".
+ */
+static std::string handle_control_command(const std::string &line, ThreadPool &math_pool,
+                                          ThreadPool &string_pool, const StatusSources &src)
+{
+    std::istringstream in(line);
+    std::string verb, key, value, extra;
+    in >> verb >> key >> value >> extra;
 
-    // String operations are async-only in this project and are collected via polling.
+    if (verb == "help")
+        return kControlHelp;
+    if (verb == "get" && key.empty())
+        return control_settings(src);
+    if (verb == "status" && key.empty()) {
+        StatusSnapshot st;
+        gather_status(src, &st);
+        return "ok " + format_status_json(st);
+    }
+    if (verb == "clients" && key.empty())
+        return control_clients();
+    if (verb == "workers" && key.empty())
+        return control_workers(math_pool, string_pool);
+    if (verb != "set")
+        return "error: unknown command '" + verb + "' (try help)";
+    if (value.empty() || !extra.empty())
+        return "error: usage: set <key> <value>";
+
+    if (key == "threads.math" || key == "threads.string") {
+        size_t n = 0;
+        if (!parse_count(value, 1, kMaxThreadsPerPool, &n))
+            return "error: thread count must be 1-256";
+        ThreadPool &pool = (key == "threads.math") ? math_pool : string_pool;
+        if (!pool.resize(n))
+            return "error: server is shutting down";
+    } else if (key == "shutdown") {
+        if (value == "drain")
+            g_shutdown_mode = ShutdownMode::Drain;
+        else if (value == "immediate")
+            g_shutdown_mode = ShutdownMode::Immediate;
+        else
+            return "error: shutdown must be drain or immediate";
+    } else if (key == "regex_cache") {
+        size_t n = 0;
+        if (!parse_count(value, 0, SIZE_MAX, &n))
+            return "error: regex_cache must be a non-negative count";
+        g_regex_cache.set_capacity(n);
+    } else if (key == "watchdog_ms") {
+        size_t n = 0;
+        if (!parse_count(value, 0, SIZE_MAX, &n))
+            return "error: watchdog_ms must be a non-negative count (0 disables)";
+        g_watchdog_ms = n;
+    } else if (key == "status_format") {
+        if (value == "text")
+            g_status_format = StatusFormat::Text;
+        else if (value == "json")
+            g_status_format = StatusFormat::Json;
+        else if (value == "both")
+            g_status_format = StatusFormat::Both;
+        else
+            return "error: status_format must be text, json or both";
+    } else {
+        return "error: unknown setting '" + key + "'";
+    }
+    printf("[CONTROL] set %s %s\n", key.c_str(), value.c_str());
+    fflush(stdout);
+    return control_settings(src);
 }
 
 /* ================================================================== */
-/*  Cleanup                                                            */
+/*  Real-time scheduling and memory locking                            */
 /* ================================================================== */
 
-static void cleanup_ipc(void)
+/** Scheduling wanted for one group of server threads; priority 0 keeps SCHED_OTHER. */
+struct RtRole {
+    const char       *name;
+    int               priority;
+    std::atomic<bool> warned{false};   ///< A failure to switch was reported already.
+};
+
+static int    g_rt_policy = SCHED_FIFO;
+static RtRole g_rt_dispatcher{"dispatcher", 0};
+static RtRole g_rt_math{"math", 0};
+static RtRole g_rt_string{"string", 0};
+static bool   g_mlock = false;
+
+/** Top of each server thread's stack touched up front under --mlock. */
+static constexpr size_t kStackPrefaultBytes = 256 * 1024;
+
+static constexpr int kCapIpcLock = 14;   // linux/capability.h
+static constexpr int kCapSysNice = 23;
+
+static const char *rt_policy_name(int policy)
 {
-    for (int i = 0; i < IPC_MAX_SLOTS; ++i) {
-        if (g_slot_sems[i] && g_slot_sems[i] != SEM_FAILED) {
-            sem_close(g_slot_sems[i]);
-            char name[64];
-            ipc_slot_sem_name(i, name, sizeof(name));
-            sem_unlink(name);
-        }
-    }
-    if (g_server_sem && g_server_sem != SEM_FAILED) {
-        sem_close(g_server_sem);
-        sem_unlink(IPC_SERVER_SEM_NAME);
-    }
-    if (g_mutex_sem && g_mutex_sem != SEM_FAILED) {
-        sem_close(g_mutex_sem);
-        sem_unlink(IPC_MUTEX_NAME);
-    }
-    if (g_shm && g_shm != MAP_FAILED) {
-        munmap(g_shm, sizeof(SharedMemoryLayout));
+    return policy == SCHED_RR ? "SCHED_RR" : "SCHED_FIFO";
+}
+
+/* Effective capability bit, read from /proc so the server needs no libcap. */
+static bool has_capability(int cap)
+{
+    FILE *f = fopen("/proc/self/status", "r");
+    if (!f)
+        return false;
+    char line[256];
+    unsigned long long caps = 0;
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "CapEff: %llx", &caps) == 1)
+            break;
     }
-    if (g_shm_fd >= 0) {
-        close(g_shm_fd);
+    fclose(f);
+    return (caps >> cap) & 1u;
+}
+
+/* Why @p role's priority cannot be granted, or an empty string if it can. */
+static std::string rt_denied_reason(const RtRole &role)
+{
+    if (has_capability(kCapSysNice))
+        return "";
+    rlimit rl{};
+    getrlimit(RLIMIT_RTPRIO, &rl);
+    if (rl.rlim_cur == RLIM_INFINITY || rl.rlim_cur >= static_cast<rlim_t>(role.priority))
+        return "";
+    return "needs CAP_SYS_NICE or RLIMIT_RTPRIO >= " + std::to_string(role.priority) +
+           ", limit is " + std::to_string(rl.rlim_cur);
+}
+
+/* Switch the calling thread to @p role's policy; a failure is reported once per role. */
+static void apply_rt_role(RtRole &role)
+{
+    if (role.priority == 0)
+        return;
+    sched_param param{};
+    param.sched_priority = role.priority;
+    int rc = pthread_setschedparam(pthread_self(), g_rt_policy, &param);
+    if (rc != 0 && !role.warned.exchange(true))
+        fprintf(stderr, "[RT] %s: cannot switch to %s/%d: %s; staying on SCHED_OTHER\n",
+                role.name, rt_policy_name(g_rt_policy), role.priority, strerror(rc));
+}
+
+/* Fault in the top of the calling thread's stack before it serves requests. */
+__attribute__((noinline)) static void prefault_stack()
+{
+    volatile char stack[kStackPrefaultBytes];
+    for (size_t i = 0; i < sizeof(stack); i += 4096)
+        stack[i] = 0;
+}
+
+/* Runs first on every pool worker of @p role. */
+static void init_server_thread(RtRole &role)
+{
+    if (g_mlock)
+        prefault_stack();
+    apply_rt_role(role);
+}
+
+/*
+ * Lock what is mapped now -- code, heap and the shared segment -- and make
+ * later mappings lock on fault, so thread stacks are not pinned in full; the
+ * part a thread uses is made resident by prefault_stack(). Kernels without
+ * MCL_ONFAULT lock future mappings in full. Without CAP_IPC_LOCK the
+ * memlock limit must be unlimited: a finite one could make a later thread
+ * creation fail instead of the server starting unlocked.
+ */
+static bool lock_memory(std::string *why)
+{
+    rlimit rl{};
+    getrlimit(RLIMIT_MEMLOCK, &rl);
+    if (!has_capability(kCapIpcLock) && rl.rlim_cur != RLIM_INFINITY) {
+        *why = "needs CAP_IPC_LOCK or an unlimited RLIMIT_MEMLOCK, limit is " +
+               std::to_string(rl.rlim_cur / 1024) + " KiB";
+        return false;
     }
-    shm_unlink(IPC_SHM_NAME);
-    if (g_lock_fd >= 0) {
-        unlink(LOCK_FILE);
-        close(g_lock_fd);
+    if (mlockall(MCL_CURRENT) != 0) {
+        *why = strerror(errno);
+        return false;
     }
+#ifdef MCL_ONFAULT
+    if (mlockall(MCL_CURRENT | MCL_FUTURE | MCL_ONFAULT) == 0)
+        return true;
+#endif
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) == 0)
+        return true;
+    *why = strerror(errno);
+    munlockall();
+    return false;
+}
+
+/* One role for the startup banner, e.g. "math SCHED_FIFO/70". */
+static std::string describe_rt_role(const RtRole &role)
+{
+    if (role.priority == 0)
+        return std::string(role.name) + " SCHED_OTHER";
+    return std::string(role.name) + " " + rt_policy_name(g_rt_policy) + "/" +
+           std::to_string(role.priority);
 }
 
 /* ================================================================== */
@@ -316,12 +2310,16 @@ static void cleanup_ipc(void)
 int main(int argc, const char *argv[])
 {
     /* --- Parse command-line flags --- */
-    size_t threads_per_pool = default_threads_per_pool();
+    size_t threads_per_pool = 0;  // 0: sized from the CPU budget
+    bool calibrate = false;
+    const char *control_path = IPC_CONTROL_SOCKET;
     for (int i = 1; i < argc; ++i) {
         if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
             int val = atoi(argv[++i]);
             if (val > 0)
                 threads_per_pool = static_cast<size_t>(val);
+        } else if (strcmp(argv[i], "--calibrate") == 0) {
+            calibrate = true;
         } else if (strncmp(argv[i], "--shutdown=", 11) == 0) {
             const char *mode = argv[i] + 11;
             if (strcmp(mode, "immediate") == 0)
@@ -332,6 +2330,90 @@ int main(int argc, const char *argv[])
                 fprintf(stderr, "Unknown shutdown mode: %s (use drain or immediate)\n", mode);
                 return 1;
             }
+        } else if (strncmp(argv[i], "--regex-cache=", 14) == 0) {
+            char *end = nullptr;
+            long val = strtol(argv[i] + 14, &end, 10);
+            if (end == argv[i] + 14 || *end != '\0' || val < 0) {
+                fprintf(stderr, "Invalid --regex-cache value: %s\n", argv[i] + 14);
+                return 1;
+            }
+            g_regex_cache.set_capacity(static_cast<size_t>(val));
+        } else if (strncmp(argv[i], "--status-format=", 16) == 0) {
+            const char *format = argv[i] + 16;
+            if (strcmp(format, "text") == 0)
+                g_status_format = StatusFormat::Text;
+            else if (strcmp(format, "json") == 0)
+                g_status_format = StatusFormat::Json;
+            else if (strcmp(format, "both") == 0)
+                g_status_format = StatusFormat::Both;
+            else {
+                fprintf(stderr, "Unknown status format: %s (use text, json or both)\n", format);
+                return 1;
+            }
+        } else if (strncmp(argv[i], "--watchdog-ms=", 14) == 0) {
+            char *end = nullptr;
+            long long val = strtoll(argv[i] + 14, &end, 10);
+            if (end == argv[i] + 14 || *end != '\0' || val < 0) {
+                fprintf(stderr, "Invalid --watchdog-ms value: %s\n", argv[i] + 14);
+                return 1;
+            }
+            g_watchdog_ms = static_cast<uint64_t>(val);
+        } else if (strncmp(argv[i], "--control=", 10) == 0) {
+            // An empty path disables the control socket.
+            control_path = argv[i] + 10;
+        } else if (strncmp(argv[i], "--cache-file=", 13) == 0) {
+            // An empty path disables cache snapshots.
+            g_cache_file = argv[i] + 13;
+        } else if (strncmp(argv[i], "--snapshot-interval=", 20) == 0) {
+            char *end = nullptr;
+            long long val = strtoll(argv[i] + 20, &end, 10);
+            if (end == argv[i] + 20 || *end != '\0' || val < 0) {
+                fprintf(stderr, "Invalid --snapshot-interval value: %s\n", argv[i] + 20);
+                return 1;
+            }
+            g_snapshot_interval_sec = static_cast<uint64_t>(val);
+        } else if (strncmp(argv[i], "--rt-policy=", 12) == 0) {
+            const char *policy = argv[i] + 12;
+            if (strcmp(policy, "fifo") == 0)
+                g_rt_policy = SCHED_FIFO;
+            else if (strcmp(policy, "rr") == 0)
+                g_rt_policy = SCHED_RR;
+            else {
+                fprintf(stderr, "Unknown real-time policy: %s (use fifo or rr)\n", policy);
+                return 1;
+            }
+        } else if (strncmp(argv[i], "--rt-", 5) == 0 && strchr(argv[i], '=')) {
+            std::string name(argv[i] + 5, strchr(argv[i], '='));
+            RtRole *role = name == "dispatcher" ? &g_rt_dispatcher
+                         : name == "math"       ? &g_rt_math
+                         : name == "string"     ? &g_rt_string
+                                                : nullptr;
+            const char *value = strchr(argv[i], '=') + 1;
+            char *end = nullptr;
+            long val = strtol(value, &end, 10);
+            if (!role || end == value || *end != '\0' || val < 0 || val > 99) {
+                fprintf(stderr, "Invalid %s (use --rt-dispatcher|math|string=0..99)\n",
+                        argv[i]);
+                return 1;
+            }
+            role->priority = static_cast<int>(val);
+        } else if (strcmp(argv[i], "--mlock") == 0) {
+            g_mlock = true;
+        }
+    }
+
+    /* --- Real-time checks: fall back to SCHED_OTHER rather than refuse to start --- */
+    for (RtRole *role : {&g_rt_dispatcher, &g_rt_math, &g_rt_string}) {
+        if (role->priority == 0)
+            continue;
+        std::string why = rt_denied_reason(*role);
+        if (role->priority < sched_get_priority_min(g_rt_policy) ||
+            role->priority > sched_get_priority_max(g_rt_policy))
+            why = "priority out of range";
+        if (!why.empty()) {
+            fprintf(stderr, "[RT] %s: %s/%d unavailable (%s); using SCHED_OTHER\n",
+                    role->name, rt_policy_name(g_rt_policy), role->priority, why.c_str());
+            role->priority = 0;
         }
     }
 
@@ -353,6 +2435,31 @@ int main(int argc, const char *argv[])
         close(g_lock_fd);
         return 1;
     }
+    if (ftruncate(g_lock_fd, 0) == 0)
+        dprintf(g_lock_fd, "%d\n", getpid());
+
+    /* --- Size the pools --- */
+    CpuBudget cpu_budget = cpu_budget_detect();
+    unsigned pool_cpus = cpu_budget.usable;
+    std::string sizing = cpu_budget_describe(cpu_budget);
+    if (calibrate && threads_per_pool != 0) {
+        sizing += "; calibration skipped (-t given)";
+    } else if (calibrate && pool_cpus == 1) {
+        sizing += "; calibration skipped (1 usable CPU)";
+    } else if (calibrate) {
+        std::string report;
+        pool_cpus = calibrate_cpus(pool_cpus, &report);
+        sizing += "; " + report;
+    }
+    size_t auto_threads = threads_for_cpus(pool_cpus);
+    if (threads_per_pool == 0) {
+        threads_per_pool = auto_threads;
+        sizing += "; threads/pool=" + std::to_string(threads_per_pool) +
+                  " ((CPUs - 1) / 2, at least 1)";
+    } else {
+        sizing += "; threads/pool=" + std::to_string(threads_per_pool) + " from -t (automatic: " +
+                  std::to_string(auto_threads) + ")";
+    }
 
     /* --- Create shared memory --- */
     g_shm_fd = shm_open(IPC_SHM_NAME, O_CREAT | O_RDWR, 0666);
@@ -377,9 +2484,15 @@ int main(int argc, const char *argv[])
     }
 
     uint64_t server_generation = next_server_generation();
-    memset(g_shm, 0, sizeof(SharedMemoryLayout));
-    g_shm->server_generation = server_generation;
-    g_shm->next_request_id = 1;
+    // Only the control structures need zeroing; the arena is described by a
+    // single free block spanning the whole region. The generation stays 0
+    // until the semaphores exist, which tells reconnecting clients to wait.
+    memset(g_shm, 0, offsetof(SharedMemoryLayout, arena));
+    // Ids carry the generation in their top bits, so an id from an earlier
+    // server never names a request of this one (clients remap old ids).
+    g_shm->next_request_id = ((server_generation & 0xFFFFFFu) << 40) | 1;
+    arena_init(g_shm);
+    load_cache_snapshot();
 
     /* --- Create semaphores --- */
     g_mutex_sem = sem_open(IPC_MUTEX_NAME, O_CREAT | O_EXCL, 0666, 1);
@@ -425,6 +2538,17 @@ int main(int argc, const char *argv[])
         }
     }
 
+    bool memory_locked = false;
+    if (g_mlock) {
+        std::string why;
+        memory_locked = lock_memory(&why);
+        if (!memory_locked)
+            fprintf(stderr, "[RT] mlockall unavailable (%s); memory stays pageable\n",
+                    why.c_str());
+    }
+
+    __atomic_store_n(&g_shm->server_generation, server_generation, __ATOMIC_RELEASE);
+
     /* --- Signal handling --- */
     struct sigaction sa;
     memset(&sa, 0, sizeof(sa));
@@ -434,6 +2558,7 @@ int main(int argc, const char *argv[])
     sigaction(SIGINT, &sa, nullptr);
     sigaction(SIGTERM, &sa, nullptr);
 
+    sem_init(&g_status_sem, 0, 0);
     struct sigaction sa_status;
     memset(&sa_status, 0, sizeof(sa_status));
     sa_status.sa_handler = status_handler;
@@ -444,82 +2569,97 @@ int main(int argc, const char *argv[])
     time_t start_time = time(nullptr);
 
     /* --- Thread pools --- */
-    ThreadPool math_pool(threads_per_pool, process_math);
-    ThreadPool string_pool(threads_per_pool, process_string);
+    ThreadPool math_pool(threads_per_pool, process_math,
+                         [] { init_server_thread(g_rt_math); });
+    ThreadPool string_pool(threads_per_pool, process_string,
+                           [] { init_server_thread(g_rt_string); });
+    StatusSources status_sources{start_time, &math_pool, &string_pool};
+    std::thread reporter(status_reporter, status_sources);
+    std::thread monitor(client_monitor);
+    std::thread watchdog(worker_watchdog, &math_pool, &string_pool);
+    std::thread snapshotter;
+    if (!g_cache_file.empty() && g_snapshot_interval_sec > 0)
+        snapshotter = std::thread(cache_snapshotter);
+
+    ControlServer control;
+    if (control_path[0] != '\0' &&
+        !control.start(control_path, [&](const std::string &line) {
+            return handle_control_command(line, math_pool, string_pool, status_sources);
+        })) {
+        fprintf(stderr, "server: continuing without a control socket\n");
+    }
 
     printf("Server started. PID=%d, generation=%llu, cores=%u, threads/pool=%zu, shutdown=%s. "
            "Waiting for requests...\n",
            getpid(), static_cast<unsigned long long>(server_generation),
-           std::thread::hardware_concurrency(), threads_per_pool,
+           cpu_budget.usable, threads_per_pool,
            (g_shutdown_mode == ShutdownMode::Drain) ? "drain" : "immediate");
+    printf("[SIZING] %s\n", sizing.c_str());
+    // Set last, so the helper threads above do not inherit the dispatcher's policy.
+    init_server_thread(g_rt_dispatcher);
+    if (g_mlock || g_rt_dispatcher.priority || g_rt_math.priority || g_rt_string.priority) {
+        printf("[RT] %s, %s, %s; memory %s\n", describe_rt_role(g_rt_dispatcher).c_str(),
+               describe_rt_role(g_rt_math).c_str(), describe_rt_role(g_rt_string).c_str(),
+               memory_locked ? "locked, stacks prefaulted" : "not locked");
+    }
     fflush(stdout);
 
     /* --- Dispatcher loop --- */
     while (g_running.load()) {
         sem_wait(g_server_sem);
 
-        if (g_status_requested.exchange(false)) {
-            time_t now = time(nullptr);
-            long uptime = static_cast<long>(difftime(now, start_time));
-            long hours = uptime / 3600;
-            long mins  = (uptime % 3600) / 60;
-            long secs  = uptime % 60;
-            const char *mode_str = (g_shutdown_mode == ShutdownMode::Drain)
-                                       ? "drain" : "immediate";
-
-            int free_slots = 0, pending_slots = 0, proc_slots = 0, ready_slots = 0;
-            sem_wait(g_mutex_sem);
-            for (int i = 0; i < IPC_MAX_SLOTS; ++i) {
-                switch (g_shm->slots[i].state) {
-                case IPC_SLOT_FREE:           ++free_slots;    break;
-                case IPC_SLOT_REQUEST_PENDING: ++pending_slots; break;
-                case IPC_SLOT_PROCESSING:      ++proc_slots;    break;
-                case IPC_SLOT_RESPONSE_READY:  ++ready_slots;   break;
-                }
-            }
-            sem_post(g_mutex_sem);
-
-            printf("[STATUS] PID=%d, uptime=%ldh%02ldm%02lds, mode=%s, "
-                   "threads/pool=%zu\n",
-                   getpid(), hours, mins, secs, mode_str, threads_per_pool);
-            printf("[STATUS] math_pool: %zu pending, string_pool: %zu pending\n",
-                   math_pool.pending_count(), string_pool.pending_count());
-            printf("[STATUS] slots: %d free, %d pending, %d processing, %d ready\n",
-                   free_slots, pending_slots, proc_slots, ready_slots);
-            fflush(stdout);
-        }
-
         if (!g_running.load())
             break;
 
         sem_wait(g_mutex_sem);
         for (int i = 0; i < IPC_MAX_SLOTS; ++i) {
-            if (g_shm->slots[i].state == IPC_SLOT_REQUEST_PENDING) {
+            // Magazine slots are published without the mutex (see libipc).
+            if (__atomic_load_n(&g_shm->slots[i].state, __ATOMIC_ACQUIRE) ==
+                IPC_SLOT_REQUEST_PENDING) {
                 g_shm->slots[i].state = IPC_SLOT_PROCESSING;
                 ipc_cmd_t cmd = g_shm->slots[i].command;
+                bool to_string_pool = is_string_command(cmd);
+                ThreadPool &pool = to_string_pool ? string_pool : math_pool;
+                uint32_t parts = request_parts(g_shm->slots[i], pool.thread_count());
+                uint64_t deadline_ns = g_shm->slots[i].deadline_ns;
+                uint8_t priority = g_shm->slots[i].priority;
+                g_result_buffers[i] = alloc_result_buffer(g_shm->slots[i]);
+                prepare_split_request(g_shm->slots[i], g_split_requests[i]);
+                g_requests_dispatched.fetch_add(1, std::memory_order_relaxed);
 
                 sem_post(g_mutex_sem);
 
-                switch (cmd) {
-                case IPC_CMD_ADD:
-                case IPC_CMD_SUB:
-                case IPC_CMD_MUL:
-                case IPC_CMD_DIV:
-                    math_pool.submit(i);
-                    break;
-                case IPC_CMD_CONCAT:
-                case IPC_CMD_SEARCH:
-                    string_pool.submit(i);
-                    break;
-                }
+                load_split_views(g_split_requests[i]);
+                g_parts_remaining[i].store(parts, std::memory_order_relaxed);
+                pool.submit_parts(i, parts, deadline_ns, priority);
 
                 sem_wait(g_mutex_sem);
             }
         }
         sem_post(g_mutex_sem);
+
+        for (int i = 0; i < IPC_MAX_STREAMS; ++i) {
+            if (__atomic_load_n(&g_shm->streams[i].doorbell, __ATOMIC_RELAXED) &&
+                __atomic_exchange_n(&g_shm->streams[i].doorbell, 0u, __ATOMIC_ACQUIRE))
+                math_pool.submit_stream(i);
+        }
     }
 
     /* --- Shutdown --- */
+    control.stop();
+    signal(SIGUSR1, SIG_IGN);
+    sem_post(&g_status_sem);
+    reporter.join();
+    sem_destroy(&g_status_sem);
+    {
+        std::lock_guard<std::mutex> lock(g_monitor_mutex);
+    }
+    g_monitor_cv.notify_all();
+    monitor.join();
+    watchdog.join();
+    if (snapshotter.joinable())
+        snapshotter.join();
+
     size_t pending = math_pool.pending_count() + string_pool.pending_count();
 
     if (g_shutdown_mode == ShutdownMode::Drain) {
@@ -537,6 +2677,7 @@ int main(int argc, const char *argv[])
         printf("Discarded %zu task(s).\n", discarded_math + discarded_string);
     }
 
+    save_cache_snapshot();
     cleanup_ipc();
     printf("Server shut down cleanly.\n");
 
@@ -0,0 +1,112 @@
+/**
+ * @file stream_stats.cpp
+ * @brief StreamAggregate: running count/sum/min/max and histogram quantiles.
+ *
+ * Bucket layout (per sign, by magnitude u): u < 16 maps to its own bucket;
+ * larger u maps to 16 + (e - 4) * 8 + m, where e is the index of the top set
+ * bit and m the next three bits. Negative buckets are stored mirrored below
+ * the non-negative ones so bucket order equals value order.
+ */
+#include "stream_stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace {
+
+int magnitude_bucket(uint32_t u)
+{
+    if (u < 16)
+        return static_cast<int>(u);
+    int e = 31 - __builtin_clz(u);
+    int m = static_cast<int>((u >> (e - 3)) & 7u);
+    return 16 + (e - 4) * 8 + m;
+}
+
+int64_t magnitude_value(int bucket)
+{
+    if (bucket < 16)
+        return bucket;
+    int e = 4 + (bucket - 16) / 8;
+    int m = (bucket - 16) % 8;
+    int64_t low = static_cast<int64_t>(8 + m) << (e - 3);
+    int64_t width = int64_t{1} << (e - 3);
+    return low + width / 2;
+}
+
+} // namespace
+
+void StreamAggregate::reset()
+{
+    count_ = 0;
+    sum_ = 0;
+    min_ = std::numeric_limits<int32_t>::max();
+    max_ = std::numeric_limits<int32_t>::min();
+    memset(hist_, 0, sizeof(hist_));
+}
+
+int StreamAggregate::bucket_of(int32_t v)
+{
+    if (v >= 0)
+        return kBucketsPerSign + magnitude_bucket(static_cast<uint32_t>(v));
+    uint32_t u = 0u - static_cast<uint32_t>(v);
+    return kBucketsPerSign - 1 - magnitude_bucket(u);
+}
+
+int32_t StreamAggregate::bucket_value(int bucket)
+{
+    int64_t v = bucket >= kBucketsPerSign
+                    ? magnitude_value(bucket - kBucketsPerSign)
+                    : -magnitude_value(kBucketsPerSign - 1 - bucket);
+    return static_cast<int32_t>(std::clamp<int64_t>(
+        v, std::numeric_limits<int32_t>::min(), std::numeric_limits<int32_t>::max()));
+}
+
+void StreamAggregate::add(const int32_t *values, size_t n)
+{
+    int64_t sum = 0;
+    int32_t lo = min_;
+    int32_t hi = max_;
+    for (size_t i = 0; i < n; ++i) {
+        int32_t v = values[i];
+        sum += v;
+        lo = std::min(lo, v);
+        hi = std::max(hi, v);
+        ++hist_[bucket_of(v)];
+    }
+    count_ += n;
+    sum_ += sum;
+    min_ = lo;
+    max_ = hi;
+}
+
+int32_t StreamAggregate::quantile(double q) const
+{
+    // Nearest-rank: the smallest value with at least ceil(q * count) values
+    // at or below it.
+    uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(q * count_)));
+    uint64_t seen = 0;
+    for (int b = 0; b < kBuckets; ++b) {
+        seen += hist_[b];
+        if (seen >= rank)
+            return std::clamp(bucket_value(b), min_, max_);
+    }
+    return max_;
+}
+
+void StreamAggregate::snapshot(StreamStats *out) const
+{
+    memset(out, 0, sizeof(*out));
+    if (count_ == 0)
+        return;
+    out->count = count_;
+    out->sum = sum_;
+    out->mean = static_cast<double>(sum_) / static_cast<double>(count_);
+    out->min = min_;
+    out->max = max_;
+    out->p50 = quantile(0.50);
+    out->p90 = quantile(0.90);
+    out->p99 = quantile(0.99);
+}
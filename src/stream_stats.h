@@ -0,0 +1,46 @@
+/**
+ * @file stream_stats.h
+ * @brief Incremental aggregates for streaming channels (server side).
+ *
+ * StreamAggregate keeps count, sum, min, max and a log-linear histogram of
+ * int32 values, updated in batches as the server drains a stream ring.
+ * Quantiles are read off the histogram, so memory and update cost stay
+ * constant no matter how many values a stream carries.
+ */
+#ifndef STREAM_STATS_H
+#define STREAM_STATS_H
+
+#include "ipc_defs.h"
+
+#include <cstddef>
+#include <cstdint>
+
+class StreamAggregate {
+public:
+    /** Buckets per sign: 16 exact values, then 8 per power of two up to 2^31. */
+    static constexpr int kBucketsPerSign = 16 + 28 * 8;
+    static constexpr int kBuckets = 2 * kBucketsPerSign;
+
+    StreamAggregate() { reset(); }
+
+    void reset();
+
+    /** Fold @p n values into the aggregate. */
+    void add(const int32_t *values, size_t n);
+
+    /** Fill @p out with the current aggregates and p50/p90/p99. */
+    void snapshot(StreamStats *out) const;
+
+private:
+    static int     bucket_of(int32_t v);
+    static int32_t bucket_value(int bucket);
+    int32_t        quantile(double q) const;
+
+    uint64_t count_;
+    int64_t  sum_;
+    int32_t  min_;
+    int32_t  max_;
+    uint64_t hist_[kBuckets];
+};
+
+#endif /* STREAM_STATS_H */
@@ -0,0 +1,415 @@
+/**
+ * @file string_bulk.cpp
+ * @brief Bulk string kernels: MSD radix sort, hash-set dedupe, CRC32C/xxHash32
+ *        and multi-needle search.
+ */
+#include "string_bulk.h"
+#include "ipc_defs.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <nmmintrin.h>
+#define IPC_HAVE_HW_CRC32C 1
+#endif
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+/* ------------------------------------------------------------------ */
+/*  Sort                                                               */
+/* ------------------------------------------------------------------ */
+
+constexpr size_t   kSmallSortThreshold = 32;
+constexpr uint32_t kMaxRadixDepth = 64;
+constexpr int      kRadixBuckets = 257;   // 0 = end of string, 1..256 = byte + 1
+
+inline int bucket_at(const StrView &s, uint32_t depth)
+{
+    return depth < s.len ? s.data[depth] + 1 : 0;
+}
+
+/* Both strings are known to be at least @p depth bytes long. */
+inline bool less_from(const StrView &a, const StrView &b, uint32_t depth)
+{
+    uint32_t la = a.len - depth;
+    uint32_t lb = b.len - depth;
+    int c = memcmp(a.data + depth, b.data + depth, std::min(la, lb));
+    if (c != 0)
+        return c < 0;
+    return la < lb;
+}
+
+void small_sort(const StrView *strs, uint32_t *idx, size_t n, uint32_t depth)
+{
+    // Stable insertion sort: only strictly smaller keys move left.
+    for (size_t i = 1; i < n; ++i) {
+        uint32_t key = idx[i];
+        size_t j = i;
+        while (j > 0 && less_from(strs[key], strs[idx[j - 1]], depth)) {
+            idx[j] = idx[j - 1];
+            --j;
+        }
+        idx[j] = key;
+    }
+}
+
+/*
+ * Stable MSD radix sort of idx[0..n) on the bytes from @p depth onwards.
+ * Deep common prefixes fall back to a comparison sort to bound recursion.
+ */
+void msd_radix(const StrView *strs, uint32_t *idx, uint32_t *tmp, size_t n,
+               uint32_t depth)
+{
+    if (n < kSmallSortThreshold) {
+        small_sort(strs, idx, n, depth);
+        return;
+    }
+    if (depth >= kMaxRadixDepth) {
+        std::stable_sort(idx, idx + n, [strs, depth](uint32_t a, uint32_t b) {
+            return less_from(strs[a], strs[b], depth);
+        });
+        return;
+    }
+
+    uint32_t counts[kRadixBuckets] = {};
+    for (size_t i = 0; i < n; ++i)
+        ++counts[bucket_at(strs[idx[i]], depth)];
+
+    uint32_t starts[kRadixBuckets];
+    uint32_t pos[kRadixBuckets];
+    uint32_t sum = 0;
+    for (int b = 0; b < kRadixBuckets; ++b) {
+        starts[b] = pos[b] = sum;
+        sum += counts[b];
+    }
+    for (size_t i = 0; i < n; ++i)
+        tmp[pos[bucket_at(strs[idx[i]], depth)]++] = idx[i];
+    memcpy(idx, tmp, n * sizeof(uint32_t));
+
+    // Bucket 0 holds strings that ended here: all equal, already stable.
+    for (int b = 1; b < kRadixBuckets; ++b) {
+        if (counts[b] > 1)
+            msd_radix(strs, idx + starts[b], tmp + starts[b], counts[b], depth + 1);
+    }
+}
+
+/* ------------------------------------------------------------------ */
+/*  Hashes                                                             */
+/* ------------------------------------------------------------------ */
+
+struct Crc32cTable {
+    uint32_t entries[256];
+    Crc32cTable()
+    {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; ++bit)
+                crc = (crc >> 1) ^ (0x82F63B78u & (0u - (crc & 1u)));
+            entries[i] = crc;
+        }
+    }
+};
+
+uint32_t crc32c_sw(uint32_t crc, const uint8_t *p, size_t len)
+{
+    static const Crc32cTable table;
+    while (len--)
+        crc = (crc >> 8) ^ table.entries[(crc ^ *p++) & 0xFFu];
+    return crc;
+}
+
+#if defined(IPC_HAVE_HW_CRC32C)
+__attribute__((target("sse4.2")))
+uint32_t crc32c_hw(uint32_t crc, const uint8_t *p, size_t len)
+{
+    uint64_t crc64 = crc;
+    while (len >= 8) {
+        uint64_t word;
+        memcpy(&word, p, sizeof(word));
+        crc64 = _mm_crc32_u64(crc64, word);
+        p += 8;
+        len -= 8;
+    }
+    crc = static_cast<uint32_t>(crc64);
+    while (len--)
+        crc = _mm_crc32_u8(crc, *p++);
+    return crc;
+}
+
+bool cpu_has_sse42()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse4.2");
+}
+#endif
+
+inline uint32_t rotl32(uint32_t x, int r)
+{
+    return (x << r) | (x >> (32 - r));
+}
+
+inline uint32_t read32(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;   // xxHash is defined on little-endian reads (x86/ARM LE).
+}
+
+/* ------------------------------------------------------------------ */
+/*  Batched search                                                     */
+/* ------------------------------------------------------------------ */
+
+constexpr uint32_t kSearchLanes = 4;   // needles per prefix compare
+
+/*
+ * Needle prefixes in lane groups. A needle matches position i as a candidate
+ * when (hay[i..i+4) & mask) == prefix; the mask covers min(len, 4) bytes.
+ * Unused lanes are never active, so their contents do not matter.
+ */
+struct alignas(16) LaneGroup {
+    uint32_t prefix[kSearchLanes];
+    uint32_t mask[kSearchLanes];
+};
+
+inline uint32_t lane_candidates(const LaneGroup &g, uint32_t window)
+{
+#if defined(__SSE2__)
+    __m128i w = _mm_set1_epi32(static_cast<int>(window));
+    __m128i p = _mm_load_si128(reinterpret_cast<const __m128i *>(g.prefix));
+    __m128i m = _mm_load_si128(reinterpret_cast<const __m128i *>(g.mask));
+    __m128i eq = _mm_cmpeq_epi32(_mm_and_si128(w, m), p);
+    return static_cast<uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(eq)));
+#else
+    uint32_t bits = 0;
+    for (uint32_t l = 0; l < kSearchLanes; ++l)
+        bits |= static_cast<uint32_t>((window & g.mask[l]) == g.prefix[l]) << l;
+    return bits;
+#endif
+}
+
+} // namespace
+
+/* ------------------------------------------------------------------ */
+/*  Public kernels                                                     */
+/* ------------------------------------------------------------------ */
+
+uint32_t crc32c(const void *data, size_t len)
+{
+    const uint8_t *p = static_cast<const uint8_t *>(data);
+#if defined(IPC_HAVE_HW_CRC32C)
+    static const bool hw = cpu_has_sse42();
+    if (hw)
+        return ~crc32c_hw(~0u, p, len);
+#endif
+    return ~crc32c_sw(~0u, p, len);
+}
+
+uint32_t xxh32(const void *data, size_t len)
+{
+    constexpr uint32_t P1 = 2654435761u;
+    constexpr uint32_t P2 = 2246822519u;
+    constexpr uint32_t P3 = 3266489917u;
+    constexpr uint32_t P4 = 668265263u;
+    constexpr uint32_t P5 = 374761393u;
+
+    const uint8_t *p = static_cast<const uint8_t *>(data);
+    const uint8_t *end = p + len;
+    uint32_t h;
+
+    if (len >= 16) {
+        uint32_t v1 = P1 + P2;
+        uint32_t v2 = P2;
+        uint32_t v3 = 0;
+        uint32_t v4 = 0u - P1;
+        const uint8_t *limit = end - 16;
+        do {
+            v1 = rotl32(v1 + read32(p) * P2, 13) * P1;
+            v2 = rotl32(v2 + read32(p + 4) * P2, 13) * P1;
+            v3 = rotl32(v3 + read32(p + 8) * P2, 13) * P1;
+            v4 = rotl32(v4 + read32(p + 12) * P2, 13) * P1;
+            p += 16;
+        } while (p <= limit);
+        h = rotl32(v1, 1) + rotl32(v2, 7) + rotl32(v3, 12) + rotl32(v4, 18);
+    } else {
+        h = P5;
+    }
+
+    h += static_cast<uint32_t>(len);
+    while (p + 4 <= end) {
+        h = rotl32(h + read32(p) * P3, 17) * P4;
+        p += 4;
+    }
+    while (p < end) {
+        h = rotl32(h + (*p) * P5, 11) * P1;
+        ++p;
+    }
+
+    h ^= h >> 15;
+    h *= P2;
+    h ^= h >> 13;
+    h *= P3;
+    h ^= h >> 16;
+    return h;
+}
+
+void bulk_sort_part(const StrView *strs, uint32_t count,
+                    uint32_t part, uint32_t parts, uint32_t *perm)
+{
+    if (count == 0)
+        return;
+
+    uint32_t counts[kRadixBuckets] = {};
+    for (uint32_t i = 0; i < count; ++i)
+        ++counts[bucket_at(strs[i], 0)];
+
+    // Owner of a bucket is derived from where the bucket starts in the output,
+    // which gives every part the same contiguous, balanced bucket range.
+    uint32_t starts[kRadixBuckets];
+    uint32_t pos[kRadixBuckets];
+    bool mine[kRadixBuckets];
+    uint32_t sum = 0;
+    uint32_t largest = 0;
+    for (int b = 0; b < kRadixBuckets; ++b) {
+        starts[b] = pos[b] = sum;
+        uint32_t owner = static_cast<uint32_t>(
+            (static_cast<uint64_t>(sum) * parts) / count);
+        mine[b] = (std::min(owner, parts - 1) == part);
+        if (mine[b])
+            largest = std::max(largest, counts[b]);
+        sum += counts[b];
+    }
+    if (largest == 0)
+        return;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        int b = bucket_at(strs[i], 0);
+        if (mine[b])
+            perm[pos[b]++] = i;
+    }
+
+    thread_local std::vector<uint32_t> tmp;
+    if (tmp.size() < largest)
+        tmp.resize(largest);
+    for (int b = 1; b < kRadixBuckets; ++b) {
+        if (mine[b] && counts[b] > 1)
+            msd_radix(strs, perm + starts[b], tmp.data(), counts[b], 1);
+    }
+}
+
+uint32_t bulk_dedupe(const StrView *strs, uint32_t count, uint32_t *out)
+{
+    // Open addressing set of (hash << 32 | index + 1); 0 marks an empty entry.
+    size_t capacity = 16;
+    while (capacity < 2 * static_cast<size_t>(count))
+        capacity <<= 1;
+    size_t mask = capacity - 1;
+    thread_local std::vector<uint64_t> table;
+    table.assign(capacity, 0);
+
+    uint32_t unique = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        const StrView &s = strs[i];
+        uint32_t h = crc32c(s.data, s.len);
+        for (size_t e = h & mask;; e = (e + 1) & mask) {
+            uint64_t entry = table[e];
+            if (entry == 0) {
+                table[e] = (static_cast<uint64_t>(h) << 32) | (i + 1u);
+                out[unique++] = i;
+                break;
+            }
+            if (static_cast<uint32_t>(entry >> 32) != h)
+                continue;
+            const StrView &other = strs[static_cast<uint32_t>(entry) - 1];
+            if (other.len == s.len && memcmp(other.data, s.data, s.len) == 0)
+                break;
+        }
+    }
+    return unique;
+}
+
+void bulk_hash(const StrView *strs, uint32_t begin, uint32_t end,
+               uint32_t algo, uint32_t *out)
+{
+    if (algo == IPC_HASH_XXH32) {
+        for (uint32_t i = begin; i < end; ++i)
+            out[i] = xxh32(strs[i].data, strs[i].len);
+        return;
+    }
+    for (uint32_t i = begin; i < end; ++i)
+        out[i] = crc32c(strs[i].data, strs[i].len);
+}
+
+void bulk_search(const uint8_t *hay, uint32_t hay_len, const StrView *needles,
+                 uint32_t begin, uint32_t end, int32_t *out)
+{
+    // Private, zero-padded copy: the window load at the last positions stays
+    // in bounds, and a haystack rewritten mid-search cannot tear results.
+    thread_local std::vector<uint8_t> text;
+    text.assign(static_cast<size_t>(hay_len) + sizeof(uint32_t), 0);
+    if (hay_len > 0)
+        memcpy(text.data(), hay, hay_len);
+
+    uint32_t n = end - begin;
+    uint32_t groups = (n + kSearchLanes - 1) / kSearchLanes;
+    thread_local std::vector<LaneGroup> lanes;
+    thread_local std::vector<uint32_t> active;   // pending lane bits per group
+    lanes.assign(groups, LaneGroup{});
+    active.assign(groups, 0);
+
+    uint32_t pending = 0;
+    for (uint32_t k = 0; k < n; ++k) {
+        const StrView &s = needles[begin + k];
+        out[begin + k] = s.len == 0 ? 0 : -1;
+        if (s.len == 0 || s.len > hay_len)
+            continue;
+        uint32_t take = std::min<uint32_t>(s.len, sizeof(uint32_t));
+        uint32_t prefix = 0;
+        memcpy(&prefix, s.data, take);
+        LaneGroup &g = lanes[k / kSearchLanes];
+        g.prefix[k % kSearchLanes] = prefix;
+        g.mask[k % kSearchLanes] = take == 4 ? ~0u : (1u << (8 * take)) - 1u;
+        active[k / kSearchLanes] |= 1u << (k % kSearchLanes);
+        ++pending;
+    }
+
+    // Groups that still have pending needles; compacted as groups finish.
+    thread_local std::vector<uint32_t> live;
+    live.clear();
+    for (uint32_t g = 0; g < groups; ++g) {
+        if (active[g])
+            live.push_back(g);
+    }
+
+    for (uint32_t i = 0; i < hay_len && pending > 0; ++i) {
+        uint32_t window;
+        memcpy(&window, text.data() + i, sizeof(window));
+        uint32_t left = hay_len - i;
+        bool retired = false;
+        for (uint32_t g : live) {
+            uint32_t bits = lane_candidates(lanes[g], window) & active[g];
+            while (bits) {
+                uint32_t l = static_cast<uint32_t>(__builtin_ctz(bits));
+                bits &= bits - 1;
+                uint32_t k = g * kSearchLanes + l;
+                const StrView &s = needles[begin + k];
+                if (s.len <= left && memcmp(text.data() + i, s.data, s.len) == 0) {
+                    out[begin + k] = static_cast<int32_t>(i);
+                    active[g] &= ~(1u << l);
+                    --pending;
+                    retired |= (active[g] == 0);
+                }
+            }
+        }
+        if (retired) {
+            live.erase(std::remove_if(live.begin(), live.end(),
+                                      [](uint32_t g) { return active[g] == 0; }),
+                       live.end());
+        }
+    }
+}
@@ -0,0 +1,72 @@
+/**
+ * @file string_bulk.h
+ * @brief Bulk string kernels (sort, dedupe, hash) over arrays of strings (server side).
+ *
+ * The kernels work on StrView arrays that the server builds from validated
+ * IpcStrRef tables in the shared data arena. Sort and hash can be split into
+ * independent parts so one request spreads over several string_pool workers.
+ */
+#ifndef STRING_BULK_H
+#define STRING_BULK_H
+
+#include <cstddef>
+#include <cstdint>
+
+/** A validated (pointer, length) view of one string in the arena. */
+struct StrView {
+    const uint8_t *data;
+    uint32_t       len;
+};
+
+/** Number of strings below which a bulk request is not split any further. */
+constexpr uint32_t kBulkStringsPerPart = 4096;
+
+/** Needles per part when an IPC_CMD_SEARCH_BATCH request is split. */
+constexpr uint32_t kSearchBatchNeedlesPerPart = 256;
+
+/**
+ * @brief Compute one part of a lexicographic (bytewise, shorter-first) sort.
+ *
+ * Every part builds the same first-byte histogram and takes a contiguous,
+ * roughly equal share of the 257 first-byte buckets (bucket 0 holds empty
+ * strings), so parts write disjoint ranges of @p perm without coordination.
+ * Equal strings keep their original relative order.
+ *
+ * @param[out] perm  Sorted permutation of 0..count-1 (this part's range only).
+ */
+void bulk_sort_part(const StrView *strs, uint32_t count,
+                    uint32_t part, uint32_t parts, uint32_t *perm);
+
+/**
+ * @brief Write the indices of the first occurrence of every distinct string.
+ *
+ * Indices are written to @p out in ascending order.
+ *
+ * @return Number of distinct strings.
+ */
+uint32_t bulk_dedupe(const StrView *strs, uint32_t count, uint32_t *out);
+
+/**
+ * @brief Hash strings [begin, end) with the given ipc_hash_t algorithm.
+ */
+void bulk_hash(const StrView *strs, uint32_t begin, uint32_t end,
+               uint32_t algo, uint32_t *out);
+
+/**
+ * @brief Find the first occurrence of needles [begin, end) in one haystack.
+ *
+ * Single pass over the haystack: at every position the first four bytes are
+ * compared against the (masked) four-byte prefixes of all pending needles at
+ * once, four needles per SIMD compare, and only prefix hits are verified.
+ * out[i] receives the position of needle i, -1 if absent, 0 if empty.
+ */
+void bulk_search(const uint8_t *hay, uint32_t hay_len, const StrView *needles,
+                 uint32_t begin, uint32_t end, int32_t *out);
+
+/** CRC32C (Castagnoli); uses the SSE4.2 crc32 instruction when available. */
+uint32_t crc32c(const void *data, size_t len);
+
+/** xxHash32 with seed 0. */
+uint32_t xxh32(const void *data, size_t len);
+
+#endif /* STRING_BULK_H */
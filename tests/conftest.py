@@ -14,6 +14,7 @@ SERVER_BIN = os.path.join(BUILD_DIR, "server")
 SERVER_BIN_REALPATH = os.path.realpath(SERVER_BIN)
 SHM_PATH = "/dev/shm/ipc_shm"
 PYTEST_LOCK_FILE = "/tmp/ipc_pytest.lock"
+CACHE_SNAPSHOT_PATH = "/tmp/ipc_server.cache"
 
 
 def _pid_is_alive(pid: int) -> bool:
@@ -144,6 +145,8 @@ def cleanup_ipc_files():
         path = f"/dev/shm/{name}"
         if os.path.exists(path):
             os.remove(path)
+    if os.path.exists(CACHE_SNAPSHOT_PATH):
+        os.remove(CACHE_SNAPSHOT_PATH)
     # Keep lock file path; flock lock ownership is inode-based and stale path is harmless.
 
 
@@ -6,10 +6,18 @@ They must run in a separate pytest invocation or after the session server
 has been torn down.
 """
 import os
+import random
+import resource
 import signal
+import socket
+import struct
 import subprocess
+import sys
+import threading
 import time
 import ctypes
+import json
+import mmap
 
 import pytest
 
@@ -21,14 +29,27 @@ from conftest import (
 
 BUILD_DIR = os.path.join(os.path.dirname(__file__), "..", "build")
 SERVER_BIN = os.path.join(BUILD_DIR, "server")
+IPCCTL_BIN = os.path.join(BUILD_DIR, "ipcctl")
+CACHE_SNAPSHOT_PATH = "/tmp/ipc_server.cache"
+GATEWAY_BIN = os.path.join(BUILD_DIR, "ipc_gateway")
 CLIENT1_BIN = os.path.join(BUILD_DIR, "client1")
 SHM_PATH = "/dev/shm/ipc_shm"
 LIBIPC_SO = os.path.join(BUILD_DIR, "libipc.so")
 IPC_MAX_SLOTS = 16
+IPC_SLOT_MAGAZINE_MAX = 4
 IPC_NOT_READY = 1
 IPC_ERR_SERVER_RESTARTED = -2
+IPC_ERR_TIMEOUT = -3
 IPC_STATUS_OK = 0
 IPC_STATUS_DIV_BY_ZERO = 1
+IPC_STATUS_NOT_FOUND = 2
+IPC_STATUS_STR_TOO_LONG = 3
+IPC_STATUS_INVALID_INPUT = 4
+IPC_STATUS_BUSY = 6
+IPC_DTYPE_INT32 = 0
+IPC_DTYPE_FLOAT32 = 1
+IPC_HASH_CRC32C = 0
+IPC_HASH_XXH32 = 1
 
 pytestmark = pytest.mark.self_managed_server
 
@@ -47,6 +68,9 @@ def _cleanup_ipc():
         path = f"/dev/shm/{name}"
         if os.path.exists(path):
             os.remove(path)
+    # Every test starts cold; warm restarts are tested with their own file.
+    if os.path.exists(CACHE_SNAPSHOT_PATH):
+        os.remove(CACHE_SNAPSHOT_PATH)
 
 
 def _cleanup_orphan_servers():
@@ -152,6 +176,55 @@ def _restart_server(proc, *extra_args):
     return _start_server(*extra_args)
 
 
+class StreamStats(ctypes.Structure):
+    _fields_ = [
+        ("count", ctypes.c_uint64),
+        ("sum", ctypes.c_int64),
+        ("mean", ctypes.c_double),
+        ("min", ctypes.c_int32),
+        ("max", ctypes.c_int32),
+        ("p50", ctypes.c_int32),
+        ("p90", ctypes.c_int32),
+        ("p99", ctypes.c_int32),
+    ]
+
+
+class IpcCacheStats(ctypes.Structure):
+    _fields_ = [
+        ("hits", ctypes.c_uint64),
+        ("misses", ctypes.c_uint64),
+        ("entries", ctypes.c_uint32),
+    ]
+
+
+class IpcResultView(ctypes.Structure):
+    _fields_ = [
+        ("data", ctypes.c_void_p),
+        ("bytes", ctypes.c_uint64),
+        ("count", ctypes.c_uint32),
+        ("handle", ctypes.c_uint64),
+    ]
+
+
+class IpcWaitStats(ctypes.Structure):
+    _fields_ = [
+        ("spin_hits", ctypes.c_uint64),
+        ("sleeps", ctypes.c_uint64),
+        ("add_service_ns", ctypes.c_uint64),
+        ("spin_limit_ns", ctypes.c_uint64),
+    ]
+
+
+class IpcSlotMagazineStats(ctypes.Structure):
+    _fields_ = [
+        ("hits", ctypes.c_uint64),
+        ("misses", ctypes.c_uint64),
+        ("lost", ctypes.c_uint64),
+        ("held", ctypes.c_uint32),
+        ("capacity", ctypes.c_uint32),
+    ]
+
+
 def _load_ipc_lib():
     """Load libipc and configure function signatures used by tests."""
     lib = ctypes.CDLL(LIBIPC_SO)
@@ -165,24 +238,143 @@ def _load_ipc_lib():
     lib.ipc_add.argtypes = [ctypes.c_int32, ctypes.c_int32, ctypes.POINTER(ctypes.c_int32)]
     lib.ipc_add.restype = ctypes.c_int
 
+    lib.ipc_subtract.argtypes = [ctypes.c_int32, ctypes.c_int32, ctypes.POINTER(ctypes.c_int32)]
+    lib.ipc_subtract.restype = ctypes.c_int
+
+    lib.ipc_result_cache_enable.argtypes = [ctypes.c_uint32]
+    lib.ipc_result_cache_enable.restype = ctypes.c_int
+    lib.ipc_result_cache_stats.argtypes = [ctypes.POINTER(IpcCacheStats)]
+    lib.ipc_result_cache_stats.restype = None
+    lib.ipc_set_deadline.argtypes = [ctypes.c_uint64]
+    lib.ipc_set_deadline.restype = None
+    lib.ipc_set_priority.argtypes = [ctypes.c_int]
+    lib.ipc_set_priority.restype = ctypes.c_int
+    for name in ("ipc_add_timed", "ipc_subtract_timed"):
+        getattr(lib, name).argtypes = [ctypes.c_int32, ctypes.c_int32,
+                                       ctypes.POINTER(ctypes.c_int32), ctypes.c_uint64]
+        getattr(lib, name).restype = ctypes.c_int
+    lib.ipc_set_timeout.argtypes = [ctypes.c_uint64]
+    lib.ipc_set_timeout.restype = None
+    lib.ipc_set_spin_limit.argtypes = [ctypes.c_uint64]
+    lib.ipc_set_spin_limit.restype = None
+    lib.ipc_wait_stats.argtypes = [ctypes.POINTER(IpcWaitStats)]
+    lib.ipc_wait_stats.restype = None
+    lib.ipc_slot_magazine.argtypes = [ctypes.c_uint32]
+    lib.ipc_slot_magazine.restype = ctypes.c_int
+    lib.ipc_slot_magazine_stats.argtypes = [ctypes.POINTER(IpcSlotMagazineStats)]
+    lib.ipc_slot_magazine_stats.restype = None
+
     lib.ipc_concat.argtypes = [
         ctypes.c_char_p, ctypes.c_char_p, ctypes.POINTER(ctypes.c_uint64)
     ]
     lib.ipc_concat.restype = ctypes.c_int
 
+    lib.ipc_search.argtypes = [
+        ctypes.c_char_p, ctypes.c_char_p, ctypes.POINTER(ctypes.c_uint64)
+    ]
+    lib.ipc_search.restype = ctypes.c_int
+
     lib.ipc_multiply.argtypes = [
         ctypes.c_int32, ctypes.c_int32, ctypes.POINTER(ctypes.c_uint64)
     ]
     lib.ipc_multiply.restype = ctypes.c_int
 
+    lib.ipc_arena_alloc.argtypes = [ctypes.c_size_t, ctypes.POINTER(ctypes.c_uint64)]
+    lib.ipc_arena_alloc.restype = ctypes.c_int
+
+    lib.ipc_arena_free.argtypes = [ctypes.c_uint64]
+    lib.ipc_arena_free.restype = ctypes.c_int
+
+    lib.ipc_arena_ptr.argtypes = [ctypes.c_uint64]
+    lib.ipc_arena_ptr.restype = ctypes.c_void_p
+
+    lib.ipc_matmul.argtypes = [
+        ctypes.c_uint32, ctypes.c_uint32, ctypes.c_uint32, ctypes.c_int,
+        ctypes.c_uint64, ctypes.c_uint64, ctypes.c_uint64,
+        ctypes.POINTER(ctypes.c_uint64),
+    ]
+    lib.ipc_matmul.restype = ctypes.c_int
+
+    str_array_args = [ctypes.c_uint64, ctypes.c_uint32, ctypes.c_uint64,
+                      ctypes.POINTER(ctypes.c_uint64)]
+    lib.ipc_str_sort.argtypes = str_array_args
+    lib.ipc_str_sort.restype = ctypes.c_int
+    lib.ipc_str_dedupe.argtypes = str_array_args
+    lib.ipc_str_dedupe.restype = ctypes.c_int
+    lib.ipc_str_hash.argtypes = [
+        ctypes.c_uint64, ctypes.c_uint32, ctypes.c_int, ctypes.c_uint64,
+        ctypes.POINTER(ctypes.c_uint64),
+    ]
+    lib.ipc_str_hash.restype = ctypes.c_int
+
+    lib.ipc_regex_search.argtypes = [
+        ctypes.c_uint64, ctypes.c_uint32, ctypes.c_uint64, ctypes.c_uint32,
+        ctypes.POINTER(ctypes.c_uint64),
+    ]
+    lib.ipc_regex_search.restype = ctypes.c_int
+
+    lib.ipc_search_batch.argtypes = [
+        ctypes.c_uint64, ctypes.c_uint32, ctypes.c_uint64, ctypes.c_uint32,
+        ctypes.c_uint64, ctypes.POINTER(ctypes.c_uint64),
+    ]
+    lib.ipc_search_batch.restype = ctypes.c_int
+
+    lib.ipc_intern.argtypes = [ctypes.c_char_p, ctypes.POINTER(ctypes.c_uint32)]
+    lib.ipc_intern.restype = ctypes.c_int
+    interned_args = [ctypes.c_uint32, ctypes.c_uint32, ctypes.POINTER(ctypes.c_uint64)]
+    lib.ipc_concat_interned.argtypes = interned_args
+    lib.ipc_concat_interned.restype = ctypes.c_int
+    lib.ipc_search_interned.argtypes = interned_args
+    lib.ipc_search_interned.restype = ctypes.c_int
+
+    lib.ipc_stream_open.argtypes = [ctypes.POINTER(ctypes.c_uint32)]
+    lib.ipc_stream_open.restype = ctypes.c_int
+    lib.ipc_stream_push.argtypes = [
+        ctypes.c_uint32, ctypes.POINTER(ctypes.c_int32), ctypes.c_uint32,
+        ctypes.POINTER(ctypes.c_uint32),
+    ]
+    lib.ipc_stream_push.restype = ctypes.c_int
+    lib.ipc_stream_query.argtypes = [ctypes.c_uint32, ctypes.POINTER(StreamStats)]
+    lib.ipc_stream_query.restype = ctypes.c_int
+    lib.ipc_stream_close.argtypes = [ctypes.c_uint32, ctypes.POINTER(StreamStats)]
+    lib.ipc_stream_close.restype = ctypes.c_int
+
     lib.ipc_get_result.argtypes = [
         ctypes.c_uint64, ctypes.c_void_p, ctypes.POINTER(ctypes.c_int)
     ]
     lib.ipc_get_result.restype = ctypes.c_int
 
+    lib.ipc_result_view.argtypes = [
+        ctypes.c_uint64, ctypes.POINTER(IpcResultView), ctypes.POINTER(ctypes.c_int)
+    ]
+    lib.ipc_result_view.restype = ctypes.c_int
+    lib.ipc_result_view_retain.argtypes = [ctypes.POINTER(IpcResultView)]
+    lib.ipc_result_view_retain.restype = ctypes.c_int
+    lib.ipc_result_view_release.argtypes = [ctypes.POINTER(IpcResultView)]
+    lib.ipc_result_view_release.restype = ctypes.c_int
+
     return lib
 
 
+def _wait_result(lib, request_id, timeout_sec=10.0):
+    """Poll an async request until it completes; returns (status, raw result bytes)."""
+    result_buf = (ctypes.c_byte * 64)()
+    status = ctypes.c_int()
+    deadline = time.time() + timeout_sec
+    while time.time() < deadline:
+        rc = lib.ipc_get_result(request_id, result_buf, ctypes.byref(status))
+        if rc == 0:
+            return status.value, bytes(result_buf)
+        assert rc == IPC_NOT_READY
+        time.sleep(0.005)
+    raise AssertionError(f"Timed out waiting for request {request_id}")
+
+
+def _result_count(raw):
+    """Element count reported by a bulk command (the first field of its result)."""
+    return int.from_bytes(raw[:4], "little")
+
+
 class TestServerThreadConfig:
     """Test the -t flag and startup banner thread info."""
 
@@ -240,6 +432,42 @@ class TestServerThreadConfig:
                 proc.wait()
             _cleanup_ipc()
 
+    def test_sizing_follows_affinity_mask(self):
+        """Pools are sized from the affinity mask, not the online CPU count."""
+        saved = os.sched_getaffinity(0)
+        os.sched_setaffinity(0, {min(saved)})
+        try:
+            proc = _start_server()
+        finally:
+            os.sched_setaffinity(0, saved)
+        try:
+            output = _stop_server(proc)
+            assert "cores=1," in output
+            assert "threads/pool=1," in output
+            sizing = [l for l in output.splitlines() if l.startswith("[SIZING]")]
+            assert len(sizing) == 1
+            assert " 1 in affinity mask" in sizing[0]
+            assert "usable" in sizing[0]
+        finally:
+            if proc.poll() is None:
+                proc.kill()
+                proc.wait()
+            _cleanup_ipc()
+
+    def test_sizing_line_explains_overrides(self):
+        """-t wins over the automatic size; the banner says so, and --calibrate is skipped."""
+        proc = _start_server("-t", "3", "--calibrate")
+        try:
+            output = _stop_server(proc)
+            assert "threads/pool=3," in output
+            assert "calibration skipped (-t given)" in output
+            assert "threads/pool=3 from -t (automatic: " in output
+        finally:
+            if proc.poll() is None:
+                proc.kill()
+                proc.wait()
+            _cleanup_ipc()
+
 
 class TestDuplicateServerDetection:
     """Test that launching a second server is rejected with a clear message."""
@@ -359,6 +587,76 @@ class TestShutdownModes:
         _cleanup_ipc()
 
 
+def _has_capability(bit):
+    with open("/proc/self/status") as f:
+        for line in f:
+            if line.startswith("CapEff:"):
+                return bool((int(line.split()[1], 16) >> bit) & 1)
+    return False
+
+
+class TestRealtimeOptions:
+    """--rt-* scheduling and --mlock, or their fallbacks without privileges."""
+
+    def test_dispatcher_and_pool_policies(self):
+        """The dispatcher and math workers run SCHED_FIFO; other threads do not."""
+        proc = _start_server("-t", "1", "--rt-dispatcher=20", "--rt-math=10", "--mlock")
+        lib = _load_ipc_lib()
+        try:
+            assert lib.ipc_init() == 0
+            out = ctypes.c_int32()
+            assert lib.ipc_add(2, 3, ctypes.byref(out)) == 0 and out.value == 5
+
+            rt_allowed = _has_capability(23) or \
+                resource.getrlimit(resource.RLIMIT_RTPRIO)[0] >= 20
+            policies = {}
+            for tid in os.listdir(f"/proc/{proc.pid}/task"):
+                tid = int(tid)
+                policies[tid] = (os.sched_getscheduler(tid),
+                                 os.sched_getparam(tid).sched_priority)
+            fifo = sorted(prio for policy, prio in policies.values()
+                          if policy == os.SCHED_FIFO)
+            if rt_allowed:
+                assert policies[proc.pid] == (os.SCHED_FIFO, 20)
+                assert fifo == [10, 20]
+            else:
+                assert fifo == []
+
+            with open(f"/proc/{proc.pid}/status") as f:
+                locked_kb = next(int(line.split()[1]) for line in f
+                                 if line.startswith("VmLck:"))
+            mlock_allowed = _has_capability(14) or \
+                resource.getrlimit(resource.RLIMIT_MEMLOCK)[0] == resource.RLIM_INFINITY
+            assert (locked_kb > 0) == mlock_allowed
+
+            lib.ipc_cleanup()
+            output = _stop_server(proc)
+            if rt_allowed:
+                assert "[RT] dispatcher SCHED_FIFO/20, math SCHED_FIFO/10, " \
+                       "string SCHED_OTHER" in output
+            else:
+                assert "[RT] dispatcher SCHED_OTHER, math SCHED_OTHER" in output
+        finally:
+            lib.ipc_cleanup()
+            if proc.poll() is None:
+                _stop_server(proc)
+            _cleanup_ipc()
+
+    def test_invalid_priority(self):
+        """A priority outside 0..99 fails with exit code 1."""
+        _cleanup_ipc()
+        proc = subprocess.Popen(
+            [SERVER_BIN, "--rt-math=100"],
+            stdout=subprocess.PIPE,
+            stderr=subprocess.PIPE,
+            cwd=BUILD_DIR,
+        )
+        _, stderr = proc.communicate(timeout=5)
+        assert proc.returncode == 1
+        assert "Invalid --rt-math=100" in stderr.decode()
+        _cleanup_ipc()
+
+
 class TestStatusReport:
     """Test SIGUSR1 status report output."""
 
@@ -380,6 +678,493 @@ class TestStatusReport:
                 proc.wait()
             _cleanup_ipc()
 
+    def test_sigusr1_json_snapshot(self):
+        """--status-format=json prints one parseable object with live counters."""
+        proc = _start_server("-t", "1", "--shutdown=drain", "--status-format=json")
+        lib = _load_ipc_lib()
+        try:
+            assert lib.ipc_init() == 0
+            out = ctypes.c_int32()
+            for i in range(3):
+                assert lib.ipc_add(i, 1, ctypes.byref(out)) == 0
+            proc.send_signal(signal.SIGUSR1)
+            time.sleep(0.5)
+            lib.ipc_cleanup()
+            output = _stop_server(proc)
+            assert "[STATUS]" not in output
+            reports = [json.loads(line) for line in output.splitlines()
+                       if line.startswith("{")]
+            assert len(reports) == 1
+            report = reports[0]
+            assert report["pid"] == proc.pid and report["mode"] == "drain"
+            assert report["requests"] == {"dispatched": 3, "completed": 3}
+            assert report["slots"]["free"] == 16
+            assert report["arena"]["free_bytes"] > 0
+            assert "hits" in report["regex_cache"]
+        finally:
+            lib.ipc_cleanup()
+            if proc.poll() is None:
+                proc.kill()
+                proc.wait()
+            _cleanup_ipc()
+
+
+class TestControlChannel:
+    """Live reconfiguration through the control socket and ipcctl."""
+
+    @staticmethod
+    def _ipcctl(*args):
+        result = subprocess.run([IPCCTL_BIN, *args], capture_output=True, text=True,
+                                timeout=10)
+        return result.returncode, result.stdout.strip()
+
+    def test_resize_pools_under_load(self):
+        """Pools grow and shrink while requests keep being served."""
+        proc = _start_server("-t", "2", "--shutdown=drain")
+        lib = _load_ipc_lib()
+        try:
+            assert lib.ipc_init() == 0
+            rc, reply = self._ipcctl("get")
+            assert rc == 0
+            assert "threads.math=2" in reply and "threads.string=2" in reply
+
+            out = ctypes.c_int32()
+            for n in ("3", "1", "4"):
+                rc, reply = self._ipcctl("set", "threads.math", n)
+                assert rc == 0 and f"threads.math={n}" in reply
+                rc, reply = self._ipcctl("set", "threads.string", n)
+                assert rc == 0 and f"threads.string={n}" in reply
+                for i in range(20):
+                    assert lib.ipc_add(i, 1, ctypes.byref(out)) == 0
+                    assert out.value == i + 1
+
+            rc, reply = self._ipcctl("status")
+            assert rc == 0 and reply.startswith("ok ")
+            report = json.loads(reply[3:])
+            assert report["threads"] == {"math": 4, "string": 4}
+            assert report["requests"]["completed"] == 60
+        finally:
+            lib.ipc_cleanup()
+            if proc.poll() is None:
+                _stop_server(proc)
+            _cleanup_ipc()
+
+    def test_shrink_does_not_wait_for_busy_workers(self):
+        """Shrinking a pool replies while the retiring worker is still blocked."""
+        proc = _start_server("-t", "2", "--shutdown=drain", "--watchdog-ms=0")
+        lib = _load_ipc_lib()
+        libc = ctypes.CDLL(None)
+        libc.sem_open.argtypes = [ctypes.c_char_p, ctypes.c_int]
+        libc.sem_open.restype = ctypes.c_void_p
+        libc.sem_wait.argtypes = [ctypes.c_void_p]
+        libc.sem_post.argtypes = [ctypes.c_void_p]
+        libc.sem_close.argtypes = [ctypes.c_void_p]
+        mutex = None
+        held = False
+        try:
+            assert lib.ipc_init() == 0
+            mutex = libc.sem_open(b"/ipc_mutex", 0)
+            assert mutex
+
+            # With more bands queued, both math workers block on the mutex:
+            # one publishing a result, the other starting its next band.
+            dim = 768
+            a_off, _ = TestMatmul._arena_array(lib, ctypes.c_float, dim * dim)
+            reqs = []
+            for _ in range(3):
+                c_off, _ = TestMatmul._arena_array(lib, ctypes.c_float, dim * dim)
+                req = ctypes.c_uint64()
+                assert lib.ipc_matmul(dim, dim, dim, IPC_DTYPE_FLOAT32, a_off, a_off, c_off,
+                                      ctypes.byref(req)) == 0
+                reqs.append(req.value)
+            while TestClientRegistry._status()["slots"]["processing"] == 0:
+                time.sleep(0.005)
+            assert libc.sem_wait(mutex) == 0
+            held = True
+            time.sleep(0.5)
+
+            rc, reply = self._ipcctl("set", "threads.math", "1")
+            assert rc == 0 and "threads.math=1" in reply
+            rc, reply = self._ipcctl("workers")
+            assert rc == 0 and "retiring" in reply and "stuck" not in reply
+
+            assert libc.sem_post(mutex) == 0
+            held = False
+            for req in reqs:
+                assert _wait_result(lib, req)[0] == IPC_STATUS_OK
+            time.sleep(0.3)
+            rc, reply = self._ipcctl("workers")
+            assert rc == 0 and "retiring" not in reply
+        finally:
+            if held:
+                libc.sem_post(mutex)
+            if mutex:
+                libc.sem_close(mutex)
+            lib.ipc_cleanup()
+            if proc.poll() is None:
+                _stop_server(proc)
+            _cleanup_ipc()
+
+    def test_settings_and_errors(self):
+        """Bad commands are rejected; valid ones change live behaviour."""
+        proc = _start_server("-t", "1", "--shutdown=drain")
+        try:
+            for args in (("set", "threads.math", "0"), ("set", "threads.math", "x"),
+                         ("set", "shutdown", "later"), ("set", "bogus", "1"),
+                         ("frobnicate",)):
+                rc, reply = self._ipcctl(*args)
+                assert rc == 1 and reply.startswith("error:"), args
+
+            assert self._ipcctl("set", "regex_cache", "7")[0] == 0
+            assert self._ipcctl("set", "status_format", "json")[0] == 0
+            rc, reply = self._ipcctl("set", "shutdown", "immediate")
+            assert rc == 0
+            assert "shutdown=immediate" in reply and "regex_cache=7" in reply
+
+            proc.send_signal(signal.SIGUSR1)
+            time.sleep(0.5)
+            output = _stop_server(proc)
+            assert "immediate mode" in output
+            reports = [json.loads(line) for line in output.splitlines()
+                       if line.startswith("{")]
+            assert len(reports) == 1 and reports[0]["regex_cache"]["capacity"] == 7
+            assert not os.path.exists("/tmp/ipc_server.ctl")
+        finally:
+            if proc.poll() is None:
+                proc.kill()
+                proc.wait()
+            _cleanup_ipc()
+
+
+class TestClientRegistry:
+    """Client registration table: join, leave, and reaping of dead clients."""
+
+    @staticmethod
+    def _clients():
+        rc, reply = TestControlChannel._ipcctl("clients")
+        assert rc == 0 and reply.startswith("ok ")
+        return reply
+
+    @staticmethod
+    def _status():
+        rc, reply = TestControlChannel._ipcctl("status")
+        assert rc == 0
+        return json.loads(reply[3:])
+
+    def test_join_heartbeat_and_leave(self):
+        """ipc_init registers the process, requests are counted, cleanup leaves."""
+        proc = _start_server("-t", "2", "--shutdown=drain")
+        lib = _load_ipc_lib()
+        try:
+            assert self._clients() == "ok 0 registered"
+            assert lib.ipc_init() == 0
+            out = ctypes.c_int32()
+            for i in range(5):
+                assert lib.ipc_add(i, i, ctypes.byref(out)) == 0
+            reply = self._clients()
+            assert reply.startswith("ok 1 registered")
+            assert f"pid={os.getpid()} requests=5 " in reply
+            assert self._status()["clients"] == {"registered": 1, "reaped": 0}
+
+            lib.ipc_cleanup()
+            assert self._clients() == "ok 0 registered"
+        finally:
+            lib.ipc_cleanup()
+            if proc.poll() is None:
+                _stop_server(proc)
+            _cleanup_ipc()
+
+    def test_dead_client_is_reaped(self):
+        """A killed client's entry and its unclaimed slots are released."""
+        proc = _start_server("-t", "2", "--shutdown=drain")
+        lib = _load_ipc_lib()
+        script = (
+            "import ctypes, os, signal, time\n"
+            f"lib = ctypes.CDLL({LIBIPC_SO!r})\n"
+            "assert lib.ipc_init() == 0\n"
+            "rid = ctypes.c_uint64()\n"
+            f"for _ in range({IPC_MAX_SLOTS}):\n"
+            "    assert lib.ipc_multiply(3, 4, ctypes.byref(rid)) == 0\n"
+            "time.sleep(0.5)\n"
+            "os.kill(os.getpid(), signal.SIGKILL)\n"
+        )
+        try:
+            child = subprocess.run([sys.executable, "-c", script], timeout=30)
+            assert child.returncode == -signal.SIGKILL
+
+            deadline = time.time() + 10
+            while time.time() < deadline:
+                report = self._status()
+                if report["clients"]["reaped"] == 1 and report["slots"]["free"] == IPC_MAX_SLOTS:
+                    break
+                time.sleep(0.2)
+            assert report["clients"] == {"registered": 0, "reaped": 1}
+            assert report["slots"]["free"] == IPC_MAX_SLOTS
+
+            assert lib.ipc_init() == 0
+            out = ctypes.c_int32()
+            assert lib.ipc_add(2, 3, ctypes.byref(out)) == 0 and out.value == 5
+        finally:
+            lib.ipc_cleanup()
+            if proc.poll() is None:
+                output = _stop_server(proc)
+                assert "reaped 1 dead client(s)" in output
+            _cleanup_ipc()
+
+    def test_half_joined_entry_is_freed(self):
+        """An entry left JOINING by a process that died mid-join is freed."""
+        proc = _start_server("-t", "1", "--shutdown=drain")
+        lib = _load_ipc_lib()
+        shm = None
+        try:
+            assert lib.ipc_init() == 0
+            with open(SHM_PATH, "r+b") as f:
+                shm = mmap.mmap(f.fileno(), 0)
+            # Our ACTIVE entry; ClientEntry is one cache line, state then pid.
+            own = -1
+            while True:
+                own = shm.find(struct.pack("<Ii", 2, os.getpid()), own + 1)
+                assert own >= 0
+                if own % 64 == 0:
+                    break
+            forged = own + 64 if struct.unpack_from("<I", shm, own + 64)[0] == 0 else own - 64
+            assert struct.unpack_from("<I", shm, forged)[0] == 0
+
+            dead = subprocess.Popen(["true"])
+            dead.wait()
+            struct.pack_into("<I", shm, forged, (dead.pid << 2) | 1)   # ipc_client_joining()
+
+            deadline = time.time() + 10
+            while time.time() < deadline and struct.unpack_from("<I", shm, forged)[0] != 0:
+                time.sleep(0.1)
+            assert struct.unpack_from("<I", shm, forged)[0] == 0
+            assert self._status()["clients"] == {"registered": 1, "reaped": 1}
+        finally:
+            if shm is not None:
+                shm.close()
+            lib.ipc_cleanup()
+            if proc.poll() is None:
+                _stop_server(proc)
+            _cleanup_ipc()
+
+
+class TestWorkerWatchdog:
+    """Workers stuck on one task are reported and replaced."""
+
+    def test_stuck_worker_is_replaced(self):
+        """A worker blocked on /ipc_mutex is set aside; its task still completes."""
+        proc = _start_server("-t", "1", "--shutdown=drain", "--watchdog-ms=200")
+        lib = _load_ipc_lib()
+        libc = ctypes.CDLL(None)
+        libc.sem_open.argtypes = [ctypes.c_char_p, ctypes.c_int]
+        libc.sem_open.restype = ctypes.c_void_p
+        libc.sem_wait.argtypes = [ctypes.c_void_p]
+        libc.sem_post.argtypes = [ctypes.c_void_p]
+        libc.sem_close.argtypes = [ctypes.c_void_p]
+        mutex = None
+        held = False
+        try:
+            assert lib.ipc_init() == 0
+            mutex = libc.sem_open(b"/ipc_mutex", 0)
+            assert mutex
+
+            # The worker multiplies, then blocks publishing while we hold the mutex.
+            dim = 1024
+            a_off, _ = TestMatmul._arena_array(lib, ctypes.c_float, dim * dim)
+            c_off, _ = TestMatmul._arena_array(lib, ctypes.c_float, dim * dim)
+            req = ctypes.c_uint64()
+            assert lib.ipc_matmul(dim, dim, dim, IPC_DTYPE_FLOAT32, a_off, a_off, c_off,
+                                  ctypes.byref(req)) == 0
+            while TestClientRegistry._status()["slots"]["processing"] == 0:
+                time.sleep(0.005)
+            assert libc.sem_wait(mutex) == 0
+            held = True
+            time.sleep(1.5)
+
+            report = TestClientRegistry._status()
+            assert report["watchdog"] == {"stuck": {"math": 1, "string": 0}, "replaced": 1}
+            rc, reply = TestControlChannel._ipcctl("workers")
+            assert rc == 0 and "stuck" in reply and reply.count("idle") == 2
+
+            assert libc.sem_post(mutex) == 0
+            held = False
+            assert _wait_result(lib, req.value)[0] == IPC_STATUS_OK
+            out = ctypes.c_int32()
+            assert lib.ipc_add(20, 22, ctypes.byref(out)) == 0 and out.value == 42
+
+            time.sleep(0.3)
+            report = TestClientRegistry._status()
+            assert report["watchdog"]["stuck"]["math"] == 0
+            assert report["threads"]["math"] == 1
+            rc, reply = TestControlChannel._ipcctl("workers")
+            assert "stuck" not in reply
+        finally:
+            if held:
+                libc.sem_post(mutex)
+            if mutex:
+                libc.sem_close(mutex)
+            lib.ipc_cleanup()
+            if proc.poll() is None:
+                output = _stop_server(proc)
+                assert "[WATCHDOG] math worker 0 stuck for" in output
+            _cleanup_ipc()
+
+
+class TestTcpGateway:
+    """ipc_gateway forwards framed requests from TCP clients over loopback."""
+
+    @staticmethod
+    def _start_gateway(*extra_args):
+        gw = subprocess.Popen([GATEWAY_BIN, "--port", "0", *extra_args],
+                              stdout=subprocess.PIPE, stderr=subprocess.PIPE,
+                              start_new_session=True)
+        line = gw.stdout.readline().decode()
+        assert line.startswith("Gateway listening on"), line
+        port = int(line.split(":")[1].split()[0])
+        return gw, port
+
+    @staticmethod
+    def _stop_gateway(gw):
+        if gw.poll() is None:
+            gw.send_signal(signal.SIGINT)
+            try:
+                gw.wait(timeout=5)
+            except subprocess.TimeoutExpired:
+                gw.kill()
+                gw.wait()
+
+    @staticmethod
+    def _frame(tag, cmd, payload):
+        body = struct.pack("<IB", tag, cmd) + payload
+        return struct.pack("<I", len(body)) + body
+
+    @classmethod
+    def _math(cls, tag, cmd, a, b):
+        return cls._frame(tag, cmd, struct.pack("<ii", a, b))
+
+    @classmethod
+    def _strings(cls, tag, cmd, s1, s2):
+        return cls._frame(tag, cmd, bytes([len(s1)]) + s1 + bytes([len(s2)]) + s2)
+
+    @staticmethod
+    def _read_responses(sock, count):
+        buf = b""
+        out = {}
+        sock.settimeout(10)
+        while len(out) < count:
+            chunk = sock.recv(65536)
+            assert chunk, "gateway closed the connection"
+            buf += chunk
+            while len(buf) >= 4:
+                (length,) = struct.unpack_from("<I", buf)
+                if len(buf) < 4 + length:
+                    break
+                tag, status = struct.unpack_from("<IB", buf, 4)
+                out[tag] = (status, buf[9:4 + length])
+                buf = buf[4 + length:]
+        return out
+
+    def test_pipelined_requests_on_one_connection(self):
+        """Hundreds of pipelined requests come back matched by tag."""
+        proc = _start_server("-t", "2", "--shutdown=drain")
+        gw = None
+        try:
+            gw, port = self._start_gateway("--loops", "2")
+            expected = {}
+            frames = []
+            for tag in range(300):
+                kind = tag % 6
+                a, b = tag * 7 - 900, tag % 13 - 6
+                if kind == 0:
+                    frames.append(self._math(tag, 0, a, b))
+                    expected[tag] = (0, struct.pack("<i", a + b))
+                elif kind == 1:
+                    frames.append(self._math(tag, 1, a, b))
+                    expected[tag] = (0, struct.pack("<i", a - b))
+                elif kind == 2:
+                    frames.append(self._math(tag, 2, a, b))
+                    expected[tag] = (0, struct.pack("<i", a * b))
+                elif kind == 3:
+                    if b == 0:
+                        expected[tag] = (IPC_STATUS_DIV_BY_ZERO, b"")
+                    else:
+                        expected[tag] = (0, struct.pack("<i", int(a / b)))
+                    frames.append(self._math(tag, 3, a, b))
+                elif kind == 4:
+                    s1, s2 = b"gw%d" % tag, b"-x"
+                    frames.append(self._strings(tag, 4, s1, s2))
+                    expected[tag] = (0, bytes([len(s1 + s2)]) + s1 + s2)
+                else:
+                    hay = b"haystack%d" % tag
+                    found = tag % 4 == 1
+                    needle = b"%d" % tag if found else b"zz"
+                    frames.append(self._strings(tag, 5, hay, needle))
+                    expected[tag] = ((0, struct.pack("<i", 8)) if found
+                                     else (IPC_STATUS_NOT_FOUND, b""))
+
+            with socket.create_connection(("127.0.0.1", port)) as sock:
+                payload = b"".join(frames)
+                # The first frame arrives a byte at a time, the rest in one go.
+                for i in range(len(frames[0])):
+                    sock.sendall(payload[i:i + 1])
+                    time.sleep(0.001)
+                sock.sendall(payload[len(frames[0]):])
+                responses = self._read_responses(sock, len(frames))
+            assert responses == expected
+        finally:
+            if gw is not None:
+                self._stop_gateway(gw)
+            if proc.poll() is None:
+                _stop_server(proc)
+            _cleanup_ipc()
+
+    def test_rejects_and_concurrent_connections(self):
+        """Unsupported or malformed requests are rejected; connections run in parallel."""
+        proc = _start_server("-t", "2", "--shutdown=drain")
+        gw = None
+        try:
+            gw, port = self._start_gateway("--loops", "2")
+            with socket.create_connection(("127.0.0.1", port)) as sock:
+                sock.sendall(self._frame(1, 6, b"\0" * 8) +           # MATMUL
+                             self._strings(2, 4, b"x" * 17, b"y") +    # too long
+                             self._frame(3, 0, b"\0" * 4) +           # short math
+                             self._math(4, 0, 2, 2))
+                responses = self._read_responses(sock, 4)
+                assert responses[1] == (0xFF, b"")
+                assert responses[2] == (0xFF, b"")
+                assert responses[3] == (0xFF, b"")
+                assert responses[4] == (0, struct.pack("<i", 4))
+
+                sock.sendall(struct.pack("<I", 100000))   # bad frame length
+                sock.settimeout(5)
+                assert sock.recv(16) == b""
+
+            errors = []
+
+            def client(base):
+                try:
+                    with socket.create_connection(("127.0.0.1", port)) as s:
+                        s.sendall(b"".join(self._math(base + i, 0, base, i)
+                                           for i in range(100)))
+                        got = self._read_responses(s, 100)
+                        for i in range(100):
+                            assert got[base + i] == (0, struct.pack("<i", base + i))
+                except Exception as exc:  # pragma: no cover - reported below
+                    errors.append(exc)
+
+            threads = [threading.Thread(target=client, args=(k * 1000,)) for k in range(6)]
+            for t in threads:
+                t.start()
+            for t in threads:
+                t.join()
+            assert not errors, errors
+        finally:
+            if gw is not None:
+                self._stop_gateway(gw)
+            if proc.poll() is None:
+                _stop_server(proc)
+            _cleanup_ipc()
+
 
 class TestSlotExhaustion:
     """Test behavior when all shared-memory slots are occupied."""
@@ -433,56 +1218,182 @@ class TestRestartRecovery:
                 _stop_server(proc)
             _cleanup_ipc()
 
-    def test_async_request_can_be_retried_after_restart(self):
-        """Old async request ID should invalidate; a re-submission should succeed."""
-        proc = _start_server("-t", "2", "--shutdown=drain")
+    def test_async_requests_survive_restart(self):
+        """Pending async requests are resubmitted by libipc and keep their IDs."""
+        proc = _start_server("-t", "2", "--shutdown=immediate")
         lib = _load_ipc_lib()
         try:
             assert lib.ipc_init() == 0
 
-            old_id = ctypes.c_uint64()
-            assert lib.ipc_multiply(6, 7, ctypes.byref(old_id)) == 0
+            mul_id = ctypes.c_uint64()
+            div_id = ctypes.c_uint64()
+            cat_id = ctypes.c_uint64()
+            assert lib.ipc_multiply(6, 7, ctypes.byref(mul_id)) == 0
+            assert lib.ipc_divide(9, 0, ctypes.byref(div_id)) == 0
+            assert lib.ipc_concat(b"ab", b"cd", ctypes.byref(cat_id)) == 0
 
-            proc = _restart_server(proc, "-t", "2", "--shutdown=drain")
+            proc = _restart_server(proc, "-t", "2", "--shutdown=immediate")
 
+            # Not journaled, so the restart is still reported for it.
             result_buf = (ctypes.c_byte * 64)()
             status = ctypes.c_int()
-            rc = lib.ipc_get_result(old_id.value, result_buf, ctypes.byref(status))
-            assert rc == IPC_ERR_SERVER_RESTARTED
-
+            assert lib.ipc_get_result(0, result_buf, ctypes.byref(status)) == \
+                IPC_ERR_SERVER_RESTARTED
+
+            st, raw = _wait_result(lib, mul_id.value)
+            assert st == IPC_STATUS_OK and struct.unpack_from("<i", raw)[0] == 42
+            st, _ = _wait_result(lib, div_id.value)
+            assert st == IPC_STATUS_DIV_BY_ZERO
+            st, raw = _wait_result(lib, cat_id.value)
+            assert st == IPC_STATUS_OK and raw.split(b"\0")[0] == b"abcd"
+            assert lib.ipc_get_result(mul_id.value, result_buf, ctypes.byref(status)) == -1
+
+            # IDs from the new server never collide with the journaled ones.
             new_id = ctypes.c_uint64()
-            assert lib.ipc_multiply(6, 7, ctypes.byref(new_id)) == 0
-
-            done = False
-            for _ in range(30):
-                rc = lib.ipc_get_result(new_id.value, result_buf, ctypes.byref(status))
-                if rc == 0:
-                    math_result = ctypes.cast(
-                        result_buf, ctypes.POINTER(ctypes.c_int32)
-                    ).contents.value
-                    assert status.value == IPC_STATUS_OK
-                    assert math_result == 42
-                    done = True
-                    break
-                assert rc == IPC_NOT_READY
-                time.sleep(0.1)
-            assert done
+            assert lib.ipc_multiply(2, 3, ctypes.byref(new_id)) == 0
+            assert new_id.value not in (mul_id.value, div_id.value, cat_id.value)
+            st, raw = _wait_result(lib, new_id.value)
+            assert struct.unpack_from("<i", raw)[0] == 6
         finally:
             lib.ipc_cleanup()
             if proc.poll() is None:
                 _stop_server(proc)
             _cleanup_ipc()
 
-    def test_sync_submit_fails_when_slots_full(self, capfd):
-        """A blocking request should fail immediately if no slot is available."""
-        proc = _start_server("-t", "2", "--shutdown=drain")
+    def test_full_journal_drops_stale_entries(self, capfd):
+        """New requests displace journal entries the replay could not place."""
+        proc = _start_server("-t", "2", "--shutdown=immediate")
         lib = _load_ipc_lib()
+        result_buf = (ctypes.c_byte * 64)()
+        status = ctypes.c_int()
+        holder = None
+
+        def product(request_id):
+            st, raw = _wait_result(lib, request_id)
+            assert st == IPC_STATUS_OK
+            return struct.unpack_from("<i", raw)[0]
+
         try:
             assert lib.ipc_init() == 0
+            old_ids = []
+            for i in range(IPC_MAX_SLOTS):
+                rid = ctypes.c_uint64()
+                assert lib.ipc_multiply(i, 2, ctypes.byref(rid)) == 0
+                old_ids.append(rid.value)
+
+            proc = _restart_server(proc, "-t", "2", "--shutdown=immediate")
+            # Another client takes most slots of the new server before we reconnect.
+            held = IPC_MAX_SLOTS - 4
+            script = (
+                "import ctypes, sys, time\n"
+                f"lib = ctypes.CDLL({LIBIPC_SO!r})\n"
+                "assert lib.ipc_init() == 0\n"
+                "rid = ctypes.c_uint64()\n"
+                f"for _ in range({held}):\n"
+                "    assert lib.ipc_multiply(1, 1, ctypes.byref(rid)) == 0\n"
+                "print('ready', flush=True)\n"
+                "time.sleep(60)\n"
+            )
+            holder = subprocess.Popen([sys.executable, "-c", script], stdout=subprocess.PIPE,
+                                      text=True)
+            assert holder.stdout.readline().strip() == "ready"
+
+            # Only four entries find a slot on replay; the rest stay stale.
+            for i in range(4):
+                assert product(old_ids[i]) == 2 * i
+            holder.kill()
+            holder.wait()
+            deadline = time.time() + 10
+            while TestClientRegistry._status()["slots"]["free"] != IPC_MAX_SLOTS:
+                assert time.time() < deadline
+                time.sleep(0.2)
+
+            new_ids = []
+            for i in range(IPC_MAX_SLOTS):
+                rid = ctypes.c_uint64()
+                assert lib.ipc_multiply(i, 3, ctypes.byref(rid)) == 0
+                new_ids.append(rid.value)
+            _, err = capfd.readouterr()
+            assert err.count("restart journal full") == held
 
-            for _ in range(IPC_MAX_SLOTS):
-                req_id = ctypes.c_uint64()
-                rc = lib.ipc_concat(b"a", b"b", ctypes.byref(req_id))
+            # Every new request is journaled and survives the next restart.
+            proc = _restart_server(proc, "-t", "2", "--shutdown=immediate")
+            for i, rid in enumerate(new_ids):
+                assert product(rid) == 3 * i
+            assert lib.ipc_get_result(old_ids[4], result_buf, ctypes.byref(status)) == -1
+        finally:
+            if holder is not None and holder.poll() is None:
+                holder.kill()
+                holder.wait()
+            lib.ipc_cleanup()
+            if proc.poll() is None:
+                _stop_server(proc)
+            _cleanup_ipc()
+
+    def test_crash_restart_swaps_recreated_objects(self):
+        """After a kill -9 restart the client drops every stale object it held."""
+        proc = _start_server("-t", "2", "--shutdown=drain")
+        lib = _load_ipc_lib()
+        try:
+            assert lib.ipc_init() == 0
+            out = ctypes.c_int32()
+            assert lib.ipc_add(1, 1, ctypes.byref(out)) == 0
+
+            proc.kill()
+            proc.wait(timeout=5)
+            proc = _start_server("-t", "2", "--shutdown=drain")
+
+            assert lib.ipc_add(1, 2, ctypes.byref(out)) == IPC_ERR_SERVER_RESTARTED
+            assert lib.ipc_add(1, 2, ctypes.byref(out)) == 0 and out.value == 3
+            with open("/proc/self/maps") as f:
+                maps = [line.strip() for line in f if "/dev/shm/" in line]
+            assert not [m for m in maps if "(deleted)" in m and "ipc_" in m]
+            assert len([m for m in maps if m.endswith("/dev/shm/ipc_shm")]) == 1
+        finally:
+            lib.ipc_cleanup()
+            if proc.poll() is None:
+                _stop_server(proc)
+            _cleanup_ipc()
+
+    def test_reconnect_waits_while_server_starts(self):
+        """Generation 0 means the server is starting; the client backs off until it is set."""
+        proc = _start_server("-t", "2", "--shutdown=drain")
+        lib = _load_ipc_lib()
+        try:
+            assert lib.ipc_init() == 0
+            out = ctypes.c_int32()
+            assert lib.ipc_add(2, 2, ctypes.byref(out)) == 0
+
+            with open("/dev/shm/ipc_shm", "r+b") as f:
+                shm = mmap.mmap(f.fileno(), 4096)
+            generation = struct.unpack_from("<Q", shm, 0)[0]
+            struct.pack_into("<Q", shm, 0, 0)
+            restore = threading.Timer(0.3, lambda: struct.pack_into("<Q", shm, 0, generation))
+            restore.start()
+            try:
+                start = time.monotonic()
+                assert lib.ipc_add(2, 3, ctypes.byref(out)) == IPC_ERR_SERVER_RESTARTED
+                assert time.monotonic() - start >= 0.25
+            finally:
+                restore.join()
+                shm.close()
+            assert lib.ipc_add(2, 3, ctypes.byref(out)) == 0 and out.value == 5
+        finally:
+            lib.ipc_cleanup()
+            if proc.poll() is None:
+                _stop_server(proc)
+            _cleanup_ipc()
+
+    def test_sync_submit_fails_when_slots_full(self, capfd):
+        """A blocking request should fail immediately if no slot is available."""
+        proc = _start_server("-t", "2", "--shutdown=drain")
+        lib = _load_ipc_lib()
+        try:
+            assert lib.ipc_init() == 0
+
+            for _ in range(IPC_MAX_SLOTS):
+                req_id = ctypes.c_uint64()
+                rc = lib.ipc_concat(b"a", b"b", ctypes.byref(req_id))
                 assert rc == 0
 
             out = ctypes.c_int32()
@@ -498,6 +1409,51 @@ class TestRestartRecovery:
             _cleanup_ipc()
 
 
+class TestResultCache:
+    """Opt-in client-side cache for ipc_add / ipc_subtract."""
+
+    @staticmethod
+    def _stats(lib):
+        stats = IpcCacheStats()
+        lib.ipc_result_cache_stats(ctypes.byref(stats))
+        return stats.hits, stats.misses, stats.entries
+
+    def test_repeated_calls_hit_and_restart_invalidates(self):
+        """Repeats are answered locally; a server restart drops cached results."""
+        proc = _start_server("-t", "2", "--shutdown=drain")
+        lib = _load_ipc_lib()
+        try:
+            assert lib.ipc_init() == 0
+            out = ctypes.c_int32()
+            assert lib.ipc_add(2, 3, ctypes.byref(out)) == 0
+            assert self._stats(lib) == (0, 0, 0)
+
+            assert lib.ipc_result_cache_enable(4097) == -1
+            assert lib.ipc_result_cache_enable(100) == 0
+            for _ in range(3):
+                assert lib.ipc_add(2, 3, ctypes.byref(out)) == 0 and out.value == 5
+                assert lib.ipc_subtract(2, 3, ctypes.byref(out)) == 0 and out.value == -1
+            assert lib.ipc_add(-(2 ** 31), -1, ctypes.byref(out)) == 0
+            assert out.value == 2 ** 31 - 1
+            assert self._stats(lib) == (4, 3, 128)
+
+            proc = _restart_server(proc, "-t", "2", "--shutdown=drain")
+            # The first repeat after the restart must not be answered locally.
+            assert lib.ipc_add(2, 3, ctypes.byref(out)) == IPC_ERR_SERVER_RESTARTED
+            assert self._stats(lib) == (4, 4, 128)
+            assert lib.ipc_add(2, 3, ctypes.byref(out)) == 0 and out.value == 5
+            assert self._stats(lib) == (4, 5, 128)
+
+            assert lib.ipc_result_cache_enable(0) == 0
+            assert lib.ipc_add(2, 3, ctypes.byref(out)) == 0
+            assert self._stats(lib) == (0, 0, 0)
+        finally:
+            lib.ipc_cleanup()
+            if proc.poll() is None:
+                _stop_server(proc)
+            _cleanup_ipc()
+
+
 class TestClientRestartUx:
     """Test client-visible restart recovery behavior."""
 
@@ -541,7 +1497,7 @@ class TestClientRestartUx:
             _cleanup_ipc()
 
     def test_client1_async_resubmit_after_restart(self):
-        """Client1 should auto-resubmit pending async work after restart."""
+        """Client1's pending async work is resubmitted by libipc after restart."""
         server = _start_server("-t", "2", "--shutdown=drain")
         env = os.environ.copy()
         env["LD_LIBRARY_PATH"] = BUILD_DIR
@@ -563,7 +1519,7 @@ class TestClientRestartUx:
             server = _restart_server(server, "-t", "2", "--shutdown=drain")
             time.sleep(0.3)
 
-            # First check triggers restart handling and re-submit.
+            # First check hits the restart; libipc resubmits the multiply under the same ID.
             client.stdin.write(b"4\n")
             client.stdin.flush()
             time.sleep(0.5)
@@ -578,9 +1534,8 @@ class TestClientRestartUx:
 
             stdout, stderr = client.communicate(timeout=20)
             out = (stdout.decode() + stderr.decode())
-            assert "re-submitting" in out.lower()
-            assert "re-submitted" in out.lower()
             assert "result is 56!" in out.lower()
+            assert "not found" not in out.lower()
         finally:
             if client.poll() is None:
                 client.kill()
@@ -928,3 +1883,1238 @@ class TestMathFunctionBatchesContd:
                 _stop_server(proc)
             _cleanup_ipc()
 
+
+
+class TestStringKernels:
+    """Length-prefixed concat/search kernels across boundary positions."""
+
+    def test_search_positions_and_edges(self):
+        """Search must honour explicit lengths, including 16-byte haystacks."""
+        cases = [
+            (b"Hello!", b"lo", 3),
+            (b"abcdefghijklmnop", b"a", 0),
+            (b"abcdefghijklmnop", b"p", 15),
+            (b"abcdefghijklmnop", b"mnop", 12),
+            (b"abcdefghijklmnop", b"abcdefghijklmnop", 0),
+            (b"aaaaaaaaaaaaaaab", b"aab", 13),
+            (b"abcabcabd", b"abd", 6),
+            (b"abc", b"abcd", -1),
+            (b"abcdefghijklmnop", b"pq", -1),
+            (b"xyx", b"yy", -1),
+        ]
+        proc = _start_server("-t", "2", "--shutdown=drain")
+        lib = _load_ipc_lib()
+        try:
+            assert lib.ipc_init() == 0
+            for hay, needle, expected in cases:
+                req_id = ctypes.c_uint64()
+                assert lib.ipc_search(hay, needle, ctypes.byref(req_id)) == 0
+                status, raw = _wait_result(lib, req_id.value)
+                position = int.from_bytes(raw[:4], "little", signed=True)
+                if expected < 0:
+                    assert status == IPC_STATUS_NOT_FOUND, (hay, needle)
+                    assert position == -1
+                else:
+                    assert status == IPC_STATUS_OK, (hay, needle)
+                    assert position == expected, (hay, needle, position)
+        finally:
+            lib.ipc_cleanup()
+            if proc.poll() is None:
+                _stop_server(proc)
+            _cleanup_ipc()
+
+    def test_concat_lengths_and_validation(self):
+        """Concat output is exact for every length mix; bad lengths are rejected."""
+        proc = _start_server("-t", "2", "--shutdown=drain")
+        lib = _load_ipc_lib()
+        try:
+            assert lib.ipc_init() == 0
+            for s1, s2 in [(b"a", b"b"), (b"x" * 16, b"y"), (b"q", b"r" * 16),
+                           (b"m" * 9, b"n" * 7), (b"s" * 16, b"t" * 16)]:
+                req_id = ctypes.c_uint64()
+                assert lib.ipc_concat(s1, s2, ctypes.byref(req_id)) == 0
+                status, raw = _wait_result(lib, req_id.value)
+                assert status == IPC_STATUS_OK
+                assert raw.split(b"\0", 1)[0] == s1 + s2
+
+            req_id = ctypes.c_uint64()
+            assert lib.ipc_concat(b"", b"b", ctypes.byref(req_id)) == -1
+            assert lib.ipc_concat(b"a" * 17, b"b", ctypes.byref(req_id)) == -1
+            assert lib.ipc_search(b"abc", None, ctypes.byref(req_id)) == -1
+        finally:
+            lib.ipc_cleanup()
+            if proc.poll() is None:
+                _stop_server(proc)
+            _cleanup_ipc()
+
+
+class TestMatmul:
+    """IPC_CMD_MATMUL over arena buffers, split across math workers."""
+
+    @staticmethod
+    def _arena_array(lib, ctype, count):
+        off = ctypes.c_uint64()
+        assert lib.ipc_arena_alloc(ctypes.sizeof(ctype) * count, ctypes.byref(off)) == 0
+        assert off.value % 64 == 0
+        ptr = lib.ipc_arena_ptr(off.value)
+        assert ptr
+        return off.value, (ctype * count).from_address(ptr)
+
+    def _run_case(self, lib, m, n, k, dtype):
+        ctype = ctypes.c_int32 if dtype == IPC_DTYPE_INT32 else ctypes.c_float
+        a_off, a = self._arena_array(lib, ctype, m * k)
+        b_off, b = self._arena_array(lib, ctype, k * n)
+        c_off, c = self._arena_array(lib, ctype, m * n)
+        for i in range(m * k):
+            a[i] = (i * 7919) % 23 - 11 if dtype == IPC_DTYPE_FLOAT32 else (i * 2654435761) % 2**31 - 2**30
+        for i in range(k * n):
+            b[i] = (i * 104729) % 19 - 9
+        req = ctypes.c_uint64()
+        assert lib.ipc_matmul(m, n, k, dtype, a_off, b_off, c_off, ctypes.byref(req)) == 0
+        assert _wait_result(lib, req.value)[0] == IPC_STATUS_OK
+
+        for i in range(m):
+            for j in range(n):
+                acc = sum(a[i * k + p] * b[p * n + j] for p in range(k))
+                if dtype == IPC_DTYPE_INT32:
+                    acc = (acc + 2**31) % 2**32 - 2**31
+                    assert c[i * n + j] == acc, (m, n, k, i, j)
+                else:
+                    assert abs(c[i * n + j] - acc) <= 1e-3 * (1 + abs(acc)), (m, n, k, i, j)
+
+        for off in (a_off, b_off, c_off):
+            assert lib.ipc_arena_free(off) == 0
+
+    def test_matmul_int32_and_float_ragged_shapes(self):
+        """Ragged shapes exercise row/column tails and multi-part splits."""
+        proc = _start_server("-t", "3", "--shutdown=drain")
+        lib = _load_ipc_lib()
+        try:
+            assert lib.ipc_init() == 0
+            self._run_case(lib, 1, 1, 1, IPC_DTYPE_INT32)
+            self._run_case(lib, 130, 19, 7, IPC_DTYPE_INT32)
+            self._run_case(lib, 5, 33, 300, IPC_DTYPE_INT32)
+            self._run_case(lib, 70, 17, 9, IPC_DTYPE_FLOAT32)
+        finally:
+            lib.ipc_cleanup()
+            if proc.poll() is None:
+                _stop_server(proc)
+            _cleanup_ipc()
+
+    def test_matmul_rejects_bad_buffers(self):
+        """Undersized, unallocated or overlapping buffers are reported as invalid input."""
+        proc = _start_server("-t", "2", "--shutdown=drain")
+        lib = _load_ipc_lib()
+        try:
+            assert lib.ipc_init() == 0
+            small_off, _ = self._arena_array(lib, ctypes.c_int32, 4)
+            req = ctypes.c_uint64()
+            assert lib.ipc_matmul(8, 8, 8, IPC_DTYPE_INT32, small_off, small_off,
+                                  small_off, ctypes.byref(req)) == 0
+            assert _wait_result(lib, req.value)[0] == IPC_STATUS_INVALID_INPUT
+
+            assert lib.ipc_matmul(1, 1, 1, IPC_DTYPE_INT32, 12345, small_off,
+                                  small_off, ctypes.byref(req)) == 0
+            assert _wait_result(lib, req.value)[0] == IPC_STATUS_INVALID_INPUT
+
+            # C must not share bytes with A or B: parts write C while others read them.
+            big_off, _ = self._arena_array(lib, ctypes.c_int32, 64)
+            assert lib.ipc_matmul(2, 2, 2, IPC_DTYPE_INT32, big_off, small_off,
+                                  big_off, ctypes.byref(req)) == 0
+            assert _wait_result(lib, req.value)[0] == IPC_STATUS_INVALID_INPUT
+            assert lib.ipc_matmul(2, 2, 2, IPC_DTYPE_INT32, small_off, big_off,
+                                  big_off, ctypes.byref(req)) == 0
+            assert _wait_result(lib, req.value)[0] == IPC_STATUS_INVALID_INPUT
+
+            assert lib.ipc_arena_free(small_off) == 0
+            assert lib.ipc_arena_free(small_off) == -1
+        finally:
+            lib.ipc_cleanup()
+            if proc.poll() is None:
+                _stop_server(proc)
+            _cleanup_ipc()
+
+    def test_matmul_rejects_forged_block_size(self):
+        """A block header whose size was overwritten cannot widen the span."""
+        proc = _start_server("-t", "2", "--shutdown=drain")
+        lib = _load_ipc_lib()
+        try:
+            assert lib.ipc_init() == 0
+            n = 4096
+            a_off, _ = self._arena_array(lib, ctypes.c_int32, n)
+            b_off, _ = self._arena_array(lib, ctypes.c_int32, n)
+            c_off, _ = self._arena_array(lib, ctypes.c_int32, 4)
+            # ArenaBlockHeader::size sits 16 bytes into the header before the block.
+            size_field = ctypes.c_uint64.from_address(lib.ipc_arena_ptr(c_off) - 64 + 16)
+            real_size = size_field.value
+            req = ctypes.c_uint64()
+            for forged in (8, 2**64 - 64, 2**63):
+                size_field.value = forged
+                assert lib.ipc_matmul(n, n, 1, IPC_DTYPE_INT32, a_off, b_off, c_off,
+                                      ctypes.byref(req)) == 0
+                assert _wait_result(lib, req.value)[0] == IPC_STATUS_INVALID_INPUT
+            size_field.value = real_size
+            assert proc.poll() is None
+            assert lib.ipc_arena_free(c_off) == 0
+        finally:
+            lib.ipc_cleanup()
+            if proc.poll() is None:
+                _stop_server(proc)
+            _cleanup_ipc()
+
+
+class TestDeadlineScheduling:
+    """Pools serve queued requests by priority, then earliest deadline first."""
+
+    @staticmethod
+    def _queue_matmuls(lib, n, count):
+        a_off, a = TestMatmul._arena_array(lib, ctypes.c_int32, n * n)
+        for i in range(n * n):
+            a[i] = i % 7
+        reqs = []
+        for _ in range(count):
+            c_off, _ = TestMatmul._arena_array(lib, ctypes.c_int32, n * n)
+            req = ctypes.c_uint64()
+            assert lib.ipc_matmul(n, n, n, IPC_DTYPE_INT32, a_off, a_off, c_off,
+                                  ctypes.byref(req)) == 0
+            reqs.append(req.value)
+        return reqs
+
+    @staticmethod
+    def _still_queued(lib, request_id):
+        result_buf = (ctypes.c_byte * 64)()
+        status = ctypes.c_int()
+        return lib.ipc_get_result(request_id, result_buf,
+                                  ctypes.byref(status)) == IPC_NOT_READY
+
+    def test_deadline_request_overtakes_queued_batch_work(self):
+        """A request with a 1 ms budget finishes before slack work queued earlier."""
+        proc = _start_server("-t", "1", "--shutdown=drain")
+        lib = _load_ipc_lib()
+        try:
+            assert lib.ipc_init() == 0
+            reqs = self._queue_matmuls(lib, 256, 8)
+
+            lib.ipc_set_deadline(1_000_000)
+            out = ctypes.c_int32()
+            assert lib.ipc_add(20, 22, ctypes.byref(out)) == 0 and out.value == 42
+            lib.ipc_set_deadline(0)
+
+            # FIFO would have finished every matmul before the add.
+            assert self._still_queued(lib, reqs[-1])
+            for req in reqs:
+                assert _wait_result(lib, req)[0] == 0
+        finally:
+            lib.ipc_cleanup()
+            if proc.poll() is None:
+                _stop_server(proc)
+            _cleanup_ipc()
+
+    def test_high_priority_overtakes_low_priority_work(self):
+        """A high-priority request jumps queued low-priority work, which still completes."""
+        proc = _start_server("-t", "1", "--shutdown=drain")
+        lib = _load_ipc_lib()
+        try:
+            assert lib.ipc_init() == 0
+            assert lib.ipc_set_priority(3) == -1
+            assert lib.ipc_set_priority(0) == 0
+            reqs = self._queue_matmuls(lib, 192, 8)
+
+            assert lib.ipc_set_priority(2) == 0
+            out = ctypes.c_int32()
+            assert lib.ipc_add(1, 2, ctypes.byref(out)) == 0 and out.value == 3
+            assert lib.ipc_set_priority(1) == 0
+
+            assert self._still_queued(lib, reqs[-1])
+            for req in reqs:
+                assert _wait_result(lib, req)[0] == 0
+        finally:
+            lib.ipc_cleanup()
+            if proc.poll() is None:
+                _stop_server(proc)
+            _cleanup_ipc()
+
+
+class TestTimedCalls:
+    """Blocking calls with a timeout give up on time and cancel their request."""
+
+    def test_timeout_cancels_request_and_frees_slot(self):
+        """A timed add stuck behind a running matmul returns IPC_ERR_TIMEOUT promptly."""
+        proc = _start_server("-t", "1", "--shutdown=drain")
+        lib = _load_ipc_lib()
+        try:
+            assert lib.ipc_init() == 0
+            out = ctypes.c_int32()
+            assert lib.ipc_add_timed(2, 3, ctypes.byref(out), 2_000_000) == 0
+            assert out.value == 5
+            assert lib.ipc_subtract_timed(2, 3, ctypes.byref(out), 0) == 0
+            assert out.value == -1
+
+            # Size the matmuls from a measured one, so each keeps the only
+            # math worker busy for about half a second on this host.
+            start = time.monotonic()
+            probe = TestDeadlineScheduling._queue_matmuls(lib, 512, 1)
+            assert _wait_result(lib, probe[0])[0] == IPC_STATUS_OK
+            scale = (0.5 / (time.monotonic() - start)) ** (1 / 3)
+            n = min(1024, max(512, int(512 * scale) // 64 * 64))
+            reqs = TestDeadlineScheduling._queue_matmuls(lib, n, 2)
+
+            # Each timed call is made right after a matmul has started.
+            assert TestDeadlineScheduling._still_queued(lib, reqs[0])
+            start = time.monotonic()
+            assert lib.ipc_add_timed(1, 1, ctypes.byref(out), 30_000) == IPC_ERR_TIMEOUT
+            assert time.monotonic() - start < 0.25
+
+            assert _wait_result(lib, reqs[0])[0] == IPC_STATUS_OK
+            assert TestDeadlineScheduling._still_queued(lib, reqs[1])
+            lib.ipc_set_timeout(30_000)
+            start = time.monotonic()
+            assert lib.ipc_subtract(5, 1, ctypes.byref(out)) == IPC_ERR_TIMEOUT
+            assert time.monotonic() - start < 0.25
+            lib.ipc_set_timeout(0)
+
+            assert _wait_result(lib, reqs[1])[0] == IPC_STATUS_OK
+            # The cancelled requests ran, but nobody has to collect them.
+            deadline = time.time() + 5
+            while TestClientRegistry._status()["slots"]["free"] != IPC_MAX_SLOTS:
+                assert time.time() < deadline
+                time.sleep(0.05)
+            assert lib.ipc_subtract_timed(9, 4, ctypes.byref(out), 2_000_000) == 0
+            assert out.value == 5
+        finally:
+            lib.ipc_cleanup()
+            if proc.poll() is None:
+                _stop_server(proc)
+            _cleanup_ipc()
+
+
+class TestAdaptiveWait:
+    """Blocking calls spin briefly on their slot before sleeping."""
+
+    def test_spin_catches_fast_responses(self):
+        """Fast adds are caught spinning; with spinning off every call sleeps."""
+        proc = _start_server("-t", "2", "--shutdown=drain")
+        lib = _load_ipc_lib()
+        try:
+            assert lib.ipc_init() == 0
+            out = ctypes.c_int32()
+            before = IpcWaitStats()
+            lib.ipc_wait_stats(ctypes.byref(before))
+            assert before.spin_limit_ns == 50_000
+            for i in range(500):
+                assert lib.ipc_add(i, 1, ctypes.byref(out)) == 0 and out.value == i + 1
+            after = IpcWaitStats()
+            lib.ipc_wait_stats(ctypes.byref(after))
+            assert after.spin_hits - before.spin_hits > 250
+            assert 0 < after.add_service_ns < 50_000
+
+            lib.ipc_set_spin_limit(0)
+            for i in range(100):
+                assert lib.ipc_subtract(i, 1, ctypes.byref(out)) == 0 and out.value == i - 1
+            final = IpcWaitStats()
+            lib.ipc_wait_stats(ctypes.byref(final))
+            assert final.spin_hits == after.spin_hits
+            assert final.sleeps - after.sleeps == 100
+            lib.ipc_set_spin_limit(50_000)
+        finally:
+            lib.ipc_cleanup()
+            if proc.poll() is None:
+                _stop_server(proc)
+            _cleanup_ipc()
+
+
+class TestSlotMagazines:
+    """Per-thread reserved slots: reuse, yielding to other claimants, idle reclaim."""
+
+    @staticmethod
+    def _stats(lib):
+        stats = IpcSlotMagazineStats()
+        lib.ipc_slot_magazine_stats(ctypes.byref(stats))
+        return stats
+
+    def test_blocking_calls_reuse_reserved_slot(self):
+        """After the first call, blocking calls run from the thread's reserved slot."""
+        proc = _start_server("-t", "2", "--shutdown=drain")
+        lib = _load_ipc_lib()
+        try:
+            assert lib.ipc_init() == 0
+            assert lib.ipc_slot_magazine(IPC_SLOT_MAGAZINE_MAX + 1) == -1
+            assert lib.ipc_slot_magazine(2) == 0
+            out = ctypes.c_int32()
+            for i in range(200):
+                assert lib.ipc_add(i, 1, ctypes.byref(out)) == 0 and out.value == i + 1
+            stats = self._stats(lib)
+            assert (stats.hits, stats.misses, stats.lost) == (199, 1, 0)
+            assert (stats.held, stats.capacity) == (1, 2)
+            slots = TestClientRegistry._status()["slots"]
+            assert slots["reserved"] == 1 and slots["free"] == IPC_MAX_SLOTS - 1
+
+            assert lib.ipc_slot_magazine(0) == 0
+            assert self._stats(lib).held == 0
+            assert TestClientRegistry._status()["slots"]["free"] == IPC_MAX_SLOTS
+        finally:
+            lib.ipc_slot_magazine(0)
+            lib.ipc_cleanup()
+            if proc.poll() is None:
+                _stop_server(proc)
+            _cleanup_ipc()
+
+    def test_reserved_slot_yields_to_others_and_idles_out(self):
+        """A full table takes the reserved slot; the server frees one left idle."""
+        proc = _start_server("-t", "2", "--shutdown=drain")
+        lib = _load_ipc_lib()
+        try:
+            assert lib.ipc_init() == 0
+            assert lib.ipc_slot_magazine(1) == 0
+            out = ctypes.c_int32()
+            assert lib.ipc_add(1, 2, ctypes.byref(out)) == 0
+            assert self._stats(lib).held == 1
+
+            reqs = []
+            for _ in range(IPC_MAX_SLOTS):
+                req_id = ctypes.c_uint64()
+                assert lib.ipc_concat(b"a", b"b", ctypes.byref(req_id)) == 0
+                reqs.append(req_id.value)
+            for req in reqs:
+                assert _wait_result(lib, req)[0] == IPC_STATUS_OK
+            assert lib.ipc_add(3, 4, ctypes.byref(out)) == 0 and out.value == 7
+            stats = self._stats(lib)
+            assert (stats.lost, stats.held) == (1, 1)
+
+            # Unused for five liveness sweeps (one per second), the slot goes back.
+            deadline = time.time() + 10
+            while TestClientRegistry._status()["slots"]["reserved"] != 0:
+                assert time.time() < deadline
+                time.sleep(0.2)
+            assert lib.ipc_add(5, 6, ctypes.byref(out)) == 0 and out.value == 11
+            assert self._stats(lib).lost == 2
+            lib.ipc_slot_magazine(0)
+            output = _stop_server(proc)
+            assert "took back 1 idle magazine slot(s)" in output
+        finally:
+            lib.ipc_slot_magazine(0)
+            lib.ipc_cleanup()
+            if proc.poll() is None:
+                _stop_server(proc)
+            _cleanup_ipc()
+
+
+class TestArenaAllocator:
+    """Slab classes, TLSF blocks and reclamation of dead clients' buffers."""
+
+    def test_buffers_are_disjoint_and_coalesce(self):
+        """Mixed-size buffers never overlap; freeing everything restores a large block."""
+        rng = random.Random(83)
+        proc = _start_server("-t", "2", "--shutdown=drain")
+        lib = _load_ipc_lib()
+        try:
+            assert lib.ipc_init() == 0
+            live = {}
+
+            def alloc(size):
+                off = ctypes.c_uint64()
+                assert lib.ipc_arena_alloc(size, ctypes.byref(off)) == 0
+                assert off.value % 64 == 0 and off.value not in live
+                tag = len(live) % 251
+                ctypes.memset(lib.ipc_arena_ptr(off.value), tag, size)
+                live[off.value] = (size, tag)
+
+            for _ in range(3):
+                for _ in range(300):
+                    alloc(rng.choice([1, 40, 64, 65, 500, 4096, 4097, 70000,
+                                      rng.randrange(1, 300000)]))
+                spans = sorted((off, off + size) for off, (size, _) in live.items())
+                assert all(a[1] <= b[0] for a, b in zip(spans, spans[1:]))
+                for off, (size, tag) in live.items():
+                    assert ctypes.string_at(lib.ipc_arena_ptr(off), size) == bytes([tag]) * size
+                for off in rng.sample(sorted(live), len(live) // 2):
+                    assert lib.ipc_arena_free(off) == 0
+                    del live[off]
+
+            for off in list(live):
+                assert lib.ipc_arena_free(off) == 0
+                assert lib.ipc_arena_free(off) == -1
+            big = ctypes.c_uint64()
+            assert lib.ipc_arena_alloc(12 * 1024 * 1024, ctypes.byref(big)) == 0
+            assert lib.ipc_arena_free(big.value) == 0
+        finally:
+            lib.ipc_cleanup()
+            if proc.poll() is None:
+                _stop_server(proc)
+            _cleanup_ipc()
+
+    def test_dead_client_buffers_are_reclaimed(self):
+        """Buffers leaked by an exited client are reused once the arena runs out."""
+        child = (
+            "import ctypes, os, sys\n"
+            "lib = ctypes.CDLL(sys.argv[1])\n"
+            "assert lib.ipc_init() == 0\n"
+            "off = ctypes.c_uint64()\n"
+            "for size in (4 << 20, 4 << 20, 4 << 20, 100, 3000):\n"
+            "    assert lib.ipc_arena_alloc(ctypes.c_size_t(size), ctypes.byref(off)) == 0\n"
+            "os._exit(0)\n"
+        )
+        proc = _start_server("-t", "2", "--shutdown=drain")
+        lib = _load_ipc_lib()
+        try:
+            assert lib.ipc_init() == 0
+            subprocess.run([sys.executable, "-c", child, LIBIPC_SO], check=True, timeout=30)
+            offs = []
+            for _ in range(3):
+                off = ctypes.c_uint64()
+                assert lib.ipc_arena_alloc(4 * 1024 * 1024, ctypes.byref(off)) == 0
+                offs.append(off.value)
+            for off in offs:
+                assert lib.ipc_arena_free(off) == 0
+        finally:
+            lib.ipc_cleanup()
+            if proc.poll() is None:
+                _stop_server(proc)
+            _cleanup_ipc()
+
+
+def _crc32c(data):
+    crc = 0xFFFFFFFF
+    for byte in data:
+        crc ^= byte
+        for _ in range(8):
+            crc = (crc >> 1) ^ (0x82F63B78 & -(crc & 1))
+    return crc ^ 0xFFFFFFFF
+
+
+def _xxh32(data):
+    p1, p2, p3, p4, p5 = 2654435761, 2246822519, 3266489917, 668265263, 374761393
+    mask = 0xFFFFFFFF
+
+    def rotl(x, r):
+        return ((x << r) | (x >> (32 - r))) & mask
+
+    def round_(acc, lane):
+        return rotl((acc + lane * p2) & mask, 13) * p1 & mask
+
+    pos, n = 0, len(data)
+    if n >= 16:
+        v = [(p1 + p2) & mask, p2, 0, (-p1) & mask]
+        while pos + 16 <= n:
+            for lane in range(4):
+                word = int.from_bytes(data[pos + 4 * lane:pos + 4 * lane + 4], "little")
+                v[lane] = round_(v[lane], word)
+            pos += 16
+        h = (rotl(v[0], 1) + rotl(v[1], 7) + rotl(v[2], 12) + rotl(v[3], 18)) & mask
+    else:
+        h = p5
+    h = (h + n) & mask
+    while pos + 4 <= n:
+        h = rotl((h + int.from_bytes(data[pos:pos + 4], "little") * p3) & mask, 17) * p4 & mask
+        pos += 4
+    while pos < n:
+        h = rotl((h + data[pos] * p5) & mask, 11) * p1 & mask
+        pos += 1
+    h ^= h >> 15
+    h = h * p2 & mask
+    h ^= h >> 13
+    h = h * p3 & mask
+    h ^= h >> 16
+    return h
+
+
+class TestBulkStrings:
+    """IPC_CMD_STR_SORT / STR_DEDUPE / STR_HASH over arena string arrays."""
+
+    @staticmethod
+    def _load_strings(lib, strings):
+        """Pack strings and their IpcStrRef table into the arena."""
+        blob = b"".join(strings)
+        data_off = ctypes.c_uint64()
+        assert lib.ipc_arena_alloc(max(len(blob), 1), ctypes.byref(data_off)) == 0
+        ctypes.memmove(lib.ipc_arena_ptr(data_off.value), blob, len(blob))
+
+        refs_off = ctypes.c_uint64()
+        assert lib.ipc_arena_alloc(8 * len(strings), ctypes.byref(refs_off)) == 0
+        refs = (ctypes.c_uint32 * (2 * len(strings))).from_address(
+            lib.ipc_arena_ptr(refs_off.value))
+        pos = data_off.value
+        for i, s in enumerate(strings):
+            refs[2 * i] = pos
+            refs[2 * i + 1] = len(s)
+            pos += len(s)
+
+        out_off, out = TestMatmul._arena_array(lib, ctypes.c_uint32, len(strings))
+        return [data_off.value, refs_off.value, out_off], out
+
+    def test_sort_dedupe_and_hash_match_reference(self):
+        """Results match Python references, including multi-part splits."""
+        rng = random.Random(5)
+        alphabet = b"ab\x00\xffz"
+        strings = [bytes(rng.choice(alphabet) for _ in range(rng.randrange(0, 12)))
+                   for _ in range(9000)]
+        strings += [b"x" * 80 + bytes([i % 3]) for i in range(300)]  # deep prefixes
+
+        proc = _start_server("-t", "3", "--shutdown=drain")
+        lib = _load_ipc_lib()
+        try:
+            assert lib.ipc_init() == 0
+            offs, out = self._load_strings(lib, strings)
+            refs_off, out_off = offs[1], offs[2]
+            req = ctypes.c_uint64()
+            n = len(strings)
+
+            assert lib.ipc_str_sort(refs_off, n, out_off, ctypes.byref(req)) == 0
+            status, raw = _wait_result(lib, req.value)
+            assert (status, _result_count(raw)) == (IPC_STATUS_OK, n)
+            expected = sorted(range(n), key=lambda i: strings[i])
+            assert list(out) == expected
+
+            assert lib.ipc_str_dedupe(refs_off, n, out_off, ctypes.byref(req)) == 0
+            seen, firsts = set(), []
+            for i, s in enumerate(strings):
+                if s not in seen:
+                    seen.add(s)
+                    firsts.append(i)
+            status, raw = _wait_result(lib, req.value)
+            assert (status, _result_count(raw)) == (IPC_STATUS_OK, len(firsts))
+            assert list(out[:len(firsts)]) == firsts
+
+            for algo, ref in ((IPC_HASH_CRC32C, _crc32c), (IPC_HASH_XXH32, _xxh32)):
+                assert lib.ipc_str_hash(refs_off, n, algo, out_off, ctypes.byref(req)) == 0
+                status, raw = _wait_result(lib, req.value)
+                assert (status, _result_count(raw)) == (IPC_STATUS_OK, n)
+                for i in range(0, n, 97):
+                    assert out[i] == ref(strings[i]), (algo, strings[i])
+
+            for off in offs:
+                assert lib.ipc_arena_free(off) == 0
+        finally:
+            lib.ipc_cleanup()
+            if proc.poll() is None:
+                _stop_server(proc)
+            _cleanup_ipc()
+
+    def test_reference_hashes(self):
+        """The Python references agree with the published check values."""
+        assert _crc32c(b"123456789") == 0xE3069283
+        assert _xxh32(b"") == 0x02CC5D05
+
+    def test_bad_string_refs_are_rejected(self):
+        """Refs pointing outside the arena or undersized tables are invalid input."""
+        proc = _start_server("-t", "2", "--shutdown=drain")
+        lib = _load_ipc_lib()
+        try:
+            assert lib.ipc_init() == 0
+            offs, _ = self._load_strings(lib, [b"abc", b"de"])
+            refs = (ctypes.c_uint32 * 4).from_address(lib.ipc_arena_ptr(offs[1]))
+            refs[2] = 16 * 1024 * 1024 - 1
+            req = ctypes.c_uint64()
+            assert lib.ipc_str_sort(offs[1], 2, offs[2], ctypes.byref(req)) == 0
+            assert _wait_result(lib, req.value)[0] == IPC_STATUS_INVALID_INPUT
+
+            assert lib.ipc_str_hash(offs[1], 64, IPC_HASH_CRC32C, offs[2],
+                                    ctypes.byref(req)) == 0
+            assert _wait_result(lib, req.value)[0] == IPC_STATUS_INVALID_INPUT
+            assert lib.ipc_str_hash(offs[1], 2, 7, offs[2], ctypes.byref(req)) == -1
+            assert lib.ipc_str_dedupe(offs[1], 0, offs[2], ctypes.byref(req)) == -1
+
+            for off in offs:
+                assert lib.ipc_arena_free(off) == 0
+        finally:
+            lib.ipc_cleanup()
+            if proc.poll() is None:
+                _stop_server(proc)
+            _cleanup_ipc()
+
+
+class TestRegexSearch:
+    """IPC_CMD_REGEX_SEARCH with server-side compiled-pattern cache."""
+
+    @staticmethod
+    def _arena_bytes(lib, data):
+        off = ctypes.c_uint64()
+        assert lib.ipc_arena_alloc(max(len(data), 1), ctypes.byref(off)) == 0
+        ctypes.memmove(lib.ipc_arena_ptr(off.value), data, len(data))
+        return off.value
+
+    def _search(self, lib, pattern, haystack):
+        """Returns (status, position, length)."""
+        p_off = self._arena_bytes(lib, pattern)
+        h_off = self._arena_bytes(lib, haystack)
+        req = ctypes.c_uint64()
+        assert lib.ipc_regex_search(p_off, len(pattern), h_off, len(haystack),
+                                    ctypes.byref(req)) == 0
+        status, raw = _wait_result(lib, req.value)
+        assert lib.ipc_arena_free(p_off) == 0
+        assert lib.ipc_arena_free(h_off) == 0
+        return (status, int.from_bytes(raw[:4], "little", signed=True),
+                int.from_bytes(raw[4:8], "little"))
+
+    def test_leftmost_longest_matches(self):
+        """Classes, alternation, repetition and anchors report the right span."""
+        proc = _start_server("-t", "2", "--shutdown=drain")
+        lib = _load_ipc_lib()
+        try:
+            assert lib.ipc_init() == 0
+            cases = [
+                (rb"\d+", b"order 12345 shipped", (IPC_STATUS_OK, 6, 5)),
+                (rb"ab|abcd", b"xxabcdx", (IPC_STATUS_OK, 2, 4)),
+                (rb"[a-c]{2,3}x?", b"zzbcax", (IPC_STATUS_OK, 2, 4)),
+                (rb"^foo", b"xfoo", (IPC_STATUS_NOT_FOUND, -1, 0)),
+                (rb"o+$", b"foo boo", (IPC_STATUS_OK, 5, 2)),
+                (rb"(?:err|warn)[^:]*:", b"line 9 warning: x", (IPC_STATUS_OK, 7, 8)),
+                (rb"x*", b"abc", (IPC_STATUS_OK, 0, 0)),
+                (rb"abcd|c", b"abcd", (IPC_STATUS_OK, 0, 4)),
+                (rb"^a|b$", b"cab", (IPC_STATUS_OK, 2, 1)),
+                (rb"needle", b"hay" * 5000 + b"needle", (IPC_STATUS_OK, 15000, 6)),
+            ]
+            for pattern, haystack, expected in cases:
+                assert self._search(lib, pattern, haystack) == expected, pattern
+            # Second round hits the compiled-pattern cache and must agree.
+            for pattern, haystack, expected in cases:
+                assert self._search(lib, pattern, haystack) == expected, pattern
+        finally:
+            lib.ipc_cleanup()
+            if proc.poll() is None:
+                _stop_server(proc)
+            _cleanup_ipc()
+
+    def test_search_time_is_linear(self):
+        """Many candidate starts before the match do not make the search quadratic."""
+        proc = _start_server("-t", "2", "--shutdown=drain")
+        lib = _load_ipc_lib()
+        try:
+            assert lib.ipc_init() == 0
+            haystack = b"a" * (256 * 1024) + b"b"
+            start = time.monotonic()
+            assert self._search(lib, rb"a*c|b", haystack) == (IPC_STATUS_OK, len(haystack) - 1, 1)
+            assert time.monotonic() - start < 1.0
+        finally:
+            lib.ipc_cleanup()
+            if proc.poll() is None:
+                _stop_server(proc)
+            _cleanup_ipc()
+
+    def test_invalid_patterns_are_rejected(self):
+        """Syntax errors and oversized patterns are reported, not crashed on."""
+        proc = _start_server("-t", "2", "--shutdown=drain", "--regex-cache=1")
+        lib = _load_ipc_lib()
+        try:
+            assert lib.ipc_init() == 0
+            for pattern in (rb"(ab", rb"a{3,2}", rb"*a", rb"[z-a]", rb"\q"):
+                assert self._search(lib, pattern, b"abc")[0] == IPC_STATUS_INVALID_INPUT
+            assert self._search(lib, b"a" * 1025, b"a")[0] == IPC_STATUS_STR_TOO_LONG
+            # Unallocated haystack offset.
+            p_off = self._arena_bytes(lib, b"a")
+            req = ctypes.c_uint64()
+            assert lib.ipc_regex_search(p_off, 1, 64 * 1000, 4, ctypes.byref(req)) == 0
+            assert _wait_result(lib, req.value)[0] == IPC_STATUS_INVALID_INPUT
+            # Cache of one entry still answers correctly while evicting.
+            assert self._search(lib, rb"b+", b"abbc") == (IPC_STATUS_OK, 1, 2)
+            assert self._search(lib, rb"c", b"abbc") == (IPC_STATUS_OK, 3, 1)
+            assert self._search(lib, rb"b+", b"abbc") == (IPC_STATUS_OK, 1, 2)
+        finally:
+            lib.ipc_cleanup()
+            if proc.poll() is None:
+                _stop_server(proc)
+            _cleanup_ipc()
+
+
+class TestSearchBatch:
+    """IPC_CMD_SEARCH_BATCH: one haystack, many needles, one request."""
+
+    def test_positions_match_bytes_find(self):
+        """Every needle gets its first position, across several worker parts."""
+        rng = random.Random(81)
+        alphabet = b"abc\x00"
+        haystack = bytes(rng.choice(alphabet) for _ in range(3000))
+        needles = [b"", b"zzz", haystack[-1:], haystack[-5:], haystack + b"a"]
+        for _ in range(700):
+            if rng.random() < 0.5:
+                start = rng.randrange(len(haystack))
+                needles.append(haystack[start:start + rng.randrange(1, 24)])
+            else:
+                needles.append(bytes(rng.choice(alphabet)
+                                     for _ in range(rng.randrange(1, 12))))
+
+        proc = _start_server("-t", "3", "--shutdown=drain")
+        lib = _load_ipc_lib()
+        try:
+            assert lib.ipc_init() == 0
+            hay_off = TestRegexSearch._arena_bytes(lib, haystack)
+            offs, _ = TestBulkStrings._load_strings(lib, needles)
+            out_off, out = TestMatmul._arena_array(lib, ctypes.c_int32, len(needles))
+            req = ctypes.c_uint64()
+            assert lib.ipc_search_batch(hay_off, len(haystack), offs[1], len(needles),
+                                        out_off, ctypes.byref(req)) == 0
+            expected = [haystack.find(nd) for nd in needles]
+            found = sum(1 for e in expected if e >= 0)
+            status, raw = _wait_result(lib, req.value)
+            assert (status, _result_count(raw)) == (IPC_STATUS_OK, found)
+            assert list(out) == expected
+
+            for off in offs + [hay_off, out_off]:
+                assert lib.ipc_arena_free(off) == 0
+        finally:
+            lib.ipc_cleanup()
+            if proc.poll() is None:
+                _stop_server(proc)
+            _cleanup_ipc()
+
+    def test_bad_batches_are_rejected(self):
+        """Out-of-arena needles or haystacks are invalid input; no needles is a client error."""
+        proc = _start_server("-t", "2", "--shutdown=drain")
+        lib = _load_ipc_lib()
+        try:
+            assert lib.ipc_init() == 0
+            hay_off = TestRegexSearch._arena_bytes(lib, b"haystack")
+            offs, _ = TestBulkStrings._load_strings(lib, [b"st", b"ck"])
+            out_off, _ = TestMatmul._arena_array(lib, ctypes.c_int32, 2)
+            req = ctypes.c_uint64()
+            assert lib.ipc_search_batch(hay_off, 1 << 20, offs[1], 2, out_off,
+                                        ctypes.byref(req)) == 0
+            assert _wait_result(lib, req.value)[0] == IPC_STATUS_INVALID_INPUT
+
+            refs = (ctypes.c_uint32 * 4).from_address(lib.ipc_arena_ptr(offs[1]))
+            refs[2] = 16 * 1024 * 1024 - 1
+            assert lib.ipc_search_batch(hay_off, 8, offs[1], 2, out_off,
+                                        ctypes.byref(req)) == 0
+            assert _wait_result(lib, req.value)[0] == IPC_STATUS_INVALID_INPUT
+            assert lib.ipc_search_batch(hay_off, 8, offs[1], 0, out_off,
+                                        ctypes.byref(req)) == -1
+
+            for off in offs + [hay_off, out_off]:
+                assert lib.ipc_arena_free(off) == 0
+        finally:
+            lib.ipc_cleanup()
+            if proc.poll() is None:
+                _stop_server(proc)
+            _cleanup_ipc()
+
+
+class TestResultViews:
+    """Server-allocated bulk outputs read in place through ipc_result_view()."""
+
+    @staticmethod
+    def _view(lib, request_id, timeout_sec=10.0):
+        view = IpcResultView()
+        status = ctypes.c_int()
+        deadline = time.time() + timeout_sec
+        while time.time() < deadline:
+            rc = lib.ipc_result_view(request_id, ctypes.byref(view), ctypes.byref(status))
+            if rc == 0:
+                return status.value, view
+            assert rc == IPC_NOT_READY
+            time.sleep(0.005)
+        raise AssertionError(f"Timed out waiting for request {request_id}")
+
+    def test_outputs_are_viewed_in_place_and_refcounted(self):
+        """Hash, batched search and matmul outputs arrive in server buffers."""
+        strings = [b"alpha", b"beta", b"", b"gamma" * 40] * 500
+        proc = _start_server("-t", "2", "--shutdown=drain")
+        lib = _load_ipc_lib()
+        try:
+            assert lib.ipc_init() == 0
+            offs, _ = TestBulkStrings._load_strings(lib, strings)
+            req = ctypes.c_uint64()
+            n = len(strings)
+
+            assert lib.ipc_str_hash(offs[1], n, IPC_HASH_CRC32C, 0, ctypes.byref(req)) == 0
+            status, view = self._view(lib, req.value)
+            assert status == IPC_STATUS_OK
+            assert view.count == n and view.bytes == 4 * n and view.handle % 64 == 0
+            hashes = (ctypes.c_uint32 * n).from_address(view.data)
+            assert [hashes[i] for i in range(4)] == [_crc32c(s) for s in strings[:4]]
+
+            # A second holder keeps the buffer alive after the first lets go.
+            copy = IpcResultView.from_buffer_copy(view)
+            stale = IpcResultView.from_buffer_copy(view)
+            assert lib.ipc_result_view_retain(ctypes.byref(copy)) == 0
+            assert lib.ipc_result_view_release(ctypes.byref(view)) == 0
+            assert view.handle == 0 and not view.data
+            assert hashes[3] == _crc32c(strings[3])
+            assert lib.ipc_result_view_release(ctypes.byref(copy)) == 0
+            assert lib.ipc_result_view_release(ctypes.byref(stale)) == -1
+            assert lib.ipc_result_view_release(ctypes.byref(view)) == 0
+
+            hay_off = TestRegexSearch._arena_bytes(lib, b"xxbetaxxalpha")
+            assert lib.ipc_search_batch(hay_off, 13, offs[1], 4, 0, ctypes.byref(req)) == 0
+            status, view = self._view(lib, req.value)
+            assert (status, view.count) == (IPC_STATUS_OK, 3)
+            assert list((ctypes.c_int32 * 4).from_address(view.data)) == [8, 2, 0, -1]
+            assert lib.ipc_result_view_release(ctypes.byref(view)) == 0
+
+            a_off, a = TestMatmul._arena_array(lib, ctypes.c_int32, 4)
+            a[:] = [1, 2, 3, 4]
+            assert lib.ipc_matmul(2, 2, 2, IPC_DTYPE_INT32, a_off, a_off, 0,
+                                  ctypes.byref(req)) == 0
+            status, view = self._view(lib, req.value)
+            assert status == IPC_STATUS_OK and view.bytes == 16
+            assert list((ctypes.c_int32 * 4).from_address(view.data)) == [7, 10, 15, 22]
+            assert lib.ipc_result_view_release(ctypes.byref(view)) == 0
+
+            # Caller-supplied outputs come back without a buffer.
+            assert lib.ipc_str_sort(offs[1], 4, offs[2], ctypes.byref(req)) == 0
+            status, view = self._view(lib, req.value)
+            assert (status, view.count, view.handle) == (IPC_STATUS_OK, 4, 0)
+            assert lib.ipc_result_view_release(ctypes.byref(view)) == 0
+
+            for off in offs + [hay_off, a_off]:
+                assert lib.ipc_arena_free(off) == 0
+        finally:
+            lib.ipc_cleanup()
+            if proc.poll() is None:
+                _stop_server(proc)
+            _cleanup_ipc()
+
+    def test_full_arena_reports_busy(self):
+        """No room for the output buffer is IPC_STATUS_BUSY, not a crash or bad input."""
+        proc = _start_server("-t", "2", "--shutdown=drain")
+        lib = _load_ipc_lib()
+        try:
+            assert lib.ipc_init() == 0
+            count = 1 << 19
+            refs_off, refs = TestMatmul._arena_array(lib, ctypes.c_uint32, 2 * count)
+            data_off = TestRegexSearch._arena_bytes(lib, b"s")
+            for i in range(0, 2 * count, 2):
+                refs[i] = data_off
+                refs[i + 1] = 1
+            filler = []
+            off = ctypes.c_uint64()
+            while lib.ipc_arena_alloc(1 << 20, ctypes.byref(off)) == 0:
+                filler.append(off.value)
+
+            req = ctypes.c_uint64()
+            assert lib.ipc_str_hash(refs_off, count, IPC_HASH_XXH32, 0, ctypes.byref(req)) == 0
+            status, view = self._view(lib, req.value)
+            assert (status, view.handle) == (IPC_STATUS_BUSY, 0)
+
+            for off in filler:
+                assert lib.ipc_arena_free(off) == 0
+            assert lib.ipc_str_hash(refs_off, count, IPC_HASH_XXH32, 0, ctypes.byref(req)) == 0
+            status, view = self._view(lib, req.value)
+            assert (status, view.count) == (IPC_STATUS_OK, count)
+            assert lib.ipc_result_view_release(ctypes.byref(view)) == 0
+            for off in (refs_off, data_off):
+                assert lib.ipc_arena_free(off) == 0
+        finally:
+            lib.ipc_cleanup()
+            if proc.poll() is None:
+                _stop_server(proc)
+            _cleanup_ipc()
+
+
+class TestInterning:
+    """Shared intern table and IPC_CMD_CONCAT/SEARCH_INTERNED."""
+
+    @staticmethod
+    def _intern(lib, s):
+        ident = ctypes.c_uint32()
+        assert lib.ipc_intern(s, ctypes.byref(ident)) == 0
+        return ident.value
+
+    def test_interned_ops_match_inline_ops(self):
+        """Ids are stable per string; interned concat/search equal the inline commands."""
+        hays = [b"Hello!", b"abcdefghijklmnop", b"aaaaaaaaaaaaaaab", b"abcabcabd", b"xyx"]
+        needles = [b"lo", b"a", b"p", b"mnop", b"aab", b"abd", b"yy", b"abcdefghijklmnop",
+                   b"abcd", b"x"]
+        proc = _start_server("-t", "2", "--shutdown=drain")
+        lib = _load_ipc_lib()
+        try:
+            assert lib.ipc_init() == 0
+            ids = {s: self._intern(lib, s) for s in hays + needles}
+            assert len(set(ids.values())) == len(ids)
+            assert all(self._intern(lib, s) == ident for s, ident in ids.items())
+
+            req = ctypes.c_uint64()
+            for _ in range(2):   # second round hits the cached search tables
+                for hay in hays:
+                    for needle in needles:
+                        assert lib.ipc_search_interned(ids[hay], ids[needle],
+                                                       ctypes.byref(req)) == 0
+                        status, raw = _wait_result(lib, req.value)
+                        position = int.from_bytes(raw[:4], "little", signed=True)
+                        expected = hay.find(needle)
+                        assert position == expected, (hay, needle)
+                        assert status == (IPC_STATUS_OK if expected >= 0
+                                          else IPC_STATUS_NOT_FOUND)
+
+            assert lib.ipc_concat_interned(ids[b"xyx"], ids[b"abcdefghijklmnop"],
+                                           ctypes.byref(req)) == 0
+            status, raw = _wait_result(lib, req.value)
+            assert status == IPC_STATUS_OK
+            assert raw.split(b"\0", 1)[0] == b"xyxabcdefghijklmnop"
+
+            unused = next(i for i in range(4096) if i not in ids.values())
+            assert lib.ipc_search_interned(ids[b"xyx"], unused, ctypes.byref(req)) == 0
+            assert _wait_result(lib, req.value)[0] == IPC_STATUS_INVALID_INPUT
+            assert lib.ipc_concat_interned(1 << 20, ids[b"x"], ctypes.byref(req)) == 0
+            assert _wait_result(lib, req.value)[0] == IPC_STATUS_INVALID_INPUT
+
+            ident = ctypes.c_uint32()
+            assert lib.ipc_intern(b"", ctypes.byref(ident)) == -1
+            assert lib.ipc_intern(b"a" * 17, ctypes.byref(ident)) == -1
+        finally:
+            lib.ipc_cleanup()
+            if proc.poll() is None:
+                _stop_server(proc)
+            _cleanup_ipc()
+
+    def test_concurrent_interning_agrees(self):
+        """Threads racing to intern the same strings all get the same ids."""
+        strings = [f"s{i:03d}".encode() for i in range(300)]
+        proc = _start_server("-t", "2", "--shutdown=drain")
+        lib = _load_ipc_lib()
+        try:
+            assert lib.ipc_init() == 0
+            results = [None] * 4
+
+            def worker(n):
+                order = strings if n % 2 == 0 else list(reversed(strings))
+                results[n] = {s: self._intern(lib, s) for s in order}
+
+            threads = [threading.Thread(target=worker, args=(n,)) for n in range(4)]
+            for t in threads:
+                t.start()
+            for t in threads:
+                t.join()
+            assert all(r == results[0] for r in results)
+            assert len(set(results[0].values())) == len(strings)
+        finally:
+            lib.ipc_cleanup()
+            if proc.poll() is None:
+                _stop_server(proc)
+            _cleanup_ipc()
+
+    @staticmethod
+    def _hash(s):
+        h = 2166136261
+        for b in s:
+            h = ((h ^ b) * 16777619) & 0xFFFFFFFF
+        return h
+
+    def test_busy_entries_wait_for_or_reclaim_their_inserter(self):
+        """A dead inserter's entry is taken over; a live one's is waited for."""
+        proc = _start_server("-t", "1", "--shutdown=drain")
+        lib = _load_ipc_lib()
+        shm = None
+        sleeper = None
+        try:
+            assert lib.ipc_init() == 0
+            with open(SHM_PATH, "r+b") as f:
+                shm = mmap.mmap(f.fileno(), 0)
+            # InternEntry is 32 bytes: tag, len, bytes.
+            anchor = b"anchor"
+            anchor_id = self._intern(lib, anchor)
+            ready = 0x80000000 | (self._hash(anchor) & 0x7FFFFFFF)
+            entry = shm.find(struct.pack("<IB", ready, len(anchor)) + anchor + b"\0")
+            assert entry >= 0
+            table = entry - 32 * anchor_id
+
+            def free_position(prefix):
+                for i in range(1000):
+                    s = prefix + str(i).encode()
+                    pos = self._hash(s) & 4095
+                    if struct.unpack_from("<I", shm, table + 32 * pos)[0] == 0:
+                        return s, pos
+                raise AssertionError("no free intern entry")
+
+            # ipc_intern_busy() of a process that died mid-insert.
+            dead = subprocess.Popen(["true"])
+            dead.wait()
+            orphan, pos = free_position(b"orphan")
+            struct.pack_into("<I", shm, table + 32 * pos, (dead.pid << 1) | 1)
+            assert self._intern(lib, orphan) == pos
+
+            # A live inserter of the same string: wait for it instead of
+            # publishing the string a second time further down the chain.
+            sleeper = subprocess.Popen(["sleep", "60"])
+            slow, pos = free_position(b"slow")
+            struct.pack_into("<I", shm, table + 32 * pos, (sleeper.pid << 1) | 1)
+            got = []
+            waiter = threading.Thread(target=lambda: got.append(self._intern(lib, slow)))
+            waiter.start()
+            time.sleep(0.3)
+            assert waiter.is_alive()
+            struct.pack_into("<B", shm, table + 32 * pos + 4, len(slow))
+            shm[table + 32 * pos + 5:table + 32 * pos + 6 + len(slow)] = slow + b"\0"
+            ready = 0x80000000 | (self._hash(slow) & 0x7FFFFFFF)
+            struct.pack_into("<I", shm, table + 32 * pos, ready)
+            waiter.join(5)
+            assert got == [pos]
+        finally:
+            if sleeper is not None:
+                sleeper.kill()
+                sleeper.wait()
+            if shm is not None:
+                shm.close()
+            lib.ipc_cleanup()
+            if proc.poll() is None:
+                _stop_server(proc)
+            _cleanup_ipc()
+
+
+class TestWarmRestart:
+    """Cache snapshot saved at shutdown and reloaded by the next server."""
+
+    def test_restart_reloads_interns_and_patterns(self, tmp_path):
+        """Interned ids and compiled patterns survive a restart."""
+        cache_file = f"--cache-file={tmp_path / 'cache'}"
+        proc = _start_server("-t", "2", "--shutdown=drain", cache_file)
+        lib = _load_ipc_lib()
+        regex = TestRegexSearch()
+        try:
+            assert lib.ipc_init() == 0
+            ids = {s: TestInterning._intern(lib, s) for s in (b"hello world", b"wor")}
+            assert regex._search(lib, b"w[a-z]+d", b"hello world")[0] == IPC_STATUS_OK
+            assert regex._search(lib, b"(", b"x")[0] == IPC_STATUS_INVALID_INPUT
+
+            out = _stop_server(proc)
+            assert "[SNAPSHOT] saved 2 interned string(s) and 2 regex pattern(s)" in out
+            proc = _start_server("-t", "2", "--shutdown=drain", cache_file)
+
+            cache = TestClientRegistry._status()["regex_cache"]
+            assert cache["size"] == 2 and cache["misses"] == 0
+
+            # Old ids work without interning again; interning returns them unchanged.
+            req = ctypes.c_uint64()
+            rc = lib.ipc_search_interned(ids[b"hello world"], ids[b"wor"], ctypes.byref(req))
+            if rc == IPC_ERR_SERVER_RESTARTED:
+                rc = lib.ipc_search_interned(ids[b"hello world"], ids[b"wor"],
+                                             ctypes.byref(req))
+            assert rc == 0
+            status, raw = _wait_result(lib, req.value)
+            assert status == IPC_STATUS_OK
+            assert int.from_bytes(raw[:4], "little", signed=True) == 6
+            assert all(TestInterning._intern(lib, s) == i for s, i in ids.items())
+
+            assert regex._search(lib, b"w[a-z]+d", b"a wild word") == (IPC_STATUS_OK, 2, 4)
+            cache = TestClientRegistry._status()["regex_cache"]
+            assert cache["hits"] == 1 and cache["misses"] == 0
+        finally:
+            lib.ipc_cleanup()
+            if proc.poll() is None:
+                _stop_server(proc)
+            _cleanup_ipc()
+
+    def test_corrupt_snapshot_is_ignored(self, tmp_path):
+        """A snapshot failing its checksum leaves the server cold but working."""
+        path = tmp_path / "cache"
+        cache_file = f"--cache-file={path}"
+        proc = _start_server("-t", "2", "--shutdown=drain", cache_file)
+        lib = _load_ipc_lib()
+        try:
+            assert lib.ipc_init() == 0
+            TestInterning._intern(lib, b"keep me")
+            lib.ipc_cleanup()
+            _stop_server(proc)
+
+            data = bytearray(path.read_bytes())
+            data[-1] ^= 0xFF
+            path.write_bytes(bytes(data))
+
+            proc = _start_server("-t", "2", "--shutdown=drain", cache_file)
+            assert lib.ipc_init() == 0
+            out = ctypes.c_int32()
+            assert lib.ipc_add(2, 3, ctypes.byref(out)) == 0 and out.value == 5
+            stdout = _stop_server(proc)
+            assert "[SNAPSHOT] loaded" not in stdout
+        finally:
+            lib.ipc_cleanup()
+            if proc.poll() is None:
+                _stop_server(proc)
+            _cleanup_ipc()
+
+
+class TestStreams:
+    """Streaming aggregation channels: shared rings drained by math workers."""
+
+    IPC_MAX_STREAMS = 8
+
+    @staticmethod
+    def _push_all(lib, stream_id, values):
+        arr = (ctypes.c_int32 * len(values))(*values)
+        done = 0
+        deadline = time.time() + 20.0
+        while done < len(values):
+            accepted = ctypes.c_uint32()
+            chunk = ctypes.cast(ctypes.byref(arr, 4 * done), ctypes.POINTER(ctypes.c_int32))
+            assert lib.ipc_stream_push(stream_id, chunk, len(values) - done,
+                                       ctypes.byref(accepted)) == 0
+            done += accepted.value
+            if accepted.value == 0:
+                assert time.time() < deadline, "stream ring never drained"
+                time.sleep(0.0005)
+
+    @staticmethod
+    def _check_quantile(values_sorted, q, got):
+        rank = max(1, -(-len(values_sorted) * int(q * 100) // 100))
+        exact = values_sorted[rank - 1]
+        assert abs(got - exact) <= max(1, abs(exact) * 0.0625), (q, got, exact)
+
+    def test_aggregates_match_pushed_values(self):
+        """Count/sum/min/max are exact; quantiles are within the histogram error."""
+        proc = _start_server("-t", "2", "--shutdown=drain")
+        lib = _load_ipc_lib()
+        try:
+            assert lib.ipc_init() == 0
+            sid = ctypes.c_uint32()
+            assert lib.ipc_stream_open(ctypes.byref(sid)) == 0
+
+            rng = random.Random(11)
+            values = [int(rng.lognormvariate(6, 2)) * rng.choice((1, 1, 1, -1))
+                      for _ in range(50000)]
+            values = [max(-2**31, min(2**31 - 1, v)) for v in values]
+            self._push_all(lib, sid.value, values[:20000])
+            stats = StreamStats()
+            assert lib.ipc_stream_query(sid.value, ctypes.byref(stats)) == 0
+            assert stats.count == 20000
+            assert stats.sum == sum(values[:20000])
+
+            self._push_all(lib, sid.value, values[20000:])
+            assert lib.ipc_stream_close(sid.value, ctypes.byref(stats)) == 0
+            assert stats.count == len(values)
+            assert stats.sum == sum(values)
+            assert stats.min == min(values) and stats.max == max(values)
+            assert abs(stats.mean - sum(values) / len(values)) < 1e-6
+            ordered = sorted(values)
+            self._check_quantile(ordered, 0.50, stats.p50)
+            self._check_quantile(ordered, 0.90, stats.p90)
+            self._check_quantile(ordered, 0.99, stats.p99)
+
+            # Closed streams reject pushes and queries.
+            accepted = ctypes.c_uint32()
+            one = (ctypes.c_int32 * 1)(5)
+            assert lib.ipc_stream_push(sid.value, one, 1, ctypes.byref(accepted)) == -1
+            assert lib.ipc_stream_query(sid.value, ctypes.byref(stats)) == -1
+        finally:
+            lib.ipc_cleanup()
+            if proc.poll() is None:
+                _stop_server(proc)
+            _cleanup_ipc()
+
+    def test_stream_table_exhaustion_and_reuse(self):
+        """All channels can be opened; the next open fails until one is closed."""
+        proc = _start_server("-t", "2", "--shutdown=drain")
+        lib = _load_ipc_lib()
+        try:
+            assert lib.ipc_init() == 0
+            ids = []
+            for _ in range(self.IPC_MAX_STREAMS):
+                sid = ctypes.c_uint32()
+                assert lib.ipc_stream_open(ctypes.byref(sid)) == 0
+                ids.append(sid.value)
+            assert sorted(ids) == list(range(self.IPC_MAX_STREAMS))
+            extra = ctypes.c_uint32()
+            assert lib.ipc_stream_open(ctypes.byref(extra)) == -1
+
+            self._push_all(lib, ids[3], [7, 7, 7])
+            assert lib.ipc_stream_close(ids[3], None) == 0
+            assert lib.ipc_stream_open(ctypes.byref(extra)) == 0
+            assert extra.value == ids[3]
+            stats = StreamStats()
+            assert lib.ipc_stream_query(extra.value, ctypes.byref(stats)) == 0
+            assert stats.count == 0   # reopened stream starts empty
+            for sid in ids:
+                assert lib.ipc_stream_close(sid, None) == 0
+        finally:
+            lib.ipc_cleanup()
+            if proc.poll() is None:
+                _stop_server(proc)
+            _cleanup_ipc()